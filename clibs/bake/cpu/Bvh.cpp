@@ -0,0 +1,287 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace cpubake {
+
+static constexpr uint32_t BIN_COUNT = 16;
+static constexpr uint32_t LEAF_SIZE = 4;
+static constexpr uint32_t MAX_DEPTH = 48;
+static constexpr uint32_t STACK_SIZE = 3 * MAX_DEPTH + 8;
+
+struct Bvh::BuildNode {
+    Aabb box;
+    int32_t left = -1;
+    int32_t right = -1;
+    uint32_t start = 0;
+    uint32_t count = 0;
+    bool IsLeaf() const { return left < 0; }
+};
+
+struct Bvh::Builder {
+    std::vector<Aabb> boxes;
+    std::vector<Float3> centers;
+    std::vector<uint32_t> order;
+    std::vector<BuildNode> nodes;
+
+    int32_t Split(uint32_t start, uint32_t count, uint32_t depth) {
+        const int32_t idx = (int32_t)nodes.size();
+        nodes.emplace_back();
+        Aabb box, cbox;
+        for (uint32_t i = start; i < start + count; ++i) {
+            box.Expand(boxes[order[i]]);
+            cbox.Expand(centers[order[i]]);
+        }
+        nodes[idx].box = box;
+        nodes[idx].start = start;
+        nodes[idx].count = count;
+        if (count <= LEAF_SIZE || depth >= MAX_DEPTH) {
+            return idx;
+        }
+
+        // binned SAH over the axis with the widest centroid extent
+        const Float3 extent = cbox.max - cbox.min;
+        int axis = 0;
+        if (extent.y > extent[axis]) axis = 1;
+        if (extent.z > extent[axis]) axis = 2;
+        if (extent[axis] <= 0.f) {
+            return idx;
+        }
+        const float scale = BIN_COUNT / extent[axis];
+        auto binOf = [&](uint32_t prim) {
+            const uint32_t b = (uint32_t)((centers[prim][axis] - cbox.min[axis]) * scale);
+            return std::min(b, BIN_COUNT - 1);
+        };
+        Aabb binBox[BIN_COUNT];
+        uint32_t binCount[BIN_COUNT] = {};
+        for (uint32_t i = start; i < start + count; ++i) {
+            const uint32_t b = binOf(order[i]);
+            binBox[b].Expand(boxes[order[i]]);
+            binCount[b]++;
+        }
+        float rightCost[BIN_COUNT];
+        Aabb acc;
+        uint32_t n = 0;
+        for (uint32_t b = BIN_COUNT - 1; b > 0; --b) {
+            acc.Expand(binBox[b]);
+            n += binCount[b];
+            rightCost[b] = acc.Area() * n;
+        }
+        float bestCost = box.Area() * count;
+        uint32_t bestSplit = 0;
+        acc = Aabb();
+        n = 0;
+        for (uint32_t b = 0; b < BIN_COUNT - 1; ++b) {
+            acc.Expand(binBox[b]);
+            n += binCount[b];
+            const float cost = acc.Area() * n + rightCost[b + 1];
+            if (n > 0 && n < count && cost < bestCost) {
+                bestCost = cost;
+                bestSplit = b + 1;
+            }
+        }
+        if (bestSplit == 0) {
+            return idx;
+        }
+        auto mid = std::partition(order.begin() + start, order.begin() + start + count, [&](uint32_t prim) {
+            return binOf(prim) < bestSplit;
+        });
+        const uint32_t leftCount = (uint32_t)(mid - (order.begin() + start));
+        const int32_t left = Split(start, leftCount, depth + 1);
+        const int32_t right = Split(start + leftCount, count - leftCount, depth + 1);
+        nodes[idx].left = left;
+        nodes[idx].right = right;
+        return idx;
+    }
+};
+
+void Bvh::Build(const std::vector<Triangle>& triangles) {
+    nodes.clear();
+    prims.clear();
+    if (triangles.empty()) {
+        return;
+    }
+    Builder b;
+    const uint32_t n = (uint32_t)triangles.size();
+    b.boxes.resize(n);
+    b.centers.resize(n);
+    b.order.resize(n);
+    for (uint32_t i = 0; i < n; ++i) {
+        const Triangle& t = triangles[i];
+        Aabb box;
+        box.Expand(t.p0);
+        box.Expand(t.p1);
+        box.Expand(t.p2);
+        b.boxes[i] = box;
+        b.centers[i] = (box.min + box.max) * 0.5f;
+        b.order[i] = i;
+    }
+    b.Split(0, n, 0);
+
+    prims.resize(n);
+    for (uint32_t i = 0; i < n; ++i) {
+        const Triangle& t = triangles[b.order[i]];
+        prims[i] = { t.p0, t.p1 - t.p0, t.p2 - t.p0, b.order[i] };
+    }
+
+    // collapse: every wide node takes up to four descendants of the binary node,
+    // opening the largest internal child first.
+    struct Collapser {
+        const std::vector<BuildNode>& bnodes;
+        std::vector<Node>& nodes;
+        int32_t Emit(int32_t bidx) {
+            int32_t lanes[4];
+            int laneCount = 0;
+            const BuildNode& root = bnodes[bidx];
+            if (root.IsLeaf()) {
+                lanes[laneCount++] = bidx;
+            }
+            else {
+                lanes[laneCount++] = root.left;
+                lanes[laneCount++] = root.right;
+            }
+            while (laneCount < 4) {
+                int best = -1;
+                float bestArea = -1.f;
+                for (int i = 0; i < laneCount; ++i) {
+                    const BuildNode& c = bnodes[lanes[i]];
+                    if (!c.IsLeaf() && c.box.Area() > bestArea) {
+                        best = i;
+                        bestArea = c.box.Area();
+                    }
+                }
+                if (best < 0) {
+                    break;
+                }
+                const BuildNode& c = bnodes[lanes[best]];
+                lanes[best] = c.left;
+                lanes[laneCount++] = c.right;
+            }
+            const int32_t idx = (int32_t)nodes.size();
+            nodes.emplace_back();
+            for (int i = 0; i < 4; ++i) {
+                Aabb box;
+                int32_t child = -1;
+                uint32_t count = 0;
+                if (i < laneCount) {
+                    const BuildNode& c = bnodes[lanes[i]];
+                    box = c.box;
+                    if (c.IsLeaf()) {
+                        child = (int32_t)c.start;
+                        count = c.count;
+                    }
+                    else {
+                        child = Emit(lanes[i]);
+                    }
+                }
+                Node& node = nodes[idx];
+                node.minx[i] = box.min.x; node.miny[i] = box.min.y; node.minz[i] = box.min.z;
+                node.maxx[i] = box.max.x; node.maxy[i] = box.max.y; node.maxz[i] = box.max.z;
+                node.child[i] = child;
+                node.count[i] = count;
+            }
+            return idx;
+        }
+    };
+    Collapser { b.nodes, nodes }.Emit(0);
+}
+
+static inline bool IntersectTriangle(const Float3& org, const Float3& dir, const Float3& p0, const Float3& e1, const Float3& e2, float tmin, float tmax, float& t, float& u, float& v) {
+    const Float3 pv = Cross(dir, e2);
+    const float det = Dot(e1, pv);
+    if (std::fabs(det) < 1e-12f) {
+        return false;
+    }
+    const float inv = 1.f / det;
+    const Float3 tv = org - p0;
+    u = Dot(tv, pv) * inv;
+    if (u < 0.f || u > 1.f) {
+        return false;
+    }
+    const Float3 qv = Cross(tv, e1);
+    v = Dot(dir, qv) * inv;
+    if (v < 0.f || u + v > 1.f) {
+        return false;
+    }
+    t = Dot(e2, qv) * inv;
+    return t > tmin && t < tmax;
+}
+
+template <bool AnyHit>
+bool Bvh::Traverse(const Ray& ray, Hit& hit) const {
+    if (nodes.empty()) {
+        return false;
+    }
+    const float ox = ray.org.x, oy = ray.org.y, oz = ray.org.z;
+    const float ix = 1.f / ray.dir.x, iy = 1.f / ray.dir.y, iz = 1.f / ray.dir.z;
+    float tmax = ray.tmax;
+    bool found = false;
+
+    int32_t stack[STACK_SIZE];
+    uint32_t sp = 0;
+    stack[sp++] = 0;
+    while (sp > 0) {
+        const Node& node = nodes[stack[--sp]];
+        float tnear[4];
+        bool overlap[4];
+        for (int i = 0; i < 4; ++i) {
+            const float x0 = (node.minx[i] - ox) * ix, x1 = (node.maxx[i] - ox) * ix;
+            const float y0 = (node.miny[i] - oy) * iy, y1 = (node.maxy[i] - oy) * iy;
+            const float z0 = (node.minz[i] - oz) * iz, z1 = (node.maxz[i] - oz) * iz;
+            const float tn = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), ray.tmin));
+            const float tf = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), tmax));
+            tnear[i] = tn;
+            overlap[i] = tn <= tf;
+        }
+        // push the far children first, so the nearest one is visited next
+        int order[4];
+        int n = 0;
+        for (int i = 0; i < 4; ++i) {
+            if (!overlap[i] || node.child[i] < 0) {
+                continue;
+            }
+            if (node.count[i] > 0) {
+                const uint32_t first = (uint32_t)node.child[i];
+                for (uint32_t p = first; p < first + node.count[i]; ++p) {
+                    const Prim& prim = prims[p];
+                    float t, u, v;
+                    if (IntersectTriangle(ray.org, ray.dir, prim.p0, prim.e1, prim.e2, ray.tmin, tmax, t, u, v)) {
+                        if (AnyHit) {
+                            return true;
+                        }
+                        found = true;
+                        tmax = t;
+                        hit.t = t;
+                        hit.u = u;
+                        hit.v = v;
+                        hit.prim = prim.id;
+                    }
+                }
+                continue;
+            }
+            int j = n++;
+            while (j > 0 && tnear[order[j - 1]] < tnear[i]) {
+                order[j] = order[j - 1];
+                --j;
+            }
+            order[j] = i;
+        }
+        for (int i = 0; i < n; ++i) {
+            assert(sp < STACK_SIZE);
+            stack[sp++] = node.child[order[i]];
+        }
+    }
+    return found;
+}
+
+bool Bvh::Intersect(const Ray& ray, Hit& hit) const {
+    return Traverse<false>(ray, hit);
+}
+
+bool Bvh::Occluded(const Ray& ray) const {
+    Hit hit;
+    return Traverse<true>(ray, hit);
+}
+
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+
+namespace cpubake {
+
+struct Float2 {
+    float x = 0.f, y = 0.f;
+};
+
+struct Float3 {
+    float x = 0.f, y = 0.f, z = 0.f;
+    Float3() = default;
+    Float3(float v) : x(v), y(v), z(v) {}
+    Float3(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
+
+    float  operator[](int i) const { return (&x)[i]; }
+    float& operator[](int i) { return (&x)[i]; }
+    Float3 operator-() const { return Float3(-x, -y, -z); }
+    Float3& operator+=(const Float3& v) { x += v.x; y += v.y; z += v.z; return *this; }
+    Float3& operator*=(float s) { x *= s; y *= s; z *= s; return *this; }
+};
+
+inline Float3 operator+(const Float3& a, const Float3& b) { return Float3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline Float3 operator-(const Float3& a, const Float3& b) { return Float3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline Float3 operator*(const Float3& a, const Float3& b) { return Float3(a.x * b.x, a.y * b.y, a.z * b.z); }
+inline Float3 operator*(const Float3& a, float s) { return Float3(a.x * s, a.y * s, a.z * s); }
+inline Float3 operator*(float s, const Float3& a) { return a * s; }
+inline float Dot(const Float3& a, const Float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Float3 Cross(const Float3& a, const Float3& b) {
+    return Float3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+inline float Length(const Float3& v) { return std::sqrt(Dot(v, v)); }
+inline Float3 Normalize(const Float3& v) {
+    const float l = Length(v);
+    return l > 0.f ? v * (1.f / l) : v;
+}
+inline Float3 Min(const Float3& a, const Float3& b) { return Float3(std::fmin(a.x, b.x), std::fmin(a.y, b.y), std::fmin(a.z, b.z)); }
+inline Float3 Max(const Float3& a, const Float3& b) { return Float3(std::fmax(a.x, b.x), std::fmax(a.y, b.y), std::fmax(a.z, b.z)); }
+
+struct Aabb {
+    Float3 min = Float3(INFINITY);
+    Float3 max = Float3(-INFINITY);
+    void Expand(const Float3& p) { min = Min(min, p); max = Max(max, p); }
+    void Expand(const Aabb& b) { min = Min(min, b.min); max = Max(max, b.max); }
+    float Area() const {
+        const Float3 d = max - min;
+        return (d.x < 0.f) ? 0.f : 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+};
+
+struct Triangle {
+    Float3 p0, p1, p2;
+};
+
+struct Ray {
+    Float3 org;
+    Float3 dir;
+    float tmin = 0.f;
+    float tmax = INFINITY;
+};
+
+struct Hit {
+    float t = INFINITY;
+    float u = 0.f;
+    float v = 0.f;
+    uint32_t prim = UINT32_MAX;
+};
+
+// 4-wide bounding volume hierarchy. Every node stores the boxes of its four children
+// as structure of arrays, so one ray is tested against all four with straight-line
+// float code the compiler vectorizes. Built with binned SAH, then collapsed from a
+// binary tree. Read-only after Build(), so it can be traversed from any thread.
+class Bvh {
+public:
+    void Build(const std::vector<Triangle>& triangles);
+    bool Intersect(const Ray& ray, Hit& hit) const;
+    bool Occluded(const Ray& ray) const;
+    size_t NodeCount() const { return nodes.size(); }
+private:
+    struct Node {
+        float minx[4], miny[4], minz[4];
+        float maxx[4], maxy[4], maxz[4];
+        // internal child: node index with count == 0, leaf: first primitive and count
+        int32_t child[4];
+        uint32_t count[4];
+    };
+    struct Prim {
+        Float3 p0, e1, e2;
+        uint32_t id;
+    };
+    struct BuildNode;
+    struct Builder;
+
+    template <bool AnyHit>
+    bool Traverse(const Ray& ray, Hit& hit) const;
+
+    std::vector<Node> nodes;
+    std::vector<Prim> prims;
+};
+
+}
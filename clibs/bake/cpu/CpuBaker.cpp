@@ -0,0 +1,307 @@
+#include "CpuBaker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace cpubake {
+
+static constexpr float PI = 3.14159265358979f;
+static constexpr size_t TEXEL_BATCH = 64;
+
+struct Baker::Texel {
+    uint32_t index;
+    Float3 pos;
+    Float3 normal;
+};
+
+static inline uint32_t Hash(uint32_t v) {
+    // pcg
+    uint32_t state = v * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+static inline float Random(uint32_t& rng) {
+    rng = Hash(rng);
+    return (rng >> 8) * (1.f / 16777216.f);
+}
+
+static inline void Basis(const Float3& n, Float3& t, Float3& b) {
+    const float sign = std::copysign(1.f, n.z);
+    const float a = -1.f / (sign + n.z);
+    const float c = n.x * n.y * a;
+    t = Float3(1.f + sign * n.x * n.x * a, sign * c, -sign * n.x);
+    b = Float3(c, sign + n.y * n.y * a, -n.y);
+}
+
+static inline Float3 CosineSample(const Float3& n, uint32_t& rng) {
+    const float r1 = Random(rng);
+    const float r2 = Random(rng);
+    const float phi = 2.f * PI * r1;
+    const float r = std::sqrt(r2);
+    Float3 t, b;
+    Basis(n, t, b);
+    return Normalize(t * (r * std::cos(phi)) + b * (r * std::sin(phi)) + n * std::sqrt(std::max(0.f, 1.f - r2)));
+}
+
+static inline Float3 ConeSample(const Float3& axis, float angle, uint32_t& rng) {
+    const float cosmax = std::cos(angle);
+    const float cost = 1.f - Random(rng) * (1.f - cosmax);
+    const float sint = std::sqrt(std::max(0.f, 1.f - cost * cost));
+    const float phi = 2.f * PI * Random(rng);
+    Float3 t, b;
+    Basis(axis, t, b);
+    return Normalize(t * (sint * std::cos(phi)) + b * (sint * std::sin(phi)) + axis * cost);
+}
+
+static inline Float3 SphereSample(uint32_t& rng) {
+    const float z = 1.f - 2.f * Random(rng);
+    const float r = std::sqrt(std::max(0.f, 1.f - z * z));
+    const float phi = 2.f * PI * Random(rng);
+    return Float3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+static inline float Saturate(float v) {
+    return std::min(std::max(v, 0.f), 1.f);
+}
+
+static inline float Smoothstep(float e0, float e1, float x) {
+    const float t = Saturate((x - e0) / (e1 - e0));
+    return t * t * (3.f - 2.f * t);
+}
+
+Baker::Baker(Scene s)
+    : scene(std::move(s)) {
+    std::vector<Triangle> triangles;
+    for (uint32_t m = 0; m < scene.meshes.size(); ++m) {
+        const Mesh& mesh = scene.meshes[m];
+        for (uint32_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            triangles.push_back({
+                mesh.positions[mesh.indices[i + 0]],
+                mesh.positions[mesh.indices[i + 1]],
+                mesh.positions[mesh.indices[i + 2]],
+            });
+            primMesh.push_back(m);
+            primFirst.push_back(i);
+        }
+    }
+    bvh.Build(triangles);
+}
+
+void Baker::Rasterize(uint32_t meshidx, std::vector<Texel>& texels) const {
+    const Mesh& mesh = scene.meshes[meshidx];
+    const int size = (int)mesh.size;
+    std::vector<bool> covered(size * size, false);
+    for (uint32_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        const uint32_t i0 = mesh.indices[i + 0], i1 = mesh.indices[i + 1], i2 = mesh.indices[i + 2];
+        const Float2 a { mesh.uvs[i0].x * size, mesh.uvs[i0].y * size };
+        const Float2 b { mesh.uvs[i1].x * size, mesh.uvs[i1].y * size };
+        const Float2 c { mesh.uvs[i2].x * size, mesh.uvs[i2].y * size };
+        const float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+        if (std::fabs(area) < 1e-12f) {
+            continue;
+        }
+        const int x0 = std::max(0, (int)std::floor(std::min({ a.x, b.x, c.x })));
+        const int y0 = std::max(0, (int)std::floor(std::min({ a.y, b.y, c.y })));
+        const int x1 = std::min(size - 1, (int)std::ceil(std::max({ a.x, b.x, c.x })));
+        const int y1 = std::min(size - 1, (int)std::ceil(std::max({ a.y, b.y, c.y })));
+        const float inv = 1.f / area;
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                const uint32_t index = y * size + x;
+                if (covered[index]) {
+                    continue;
+                }
+                const float px = x + 0.5f, py = y + 0.5f;
+                const float w1 = ((px - a.x) * (c.y - a.y) - (c.x - a.x) * (py - a.y)) * inv;
+                const float w2 = ((b.x - a.x) * (py - a.y) - (px - a.x) * (b.y - a.y)) * inv;
+                const float w0 = 1.f - w1 - w2;
+                if (w0 < 0.f || w1 < 0.f || w2 < 0.f) {
+                    continue;
+                }
+                covered[index] = true;
+                Texel t;
+                t.index = index;
+                t.pos = mesh.positions[i0] * w0 + mesh.positions[i1] * w1 + mesh.positions[i2] * w2;
+                t.normal = Normalize(mesh.normals[i0] * w0 + mesh.normals[i1] * w1 + mesh.normals[i2] * w2);
+                texels.push_back(t);
+            }
+        }
+    }
+}
+
+bool Baker::Trace(const Float3& org, const Float3& dir, float bias, Surface& s) const {
+    Ray ray;
+    ray.org = org;
+    ray.dir = dir;
+    ray.tmin = bias;
+    Hit hit;
+    if (!bvh.Intersect(ray, hit)) {
+        return false;
+    }
+    const uint32_t m = primMesh[hit.prim];
+    const uint32_t first = primFirst[hit.prim];
+    const Mesh& mesh = scene.meshes[m];
+    const uint32_t i0 = mesh.indices[first + 0], i1 = mesh.indices[first + 1], i2 = mesh.indices[first + 2];
+    const float w0 = 1.f - hit.u - hit.v;
+    s.pos = org + dir * hit.t;
+    s.normal = Normalize(mesh.normals[i0] * w0 + mesh.normals[i1] * hit.u + mesh.normals[i2] * hit.v);
+    s.mesh = m;
+    return true;
+}
+
+Float3 Baker::DirectLight(const Float3& pos, const Float3& normal, const Settings& settings, uint32_t& rng) const {
+    Float3 e;
+    for (const Light& l : scene.lights) {
+        Ray ray;
+        ray.org = pos;
+        ray.tmin = settings.bias;
+        float atten = 1.f;
+        if (l.type == Light::Directional) {
+            const Float3 dir = Normalize(l.dir);
+            ray.dir = l.radius > 0.f ? ConeSample(dir, l.radius, rng) : dir;
+        }
+        else {
+            Float3 target = l.pos;
+            if (l.radius > 0.f) {
+                target += SphereSample(rng) * l.radius;
+            }
+            const Float3 pt2l = target - pos;
+            const float dist = Length(pt2l);
+            if (dist <= settings.bias) {
+                continue;
+            }
+            const float ratio = l.range > 0.f ? dist / l.range : 0.f;
+            atten = Saturate(1.f - ratio * ratio * ratio * ratio) / (dist * dist);
+            ray.dir = pt2l * (1.f / dist);
+            ray.tmax = dist - settings.bias;
+            if (l.type == Light::Spot) {
+                atten *= Smoothstep(l.outter_cutoff, l.inner_cutoff, Dot(Normalize(l.dir), ray.dir));
+            }
+        }
+        const float ndotl = Dot(normal, ray.dir);
+        if (ndotl <= 0.f || atten <= 0.f) {
+            continue;
+        }
+        if (bvh.Occluded(ray)) {
+            continue;
+        }
+        e += l.color * (ndotl * atten);
+    }
+    return e;
+}
+
+Float3 Baker::Irradiance(const Float3& pos, const Float3& normal, const Settings& settings, uint32_t& rng) const {
+    Float3 indirect;
+    const uint32_t samples = std::max(settings.samples, 1u);
+    for (uint32_t s = 0; s < samples; ++s) {
+        // path traced incoming radiance, cosine weighted so the estimator is a plain average
+        Float3 org = pos;
+        Float3 dir = CosineSample(normal, rng);
+        Float3 throughput(1.f);
+        Float3 radiance;
+        for (uint32_t depth = 0;; ++depth) {
+            Surface surf;
+            if (!Trace(org, dir, settings.bias, surf)) {
+                radiance += throughput * scene.sky;
+                break;
+            }
+            if (Dot(surf.normal, dir) > 0.f) {
+                // the back of a surface, the ray is inside a closed mesh
+                break;
+            }
+            const Mesh& mesh = scene.meshes[surf.mesh];
+            radiance += throughput * mesh.emissive;
+            throughput = throughput * mesh.albedo;
+            const Float3 offset = surf.pos + surf.normal * settings.bias;
+            radiance += throughput * DirectLight(offset, surf.normal, settings, rng) * (1.f / PI);
+            if (depth >= settings.bounces) {
+                break;
+            }
+            org = offset;
+            dir = CosineSample(surf.normal, rng);
+        }
+        indirect += radiance;
+    }
+    return indirect * (1.f / samples) + DirectLight(pos, normal, settings, rng) * (1.f / PI);
+}
+
+static void Dilate(Texels& texels, uint32_t size, uint32_t iterations) {
+    Texels src;
+    for (uint32_t it = 0; it < iterations; ++it) {
+        src = texels;
+        for (uint32_t y = 0; y < size; ++y) {
+            for (uint32_t x = 0; x < size; ++x) {
+                Float4& t = texels[y * size + x];
+                if (t.w > 0.f) {
+                    continue;
+                }
+                Float4 sum;
+                for (int dy = -1; dy <= 1; ++dy) {
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        const int nx = (int)x + dx, ny = (int)y + dy;
+                        if (nx < 0 || ny < 0 || nx >= (int)size || ny >= (int)size) {
+                            continue;
+                        }
+                        const Float4& n = src[ny * size + nx];
+                        if (n.w > 0.f) {
+                            sum.x += n.x; sum.y += n.y; sum.z += n.z; sum.w += 1.f;
+                        }
+                    }
+                }
+                if (sum.w > 0.f) {
+                    t = { sum.x / sum.w, sum.y / sum.w, sum.z / sum.w, 1.f };
+                }
+            }
+        }
+    }
+}
+
+void Baker::Bake(const Settings& settings, std::vector<Texels>& result) const {
+    result.resize(scene.meshes.size());
+    uint32_t threads = settings.threads;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (uint32_t m = 0; m < scene.meshes.size(); ++m) {
+        const uint32_t size = scene.meshes[m].size;
+        Texels& out = result[m];
+        out.assign(size * size, Float4 {});
+        if (size == 0) {
+            continue;
+        }
+        std::vector<Texel> texels;
+        Rasterize(m, texels);
+
+        std::atomic<size_t> next { 0 };
+        auto worker = [&]() {
+            for (;;) {
+                const size_t first = next.fetch_add(TEXEL_BATCH);
+                if (first >= texels.size()) {
+                    break;
+                }
+                const size_t last = std::min(first + TEXEL_BATCH, texels.size());
+                for (size_t i = first; i < last; ++i) {
+                    const Texel& t = texels[i];
+                    uint32_t rng = Hash(Hash(settings.seed ^ Hash(m)) + t.index);
+                    const Float3 pos = t.pos + t.normal * settings.bias;
+                    const Float3 e = Irradiance(pos, t.normal, settings, rng);
+                    out[t.index] = { e.x, e.y, e.z, 1.f };
+                }
+            }
+        };
+        const uint32_t n = (uint32_t)std::min<size_t>(threads, (texels.size() + TEXEL_BATCH - 1) / TEXEL_BATCH);
+        std::vector<std::thread> pool;
+        for (uint32_t i = 1; i < n; ++i) {
+            pool.emplace_back(worker);
+        }
+        worker();
+        for (auto& t : pool) {
+            t.join();
+        }
+        Dilate(out, size, settings.dilate);
+    }
+}
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Bvh.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace cpubake {
+
+struct Float4 {
+    float x = 0.f, y = 0.f, z = 0.f, w = 0.f;
+};
+
+// world space geometry of one lightmapped mesh
+struct Mesh {
+    std::vector<Float3>   positions;
+    std::vector<Float3>   normals;
+    std::vector<Float2>   uvs;          // lightmap uv
+    std::vector<uint32_t> indices;
+    uint32_t size = 0;                  // lightmap resolution, 0 means the mesh only occludes
+    Float3 albedo = Float3(0.8f);
+    Float3 emissive = Float3(0.f);
+};
+
+// same conventions as pbr/lighting.sh: `dir` of a directional light points to the light,
+// cutoffs are cosines, `color` is premultiplied by the intensity.
+struct Light {
+    enum Type {
+        Directional = 0,
+        Point,
+        Spot,
+        Area,
+    };
+    Type   type = Directional;
+    Float3 pos;
+    Float3 dir;
+    Float3 color;
+    float  range = 0.f;
+    float  inner_cutoff = 0.f;
+    float  outter_cutoff = 0.f;
+    float  radius = 0.f;                // angular radius of a directional light, sphere radius otherwise
+};
+
+struct Scene {
+    std::vector<Mesh>  meshes;
+    std::vector<Light> lights;
+    Float3 sky;
+};
+
+struct Settings {
+    uint32_t samples = 64;              // hemisphere samples per texel
+    uint32_t bounces = 2;
+    uint32_t threads = 0;               // 0 means all hardware threads
+    uint32_t dilate = 2;                // texels to grow the charts by
+    uint32_t seed = 0;
+    float bias = 1e-3f;
+};
+
+// lightmap of one mesh, size * size texels, rgb is the irradiance divided by pi
+// (outgoing radiance is albedo * rgb), w is 1 for texels covered by the mesh or its dilation.
+using Texels = std::vector<Float4>;
+
+// The result only depends on the scene and the settings, never on the thread count:
+// every texel draws its random numbers from a hash of its own coordinates.
+class Baker {
+public:
+    explicit Baker(Scene scene);
+    void Bake(const Settings& settings, std::vector<Texels>& result) const;
+    const Bvh& GetBvh() const { return bvh; }
+private:
+    struct Texel;
+    struct Surface {
+        Float3 pos;
+        Float3 normal;
+        uint32_t mesh;
+    };
+    void Rasterize(uint32_t meshidx, std::vector<Texel>& texels) const;
+    Float3 DirectLight(const Float3& pos, const Float3& normal, const Settings& settings, uint32_t& rng) const;
+    Float3 Irradiance(const Float3& pos, const Float3& normal, const Settings& settings, uint32_t& rng) const;
+    bool Trace(const Float3& org, const Float3& dir, float bias, Surface& s) const;
+
+    Scene scene;
+    Bvh bvh;
+    std::vector<uint32_t> primMesh;     // bvh primitive -> mesh
+    std::vector<uint32_t> primFirst;    // bvh primitive -> first index in mesh
+};
+
+}
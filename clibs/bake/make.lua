@@ -1,46 +1,32 @@
-do return end
-
 local lm = require "luamake"
-local fs = require "bee.filesystem"
-
-lm.defines = lm.mode ~= "release" and "_DEBUG"
 
-lm:source_set "Meshbaker" {
-    confs = { "glm" },
-    includes = {},
-    sources = {
-        "./path_tracer/BakerInterface.cpp"
-    },
-    defines = {
-        "_UNICODE",
-        "UNICODE",
-    },
-    cxx = "c++14",
-    linkdirs = {},
+local sources = {
+    "cpu/Bvh.cpp",
+    "cpu/CpuBaker.cpp",
 }
 
-local inputpaths = {}
-
-local outputpaths = {}
-
-for idx, d in ipairs(inputpaths) do
-    outputpaths[idx] = "$bin/" .. fs.path(d):filename():string()
-end
-
 lm:lua_src "bake" {
+    confs = { "glm" },
     includes = {
-        GLMInclude,
+        lm.AntDir .. "/3rd/bee.lua",
         "../luabind",
-        "../bgfx",
     },
     sources = {
-        "./path_tracer/lbake.cpp",
+        sources,
+        "path_tracer/BakerInterface.cpp",
+        "path_tracer/lbake.cpp",
+    },
+    msvc = {
+        flags = "/Zc:preprocessor",
     },
-    deps = {}
 }
 
-lm:source_set "radiosity_lightmapper" {
+lm:exe "bake_test" {
     sources = {
-        "radiosity/lightmapper.cpp",
-    }
+        sources,
+        "test/cornell_box.cpp",
+    },
+    linux = {
+        links = "pthread",
+    },
 }
@@ -34,6 +34,8 @@ struct MaterialData{
     std::string normal;
     std::string roughness;
     std::string metallic;
+    glm::vec4   basecolor = glm::vec4(1.f);
+    glm::vec3   emissive = glm::vec3(0.f);
 };
 
 enum BufferType {
@@ -79,9 +81,9 @@ struct Sky{
         SimpleColor = 0,
         CubeMap = 1,
     };
-    SkyType     type;
+    SkyType     type = SimpleColor;
     std::string cubemapTexture;
-    glm::vec3   skyColor;
+    glm::vec3   skyColor = glm::vec3(0.f);
 };
 
 struct Scene {
@@ -101,6 +103,12 @@ struct BakeResult {
     std::vector<LightmapResult> lightmaps;
 };
 
+struct BakeSettings {
+    uint32_t samples = 64;
+    uint32_t bounces = 2;
+    uint32_t threads = 0;   // 0 means all hardware threads
+};
+
 extern BakerHandle CreateBaker(const Scene* scene);
-extern void Bake(BakerHandle handle, BakeResult *result);
+extern void Bake(BakerHandle handle, BakeResult *result, const BakeSettings &settings = BakeSettings());
 extern void DestroyBaker(BakerHandle handle);
\ No newline at end of file
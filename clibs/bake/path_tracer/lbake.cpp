@@ -2,126 +2,163 @@
 #include "BakerInterface.h"
 
 #include "lua2struct.h"
-#include "luabgfx.h"
+
+template <typename T>
+static T get_field(lua_State *L, int idx, const char* name){
+    lua_getfield(L, idx, name);
+    T v = lua_struct::unpack<T>(L, -1);
+    lua_pop(L, 1);
+    return v;
+}
+
+template <typename T>
+static void get_field_opt(lua_State *L, int idx, const char* name, T &v){
+    if (lua_getfield(L, idx, name) != LUA_TNIL){
+        v = lua_struct::unpack<T>(L, -1);
+    }
+    lua_pop(L, 1);
+}
+
+template <typename T>
+static T get_vector(lua_State *L, int idx, int n){
+    idx = lua_absindex(L, idx);
+    luaL_checktype(L, idx, LUA_TTABLE);
+    T v;
+    float *vv = &v[0];
+    for (int ii=0; ii<n; ++ii){
+        lua_geti(L, idx, ii+1);
+        vv[ii] = (float)lua_tonumber(L, -1);
+        lua_pop(L, 1);
+    }
+    return v;
+}
 
 namespace lua_struct {
     template<>
-    inline void unpack<glm::vec3>(lua_State *L, int idx, glm::vec3 &v, void*){
-        luaL_checktype(L, idx, LUA_TTABLE);
-        for (int ii=0; ii<3; ++ii){
-            lua_geti(L, idx, ii+1);
-            v[ii] = (float)lua_tonumber(L, -1);
-            lua_pop(L, 1);
-        }
+    inline glm::vec3 unpack<glm::vec3>(lua_State *L, int idx){
+        return get_vector<glm::vec3>(L, idx, 3);
     }
 
     template<>
-    inline void unpack<glm::vec4>(lua_State *L, int idx, glm::vec4 &v, void*){
-        luaL_checktype(L, idx, LUA_TTABLE);
-        for (int ii=0; ii<4; ++ii){
-            lua_geti(L, idx, ii+1);
-            v[ii] = (float)lua_tonumber(L, -1);
-            lua_pop(L, 1);
-        }
+    inline glm::vec4 unpack<glm::vec4>(lua_State *L, int idx){
+        return get_vector<glm::vec4>(L, idx, 4);
     }
 
     template<>
-    inline void unpack<glm::mat4>(lua_State *L, int idx, glm::mat4 &v, void*){
+    inline glm::mat4 unpack<glm::mat4>(lua_State *L, int idx){
+        idx = lua_absindex(L, idx);
         luaL_checktype(L, idx, LUA_TTABLE);
+        glm::mat4 v;
         float *vv = &v[0].x;
         for (int ii=0; ii<16; ++ii){
             lua_geti(L, idx, ii+1);
             vv[ii] = (float)lua_tonumber(L, -1);
             lua_pop(L, 1);
         }
+        return v;
     }
 
     template <>
-    inline void unpack<BufferData>(lua_State* L, int idx, BufferData& v, void*) {
+    inline BufferData unpack<BufferData>(lua_State* L, int idx) {
+        idx = lua_absindex(L, idx);
         luaL_checktype(L, idx, LUA_TTABLE);
-        unpack_field(L, idx, "data", v.data);
-        unpack_field(L, idx, "offset", v.offset);
-        unpack_field(L, idx, "stride", v.stride);
-        const char* type = nullptr;
-        unpack_field(L, idx, "type", type);
-        switch (type[0]){
+        BufferData v;
+        lua_getfield(L, idx, "data");
+        v.data = lua_type(L, -1) == LUA_TSTRING ? lua_tostring(L, -1) : (const char*)lua_touserdata(L, -1);
+        lua_pop(L, 1);
+        v.offset = get_field<uint32_t>(L, idx, "offset");
+        v.stride = get_field<uint32_t>(L, idx, "stride");
+        auto type = get_field<std::string_view>(L, idx, "type");
+        switch (type.empty() ? '\0' : type[0]){
             case 'B': v.type = BT_Byte; break;
             case 'H': v.type = BT_Uint16; break;
             case 'I': v.type = BT_Uint32; break;
             case 'f': v.type = BT_Float; break;
             case '\0':v.type = BT_None; break;
-            default: luaL_error(L, "invalid data type:%s", type);
+            default: luaL_error(L, "invalid data type:%s", type.data());
         }
+        return v;
     }
 
     template <>
-    inline void unpack<MeshData>(lua_State* L, int idx, MeshData& v, void*) {
+    inline MeshData unpack<MeshData>(lua_State* L, int idx) {
+        idx = lua_absindex(L, idx);
         luaL_checktype(L, idx, LUA_TTABLE);
-        unpack_field(L, idx, "worldmat", v.worldmat);
-        unpack_field(L, idx, "normalmat", v.normalmat);
+        MeshData v;
+        v.worldmat  = get_field<glm::mat4>(L, idx, "worldmat");
+        v.normalmat = get_field<glm::mat4>(L, idx, "normalmat");
 
-        unpack_field(L, idx, "positions", v.positions);
-        unpack_field(L, idx, "normals",   v.normals);
+        v.positions = get_field<BufferData>(L, idx, "positions");
+        v.normals   = get_field<BufferData>(L, idx, "normals");
         v.tangents.type = BT_None;
-        unpack_field_opt(L, idx, "tangents", v.tangents);
+        get_field_opt(L, idx, "tangents", v.tangents);
         v.bitangents.type = BT_None;
-        unpack_field_opt(L, idx, "bitangents", v.bitangents);
+        get_field_opt(L, idx, "bitangents", v.bitangents);
 
-        unpack_field(L, idx, "texcoords0", v.texcoords0);
+        v.texcoords0 = get_field<BufferData>(L, idx, "texcoords0");
 
         v.texcoords1.type = BT_None;
-        unpack_field_opt(L, idx, "texcoords1", v.texcoords1);
+        get_field_opt(L, idx, "texcoords1", v.texcoords1);
         if (v.texcoords1.type == BT_None){
             v.texcoords1 = v.texcoords0;
         }
 
-        unpack_field(L, idx, "vertexCount", v.vertexCount);
+        v.vertexCount = get_field<uint32_t>(L, idx, "vertexCount");
 
         // for indices
         v.indices.type = BT_None;
-        unpack_field_opt(L, idx, "indices", v.indices);
+        get_field_opt(L, idx, "indices", v.indices);
         v.indexCount = 0;
-        unpack_field_opt(L, idx, "indexCount", v.indexCount);
+        get_field_opt(L, idx, "indexCount", v.indexCount);
 
-        unpack_field(L, idx, "materialidx", v.materialidx);
-        assert(v.materialidx > 0);
+        v.materialidx = get_field<uint32_t>(L, idx, "materialidx");
+        if (v.materialidx == 0){
+            luaL_error(L, "invalid materialidx, it is 1 based");
+        }
         --v.materialidx;
 
-        unpack_field(L, idx, "lightmap", v.lightmap);
+        v.lightmap = get_field<Lightmap>(L, idx, "lightmap");
+        return v;
     }
 
     template <>
-    inline void unpack<MaterialData>(lua_State* L, int idx, MaterialData& v, void*) {
+    inline MaterialData unpack<MaterialData>(lua_State* L, int idx) {
+        idx = lua_absindex(L, idx);
         luaL_checktype(L, idx, LUA_TTABLE);
-        unpack_field_opt(L, idx, "diffuse", v.diffuse);
-        unpack_field_opt(L, idx, "normal", v.normal);
-        unpack_field_opt(L, idx, "roughness", v.roughness);
-        unpack_field_opt(L, idx, "metallic",   v.metallic);
+        MaterialData v;
+        get_field_opt(L, idx, "diffuse", v.diffuse);
+        get_field_opt(L, idx, "normal", v.normal);
+        get_field_opt(L, idx, "roughness", v.roughness);
+        get_field_opt(L, idx, "metallic",   v.metallic);
+        get_field_opt(L, idx, "basecolor", v.basecolor);
+        get_field_opt(L, idx, "emissive", v.emissive);
+        return v;
     }
 
     template <>
-    inline void unpack<Light>(lua_State* L, int idx, Light& v, void*) {
+    inline Light unpack<Light>(lua_State* L, int idx) {
+        idx = lua_absindex(L, idx);
         luaL_checktype(L, idx, LUA_TTABLE);
-        unpack_field(L, idx, "dir", v.dir);
-        unpack_field(L, idx, "pos", v.pos);
-        unpack_field(L, idx, "color", v.color);
-
-        unpack_field(L, idx, "intensity", v.intensity);
-        unpack_field(L, idx, "range", v.range);
-        unpack_field(L, idx, "inner_cutoff", v.inner_cutoff);
-        unpack_field(L, idx, "outter_cutoff", v.outter_cutoff);
-        unpack_field(L, idx, "angular_radius", v.angular_radius);
-
-        const char* type = nullptr;
-        unpack_field(L, idx, "type", type);
-        if (strcmp(type, "directional") == 0){
+        Light v;
+        v.dir   = get_field<glm::vec3>(L, idx, "dir");
+        v.pos   = get_field<glm::vec3>(L, idx, "pos");
+        v.color = get_field<glm::vec3>(L, idx, "color");
+
+        v.intensity     = get_field<float>(L, idx, "intensity");
+        v.range         = get_field<float>(L, idx, "range");
+        v.inner_cutoff  = get_field<float>(L, idx, "inner_cutoff");
+        v.outter_cutoff = get_field<float>(L, idx, "outter_cutoff");
+        v.angular_radius= get_field<float>(L, idx, "angular_radius");
+
+        auto type = get_field<std::string_view>(L, idx, "type");
+        if (type == "directional"){
             v.type = Light::LT_Directional;
-        } else if (strcmp(type, "point") == 0){
+        } else if (type == "point"){
             v.type = Light::LT_Point;
             if (v.range == 0.f){
                 luaL_error(L, "invalid point light, range must not be 0.0");
             }
-        } else if (strcmp(type, "spot") == 0){
+        } else if (type == "spot"){
             v.type = Light::LT_Spot;
             if (v.range == 0.f){
                 luaL_error(L, "invalid spot light, range must not be 0.0");
@@ -129,109 +166,55 @@ namespace lua_struct {
             if (v.inner_cutoff == 0.f || v.outter_cutoff == 0.f){
                 luaL_error(L, "invalid spot light, inner_cutoff and outter_cutoff must not be 0.0");
             }
-        } else if (strcmp(type, "area") == 0){
+        } else if (type == "area"){
             v.type = Light::LT_Area;
             if (v.angular_radius == 0.f){
                 luaL_error(L, "invalid area light, angular_radius must not be 0.0");
             }
         } else {
-            luaL_error(L, "invalid light type:%s", type);
+            luaL_error(L, "invalid light type:%s", type.data());
         }
+        return v;
     }
-}
-
-LUA2STRUCT(Lightmap, size);
-
-LUA2STRUCT(Scene, models, lights, materials);
 
-    //{
-    //     MeshData md;
-    //     glm::vec3 pos[] = {
-    //         glm::vec3(-1.f, 0.f, 1.f),
-    //         glm::vec3(1.f, 0.f, 1.f),
-    //         glm::vec3(1.f, 0.f, -1.f),
-    //         glm::vec3(-1.f, 0.f, -1.f),
-
-    //         glm::vec3(-1.f,  1.f, 0.f),
-    //         glm::vec3(1.f,  1.f, 0.f),
-    //         glm::vec3(1.f, -1.f, 0.f),
-    //         glm::vec3(-1.f, -1.f, 0.f),
-    //     };
-
-    //     glm::vec3 nor[] = {
-    //         glm::vec3(0.f, 1.f, 0.f),
-    //         glm::vec3(0.f, 1.f, 0.f),
-    //         glm::vec3(0.f, 1.f, 0.f),
-    //         glm::vec3(0.f, 1.f, 0.f),
-
-    //         glm::vec3(0.f, 0.f, 1.f),
-    //         glm::vec3(0.f, 0.f, 1.f),
-    //         glm::vec3(0.f, 0.f, 1.f),
-    //         glm::vec3(0.f, 0.f, 1.f),
-    //     };
-
-    //     glm::vec2 tex0[] = {
-    //         glm::vec2(0.f, 0.f),
-    //         glm::vec2(1.f, 0.f),
-    //         glm::vec2(1.f, 1.f),
-    //         glm::vec2(0.f, 1.f),
-
-    //         glm::vec2(0.f, 0.f),
-    //         glm::vec2(1.f, 0.f),
-    //         glm::vec2(1.f, 1.f),
-    //         glm::vec2(0.f, 1.f),
-    //     };
-
-    //     glm::vec2 lm_uv[] = {
-    //         glm::vec2(0.f, 0.f),
-    //         glm::vec2(1.f, 0.f),
-    //         glm::vec2(1.f, 1.f),
-    //         glm::vec2(0.f, 1.f),
-
-    //         glm::vec2(0.f, 0.f),
-    //         glm::vec2(1.f, 0.f),
-    //         glm::vec2(1.f, 1.f),
-    //         glm::vec2(0.f, 1.f),
-    //     };
-
-    //     auto set_buffer = [](auto &b, auto data, auto type, auto stride, auto offset){
-    //         b.data = (const char*)data;
-    //         b.type = type;
-    //         b.stride = stride, b.offset = offset;
-    //     };
-        
-    //     set_buffer(md.positions, pos, BT_Float, 12, 0);
-    //     set_buffer(md.normals, nor, BT_Float, 12, 0);
-    //     set_buffer(md.texcoords0, tex0, BT_Float, 8, 0);
-    //     set_buffer(md.texcoords1, lm_uv, BT_Float, 8, 0);
-
-    //     set_buffer(md.tangents, nullptr, BT_None, 0, 0);
-    //     set_buffer(md.bitangents, nullptr, BT_None, 0, 0);
-    //     md.vertexCount = 8;
-
-    //     uint16_t indices[] = {
-    //         0, 1, 2,
-    //         2, 3, 0,
-
-    //         4, 5, 6,
-    //         6, 7, 4,
-    //     };
+    template <>
+    inline Sky unpack<Sky>(lua_State* L, int idx) {
+        idx = lua_absindex(L, idx);
+        luaL_checktype(L, idx, LUA_TTABLE);
+        Sky v;
+        get_field_opt(L, idx, "color", v.skyColor);
+        get_field_opt(L, idx, "cubemap", v.cubemapTexture);
+        v.type = v.cubemapTexture.empty() ? Sky::SimpleColor : Sky::CubeMap;
+        return v;
+    }
 
-    //     md.indexCount = 12;
+    template <>
+    inline Scene unpack<Scene>(lua_State* L, int idx) {
+        idx = lua_absindex(L, idx);
+        luaL_checktype(L, idx, LUA_TTABLE);
+        Scene v;
+        v.models    = get_field<std::vector<MeshData>>(L, idx, "models");
+        v.lights    = get_field<std::vector<Light>>(L, idx, "lights");
+        v.materials = get_field<std::vector<MaterialData>>(L, idx, "materials");
+        get_field_opt(L, idx, "sky", v.sky);
+        return v;
+    }
 
-    //     set_buffer(md.indices, indices, BT_Uint16, 2, 0);
+    template <>
+    inline BakeSettings unpack<BakeSettings>(lua_State* L, int idx) {
+        idx = lua_absindex(L, idx);
+        luaL_checktype(L, idx, LUA_TTABLE);
+        BakeSettings v;
+        get_field_opt(L, idx, "samples", v.samples);
+        get_field_opt(L, idx, "bounces", v.bounces);
+        get_field_opt(L, idx, "threads", v.threads);
+        return v;
+    }
+}
 
-    //     md.worldmat = glm::mat4(1.f);
-    //     md.normalmat = glm::mat4(1.f);
-        
-    //     md.materialidx = 0;
-    //     s.models.push_back(md);
-    //     s.materials.push_back(MaterialData());
-    // }
 static int
 lbaker_create(lua_State *L){
-    Scene s;
-    lua_struct::unpack(L, 1, s);
+    auto s = lua_struct::unpack<Scene>(L, 1);
     BakerHandle bh = CreateBaker(&s);
     lua_pushlightuserdata(L, bh);
     return 1;
@@ -240,8 +223,12 @@ lbaker_create(lua_State *L){
 static int
 lbaker_bake(lua_State *L){
     auto bh = (BakerHandle)lua_touserdata(L, 1);
+    BakeSettings settings;
+    if (!lua_isnoneornil(L, 2)){
+        settings = lua_struct::unpack<BakeSettings>(L, 2);
+    }
     BakeResult br;
-    Bake(bh, &br);
+    Bake(bh, &br, settings);
 
     lua_createtable(L, (int)br.lightmaps.size(), 0);
     for (size_t ii=0; ii<br.lightmaps.size(); ++ii){
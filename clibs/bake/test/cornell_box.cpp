@@ -0,0 +1,113 @@
+// Regression test for the cpu baker: bakes a small Cornell box with 1 and N threads,
+// the results must be bit identical and match the reference texels below.
+#include "../cpu/CpuBaker.h"
+
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+
+using namespace cpubake;
+
+static constexpr uint32_t LIGHTMAP_SIZE = 16;
+
+static Mesh Quad(const Float3& p0, const Float3& p1, const Float3& p2, const Float3& p3, const Float3& albedo) {
+    Mesh m;
+    m.positions = { p0, p1, p2, p3 };
+    const Float3 n = Normalize(Cross(p1 - p0, p3 - p0));
+    m.normals = { n, n, n, n };
+    m.uvs = { { 0.f, 0.f }, { 1.f, 0.f }, { 1.f, 1.f }, { 0.f, 1.f } };
+    m.indices = { 0, 1, 2, 2, 3, 0 };
+    m.size = LIGHTMAP_SIZE;
+    m.albedo = albedo;
+    return m;
+}
+
+static Scene CornellBox() {
+    const Float3 white(0.73f), red(0.65f, 0.05f, 0.05f), green(0.12f, 0.45f, 0.15f);
+    Scene s;
+    // 2x2x2 box around the origin, open to the -z side
+    s.meshes.push_back(Quad({-1,-1,-1}, {-1,-1, 1}, { 1,-1, 1}, { 1,-1,-1}, white));  // floor
+    s.meshes.push_back(Quad({-1, 1,-1}, { 1, 1,-1}, { 1, 1, 1}, {-1, 1, 1}, white));  // ceiling
+    s.meshes.push_back(Quad({-1,-1, 1}, {-1, 1, 1}, { 1, 1, 1}, { 1,-1, 1}, white));  // back
+    s.meshes.push_back(Quad({-1,-1,-1}, {-1, 1,-1}, {-1, 1, 1}, {-1,-1, 1}, red));    // left
+    s.meshes.push_back(Quad({ 1,-1, 1}, { 1, 1, 1}, { 1, 1,-1}, { 1,-1,-1}, green));  // right
+
+    Light l;
+    l.type = Light::Point;
+    l.pos = Float3(0.f, 0.9f, 0.f);
+    l.color = Float3(3.f);
+    l.range = 10.f;
+    l.radius = 0.1f;
+    s.lights.push_back(l);
+    s.sky = Float3(0.f);
+    return s;
+}
+
+static bool Same(const std::vector<Texels>& a, const std::vector<Texels>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].size() != b[i].size() || memcmp(a[i].data(), b[i].data(), a[i].size() * sizeof(Float4)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct Reference {
+    uint32_t mesh;
+    uint32_t x, y;
+    Float3 value;
+};
+
+// floor center, floor next to the red wall, back wall, left wall
+static const Reference REFERENCES[] = {
+    { 0,  8,  8, { 1.0920f, 1.0544f, 1.0225f } },
+    { 0,  8,  1, { 0.4274f, 0.3502f, 0.3369f } },
+    { 2,  8,  8, { 0.7182f, 0.6670f, 0.6251f } },
+    { 3,  8,  8, { 0.9182f, 0.9172f, 0.8569f } },
+};
+
+static bool Near(float a, float b) {
+    return std::fabs(a - b) <= 1e-3f + std::fabs(b) * 1e-2f;
+}
+
+int main() {
+    Settings settings;
+    settings.samples = 32;
+    settings.bounces = 2;
+
+    Baker baker(CornellBox());
+    std::vector<Texels> single, multi, again;
+    settings.threads = 1;
+    baker.Bake(settings, single);
+    settings.threads = std::max(4u, std::thread::hardware_concurrency());
+    baker.Bake(settings, multi);
+    baker.Bake(settings, again);
+
+    int failed = 0;
+    if (!Same(single, multi) || !Same(multi, again)) {
+        printf("FAILED: bake result depends on the thread count\n");
+        failed++;
+    }
+    for (const Reference& r : REFERENCES) {
+        const Float4& t = single[r.mesh][r.y * LIGHTMAP_SIZE + r.x];
+        printf("mesh %u texel (%u, %u): %.4f %.4f %.4f\n", r.mesh, r.x, r.y, t.x, t.y, t.z);
+        if (t.w != 1.f || !Near(t.x, r.value.x) || !Near(t.y, r.value.y) || !Near(t.z, r.value.z)) {
+            printf("FAILED: expected %.4f %.4f %.4f\n", r.value.x, r.value.y, r.value.z);
+            failed++;
+        }
+    }
+    // color bleeding: the floor next to the red wall is redder than its center
+    const Float4& center = single[0][8 * LIGHTMAP_SIZE + 8];
+    const Float4& side = single[0][1 * LIGHTMAP_SIZE + 8];
+    if (side.x / side.y <= center.x / center.y) {
+        printf("FAILED: no color bleeding from the red wall\n");
+        failed++;
+    }
+    printf(failed ? "cornell_box: %d failure(s)\n" : "cornell_box: ok\n", failed);
+    return failed ? 1 : 0;
+}
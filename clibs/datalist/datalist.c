@@ -3,6 +3,8 @@
 #include <lua.h>
 #include <lauxlib.h>
 
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -1025,7 +1027,7 @@ parse_section(lua_State *L, struct lex_state *LS, int layer) {
 }
 
 static void
-init_lex(lua_State *L, int index, struct lex_state *LS) {
+init_source(lua_State *L, struct lex_state *LS) {
 	switch (lua_type(L, 1)) {
 	case LUA_TUSERDATA:
 		LS->source = (const char*)lua_touserdata(L, 1);
@@ -1048,6 +1050,10 @@ init_lex(lua_State *L, int index, struct lex_state *LS) {
 		LS->source = luaL_checklstring(L, 1, &LS->sz);
 		break;
 	}
+}
+
+static void
+init_lex(lua_State *L, struct lex_state *LS) {
 	LS->position = 0;
 	LS->newline = 1;
 	LS->aslist = 0;
@@ -1093,10 +1099,625 @@ parse_all(lua_State *L, struct lex_state *LS) {
 	}
 }
 
+// Binary datalist, produced by datalist.encode at compile time.
+//
+// magic(4) version(1) nstrings { len bytes } nshared value
+// Every string is stored once and referred to by index. A table referred to more than once
+// (a tag) is stored at its first use and referred to by id after that. Converters are kept
+// as nodes, so the converter of the loader runs on the same arguments as for the text.
+
+#define BINARY_MAGIC "\0DLB"
+#define BINARY_VERSION 1
+#define BINARY_HEADER 5
+
+enum binary_type {
+	BINARY_NIL,
+	BINARY_FALSE,
+	BINARY_TRUE,
+	BINARY_INTEGER,	// zigzag varint
+	BINARY_REAL,	// 8 bytes
+	BINARY_STRING,	// varint string index
+	BINARY_TABLE,	// varint shared id (0 : not shared), varint narray, varint nhash, values, key value pairs
+	BINARY_REF,	// varint shared id
+	BINARY_CONVERTER,	// the argument table
+};
+
+static inline int
+is_binary(const char *source, size_t sz) {
+	return sz >= BINARY_HEADER && memcmp(source, BINARY_MAGIC, 4) == 0;
+}
+
+// encoder, stack : 1 text, 2 marker metatable, 3 root, 4 table -> use count / shared id, 5 string -> index, 6 strings, 7 buffer
+#define ENCODE_MARKER 2
+#define ENCODE_ROOT 3
+#define ENCODE_TABLES 4
+#define ENCODE_STRING_INDEX 5
+#define ENCODE_STRINGS 6
+#define ENCODE_BUFFER 7
+
+struct writer {
+	lua_State *L;
+	char *ptr;
+	size_t sz;
+	size_t cap;
+	lua_Integer nstrings;
+	lua_Integer nshared;
+};
+
+static void
+write_bytes(struct writer *W, const void *data, size_t sz) {
+	if (W->sz + sz > W->cap) {
+		size_t cap = W->cap * 2;
+		while (cap < W->sz + sz)
+			cap *= 2;
+		char *ptr = (char *)lua_newuserdatauv(W->L, cap, 0);
+		memcpy(ptr, W->ptr, W->sz);
+		lua_replace(W->L, ENCODE_BUFFER);
+		W->ptr = ptr;
+		W->cap = cap;
+	}
+	memcpy(W->ptr + W->sz, data, sz);
+	W->sz += sz;
+}
+
+static inline void
+write_byte(struct writer *W, int c) {
+	uint8_t b = (uint8_t)c;
+	write_bytes(W, &b, 1);
+}
+
+static void
+write_varint(struct writer *W, uint64_t v) {
+	uint8_t buffer[10];
+	int n = 0;
+	while (v >= 0x80) {
+		buffer[n++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	buffer[n++] = (uint8_t)v;
+	write_bytes(W, buffer, n);
+}
+
+static int
+marker_converter(lua_State *L) {
+	lua_createtable(L, 1, 0);
+	lua_insert(L, 1);
+	lua_rawseti(L, 1, 1);
+	lua_pushvalue(L, lua_upvalueindex(1));
+	lua_setmetatable(L, 1);
+	return 1;
+}
+
+static int
+is_marker(lua_State *L, int index) {
+	if (!lua_getmetatable(L, index))
+		return 0;
+	int r = lua_rawequal(L, -1, ENCODE_MARKER);
+	lua_pop(L, 1);
+	return r;
+}
+
+// first pass : collect strings, count the uses of every table
+static void
+encode_count(lua_State *L, struct writer *W, int layer) {
+	if (layer > MAX_DEPTH)
+		luaL_error(L, "too many layers");
+	luaL_checkstack(L, 8, NULL);
+	switch (lua_type(L, -1)) {
+	case LUA_TNIL:
+	case LUA_TBOOLEAN:
+	case LUA_TNUMBER:
+		break;
+	case LUA_TSTRING:
+		lua_pushvalue(L, -1);
+		if (lua_rawget(L, ENCODE_STRING_INDEX) == LUA_TNIL) {
+			lua_pushvalue(L, -2);
+			lua_pushinteger(L, ++W->nstrings);
+			lua_rawset(L, ENCODE_STRING_INDEX);
+			lua_pushvalue(L, -2);
+			lua_rawseti(L, ENCODE_STRINGS, W->nstrings);
+		}
+		lua_pop(L, 1);
+		break;
+	case LUA_TTABLE:
+		lua_pushvalue(L, -1);
+		if (lua_rawget(L, ENCODE_TABLES) != LUA_TNIL) {
+			lua_Integer n = lua_tointeger(L, -1);
+			lua_pop(L, 1);
+			lua_pushvalue(L, -1);
+			lua_pushinteger(L, n + 1);
+			lua_rawset(L, ENCODE_TABLES);
+			return;
+		}
+		lua_pop(L, 1);
+		lua_pushvalue(L, -1);
+		lua_pushinteger(L, 1);
+		lua_rawset(L, ENCODE_TABLES);
+		if (is_marker(L, -1)) {
+			lua_rawgeti(L, -1, 1);
+			encode_count(L, W, layer + 1);
+			lua_pop(L, 1);
+			return;
+		}
+		lua_pushnil(L);
+		while (lua_next(L, -2) != 0) {
+			encode_count(L, W, layer + 1);
+			lua_pop(L, 1);
+			encode_count(L, W, layer + 1);
+		}
+		break;
+	default:
+		luaL_error(L, "Unsupported type %s", luaL_typename(L, -1));
+	}
+}
+
+// tables used once become false, shared tables 0 until they get an id
+static void
+encode_shared(lua_State *L, struct writer *W) {
+	lua_pushnil(L);
+	while (lua_next(L, ENCODE_TABLES) != 0) {
+		lua_Integer n = lua_tointeger(L, -1);
+		lua_pop(L, 1);
+		lua_pushvalue(L, -1);
+		if (n > 1) {
+			lua_pushinteger(L, 0);
+			W->nshared++;
+		} else {
+			lua_pushboolean(L, 0);
+		}
+		lua_rawset(L, ENCODE_TABLES);
+	}
+}
+
+static void
+encode_value(lua_State *L, struct writer *W, lua_Integer *shared_id) {
+	luaL_checkstack(L, 8, NULL);
+	switch (lua_type(L, -1)) {
+	case LUA_TNIL:
+		write_byte(W, BINARY_NIL);
+		break;
+	case LUA_TBOOLEAN:
+		write_byte(W, lua_toboolean(L, -1) ? BINARY_TRUE : BINARY_FALSE);
+		break;
+	case LUA_TNUMBER:
+		if (lua_isinteger(L, -1)) {
+			uint64_t v = (uint64_t)lua_tointeger(L, -1);
+			write_byte(W, BINARY_INTEGER);
+			write_varint(W, (v << 1) ^ (uint64_t)((int64_t)v >> 63));
+		} else {
+			double v = (double)lua_tonumber(L, -1);
+			write_byte(W, BINARY_REAL);
+			write_bytes(W, &v, sizeof(v));
+		}
+		break;
+	case LUA_TSTRING:
+		lua_pushvalue(L, -1);
+		lua_rawget(L, ENCODE_STRING_INDEX);
+		write_byte(W, BINARY_STRING);
+		write_varint(W, (uint64_t)lua_tointeger(L, -1));
+		lua_pop(L, 1);
+		break;
+	case LUA_TTABLE: {
+		if (is_marker(L, -1)) {
+			write_byte(W, BINARY_CONVERTER);
+			lua_rawgeti(L, -1, 1);
+			encode_value(L, W, shared_id);
+			lua_pop(L, 1);
+			break;
+		}
+		lua_pushvalue(L, -1);
+		lua_rawget(L, ENCODE_TABLES);
+		lua_Integer id = 0;
+		if (lua_isinteger(L, -1)) {
+			id = lua_tointeger(L, -1);
+			lua_pop(L, 1);
+			if (id > 0) {
+				write_byte(W, BINARY_REF);
+				write_varint(W, (uint64_t)id);
+				break;
+			}
+			id = ++*shared_id;
+			lua_pushvalue(L, -1);
+			lua_pushinteger(L, id);
+			lua_rawset(L, ENCODE_TABLES);
+		} else {
+			lua_pop(L, 1);
+		}
+		lua_Integer narray = 0;
+		while (lua_rawgeti(L, -1, narray + 1) != LUA_TNIL) {
+			lua_pop(L, 1);
+			++narray;
+		}
+		lua_pop(L, 1);
+		lua_Integer npairs = 0;
+		lua_pushnil(L);
+		while (lua_next(L, -2) != 0) {
+			lua_pop(L, 1);
+			++npairs;
+		}
+		write_byte(W, BINARY_TABLE);
+		write_varint(W, (uint64_t)id);
+		write_varint(W, (uint64_t)narray);
+		write_varint(W, (uint64_t)(npairs - narray));
+		lua_Integer i;
+		for (i = 1; i <= narray; i++) {
+			lua_rawgeti(L, -1, i);
+			encode_value(L, W, shared_id);
+			lua_pop(L, 1);
+		}
+		lua_pushnil(L);
+		while (lua_next(L, -2) != 0) {
+			if (lua_isinteger(L, -2)) {
+				lua_Integer k = lua_tointeger(L, -2);
+				if (k >= 1 && k <= narray) {
+					lua_pop(L, 1);
+					continue;
+				}
+			}
+			lua_pushvalue(L, -2);
+			encode_value(L, W, shared_id);
+			lua_pop(L, 1);
+			encode_value(L, W, shared_id);
+			lua_pop(L, 1);
+		}
+		break;
+	}
+	default:
+		luaL_error(L, "Unsupported type %s", luaL_typename(L, -1));
+	}
+}
+
+static int lparse(lua_State *L);
+
+static int
+lencode(lua_State *L) {
+	lua_settop(L, 1);
+	lua_newtable(L);	// marker metatable (ENCODE_MARKER)
+	lua_pushcfunction(L, lparse);
+	lua_pushvalue(L, 1);
+	lua_pushvalue(L, ENCODE_MARKER);
+	lua_pushcclosure(L, marker_converter, 1);
+	lua_call(L, 2, 1);	// root (ENCODE_ROOT)
+	lua_newtable(L);	// ENCODE_TABLES
+	lua_newtable(L);	// ENCODE_STRING_INDEX
+	lua_newtable(L);	// ENCODE_STRINGS
+	struct writer W;
+	W.L = L;
+	W.cap = 4096;
+	W.sz = 0;
+	W.ptr = (char *)lua_newuserdatauv(L, W.cap, 0);	// ENCODE_BUFFER
+	W.nstrings = 0;
+	W.nshared = 0;
+
+	lua_pushvalue(L, ENCODE_ROOT);
+	encode_count(L, &W, 0);
+	lua_pop(L, 1);
+	encode_shared(L, &W);
+
+	write_bytes(&W, BINARY_MAGIC, 4);
+	write_byte(&W, BINARY_VERSION);
+	write_varint(&W, (uint64_t)W.nstrings);
+	lua_Integer i;
+	for (i = 1; i <= W.nstrings; i++) {
+		size_t sz;
+		lua_rawgeti(L, ENCODE_STRINGS, i);
+		const char *str = lua_tolstring(L, -1, &sz);
+		write_varint(&W, (uint64_t)sz);
+		write_bytes(&W, str, sz);
+		lua_pop(L, 1);
+	}
+	write_varint(&W, (uint64_t)W.nshared);
+	lua_Integer shared_id = 0;
+	lua_pushvalue(L, ENCODE_ROOT);
+	encode_value(L, &W, &shared_id);
+	lua_pop(L, 1);
+
+	lua_pushlstring(L, W.ptr, W.sz);
+	return 1;
+}
+
+// decoder, stack : 1 source, 2 converter, 3 strings, 4 shared tables, [5 root]
+#define DECODE_STRINGS 3
+#define DECODE_SHARED 4
+
+struct reader {
+	const uint8_t *ptr;
+	const uint8_t *endptr;
+	lua_Integer nstrings;
+	lua_Integer nshared;
+};
+
+static int
+invalid_binary(lua_State *L) {
+	return luaL_error(L, "Invalid binary datalist");
+}
+
+static inline int
+read_byte(lua_State *L, struct reader *R) {
+	if (R->ptr >= R->endptr)
+		invalid_binary(L);
+	return *R->ptr++;
+}
+
+static uint64_t
+read_varint(lua_State *L, struct reader *R) {
+	uint64_t v = 0;
+	int shift = 0;
+	for (;;) {
+		int c = read_byte(L, R);
+		if (shift > 63)
+			invalid_binary(L);
+		v |= (uint64_t)(c & 0x7f) << shift;
+		if (!(c & 0x80))
+			return v;
+		shift += 7;
+	}
+}
+
+// a count of items, each takes at least one byte
+static lua_Integer
+read_count(lua_State *L, struct reader *R) {
+	uint64_t n = read_varint(L, R);
+	if (n > (uint64_t)(R->endptr - R->ptr))
+		invalid_binary(L);
+	return (lua_Integer)n;
+}
+
+static void decode_value(lua_State *L, struct reader *R, int layer);
+
+static void
+decode_table_body(lua_State *L, struct reader *R, int layer, lua_Integer narray, lua_Integer nhash, int raw) {
+	lua_Integer i;
+	for (i = 1; i <= narray; i++) {
+		decode_value(L, R, layer);
+		if (raw)
+			lua_rawseti(L, -2, i);
+		else
+			lua_seti(L, -2, i);
+	}
+	for (i = 0; i < nhash; i++) {
+		decode_value(L, R, layer);
+		if (lua_isnil(L, -1))
+			invalid_binary(L);
+		decode_value(L, R, layer);
+		if (raw)
+			lua_rawset(L, -3);
+		else
+			lua_settable(L, -3);
+	}
+}
+
+static void
+decode_value(lua_State *L, struct reader *R, int layer) {
+	if (layer >= MAX_DEPTH)
+		luaL_error(L, "too many layers");
+	luaL_checkstack(L, 8, NULL);
+	switch (read_byte(L, R)) {
+	case BINARY_NIL:
+		lua_pushnil(L);
+		break;
+	case BINARY_FALSE:
+		lua_pushboolean(L, 0);
+		break;
+	case BINARY_TRUE:
+		lua_pushboolean(L, 1);
+		break;
+	case BINARY_INTEGER: {
+		uint64_t v = read_varint(L, R);
+		lua_pushinteger(L, (lua_Integer)((v >> 1) ^ (~(v & 1) + 1)));
+		break;
+	}
+	case BINARY_REAL: {
+		double v;
+		if (R->endptr - R->ptr < (ptrdiff_t)sizeof(v))
+			invalid_binary(L);
+		memcpy(&v, R->ptr, sizeof(v));
+		R->ptr += sizeof(v);
+		lua_pushnumber(L, (lua_Number)v);
+		break;
+	}
+	case BINARY_STRING: {
+		uint64_t index = read_varint(L, R);
+		if (index == 0 || index > (uint64_t)R->nstrings)
+			invalid_binary(L);
+		lua_rawgeti(L, DECODE_STRINGS, (lua_Integer)index);
+		break;
+	}
+	case BINARY_TABLE: {
+		uint64_t id = read_varint(L, R);
+		lua_Integer narray = read_count(L, R);
+		lua_Integer nhash = read_count(L, R);
+		if (id > (uint64_t)R->nshared)
+			invalid_binary(L);
+		lua_createtable(L, (int)narray, (int)nhash);
+		if (id > 0) {
+			lua_pushvalue(L, -1);
+			lua_rawseti(L, DECODE_SHARED, (lua_Integer)id);
+		}
+		decode_table_body(L, R, layer + 1, narray, nhash, 1);
+		break;
+	}
+	case BINARY_REF: {
+		uint64_t id = read_varint(L, R);
+		if (id == 0 || id > (uint64_t)R->nshared)
+			invalid_binary(L);
+		if (lua_rawgeti(L, DECODE_SHARED, (lua_Integer)id) != LUA_TTABLE)
+			invalid_binary(L);
+		break;
+	}
+	case BINARY_CONVERTER:
+		decode_value(L, R, layer + 1);
+		lua_pushvalue(L, CONVERTER);
+		lua_insert(L, -2);
+		lua_call(L, 1, 1);
+		break;
+	default:
+		invalid_binary(L);
+	}
+}
+
+// same arguments as parse_all, the root is decoded into the table at 3 if there is one
+static void
+parse_binary(lua_State *L, struct lex_state *LS) {
+	struct reader R;
+	R.ptr = (const uint8_t *)LS->source + BINARY_HEADER;
+	R.endptr = (const uint8_t *)LS->source + LS->sz;
+	if (LS->aslist)
+		luaL_error(L, "Can't parse a binary datalist as a list");
+	if ((uint8_t)LS->source[4] != BINARY_VERSION)
+		luaL_error(L, "Unsupported binary datalist version %d", (uint8_t)LS->source[4]);
+	int t = lua_type(L, 2);
+	if (t != LUA_TFUNCTION) {
+		lua_pushcfunction(L, dummy_converter);
+		lua_insert(L, 2);
+	} else {
+		t = lua_type(L, 3);
+	}
+	int target = (t == LUA_TTABLE || t == LUA_TUSERDATA);
+	lua_settop(L, target ? 3 : 2);
+
+	R.nstrings = read_count(L, &R);
+	lua_createtable(L, (int)R.nstrings, 0);
+	lua_Integer i;
+	for (i = 1; i <= R.nstrings; i++) {
+		uint64_t sz = read_varint(L, &R);
+		if (sz > (uint64_t)(R.endptr - R.ptr))
+			invalid_binary(L);
+		lua_pushlstring(L, (const char *)R.ptr, (size_t)sz);
+		lua_rawseti(L, -2, i);
+		R.ptr += sz;
+	}
+	R.nshared = read_count(L, &R);
+	lua_createtable(L, (int)R.nshared, 0);
+	if (target) {
+		lua_rotate(L, 3, -1);
+		// 3 strings, 4 shared, 5 target
+		if (read_byte(L, &R) != BINARY_TABLE || read_varint(L, &R) != 0)
+			invalid_binary(L);
+		lua_Integer narray = read_count(L, &R);
+		lua_Integer nhash = read_count(L, &R);
+		decode_table_body(L, &R, 1, narray, nhash, 0);
+	} else {
+		decode_value(L, &R, 0);
+	}
+	if (R.ptr != R.endptr)
+		invalid_binary(L);
+}
+
+// basepath .. path with . and .. removed, for every part between |, like ant.serialize
+static size_t
+normalize_path(const char *src, size_t sz, char *out, size_t *seg) {
+	size_t n = 0;
+	const char *endptr = src + sz;
+	while (src < endptr) {
+		const char *part = src;
+		while (src < endptr && *src != '|')
+			++src;
+		const char *part_end = src;
+		if (src < endptr)
+			++src;	// skip |
+		if (part == part_end)
+			continue;
+		if (n > 0)
+			out[n++] = '|';
+		if (*part == '/')
+			out[n++] = '/';
+		size_t base = n;
+		int nseg = 0;
+		const char *ptr = part;
+		while (ptr < part_end) {
+			while (ptr < part_end && *ptr == '/')
+				++ptr;
+			const char *name = ptr;
+			while (ptr < part_end && *ptr != '/')
+				++ptr;
+			size_t len = ptr - name;
+			if (len == 0)
+				break;
+			if (len == 2 && name[0] == '.' && name[1] == '.' && nseg > 0) {
+				n = seg[--nseg];
+			} else if (!(len == 1 && name[0] == '.')) {
+				seg[nseg++] = n;
+				if (n > base)
+					out[n++] = '/';
+				memcpy(out + n, name, len);
+				n += len;
+			}
+		}
+		if (part_end[-1] == '/')
+			out[n++] = '/';
+	}
+	return n;
+}
+
+static void
+push_path(lua_State *L, const char *base, size_t base_sz, const char *path, size_t sz) {
+	if (sz > 0 && path[0] == '/') {
+		lua_pushlstring(L, path, sz);
+		return;
+	}
+	if (sz > 2 && path[0] == '.' && path[1] == '/') {
+		path += 2;
+		sz -= 2;
+	}
+	size_t full = base_sz + sz;
+	char tmp[SHORT_STRING * 3 + 2];
+	size_t tmp_seg[SHORT_STRING / 2 + 1];
+	char *buffer = tmp;
+	size_t *seg = tmp_seg;
+	if (full > SHORT_STRING) {
+		seg = (size_t *)lua_newuserdatauv(L, (full / 2 + 1) * sizeof(size_t) + full * 3 + 2, 0);
+		buffer = (char *)(seg + full / 2 + 1);
+	}
+	memcpy(buffer, base, base_sz);
+	memcpy(buffer + base_sz, path, sz);
+	size_t n = normalize_path(buffer, full, buffer + full, seg);
+	lua_pushlstring(L, buffer + full, n);
+	if (full > SHORT_STRING)
+		lua_replace(L, -2);
+}
+
+// [ path "xxx" ] or $path "xxx", leaves the name and the path on the stack
+static int
+is_path(lua_State *L) {
+	if (lua_type(L, 1) != LUA_TTABLE || lua_rawgeti(L, 1, 1) != LUA_TSTRING)
+		return 0;
+	size_t sz;
+	const char *name = lua_tolstring(L, -1, &sz);
+	return IS_KEYWORD(name, sz, "path") && lua_rawgeti(L, 1, 2) == LUA_TSTRING;
+}
+
+// upvalue 1 : basepath, upvalue 2 : converter or nil
+// $path is resolved here, other converters are passed on
+static int
+path_converter(lua_State *L) {
+	lua_settop(L, 1);
+	if (is_path(L)) {
+		size_t base_sz, sz;
+		const char *base = lua_tolstring(L, lua_upvalueindex(1), &base_sz);
+		const char *path = lua_tolstring(L, 3, &sz);
+		push_path(L, base, base_sz, path, sz);
+		return 1;
+	}
+	lua_settop(L, 1);
+	if (lua_isnil(L, lua_upvalueindex(2)))
+		return 1;
+	lua_pushvalue(L, lua_upvalueindex(2));
+	lua_insert(L, 1);
+	lua_call(L, 1, 1);
+	return 1;
+}
+
 static int
 lparse(lua_State *L) {
 	struct lex_state LS;
-	init_lex(L, 1, &LS);
+	init_source(L, &LS);
+	LS.aslist = 0;
+	if (is_binary(LS.source, LS.sz)) {
+		parse_binary(L, &LS);
+		return 1;
+	}
+	init_lex(L, &LS);
 	parse_all(L, &LS);
 	lua_pushvalue(L, REF_CACHE);
 	return 2;
@@ -1105,17 +1726,58 @@ lparse(lua_State *L) {
 static int
 lparse_list(lua_State *L) {
 	struct lex_state LS;
-	init_lex(L, 1, &LS);
+	init_source(L, &LS);
+	LS.aslist = 1;
+	if (is_binary(LS.source, LS.sz)) {
+		parse_binary(L, &LS);
+		return 1;
+	}
+	init_lex(L, &LS);
 	LS.aslist = 1;
 	parse_all(L, &LS);
 	lua_pushvalue(L, REF_CACHE);
 	return 2;
 }
 
+// parse with $path resolved against basepath, the converter gets the other converters
+static int
+lload(lua_State *L) {
+	lua_settop(L, 3);
+	if (lua_isnil(L, 2)) {
+		lua_remove(L, 2);
+		if (lua_isnil(L, 2))
+			lua_settop(L, 1);
+	} else {
+		luaL_checktype(L, 2, LUA_TSTRING);
+		lua_pushcclosure(L, path_converter, 2);
+	}
+	return lparse(L);
+}
+
+static int
+lisbinary(lua_State *L) {
+	size_t sz = 0;
+	const char *source = NULL;
+	switch (lua_type(L, 1)) {
+	case LUA_TSTRING:
+		source = lua_tolstring(L, 1, &sz);
+		break;
+	case LUA_TUSERDATA:
+		source = (const char *)lua_touserdata(L, 1);
+		sz = lua_rawlen(L, 1);
+		break;
+	default:
+		break;
+	}
+	lua_pushboolean(L, source != NULL && is_binary(source, sz));
+	return 1;
+}
+
 static int
 ltoken(lua_State *L) {
 	struct lex_state LS;
-	init_lex(L, 1, &LS);
+	init_source(L, &LS);
+	init_lex(L, &LS);
 
 	lua_newtable(L);
 
@@ -1229,6 +1891,9 @@ luaopen_datalist(lua_State *L) {
 	luaL_Reg l[] = {
 		{ "parse", lparse },
 		{ "parse_list", lparse_list },
+		{ "load", lload },
+		{ "encode", lencode },
+		{ "isbinary", lisbinary },
 		{ "token", ltoken },
 		{ "quote", lquote },
 		{ NULL, NULL },
@@ -28,8 +28,12 @@ end
 
 local function C(str)
 	local t = datalist.parse(str)
+	local b = datalist.parse(datalist.encode(str))
 	return function (tbl)
-		local ok , err = pcall(compare_table , t, tbl)
+		local ok , err = pcall(function()
+			compare_table(t, tbl)
+			compare_table(b, tbl)	-- binary datalist
+		end)
 		if not ok then
 			print("Error in :")
 			print(str)
@@ -238,3 +242,43 @@ assert(v[1].x == 1)
 assert(v[1].y.type == "subobj")
 assert(v[1].y.z == 2)
 assert(v[2].z == 3)
+
+-- binary datalist
+local bin = datalist.encode [[
+--- &1
+x : 1
+y : $path ../a/./b.png
+--- *1
+--- [ sum 1 2 3 ]
+]]
+assert(datalist.isbinary(bin))
+assert(not datalist.isbinary "x : 1")
+assert(datalist.encode(bin) == bin)
+
+local v = datalist.parse(bin, function (v) return v end)
+assert(v[1] == v[2])
+assert(v[1].y[1] == "path" and v[1].y[2] == "../a/./b.png")
+assert(v[3][1] == "sum" and v[3][4] == 3)
+
+local v = datalist.load(bin, "/pkg/ant.test/materials/", function (v) return v[2] end)
+assert(v[1].y == "/pkg/ant.test/a/b.png")
+assert(v[3] == 1)
+
+local v = datalist.load("x : $path ./c.material|/d", "/pkg/ant.test/")
+assert(v.x == "/pkg/ant.test/c.material|/d")
+
+F(bin:sub(1, -2))
+F(bin:sub(1, 5))
+
+-- lua test.lua $(git ls-files "*.prefab" "*.material" "*.ant" "*.patch")
+local function converter(v) return v end
+for _, filename in ipairs {...} do
+	local f <close> = assert(io.open(filename, "rb"))
+	local text = f:read "a"
+	local ok, t = pcall(datalist.parse, text, converter)
+	if ok then
+		compare_table(datalist.parse(datalist.encode(text), converter), t)
+		local basepath = "/" .. filename:match "^(.-)[^/|]*$"
+		compare_table(datalist.load(datalist.encode(text), basepath), datalist.load(text, basepath))
+	end
+end
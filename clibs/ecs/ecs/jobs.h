@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Work stealing job scheduler of ecs_world (w->jobs).
+// Worker 0 is the thread calling run(), the world's service. Jobs are spread over the
+// queues of all workers, a worker pops its own queue from the back and steals from the
+// front of the others. run() returns when every job of the call is done, the caller
+// runs jobs while it waits, so a job may call run() again.
+// Only one thread outside of the workers may call run() at a time.
+struct job_scheduler {
+    using job_func = void (*)(void* ud, size_t job, unsigned worker);
+
+    static unsigned default_threads() noexcept {
+        const unsigned n = std::thread::hardware_concurrency();
+        return n > 2 ? n / 2 : 0;
+    }
+
+    explicit job_scheduler(unsigned threads) noexcept;
+    ~job_scheduler() noexcept;
+    job_scheduler(const job_scheduler&) = delete;
+    job_scheduler& operator=(const job_scheduler&) = delete;
+
+    // worker threads and the calling thread
+    unsigned concurrency() const noexcept {
+        return (unsigned)queues.size();
+    }
+    void run(job_func func, void* ud, size_t n) noexcept;
+
+    // f(job, worker) for job in [0, n)
+    template <typename F>
+    void parallel_for(size_t n, F&& f) noexcept {
+        run(+[](void* ud, size_t job, unsigned worker) {
+            (*(std::remove_reference_t<F>*)ud)(job, worker);
+        }, (void*)&f, n);
+    }
+
+private:
+    struct task {
+        job_func func;
+        void* ud;
+        size_t job;
+        std::atomic<size_t>* pending;
+    };
+    struct queue {
+        std::mutex mutex;
+        std::deque<task> tasks;
+    };
+    bool pop(unsigned worker, task& t) noexcept;
+    bool steal(unsigned worker, task& t) noexcept;
+    bool execute(unsigned worker) noexcept;
+    void worker_main(unsigned worker) noexcept;
+
+    std::vector<std::unique_ptr<queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> queued = 0;
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cv;
+    bool stop = false;
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "select.h"
+#include "jobs.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// Parallel selectors. The index range of the main key is cut into chunks and the chunks are
+// run by the job scheduler, f(entity) is called on any worker in any order.
+// f may read any component and write the components of its own entity. It must not create
+// or remove entities, enable or disable tags, or call into Lua.
+// Without a scheduler, or with few entities, everything runs on the calling thread.
+namespace ecs {
+    static constexpr int PARALLEL_MIN_GRAIN = 256;
+
+    namespace impl {
+        inline int parallel_grain(job_scheduler* js, int n, int grain) noexcept {
+            if (grain > 0) {
+                return grain;
+            }
+            const int workers = js ? (int)js->concurrency() : 1;
+            return std::max(PARALLEL_MIN_GRAIN, n / (workers * 8));
+        }
+
+        template <typename Context, typename MainKey, typename ...SubKey, typename GetContext, typename F>
+            requires (!is_tag<MainKey>)
+        void parallel_select(job_scheduler* js, int n, int grain, GetContext&& get, F&& f) noexcept {
+            using entity_type = basic_entity<Context, MainKey, SubKey...>;
+            auto range = [&](int first, int last, unsigned worker) {
+                entity_type e(get(worker));
+                e.index = first - 1;
+                for (e.next(last); !e.invalid(); e.next(last)) {
+                    f(e);
+                }
+            };
+            grain = parallel_grain(js, n, grain);
+            if (!js || js->concurrency() == 1 || n <= grain) {
+                if (n > 0) {
+                    range(0, n, 0);
+                }
+                return;
+            }
+            js->parallel_for((size_t)((n + grain - 1) / grain), [&](size_t job, unsigned worker) {
+                const int first = (int)job * grain;
+                range(first, std::min(n, first + grain), worker);
+            });
+        }
+    }
+
+    // one cached_context per worker, keep it like a cached_context between frames
+    template <typename MainKey, typename ...SubKey>
+    struct parallel_cache {
+        using context_type = cached_context<MainKey, SubKey...>;
+        parallel_cache(job_scheduler* js, ecs_context* ctx) noexcept
+            : ctx(ctx) {
+            const unsigned n = js ? js->concurrency() : 1;
+            workers.reserve(n);
+            for (unsigned i = 0; i < n; ++i) {
+                workers.emplace_back(std::make_unique<context_type>(ctx));
+            }
+        }
+        void sync() noexcept {
+            for (auto& c : workers) {
+                c->sync();
+            }
+        }
+        context_type& worker(unsigned i) noexcept {
+            return *workers[i];
+        }
+        ecs_context* ctx;
+        std::vector<std::unique_ptr<context_type>> workers;
+    };
+
+    // main key only, fetching by index needs no per worker state
+    template <typename MainKey, typename F>
+    void parallel_select(job_scheduler* js, ecs_context* ctx, F&& f, int grain = 0) noexcept {
+        auto& c = context::create(ctx);
+        const int n = entity_count(ctx, component_id<MainKey>);
+        impl::parallel_select<context, MainKey>(js, n, grain, [&](unsigned) -> context& { return c; }, f);
+    }
+
+    // sub keys are looked up in the cache of the worker
+    template <typename MainKey, typename ...SubKey, typename F>
+    void parallel_select(job_scheduler* js, parallel_cache<MainKey, SubKey...>& cache, F&& f, int grain = 0) noexcept {
+        cache.sync();
+        const int n = entity_count(cache.ctx, component_id<MainKey>);
+        impl::parallel_select<cached_context<MainKey, SubKey...>, MainKey, SubKey...>(js, n, grain, [&](unsigned worker) -> auto& {
+            return cache.worker(worker);
+        }, f);
+    }
+}
@@ -8,6 +8,8 @@
 #include <string_view>
 #include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace ecs {
     namespace flags {
@@ -87,6 +89,15 @@ namespace ecs {
         
         template <typename Component, typename...Components>
         constexpr bool has_element_v = has_element<Component, Components...>();
+
+        template <typename T>
+        std::span<T> component_array(ecs_context* ctx) noexcept {
+            T* first = (T*)entity_fetch(ctx, component_id<T>, 0, NULL);
+            if (!first) {
+                return {};
+            }
+            return { first, (size_t)entity_count(ctx, component_id<T>) };
+        }
     }
 
     struct context: public ecs_context {
@@ -148,6 +159,15 @@ namespace ecs {
         T* component(ecs_token token, [[maybe_unused]] int i) noexcept {
             return (T*)entity_component(ctx(), token, component_id<T>);
         }
+        template <typename T>
+            requires (
+                !std::is_function_v<T>
+                && !is_tag<T>
+                && component_id<T> != COMPONENT::EID
+            )
+        std::span<T> component_array() noexcept {
+            return impl::component_array<T>(ctx());
+        }
         void disable_tag(int tagid, int i) noexcept {
             entity_disable_tag(ctx(), tagid, i);
         }
@@ -236,6 +256,16 @@ namespace ecs {
         T* component(ecs_token token, [[maybe_unused]] int i) noexcept {
             return (T*)entity_component(ctx(), token, COMPONENT::EID);
         }
+        template <typename T>
+            requires (
+                !std::is_function_v<T>
+                && impl::has_element_v<T, MainKey, Components...>
+                && !is_tag<T>
+                && component_id<T> != COMPONENT::EID
+            )
+        std::span<T> component_array() noexcept {
+            return impl::component_array<T>(ctx());
+        }
         void disable_tag(int tagid, int i) noexcept {
             entity_disable_tag(ctx(), tagid, i);
         }
@@ -248,6 +278,14 @@ namespace ecs {
     };
 
     namespace impl {
+        template <typename...Ts>
+        using component_spans = decltype(std::tuple_cat(
+            std::declval<std::conditional_t<std::is_function_v<Ts> || is_tag<Ts>,
+                std::tuple<>,
+                std::tuple<std::span<Ts>>
+            >>()...
+        ));
+
         template <typename...Ts>
         using components = decltype(std::tuple_cat(
             std::declval<std::conditional_t<std::is_function_v<Ts> || is_tag<Ts>,
@@ -371,6 +409,21 @@ namespace ecs {
                 }
             }
         }
+        // the next entity with an index below last
+        void next(int last) noexcept
+            requires (!is_tag<MainKey>) {
+            for (++index; index < last; ++index) {
+                auto v = ctx.template fetch<MainKey>(index, token);
+                if (!v) {
+                    break;
+                }
+                assgin<0>(v);
+                if (fetch_sibiling(index)) {
+                    return;
+                }
+            }
+            index = kInvalidIndex;
+        }
         void remove() const noexcept {
             entity_remove(ctx.ctx(), token);
         }
@@ -556,6 +609,124 @@ namespace ecs {
         using cached_selector = basic_selector<cached_context<Args...>, Args...>;
     }
 
+    static constexpr size_t CHUNK_SIZE = 1024;
+
+    // A run of the entities of a query, as positions in the component arrays.
+    // index<T>()[k] is the position of the k-th entity in array<T>(), for every component of the
+    // query that is not a tag. Loops over a chunk make no fetch calls.
+    template <typename MainKey, typename ...SubKey>
+    struct chunk {
+        using components = impl::components<MainKey, SubKey...>;
+        static constexpr size_t N = std::tuple_size_v<components>;
+        template <typename T>
+        static constexpr size_t slot = helper::component_id_v<T*, components> - 1;
+
+        size_t size() const noexcept {
+            return n;
+        }
+        template <typename T>
+        std::span<T> array() const noexcept {
+            return std::get<slot<T>>(arrays);
+        }
+        template <typename T>
+        std::span<const int> index() const noexcept {
+            return { indices[slot<T>].data(), n };
+        }
+
+        impl::component_spans<MainKey, SubKey...> arrays;
+        std::array<std::vector<int>, N> indices;
+        size_t n = 0;
+    };
+
+    namespace impl {
+        template <std::size_t Is, typename Context, typename Component, typename ...Components>
+        bool chunk_fetch(Context& ctx, ecs_token token, int i, std::vector<int>* indices, size_t n) noexcept {
+            if constexpr (std::is_function_v<Component>) {
+                using C = typename std::invoke_result<Component, flags::absent>::type;
+                if (ctx.template component<C>(token, i)) {
+                    return false;
+                }
+                if constexpr (sizeof...(Components) > 0) {
+                    return chunk_fetch<Is, Context, Components...>(ctx, token, i, indices, n);
+                }
+                return true;
+            }
+            else if constexpr (is_tag<Component>) {
+                if (!ctx.template component<Component>(token, i)) {
+                    return false;
+                }
+            }
+            else {
+                int index = ctx.template component_index<Component>(token, i);
+                if (index < 0) {
+                    return false;
+                }
+                indices[Is][n] = index;
+            }
+            if constexpr (sizeof...(Components) > 0) {
+                return chunk_fetch<next<Is, Component>(), Context, Components...>(ctx, token, i, indices, n);
+            }
+            return true;
+        }
+    }
+
+    // f(chunk&) for every chunk of up to chunk_size entities of the query.
+    // f must not create or remove entities, the arrays of the chunk would move.
+    template <typename Context, typename MainKey, typename ...SubKey, typename F>
+        requires (
+            ((component_id<SubKey> != COMPONENT::EID) && ...)
+            && component_id<MainKey> != COMPONENT::EID
+        )
+    void basic_chunk_select(Context& ctx, F&& f, size_t chunk_size = CHUNK_SIZE) noexcept {
+        using chunk_type = chunk<MainKey, SubKey...>;
+        chunk_type c;
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            ((std::get<I>(c.arrays) = ctx.template component_array<std::remove_pointer_t<std::tuple_element_t<I, typename chunk_type::components>>>()), ...);
+        }(std::make_index_sequence<chunk_type::N>{});
+        for (auto& v : c.indices) {
+            v.resize(chunk_size);
+        }
+        ctx.sync();
+        ecs_token token;
+        int i = -1;
+        for (;;) {
+            if constexpr (is_tag<MainKey>) {
+                ctx.template next<MainKey>(i, token);
+                if (i == -1) {
+                    break;
+                }
+            }
+            else {
+                if (!ctx.template fetch<MainKey>(++i, token)) {
+                    break;
+                }
+                c.indices[0][c.n] = i;
+            }
+            if constexpr (sizeof...(SubKey) > 0) {
+                if (!impl::chunk_fetch<impl::next<0, MainKey>(), Context, SubKey...>(ctx, token, i, c.indices.data(), c.n)) {
+                    continue;
+                }
+            }
+            if (++c.n == chunk_size) {
+                f(c);
+                c.n = 0;
+            }
+        }
+        if (c.n > 0) {
+            f(c);
+        }
+    }
+
+    template <typename MainKey, typename ...SubKey, typename F>
+    void chunk_select(ecs_context* ctx, F&& f, size_t chunk_size = CHUNK_SIZE) noexcept {
+        basic_chunk_select<context, MainKey, SubKey...>(context::create(ctx), f, chunk_size);
+    }
+
+    template <typename ...Args, typename F>
+    void cached_chunk_select(cached_context<Args...>& cache, F&& f, size_t chunk_size = CHUNK_SIZE) noexcept {
+        basic_chunk_select<cached_context<Args...>, Args...>(cache, f, chunk_size);
+    }
+
     template <typename Component>
     void clear_type(ecs_context* ctx) noexcept {
         entity_clear_type(ctx, component_id<Component>);
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "select.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Write versions of components (w->versions).
+// A native system that changes a component of an entity calls write(eid, w->frame). Readers
+// keep the frame they last ran at and ask for the entities written after it, the cost is the
+// number of writes since then, not the number of entities.
+// Only a few frames of history are kept. A reader whose frame is older than that gets false,
+// and has to take every entity as changed.
+// Not thread safe, record the writes of parallel_select after it returns.
+namespace ecs {
+    struct change_log {
+        // the frame of the last write, 0 when never written or forgotten by clear()
+        uint64_t version(uint64_t eid) const noexcept {
+            auto it = versions.find(eid);
+            return it == versions.end() ? 0 : it->second;
+        }
+        // frames must not decrease from one write to the next
+        void write(uint64_t eid, uint64_t frame) {
+            assert(writes.empty() || writes.back().frame <= frame);
+            auto [it, inserted] = versions.try_emplace(eid, frame);
+            if (!inserted) {
+                if (it->second == frame) {
+                    return;
+                }
+                it->second = frame;
+            }
+            writes.push_back({ frame, eid });
+        }
+        // f(eid) once for every entity written after frame, oldest write first.
+        // false without calling f when the writes after frame have been cleared
+        template <typename F>
+        bool changed_after(uint64_t frame, F&& f) const {
+            if (frame < horizon) {
+                return false;
+            }
+            for (auto it = first_after(frame); it != writes.end(); ++it) {
+                if (version(it->eid) == it->frame) {
+                    f(it->eid);
+                }
+            }
+            return true;
+        }
+        // true as well when frame is older than the history
+        bool changed(uint64_t eid, uint64_t frame) const noexcept {
+            return frame < horizon || version(eid) > frame;
+        }
+        // forget the writes at or before frame, their entities read as never written
+        void clear(uint64_t frame) {
+            auto last = first_after(frame);
+            for (auto it = writes.begin(); it != last; ++it) {
+                auto v = versions.find(it->eid);
+                if (v != versions.end() && v->second == it->frame) {
+                    versions.erase(v);
+                }
+            }
+            writes.erase(writes.begin(), last);
+            horizon = std::max(horizon, frame);
+        }
+        // for removed entities
+        void erase(uint64_t eid) {
+            versions.erase(eid);
+        }
+        size_t size() const noexcept {
+            return versions.size();
+        }
+
+    private:
+        struct record {
+            uint64_t frame;
+            uint64_t eid;
+        };
+        std::vector<record>::const_iterator first_after(uint64_t frame) const noexcept {
+            return std::upper_bound(writes.begin(), writes.end(), frame, [](uint64_t f, const record& r) {
+                return f < r.frame;
+            });
+        }
+        std::unordered_map<uint64_t, uint64_t> versions;
+        std::vector<record> writes;
+        uint64_t horizon = 0;       // the last frame cleared
+    };
+}
+
+// one change_log per component id
+struct component_versions {
+    template <typename Component>
+    ecs::change_log& log() {
+        static_assert(ecs::component_id<Component> >= 0);
+        const size_t id = (size_t)ecs::component_id<Component>;
+        if (id >= logs.size()) {
+            logs.resize(id + 1);
+        }
+        return logs[id];
+    }
+    // forget everything at or before frame, in every log
+    void clear(uint64_t frame) {
+        for (auto& l : logs) {
+            l.clear(frame);
+        }
+    }
+    // for removed entities, in every log
+    void erase(uint64_t eid) {
+        for (auto& l : logs) {
+            l.erase(eid);
+        }
+    }
+    std::vector<ecs::change_log> logs;
+};
+
+namespace ecs {
+    // f(entity) for the entities of log written after frame that still exist,
+    // Eid is component::eid, f reads the components with entity.component<T>().
+    // false when frame is older than the history, see change_log::changed_after
+    template <typename Eid, typename F>
+    bool changed_select(ecs_context* ctx, const change_log& log, uint64_t frame, F&& f) {
+        return log.changed_after(frame, [&](uint64_t eid) {
+            auto e = find_entity(ctx, (Eid)eid);
+            if (!e.invalid()) {
+                f(e);
+            }
+        });
+    }
+}
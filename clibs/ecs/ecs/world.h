@@ -24,6 +24,13 @@ struct bgfx_encoder_holder {
 };
 
 struct cull_cached;
+struct job_scheduler;
+struct component_versions;
+struct shadow_cache;
+struct shadow_cull;
+struct cluster_light;
+struct local_shadow;
+struct mesh_pick;
 
 struct ecs_world {
 	struct ecs_context*           ecs;
@@ -36,8 +43,13 @@ struct ecs_world {
 	struct queue_container*       Q;
 	struct submit_cache*          submit_cache;
 	struct mesh_container*        MESH;
-	uint64_t                      unused1;
-	uint64_t                      unused2;
+	struct job_scheduler*         jobs;
+	struct component_versions*    versions;
+	struct shadow_cache*          shadow_cache;
+	struct shadow_cull*           shadow_cull;
+	struct cluster_light*         cluster_light;
+	struct local_shadow*          local_shadow;
+	struct mesh_pick*             mesh_pick;
 };
 
 static inline struct ecs_world* getworld(lua_State* L) {
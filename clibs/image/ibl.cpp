@@ -0,0 +1,468 @@
+#include "ibl.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numbers>
+#include <thread>
+#include <vector>
+
+namespace ibl {
+
+static constexpr float const_pi = std::numbers::pi_v<float>;
+
+struct vec3 {
+    float x, y, z;
+};
+
+static inline vec3 operator+(const vec3& a, const vec3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+static inline vec3 operator*(const vec3& a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+static inline float dot(const vec3& a, const vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static inline vec3 cross(const vec3& a, const vec3& b) {
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+static inline vec3 normalize(const vec3& v) { return v * (1.f / std::sqrt(dot(v, v))); }
+
+// rows are handed out in small batches, every row is written by exactly one thread,
+// so the results don't depend on the thread count.
+template <typename Func>
+static void parallel_rows(uint32_t rows, Func&& func) {
+    const uint32_t threads = std::min(rows, std::max(1u, std::thread::hardware_concurrency()));
+    std::atomic<uint32_t> next { 0 };
+    auto worker = [&]() {
+        for (;;) {
+            const uint32_t row = next.fetch_add(1);
+            if (row >= rows) {
+                break;
+            }
+            func(row);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (uint32_t i = 1; i < threads; ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : pool) {
+        t.join();
+    }
+}
+
+static inline float n2s(float v) { return v * 2.f - 1.f; }
+static inline float s2n(float v) { return (v + 1.f) * 0.5f; }
+
+struct face_address {
+    uint8_t face;
+    float u, v;
+};
+
+static inline face_address
+dir2uvface(const vec3& dir) {
+    const float x = dir.x, y = dir.y, z = dir.z;
+    const float ax = std::abs(x), ay = std::abs(y), az = std::abs(z);
+    if (ax > ay) {
+        if (ax > az) {
+            return (x > 0) ? face_address { 0, s2n(-z / ax), s2n(y / ax) }     // +X
+                           : face_address { 1, s2n(z / ax), s2n(y / ax) };     // -X
+        }
+    } else {
+        if (ay > az) {
+            return (y > 0) ? face_address { 2, s2n(x / ay), s2n(z / ay) }      // +Y
+                           : face_address { 3, s2n(x / ay), s2n(-z / ay) };    // -Y
+        }
+    }
+    return z > 0 ? face_address { 4, s2n(x / az), s2n(y / az) }                // +Z
+                 : face_address { 5, s2n(x / az), s2n(-y / az) };              // -Z
+}
+
+static inline vec3
+uvface2dir(int face, float u, float v) {
+    u = n2s(u), v = n2s(v);
+    switch (face) {
+        case 0: return {  1.f, v,  -u };
+        case 1: return { -1.f, v,   u };
+        case 2: return {  u, 1.f,  -v };
+        case 3: return {  u, -1.f,  v };
+        case 4: return {  u,  v,  1.f };
+        case 5:
+        default: return { -u,  v, -1.f };
+    }
+}
+
+static inline const float*
+texel(const float* cubemap, uint32_t facesize, uint32_t face, uint32_t x, uint32_t y) {
+    return cubemap + ((size_t(face) * facesize + y) * facesize + x) * 4;
+}
+
+// same filter as the former image.cpp version, the second texel is clamped to the face
+static inline vec3
+filter_at(const float* cubemap, uint32_t facesize, const vec3& direction) {
+    const auto addr = dir2uvface(direction);
+    const float maxsize = (float)facesize - 1;
+    const float fx = std::min(addr.u * maxsize, maxsize);
+    const float fy = std::min(addr.v * maxsize, maxsize);
+    const uint32_t x0 = (uint32_t)std::floor(fx), y0 = (uint32_t)std::floor(fy);
+    const uint32_t x1 = std::min(x0 + 1, facesize - 1), y1 = std::min(y0 + 1, facesize - 1);
+    const float s = fx - std::floor(fx), t = fy - std::floor(fy);
+
+    const float* t00 = texel(cubemap, facesize, addr.face, x0, y0);
+    const float* t10 = texel(cubemap, facesize, addr.face, x1, y0);
+    const float* t01 = texel(cubemap, facesize, addr.face, x0, y1);
+    const float* t11 = texel(cubemap, facesize, addr.face, x1, y1);
+    float c[3];
+    for (int i = 0; i < 3; ++i) {
+        const float a = t00[i] * (1.f - s) + t10[i] * s;
+        const float b = t01[i] * (1.f - s) + t11[i] * s;
+        c[i] = a * (1.f - t) + b * t;
+    }
+    return { c[0], c[1], c[2] };
+}
+
+static inline float
+radical_inverse(uint32_t bits) {
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return bits;
+}
+
+void cubemap2equirectangular(const float* cubemap, uint32_t facesize, float* equirect, uint32_t w, uint32_t h) {
+    constexpr uint32_t num_samples = 64;
+    constexpr float tof = 0.5f / 0x80000000U;
+    float su[num_samples], sv[num_samples];
+    for (uint32_t i = 0; i < num_samples; ++i) {
+        su[i] = i * (1.0f / num_samples);
+        sv[i] = radical_inverse(i) * tof;
+    }
+    parallel_rows(h, [&](uint32_t ih) {
+        for (uint32_t iw = 0; iw < w; ++iw) {
+            vec3 c { 0.f, 0.f, 0.f };
+            for (uint32_t sample = 0; sample < num_samples; ++sample) {
+                const float x = 2.0f * (iw + su[sample]) / w - 1.0f;
+                const float y = 1.0f - 2.0f * (ih + sv[sample]) / h;
+                const float theta = x * const_pi;
+                const float phi = y * const_pi * 0.5f;
+                const vec3 s {
+                    std::cos(phi) * std::sin(theta),
+                    std::sin(phi),
+                    std::cos(phi) * std::cos(theta) };
+                c = c + filter_at(cubemap, facesize, s);
+            }
+            c = c * (1.0f / num_samples);
+            float* d = equirect + (size_t(ih) * w + iw) * 4;
+            d[0] = c.x; d[1] = c.y; d[2] = c.z; d[3] = 0.f;
+        }
+    });
+}
+
+void equirectangular2cubemap(const float* equirect, uint32_t w, uint32_t h, float* cubemap, uint32_t facesize) {
+    const float invsize = 1.f / facesize;
+    parallel_rows(6 * facesize, [&](uint32_t row) {
+        const uint32_t face = row / facesize;
+        const uint32_t y = row % facesize;
+        for (uint32_t x = 0; x < facesize; ++x) {
+            const vec3 dir = normalize(uvface2dir(face, (x + 0.5f) * invsize, (y + 0.5f) * invsize));
+            const float su = 0.5f + 0.5f * std::atan2(dir.z, dir.x) / const_pi;
+            const float sv = std::acos(dir.y) / const_pi;
+            const uint32_t ix = std::min((uint32_t)(su * w), w - 1);
+            const uint32_t iy = std::min((uint32_t)(sv * h), h - 1);
+            const float* s = equirect + (size_t(iy) * w + ix) * 4;
+            float* d = cubemap + ((size_t(face) * facesize + y) * facesize + x) * 4;
+            d[0] = s[0]; d[1] = s[1]; d[2] = s[2]; d[3] = 0.f;
+        }
+    });
+}
+
+struct cubemap_chain {
+    std::vector<std::vector<float>> mips;
+    std::vector<uint32_t> sizes;
+};
+
+cubemap_chain* create_chain(const float* cubemap, uint32_t facesize) {
+    auto chain = new cubemap_chain;
+    chain->mips.emplace_back(cubemap, cubemap + size_t(facesize) * facesize * 6 * 4);
+    chain->sizes.push_back(facesize);
+    while (facesize > 1) {
+        const uint32_t half = facesize / 2;
+        const std::vector<float>& src = chain->mips.back();
+        std::vector<float> dst(size_t(half) * half * 6 * 4);
+        for (uint32_t face = 0; face < 6; ++face) {
+            for (uint32_t y = 0; y < half; ++y) {
+                for (uint32_t x = 0; x < half; ++x) {
+                    float* d = &dst[((size_t(face) * half + y) * half + x) * 4];
+                    const float* s00 = texel(src.data(), facesize, face, x * 2, y * 2);
+                    const float* s10 = texel(src.data(), facesize, face, x * 2 + 1, y * 2);
+                    const float* s01 = texel(src.data(), facesize, face, x * 2, y * 2 + 1);
+                    const float* s11 = texel(src.data(), facesize, face, x * 2 + 1, y * 2 + 1);
+                    for (int i = 0; i < 4; ++i) {
+                        d[i] = (s00[i] + s10[i] + s01[i] + s11[i]) * 0.25f;
+                    }
+                }
+            }
+        }
+        chain->mips.emplace_back(std::move(dst));
+        chain->sizes.push_back(half);
+        facesize = half;
+    }
+    return chain;
+}
+
+void destroy_chain(cubemap_chain* chain) {
+    delete chain;
+}
+
+// textureCube face selection (major axis, sc, tc), t runs from the first row of the face,
+// the inverse of id2dir in shaders/common/utils.sh
+static inline face_address
+dir2texcoord(const vec3& dir) {
+    const float ax = std::abs(dir.x), ay = std::abs(dir.y), az = std::abs(dir.z);
+    if (az >= ax && az >= ay) {
+        return dir.z > 0 ? face_address { 4, s2n(dir.x / az), s2n(-dir.y / az) }
+                         : face_address { 5, s2n(-dir.x / az), s2n(-dir.y / az) };
+    }
+    if (ay >= ax) {
+        return dir.y > 0 ? face_address { 2, s2n(dir.x / ay), s2n(dir.z / ay) }
+                         : face_address { 3, s2n(dir.x / ay), s2n(-dir.z / ay) };
+    }
+    return dir.x > 0 ? face_address { 0, s2n(-dir.z / ax), s2n(-dir.y / ax) }
+                     : face_address { 1, s2n(dir.z / ax), s2n(-dir.y / ax) };
+}
+
+// bilinear, texel centers at half texels, clamped to the face
+static inline vec3
+bilinear_at(const cubemap_chain* chain, uint32_t mip, const face_address& addr) {
+    const float* data = chain->mips[mip].data();
+    const uint32_t size = chain->sizes[mip];
+    const float fx = std::clamp(addr.u * size - 0.5f, 0.f, (float)(size - 1));
+    const float fy = std::clamp(addr.v * size - 0.5f, 0.f, (float)(size - 1));
+    const uint32_t x0 = (uint32_t)fx, y0 = (uint32_t)fy;
+    const uint32_t x1 = std::min(x0 + 1, size - 1), y1 = std::min(y0 + 1, size - 1);
+    const float s = fx - x0, t = fy - y0;
+    const float* t00 = texel(data, size, addr.face, x0, y0);
+    const float* t10 = texel(data, size, addr.face, x1, y0);
+    const float* t01 = texel(data, size, addr.face, x0, y1);
+    const float* t11 = texel(data, size, addr.face, x1, y1);
+    float c[3];
+    for (int i = 0; i < 3; ++i) {
+        const float a = t00[i] + (t10[i] - t00[i]) * s;
+        const float b = t01[i] + (t11[i] - t01[i]) * s;
+        c[i] = a + (b - a) * t;
+    }
+    return { c[0], c[1], c[2] };
+}
+
+static inline vec3
+sample_lod(const cubemap_chain* chain, const vec3& dir, float lod) {
+    const auto addr = dir2texcoord(dir);
+    const float maxlod = (float)(chain->mips.size() - 1);
+    lod = std::clamp(lod, 0.f, maxlod);
+    const uint32_t l0 = (uint32_t)lod;
+    const float f = lod - l0;
+    const vec3 c0 = bilinear_at(chain, l0, addr);
+    if (f <= 0.f) {
+        return c0;
+    }
+    const vec3 c1 = bilinear_at(chain, l0 + 1, addr);
+    return c0 * (1.f - f) + c1 * f;
+}
+
+// common.sh: calc_TB
+static inline void
+calc_TB(const vec3& N, vec3& T, vec3& B) {
+    T = cross(N, { 0.f, 1.f, 0.f });
+    if (dot(T, T) < 0.0000001f) {
+        T = cross(N, { 1.f, 0.f, 0.f });
+    }
+    T = normalize(T);
+    B = normalize(cross(N, T));
+}
+
+struct ggx_sample {
+    vec3 H;         // tangent space half vector
+    float pdf;
+};
+
+static inline ggx_sample
+importance_sample_GGX(uint32_t i, uint32_t n, float roughness) {
+    const float xi_x = float(i) / float(n);
+    const float xi_y = radical_inverse(i) * 2.3283064365386963e-10f;
+    const float alpha = roughness * roughness;
+    const float cos_theta = std::clamp(std::sqrt((1.f - xi_y) / (1.f + (alpha * alpha - 1.f) * xi_y)), 0.f, 1.f);
+    const float sin_theta = std::sqrt(1.f - cos_theta * cos_theta);
+    const float phi = 2.f * const_pi * xi_x;
+    // D_GGX(cos_theta, alpha)
+    const float a = cos_theta * alpha;
+    const float k = alpha / std::max(1.f - cos_theta * cos_theta + a * a, 1e-6f);
+    const float D = k * k * (1.f / const_pi);
+    return {
+        normalize({ sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta }),
+        D / 4.f,
+    };
+}
+
+void prefilter(const cubemap_chain* source, float roughness, uint32_t sample_count, float* cubemap, uint32_t facesize) {
+    // V == N, so L = reflect(-N, H) only depends on the sample: precompute L in tangent space.
+    // Samples with NdotL <= 0 contribute nothing and are dropped up front.
+    const float srcsize = (float)source->sizes[0];
+    std::vector<float> lx, ly, lz, lod;
+    lx.reserve(sample_count); ly.reserve(sample_count); lz.reserve(sample_count); lod.reserve(sample_count);
+    for (uint32_t i = 0; i < sample_count; ++i) {
+        const ggx_sample s = importance_sample_GGX(i, sample_count, roughness);
+        const float NdotH = s.H.z;
+        const float NdotL = 2.f * NdotH * NdotH - 1.f;
+        if (NdotL <= 0.f) {
+            continue;
+        }
+        lx.push_back(2.f * NdotH * s.H.x);
+        ly.push_back(2.f * NdotH * s.H.y);
+        lz.push_back(NdotL);
+        lod.push_back(roughness == 0.f ? 0.f : 0.5f * std::log2(6.f * srcsize * srcsize / (float(sample_count) * s.pdf)));
+    }
+    const uint32_t n = (uint32_t)lx.size();
+    const float invcount = 1.f / sample_count;
+    const float invsize = 1.f / facesize;
+    parallel_rows(6 * facesize, [&](uint32_t row) {
+        const uint32_t face = row / facesize;
+        const uint32_t y = row % facesize;
+        for (uint32_t x = 0; x < facesize; ++x) {
+            // id2dir: texel center, v flipped
+            const vec3 N = normalize(uvface2dir(face, (x + 0.5f) * invsize, 1.f - (y + 0.5f) * invsize));
+            vec3 T, B;
+            calc_TB(N, T, B);
+            vec3 color { 0.f, 0.f, 0.f };
+            float weight = 0.f;
+            for (uint32_t i = 0; i < n; ++i) {
+                const vec3 L = normalize(T * lx[i] + B * ly[i] + N * lz[i]);
+                color = color + sample_lod(source, L, lod[i]) * lz[i];
+                weight += lz[i];
+            }
+            float* d = cubemap + ((size_t(face) * facesize + y) * facesize + x) * 4;
+            d[0] = color.x * invcount;
+            d[1] = color.y * invcount;
+            d[2] = color.z * invcount;
+            d[3] = weight * invcount;
+        }
+    });
+}
+
+// ant.sh/sh.lua: SHb, A and solidAngle
+static const float SHb[9] = {
+     0.282094791773878f,
+    -0.488602511902920f,
+     0.488602511902920f,
+    -0.488602511902920f,
+     1.092548430592079f,
+    -1.092548430592079f,
+     0.315391565252520f,
+    -1.092548430592079f,
+     0.546274215296040f,
+};
+
+static inline double
+sphere_quadrant_area(double x, double y) {
+    return std::atan2(x * y, std::sqrt(x * x + y * y + 1.0));
+}
+
+static inline double
+solid_angle(double idim, uint32_t iu, uint32_t iv) {
+    const double s = ((iu + 0.5) * 2.0 * idim) - 1.0;
+    const double t = ((iv + 0.5) * 2.0 * idim) - 1.0;
+    const double x0 = s - idim, y0 = t - idim;
+    const double x1 = s + idim, y1 = t + idim;
+    return sphere_quadrant_area(x0, y0) - sphere_quadrant_area(x0, y1) - sphere_quadrant_area(x1, y0) + sphere_quadrant_area(x1, y1);
+}
+
+void irradiance_SH(const float* cubemap, uint32_t facesize, uint32_t bandnum, float (*Eml)[3]) {
+    const uint32_t num = bandnum * bandnum;
+    const uint32_t rows = 6 * facesize;
+    // one partial sum per row, summed in row order afterwards so the result is stable
+    std::vector<double> partial(size_t(rows) * num * 3, 0.0);
+    const double idim = 1.0 / facesize;
+    parallel_rows(rows, [&](uint32_t row) {
+        const uint32_t face = row / facesize;
+        const uint32_t y = row % facesize;
+        double* Lml = &partial[size_t(row) * num * 3];
+        for (uint32_t x = 0; x < facesize; ++x) {
+            const vec3 N = normalize(uvface2dir(face, (x + 0.5f) / facesize, (y + 0.5f) / facesize));
+            const float* c = texel(cubemap, facesize, face, x, y);
+            const double sa = solid_angle(idim, x, y);
+            double Yml[9];
+            Yml[0] = SHb[0];
+            if (bandnum > 1) {
+                Yml[1] = SHb[1] * N.y;
+                Yml[2] = SHb[2] * N.z;
+                Yml[3] = SHb[3] * N.x;
+            }
+            if (bandnum > 2) {
+                Yml[4] = SHb[4] * N.y * N.x;
+                Yml[5] = SHb[5] * N.y * N.z;
+                Yml[6] = SHb[6] * (3.0 * N.z * N.z - 1.0);
+                Yml[7] = SHb[7] * N.x * N.z;
+                Yml[8] = SHb[8] * (N.x * N.x - N.y * N.y);
+            }
+            for (uint32_t i = 0; i < num; ++i) {
+                const double w = sa * Yml[i];
+                Lml[i * 3 + 0] += c[0] * w;
+                Lml[i * 3 + 1] += c[1] * w;
+                Lml[i * 3 + 2] += c[2] * w;
+            }
+        }
+    });
+    static const double A[3] = { std::numbers::pi, std::numbers::pi * 2.0 / 3.0, std::numbers::pi / 4.0 };
+    for (uint32_t l = 0; l < bandnum; ++l) {
+        for (uint32_t i = l * l; i < (l + 1) * (l + 1); ++i) {
+            double sum[3] = { 0.0, 0.0, 0.0 };
+            for (uint32_t row = 0; row < rows; ++row) {
+                const double* Lml = &partial[(size_t(row) * num + i) * 3];
+                sum[0] += Lml[0]; sum[1] += Lml[1]; sum[2] += Lml[2];
+            }
+            const double s = A[l] / std::numbers::pi * SHb[i];
+            Eml[i][0] = float(sum[0] * s);
+            Eml[i][1] = float(sum[1] * s);
+            Eml[i][2] = float(sum[2] * s);
+        }
+    }
+}
+
+void build_LUT(uint32_t size, uint32_t sample_count, float* lut) {
+    constexpr float MIN_ROUGHNESS = 0.04f;
+    parallel_rows(size, [&](uint32_t y) {
+        const float roughness = std::max(float(y) / size, MIN_ROUGHNESS);
+        const float a2 = std::pow(roughness, 4.f);
+        // N = (0, 0, 1), calc_TB gives T = -X and B = -Y
+        std::vector<ggx_sample> samples(sample_count);
+        for (uint32_t i = 0; i < sample_count; ++i) {
+            samples[i] = importance_sample_GGX(i, sample_count, roughness);
+            samples[i].H = { -samples[i].H.x, -samples[i].H.y, samples[i].H.z };
+        }
+        for (uint32_t x = 0; x < size; ++x) {
+            const float NdotV = float(x) / size;
+            const vec3 V { std::sqrt(1.f - NdotV * NdotV), 0.f, NdotV };
+            float A = 0.f, B = 0.f;
+            for (const auto& s : samples) {
+                const vec3& H = s.H;
+                const float VdotH_raw = dot(V, H);
+                const vec3 L = normalize(H * (2.f * VdotH_raw) + V * -1.f);
+                const float NdotL = std::clamp(L.z, 0.f, 1.f);
+                const float NdotH = std::clamp(H.z, 0.f, 1.f);
+                const float VdotH = std::clamp(VdotH_raw, 0.f, 1.f);
+                if (NdotL > 0.f) {
+                    const float GGXV = NdotL * std::sqrt(NdotV * NdotV * (1.f - a2) + a2);
+                    const float GGXL = NdotV * std::sqrt(NdotL * NdotL * (1.f - a2) + a2);
+                    const float Vis = 0.5f / (GGXV + GGXL);
+                    const float V_pdf = Vis * VdotH * NdotL / NdotH;
+                    const float Fc = std::pow(1.f - VdotH, 5.f);
+                    A += (1.f - Fc) * V_pdf;
+                    B += Fc * V_pdf;
+                }
+            }
+            float* d = lut + (size_t(y) * size + x) * 2;
+            d[0] = 4.f * A / sample_count;
+            d[1] = 4.f * B / sample_count;
+        }
+    });
+}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+// CPU versions of the cubemap conversions and the IBL builders in shaders/pbr/ibl.
+// All images are tightly packed RGBA32F, a cubemap is 6 faces of facesize*facesize texels
+// in +X, -X, +Y, -Y, +Z, -Z order. Work is spread over all hardware threads.
+namespace ibl {
+    // 64 hammersley samples per output texel, bilinear fetch from the cubemap
+    void cubemap2equirectangular(const float* cubemap, uint32_t facesize, float* equirect, uint32_t w, uint32_t h);
+    // nearest fetch from the equirectangular map, width must be 2 * height
+    void equirectangular2cubemap(const float* equirect, uint32_t w, uint32_t h, float* cubemap, uint32_t facesize);
+
+    // the source cubemap with a box filtered mip chain, used by prefilter()
+    struct cubemap_chain;
+    cubemap_chain* create_chain(const float* cubemap, uint32_t facesize);
+    void destroy_chain(cubemap_chain* chain);
+
+    // GGX prefiltered radiance for one mip of the specular cubemap, the same integral as cs_build_prefiltermap.sc
+    void prefilter(const cubemap_chain* source, float roughness, uint32_t sample_count, float* cubemap, uint32_t facesize);
+
+    // irradiance SH coefficients Eml, pre-multiplied by the basis constants and 1/pi (see ant.sh/sh.lua),
+    // bandnum * bandnum rgb values are written to Eml
+    void irradiance_SH(const float* cubemap, uint32_t facesize, uint32_t bandnum, float (*Eml)[3]);
+
+    // split sum DFG term, x is NdotV and y is roughness, two floats per texel (cs_build_LUT.sc)
+    void build_LUT(uint32_t size, uint32_t sample_count, float* lut);
+}
@@ -6,11 +6,7 @@
 #include <bx/readerwriter.h>
 #include <bx/pixelformat.h>
 #include <bimg/decode.h>
-#include <numbers>
-
-#include <glm/glm.hpp>
-#include <glm/ext/scalar_constants.hpp>
-#include <glm/gtx/compatibility.hpp>
+#include <algorithm>
 
 #include "luabgfx.h"
 
@@ -18,8 +14,7 @@
 
 #include "lua2struct.h"
 #include "fastio.h"
-
-static constexpr auto const_pi = std::numbers::pi_v<float>;
+#include "ibl.h"
 
 namespace lua_struct {
     template <>
@@ -141,17 +136,25 @@ static void replace_debug_mipmap_image(const bimg::ImageContainer *srt_image, co
 static int
 lclip_rect(lua_State *L) {
     auto src_memory = getmemory(L, 1);
+    auto texfmt = bimg::TextureFormat::Count;
+    if (!lua_isnoneornil(L, 2)) {
+        // convert the content (e.g. a compressed runtime texture) before clipping
+        texfmt = bimg::getFormat(lua_tostring(L, 2));
+        if (texfmt == bimg::TextureFormat::Unknown) {
+            return luaL_error(L, "Unknown texture format: %s", lua_tostring(L, 2));
+        }
+    }
 
     bx::DefaultAllocator defaultAllocator;
     AlignedAllocator allocator(&defaultAllocator, 16);
-    auto srt_image = bimg::imageParse(&allocator, (const void*)src_memory.data(), (uint32_t)src_memory.size(), bimg::TextureFormat::Count, nullptr);
-    const uint8_t* src_data = (uint8_t*)srt_image->m_data;
-    bimg::UnpackFn unpack = bimg::getUnpack(srt_image->m_format);
-    const uint32_t bpp = bimg::getBitsPerPixel(srt_image->m_format);
+    auto srt_image = bimg::imageParse(&allocator, (const void*)src_memory.data(), (uint32_t)src_memory.size(), texfmt, nullptr);
     if (!srt_image){
         lua_pushstring(L, "Invalid src image content");
         return lua_error(L);
     }
+    const uint8_t* src_data = (uint8_t*)srt_image->m_data;
+    bimg::UnpackFn unpack = bimg::getUnpack(srt_image->m_format);
+    const uint32_t bpp = bimg::getBitsPerPixel(srt_image->m_format);
     uint32_t minx = srt_image->m_width - 1;
     uint32_t miny = srt_image->m_height - 1;
     uint32_t maxx = 0;
@@ -177,6 +180,10 @@ lclip_rect(lua_State *L) {
             }
         }
     }
+    if (minx > maxx || miny > maxy) {
+        // fully transparent
+        minx = maxx = miny = maxy = 0;
+    }
     lua_pushnumber(L, srt_image->m_width);
     lua_pushnumber(L, srt_image->m_height);
     lua_pushnumber(L, minx + 1);     //dx
@@ -188,11 +195,24 @@ lclip_rect(lua_State *L) {
     return 7;
 }
 
+// accept a BGFX_MEMORY (bgfx.memory_texture) too, so an atlas can be filled in place and
+// passed to bgfx.update_texture2d without another copy.
+static std::string_view
+getpixelmemory(lua_State *L, int idx, bool writable) {
+    if (auto m = (struct memory *)luaL_testudata(L, idx, "BGFX_MEMORY")) {
+        if (writable && m->constant) {
+            luaL_error(L, "Can't write to constant memory object");
+        }
+        return { (const char*)m->data, m->size };
+    }
+    return getmemory(L, idx);
+}
+
 static int
 lupdate_atlas(lua_State *L) {
 
-    auto atlas_memory = getmemory(L, 1).data();
-    auto rect_memory  = getmemory(L, 2).data();
+    auto atlas_memory = getpixelmemory(L, 1, true);
+    auto rect_memory  = getpixelmemory(L, 2, false);
     auto ax = (uint32_t)luaL_checkinteger(L, 3) - 1;
     auto ay = (uint32_t)luaL_checkinteger(L, 4) - 1;
     auto dx = (uint32_t)luaL_checkinteger(L, 5) - 1;
@@ -202,13 +222,23 @@ lupdate_atlas(lua_State *L) {
     auto rw = (uint32_t)luaL_checkinteger(L, 9);
     auto aw = (uint32_t)luaL_checkinteger(L, 10);
 
-    uint8_t* atlas_data = (uint8_t*)atlas_memory;
-    const uint8_t* rect_data = (uint8_t*)rect_memory;
+    uint8_t* atlas_data = (uint8_t*)atlas_memory.data();
+    const uint8_t* rect_data = (uint8_t*)rect_memory.data();
     auto format = bimg::TextureFormat::RGBA8;
     bimg::UnpackFn unpack = bimg::getUnpack(format);
     bimg::PackFn pack = bimg::getPack(format);
     const uint32_t bpp = bimg::getBitsPerPixel(format);
 
+    if (dw == 0 || dh == 0) {
+        return 0;
+    }
+    if (((dy + dh - 1) * rw + dx + dw) * bpp / 8 > rect_memory.size()) {
+        return luaL_error(L, "Rect out of range: %d, %d, %d, %d", dx + 1, dy + 1, dw, dh);
+    }
+    if (((ay + dh - 1) * aw + ax + dw) * bpp / 8 > atlas_memory.size()) {
+        return luaL_error(L, "Atlas out of range: %d, %d, %d, %d", ax + 1, ay + 1, dw, dh);
+    }
+
     for (uint32_t yy = 0; yy < dh; ++yy) {
         for (uint32_t xx = 0; xx < dw; ++xx) {
             float rgba[4];
@@ -637,101 +667,19 @@ lpack2cubemap(lua_State *L){
     return 1;
 }
 
-static inline glm::vec2
-hammersley(uint32_t i, float iN) {
-    constexpr float tof = 0.5f / 0x80000000U;
-    uint32_t bits = i;
-    bits = (bits << 16u) | (bits >> 16u);
-    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
-    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
-    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
-    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
-    return{ i * iN, bits * tof};
-}
-
-struct face_address
-{
-    uint8_t face;
-    float u, v;
-};
-
-static float inline n2s(float v){return v*2.f - 1.f;}
-static float inline s2n(float v){return (v+1.f)*0.5f;}
-
-static inline face_address
-dir2uvface(const glm::vec3 &dir){
-    const float x = dir.x, y = dir.y, z = dir.z;
-    const float ax = glm::abs(x), ay = glm::abs(y), az = glm::abs(z);
-    if (ax > ay){
-        if (ax > az){
-            return (x > 0) ? face_address{0, s2n(-z/ax), s2n(y/ax)}     // +X
-                           : face_address{1, s2n(z/ax), s2n(y/ax)};     // -X
-        }
-    } else {
-        if (ay > az){
-            return (y > 0) ? face_address{2, s2n(x/ay), s2n(z/ay)}      // +Y
-                           : face_address{3, s2n(x/ay), s2n(-z/ay)};    // -Y
+// mip 0 of each face, tightly packed as ibl:: expects
+static std::vector<float>
+cubemap_texels(const bimg::ImageContainer &cm){
+    const uint32_t facesize = cm.m_width;
+    const size_t facebytes = size_t(facesize) * facesize * sizeof(float) * 4;
+    std::vector<float> texels(size_t(facesize) * facesize * 4 * 6);
+    for (uint8_t face=0; face < 6; ++face){
+        bimg::ImageMip mip;
+        if (bimg::imageGetRawData(cm, face, 0, cm.m_data, cm.m_size, mip)){
+            memcpy((uint8_t*)texels.data() + facebytes * face, mip.m_data, facebytes);
         }
     }
-
-    return z > 0 ? face_address{4, s2n(x/az), s2n(y/az)}                // +Z
-                 : face_address{5, s2n(x/az), s2n(-y/az)};              // -Z
-}
-
-
-static inline glm::vec3
-uvface2dir(int face, float u, float v){
-    u = n2s(u), v = n2s(v);
-    switch (face){
-        case 0: return glm::vec3( 1.0, v,-u); break;
-        case 1: return glm::vec3(-1.0, v, u); break;
-        case 2: return glm::vec3( u, 1.0,-v); break;
-        case 3: return glm::vec3( u,-1.0, v); break;
-        case 4: return glm::vec3( u, v, 1.0); break;
-        case 5: 
-        default: return glm::vec3(-u, v,-1.0); break;
-    }
-}
-
-static inline glm::vec3
-filter_at(const bimg::ImageContainer &cm, const glm::vec3 &direction){
-    auto addr = dir2uvface(direction);
-    bimg::ImageMip cm_mip;
-    if (!bimg::imageGetRawData(cm, (uint8_t)addr.face, 0, cm.m_data, cm.m_size, cm_mip))
-        return glm::vec3(0.f);
-
-    const float maxwidth = (float)cm.m_width-1, maxheight = (float)cm.m_height-1;
-    const glm::vec2 xy(std::min(addr.u * maxwidth,  maxwidth),
-                 std::min(addr.v * maxheight, maxheight));
-
-    const glm::uvec2 uxy = glm::floor(xy);
-
-    auto read_texel = [&cm_mip](uint32_t x, uint32_t y){
-        return *((glm::vec4*)cm_mip.m_data + cm_mip.m_width * y + x);
-    };
-
-    const uint32_t x0 = uxy.x, y0 = uxy.y;
-    const uint32_t x1 = uxy.x+1, y1 = uxy.y+1;
-
-    const auto texel_x0y0 = read_texel(x0, y0);
-    const auto texel_x1y0 = read_texel(x1, y0);
-    const auto texel_x0y1 = read_texel(x0, y1);
-    const auto texel_x1y1 = read_texel(x1, y1);
-
-    const glm::vec2 st = glm::fract(xy);
-
-    return glm::vec3(
-            glm::lerp(
-                glm::lerp(texel_x0y0, texel_x1y0, st.s), 
-                glm::lerp(texel_x0y1, texel_x1y1, st.s), 
-                st.t));
-}
-
-template<class ImageType>
-static inline void
-write_at(ImageType &face, size_t iw, size_t ih, const glm::vec3 &v){
-    auto d = (glm::vec4*)face.m_data;
-    d[face.m_width * ih + iw] = glm::vec4(v, 0.f);
+    return texels;
 }
 
 static int
@@ -742,7 +690,7 @@ lcubemap2equirectangular(lua_State *L){
     bx::DefaultAllocator allocator;
     bx::Error err;
     auto cm = bimg::imageParse(&allocator, cmdata, (uint32_t)cmsize, bimg::TextureFormat::RGBA32F, &err);
-    if (cm == nullptr){
+    if (cm == nullptr || !cm->m_cubeMap){
         return luaL_error(L, "Invalid cubemap texture");
     }
 
@@ -750,37 +698,9 @@ lcubemap2equirectangular(lua_State *L){
     const uint16_t h = (uint16_t)luaL_optinteger(L, 4, cm->m_height);
 
     auto equirectangular = bimg::imageAlloc(&allocator, bimg::TextureFormat::RGBA32F, w, h, 1, 1, false, false);
-
-    for (size_t ih = 0; ih < h; ++ih){
-        for (size_t iw = 0; iw < w; ++iw) {
-            glm::vec3 c(0.0);
-            // float x = 2.0f * (iw) / w - 1.0f;
-            // float y = 1.0f - 2.0f * (ih) / h;
-            // float theta = x * const_pi;
-            // float phi = y * const_pi * 0.5f;
-            // glm::vec3 s = {
-            //         std::cos(phi) * std::sin(theta),
-            //         std::sin(phi),
-            //         std::cos(phi) * std::cos(theta) };
-            // c += filter_at(*cm, s);
-            // write_at(*equirectangular, iw, ih, c);
-
-            const size_t numSamples = 64; // TODO: how to chose numsamples
-            for (size_t sample = 0; sample < numSamples; sample++) {
-                const glm::vec2 u = hammersley(uint32_t(sample), 1.0f / numSamples);
-                float x = 2.0f * (iw + u.x) / w - 1.0f;
-                float y = 1.0f - 2.0f * (ih + u.y) / h;
-                float theta = x * const_pi;
-                float phi = y * const_pi * 0.5f;
-                glm::vec3 s = {
-                        std::cos(phi) * std::sin(theta),
-                        std::sin(phi),
-                        std::cos(phi) * std::cos(theta) };
-                c += filter_at(*cm, s);
-            }
-            write_at(*equirectangular, iw, ih, c * (1.0f / numSamples));
-        }
-    }
+    const auto texels = cubemap_texels(*cm);
+    ibl::cubemap2equirectangular(texels.data(), cm->m_width, (float*)equirectangular->m_data, w, h);
+    bimg::imageFree(cm);
 
     bx::MemoryBlock mb(&allocator);
     write2memory(L, mb, equirectangular, fmt);
@@ -800,8 +720,8 @@ lequirectangular2cubemap(lua_State *L) {
         return luaL_error(L, "Invalid cubemap texture");
     }
 
-    const size_t width = equirectangular->m_width;
-    const size_t height = equirectangular->m_height;
+    const uint32_t width = equirectangular->m_width;
+    const uint32_t height = equirectangular->m_height;
 
     if (height * 2 != width){
         return luaL_error(L, "Invalid equirectangular map, width:%d = 2 * height:%d", width, height);
@@ -809,94 +729,118 @@ lequirectangular2cubemap(lua_State *L) {
 
     const uint16_t facesize = (uint16_t)luaL_optinteger(L, 2, height);
 
-    auto load_at = [](const auto equirectangular, size_t x, size_t y){
-        const glm::vec4 *d = (const glm::vec4*)(equirectangular->m_data);
-        return d[y*equirectangular->m_width+x];
-    };
-
-    // const float pioverone = 1.f / const_pi;
-
-    // auto toRectilinear = [=](glm::vec3 s){
-    //     float xf = std::atan2(s.x, s.z) * pioverone;   // range [-1.0, 1.0]
-    //     float yf = std::asin(s.y) * (2 * pioverone);   // range [-1.0, 1.0]
-    //     xf = (xf + 1.0f) * 0.5f * (width  - 1);        // range [0, width [
-    //     yf = (1.0f - yf) * 0.5f * (height - 1);        // range [0, height[
-    //     return glm::vec2(xf, yf);
-    // };
-
     auto cm = bimg::imageAlloc(&allocator, bimg::TextureFormat::RGBA32F, facesize, facesize, 1, 1, true, false);
+    ibl::equirectangular2cubemap((const float*)equirectangular->m_data, width, height, (float*)cm->m_data, facesize);
+    bimg::imageFree(equirectangular);
 
-    auto dir2spherecoord = [](const glm::vec3 &v)
-    {
-        return glm::vec2(
-            0.5f + 0.5f * atan2(v.z, v.x) / const_pi,
-            acos(v.y) / const_pi);
-    };
+    bx::MemoryBlock mb(&allocator);
+    write2memory(L, mb, cm, "KTX");
+    lua_pushlstring(L, (const char*)mb.more(), mb.getSize());
+    bimg::imageFree(cm);
+    return 1;
+}
 
-    const float invsize = 1.f / facesize;
+static int
+libl_prefilter(lua_State *L){
+    size_t cmsize;
+    const char* cmdata = luaL_checklstring(L, 1, &cmsize);
+    const uint32_t sample_count = (uint32_t)luaL_optinteger(L, 3, 512);
+    const char* fmt = luaL_optstring(L, 4, "RGBA16F");
+    bx::DefaultAllocator allocator;
+    bx::Error err;
+    auto source = bimg::imageParse(&allocator, cmdata, (uint32_t)cmsize, bimg::TextureFormat::RGBA32F, &err);
+    if (source == nullptr || !source->m_cubeMap){
+        return luaL_error(L, "Invalid cubemap texture");
+    }
+    const uint16_t facesize = (uint16_t)luaL_optinteger(L, 2, source->m_width);
+
+    auto chain = ibl::create_chain(cubemap_texels(*source).data(), source->m_width);
+    bimg::imageFree(source);
+
+    // mip i is filtered with roughness i/(mipcount-1), the same as ant.render/ibl
+    auto cm = bimg::imageAlloc(&allocator, bimg::TextureFormat::RGBA32F, facesize, facesize, 1, 1, true, true);
+    const uint8_t mipcount = cm->m_numMips;
+    std::vector<float> texels;
+    for (uint8_t mip=0; mip < mipcount; ++mip){
+        const uint32_t size = std::max(1, facesize >> mip);
+        const float roughness = mipcount > 1 ? float(mip) / (mipcount - 1) : 0.f;
+        texels.resize(size_t(size) * size * 4 * 6);
+        ibl::prefilter(chain, roughness, sample_count, texels.data(), size);
+        const size_t facebytes = size_t(size) * size * sizeof(float) * 4;
+        for (uint8_t face=0; face < 6; ++face){
+            bimg::ImageMip dst;
+            bimg::imageGetRawData(*cm, face, mip, cm->m_data, cm->m_size, dst);
+            memcpy((void*)dst.m_data, (const uint8_t*)texels.data() + facebytes * face, facebytes);
+        }
+    }
+    ibl::destroy_chain(chain);
 
-    auto remap_index = [=](float v){ return ((v+0.5f) * invsize);};
+    auto result = bimg::imageConvert(&allocator, bimg::getFormat(fmt), *cm, true);
+    bimg::imageFree(cm);
+    bx::MemoryBlock mb(&allocator);
+    write2memory(L, mb, result, "KTX");
+    lua_pushlstring(L, (const char*)mb.more(), mb.getSize());
+    bimg::imageFree(result);
+    return 1;
+}
 
-    for (uint8_t face=0; face < 6; ++face){
-        bimg::ImageMip cmface;
-        bimg::imageGetRawData(*cm, (uint8_t)face, 0, cm->m_data, cm->m_size, cmface);
-        for (uint16_t y=0; y<facesize; ++y){
-            for (uint16_t x=0 ; x<facesize ; ++x) {
-                const glm::vec3 dir = glm::normalize(uvface2dir(face, remap_index(x), remap_index(y)));
-                const glm::vec2 suv = dir2spherecoord(dir);
-                const glm::uvec2 uv = glm::uvec2(suv * glm::vec2(width, height));
-                auto c = load_at(equirectangular, uv.x, uv.y);
-                /////////////////////////////////////////////////////////////////////////////////////////////
-                // calculate how many samples we need based on dx, dy in the source
-                // x = cos(phi) sin(theta)
-                // y = sin(phi)
-                // z = cos(phi) cos(theta)
-
-                // here we try to figure out how many samples we need, by evaluating the surface
-                // (in pixels) in the equirectangular -- we take the bounding box of the
-                // projection of the cubemap texel's corners.
-
-                // auto pos0 = toRectilinear(glm::normalize(uvface2dir(face, remap_index(x + 0.0f), remap_index(y + 0.0f)))); // make sure to use the float version
-                // auto pos1 = toRectilinear(glm::normalize(uvface2dir(face, remap_index(x + 1.0f), remap_index(y + 0.0f)))); // make sure to use the float version
-                // auto pos2 = toRectilinear(glm::normalize(uvface2dir(face, remap_index(x + 0.0f), remap_index(y + 1.0f)))); // make sure to use the float version
-                // auto pos3 = toRectilinear(glm::normalize(uvface2dir(face, remap_index(x + 1.0f), remap_index(y + 1.0f)))); // make sure to use the float version
-                // const float minx = std::min(pos0.x, std::min(pos1.x, std::min(pos2.x, pos3.x)));
-                // const float maxx = std::max(pos0.x, std::max(pos1.x, std::max(pos2.x, pos3.x)));
-                // const float miny = std::min(pos0.y, std::min(pos1.y, std::min(pos2.y, pos3.y)));
-                // const float maxy = std::max(pos0.y, std::max(pos1.y, std::max(pos2.y, pos3.y)));
-                // const float dx = std::max(1.0f, maxx - minx);
-                // const float dy = std::max(1.0f, maxy - miny);
-                // const size_t numSamples = size_t(dx * dy);
-
-                // const float iNumSamples = 1.0f / numSamples;
-                // glm::vec3 c(0.f);
-                // for (size_t sample = 0; sample < numSamples; sample++) {
-                //     // Generate numSamples in our destination pixels and map them to input pixels
-                //     const glm::vec2 h = hammersley(uint32_t(sample), iNumSamples);
-                //     const glm::vec3 s(glm::normalize(uvface2dir(face, remap_index(x + h.x), remap_index(y + h.y))));
-                //     auto pos = toRectilinear(s);
-
-                //     // we can't use filterAt() here because it reads past the width/height
-                //     // which is okay for cubmaps but not for square images
-
-                //     // TODO: the sample should be weighed by the area it covers in the cubemap texel
-
-                //     c += glm::vec3(load_at(equirectangular, (uint32_t)pos.x, (uint32_t)pos.y));
-                // }
-                // c *= iNumSamples;
-                
-                write_at(cmface, x, y, glm::vec3(c));
-            }
+static int
+libl_irradiance_SH(lua_State *L){
+    auto memory = getmemory(L, 1);
+    const uint32_t facesize = (uint32_t)luaL_checkinteger(L, 2);
+    const uint32_t bandnum = (uint32_t)luaL_optinteger(L, 3, 3);
+    if (bandnum < 1 || bandnum > 3){
+        return luaL_error(L, "Invalid SH band number: %d", bandnum);
+    }
+    if (memory.size() < size_t(facesize) * facesize * sizeof(float) * 4 * 6){
+        return luaL_error(L, "Invalid cubemap content, need RGBA32F without mipmap");
+    }
+    float Eml[9][3];
+    ibl::irradiance_SH((const float*)memory.data(), facesize, bandnum, Eml);
+    const uint32_t num = bandnum * bandnum;
+    lua_createtable(L, num, 0);
+    for (uint32_t i=0; i < num; ++i){
+        lua_createtable(L, 4, 0);
+        for (int c=0; c < 3; ++c){
+            lua_pushnumber(L, Eml[i][c]);
+            lua_rawseti(L, -2, c+1);
         }
+        lua_pushnumber(L, 0);
+        lua_rawseti(L, -2, 4);
+        lua_rawseti(L, -2, i+1);
     }
+    return 1;
+}
 
+static int
+libl_LUT(lua_State *L){
+    const uint16_t size = (uint16_t)luaL_optinteger(L, 1, 256);
+    const uint32_t sample_count = (uint32_t)luaL_optinteger(L, 2, 512);
+    const char* fmt = luaL_optstring(L, 3, "RG16F");
+    bx::DefaultAllocator allocator;
+    auto lut = bimg::imageAlloc(&allocator, bimg::TextureFormat::RG32F, size, size, 1, 1, false, false);
+    ibl::build_LUT(size, sample_count, (float*)lut->m_data);
+    auto result = bimg::imageConvert(&allocator, bimg::getFormat(fmt), *lut, true);
+    bimg::imageFree(lut);
     bx::MemoryBlock mb(&allocator);
-    write2memory(L, mb, cm, "KTX");
+    write2memory(L, mb, result, "KTX");
     lua_pushlstring(L, (const char*)mb.more(), mb.getSize());
-    bimg::imageFree(cm);
+    bimg::imageFree(result);
     return 1;
 }
 
+static void
+create_ibl_lib(lua_State *L){
+    lua_newtable(L);
+    luaL_Reg ibllib[] = {
+        {"prefilter", libl_prefilter},
+        {"irradiance_SH", libl_irradiance_SH},
+        {"LUT", libl_LUT},
+        {nullptr, nullptr},
+    };
+    luaL_setfuncs(L, ibllib, 0);
+}
+
 static int
 lcvt2file(lua_State *L){
     auto memory = getmemory(L, 1);
@@ -1097,5 +1041,8 @@ luaopen_image(lua_State* L) {
     create_png_lib(L);
     lua_setfield(L, -2, "png");
 
+    create_ibl_lib(L);
+    lua_setfield(L, -2, "ibl");
+
     return 1;
 }
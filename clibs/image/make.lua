@@ -16,8 +16,16 @@ lm:lua_src "image" {
     },
     sources = {
         "image.cpp",
+        "ibl.cpp",
     },
     msvc = {
         flags =	"/Zc:preprocessor",
     },
 }
+
+lm:exe "image_ibl_test" {
+    sources = {
+        "ibl.cpp",
+        "test/ibl_test.cpp",
+    },
+}
@@ -0,0 +1,234 @@
+// Checks the threaded ibl:: functions against straight scalar ports of the code they replace
+// (the loops formerly in image.cpp and ant.sh/sh.lua) and some known values of the IBL terms.
+#include "../ibl.h"
+
+#include <cmath>
+#include <cstdio>
+#include <numbers>
+#include <random>
+#include <vector>
+
+static constexpr float const_pi = std::numbers::pi_v<float>;
+
+struct vec3 {
+    float x, y, z;
+};
+
+static vec3 normalize(vec3 v) {
+    const float l = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+    return { v.x / l, v.y / l, v.z / l };
+}
+
+static float n2s(float v) { return v * 2.f - 1.f; }
+static float s2n(float v) { return (v + 1.f) * 0.5f; }
+
+static vec3 uvface2dir(int face, float u, float v) {
+    u = n2s(u), v = n2s(v);
+    switch (face) {
+        case 0: return {  1.f, v,  -u };
+        case 1: return { -1.f, v,   u };
+        case 2: return {  u, 1.f,  -v };
+        case 3: return {  u, -1.f,  v };
+        case 4: return {  u,  v,  1.f };
+        default: return { -u,  v, -1.f };
+    }
+}
+
+static void dir2uvface(vec3 d, int& face, float& u, float& v) {
+    const float ax = std::abs(d.x), ay = std::abs(d.y), az = std::abs(d.z);
+    if (ax > ay && ax > az) {
+        face = d.x > 0 ? 0 : 1; u = s2n((d.x > 0 ? -d.z : d.z) / ax); v = s2n(d.y / ax);
+    } else if (ax <= ay && ay > az) {
+        face = d.y > 0 ? 2 : 3; u = s2n(d.x / ay); v = s2n((d.y > 0 ? d.z : -d.z) / ay);
+    } else {
+        face = d.z > 0 ? 4 : 5; u = s2n(d.x / az); v = s2n((d.z > 0 ? d.y : -d.y) / az);
+    }
+}
+
+static const float* texel(const std::vector<float>& cm, uint32_t size, int face, uint32_t x, uint32_t y) {
+    return &cm[((size_t(face) * size + y) * size + x) * 4];
+}
+
+static vec3 ref_filter_at(const std::vector<float>& cm, uint32_t size, vec3 dir) {
+    int face; float u, v;
+    dir2uvface(dir, face, u, v);
+    const float maxsize = (float)size - 1;
+    const float fx = std::min(u * maxsize, maxsize), fy = std::min(v * maxsize, maxsize);
+    const uint32_t x0 = (uint32_t)std::floor(fx), y0 = (uint32_t)std::floor(fy);
+    const uint32_t x1 = std::min(x0 + 1, size - 1), y1 = std::min(y0 + 1, size - 1);
+    const float s = fx - std::floor(fx), t = fy - std::floor(fy);
+    float c[3];
+    for (int i = 0; i < 3; ++i) {
+        const float a = texel(cm, size, face, x0, y0)[i] * (1 - s) + texel(cm, size, face, x1, y0)[i] * s;
+        const float b = texel(cm, size, face, x0, y1)[i] * (1 - s) + texel(cm, size, face, x1, y1)[i] * s;
+        c[i] = a * (1 - t) + b * t;
+    }
+    return { c[0], c[1], c[2] };
+}
+
+static std::vector<float> ref_cubemap2equirectangular(const std::vector<float>& cm, uint32_t size, uint32_t w, uint32_t h) {
+    std::vector<float> out(size_t(w) * h * 4);
+    for (uint32_t ih = 0; ih < h; ++ih) {
+        for (uint32_t iw = 0; iw < w; ++iw) {
+            vec3 c { 0, 0, 0 };
+            for (uint32_t sample = 0; sample < 64; ++sample) {
+                uint32_t bits = sample;
+                bits = (bits << 16u) | (bits >> 16u);
+                bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+                bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+                bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+                bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+                const float hx = sample * (1.f / 64), hy = bits * (0.5f / 0x80000000U);
+                const float x = 2.0f * (iw + hx) / w - 1.0f;
+                const float y = 1.0f - 2.0f * (ih + hy) / h;
+                const float theta = x * const_pi, phi = y * const_pi * 0.5f;
+                const vec3 r = ref_filter_at(cm, size, { std::cos(phi) * std::sin(theta), std::sin(phi), std::cos(phi) * std::cos(theta) });
+                c = { c.x + r.x, c.y + r.y, c.z + r.z };
+            }
+            float* d = &out[(size_t(ih) * w + iw) * 4];
+            d[0] = c.x / 64; d[1] = c.y / 64; d[2] = c.z / 64; d[3] = 0;
+        }
+    }
+    return out;
+}
+
+static std::vector<float> ref_equirectangular2cubemap(const std::vector<float>& e, uint32_t w, uint32_t h, uint32_t size) {
+    std::vector<float> out(size_t(size) * size * 6 * 4);
+    for (int face = 0; face < 6; ++face) {
+        for (uint32_t y = 0; y < size; ++y) {
+            for (uint32_t x = 0; x < size; ++x) {
+                const vec3 dir = normalize(uvface2dir(face, (x + 0.5f) / size, (y + 0.5f) / size));
+                const uint32_t ix = std::min((uint32_t)((0.5f + 0.5f * std::atan2(dir.z, dir.x) / const_pi) * w), w - 1);
+                const uint32_t iy = std::min((uint32_t)(std::acos(dir.y) / const_pi * h), h - 1);
+                for (int i = 0; i < 3; ++i) {
+                    out[((size_t(face) * size + y) * size + x) * 4 + i] = e[(size_t(iy) * w + ix) * 4 + i];
+                }
+            }
+        }
+    }
+    return out;
+}
+
+// ant.sh/sh.lua calc_Eml, in double like the lua version
+static void ref_irradiance_SH(const std::vector<float>& cm, uint32_t size, double Eml[9][3]) {
+    const double pi = std::numbers::pi, sqrtpi = std::sqrt(pi);
+    const double SHb[9] = {
+        0.5 / sqrtpi, -std::sqrt(3 / (4 * pi)), std::sqrt(3 / (4 * pi)), -std::sqrt(3 / (4 * pi)),
+        std::sqrt(15.0) / sqrtpi * 0.5, -std::sqrt(15.0) / sqrtpi * 0.5, std::sqrt(5.0) / sqrtpi * 0.25,
+        -std::sqrt(15.0) / sqrtpi * 0.5, std::sqrt(15.0) / sqrtpi * 0.25,
+    };
+    const double A[3] = { pi, pi * 2 / 3, pi / 4 };
+    auto area = [](double x, double y) { return std::atan2(x * y, std::sqrt(x * x + y * y + 1)); };
+    double Lml[9][3] = {};
+    const double idim = 1.0 / size;
+    for (int face = 0; face < 6; ++face) {
+        for (uint32_t y = 0; y < size; ++y) {
+            for (uint32_t x = 0; x < size; ++x) {
+                const vec3 N = normalize(uvface2dir(face, (x + 0.5f) / size, (y + 0.5f) / size));
+                const double s = (x + 0.5) * 2 * idim - 1, t = (y + 0.5) * 2 * idim - 1;
+                const double sa = area(s - idim, t - idim) - area(s - idim, t + idim) - area(s + idim, t - idim) + area(s + idim, t + idim);
+                const double Y[9] = { 1, N.y, N.z, N.x, N.y * N.x, N.y * N.z, 3.0 * N.z * N.z - 1, N.x * N.z, N.x * N.x - N.y * N.y };
+                const float* c = texel(cm, size, face, x, y);
+                for (int i = 0; i < 9; ++i) {
+                    for (int k = 0; k < 3; ++k) {
+                        Lml[i][k] += c[k] * sa * SHb[i] * Y[i];
+                    }
+                }
+            }
+        }
+    }
+    for (int i = 0; i < 9; ++i) {
+        const int l = i == 0 ? 0 : (i < 4 ? 1 : 2);
+        for (int k = 0; k < 3; ++k) {
+            Eml[i][k] = A[l] / pi * SHb[i] * Lml[i][k];
+        }
+    }
+}
+
+static int failed = 0;
+
+static void check(bool ok, const char* what) {
+    printf("%s: %s\n", what, ok ? "ok" : "FAILED");
+    failed += ok ? 0 : 1;
+}
+
+static float max_diff(const std::vector<float>& a, const std::vector<float>& b) {
+    float d = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        d = std::max(d, std::abs(a[i] - b[i]));
+    }
+    return a.size() == b.size() ? d : INFINITY;
+}
+
+int main() {
+    constexpr uint32_t SIZE = 32;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(0.f, 4.f);
+    std::vector<float> cm(size_t(SIZE) * SIZE * 6 * 4);
+    for (auto& v : cm) {
+        v = dist(rng);
+    }
+
+    std::vector<float> equirect(size_t(SIZE) * 2 * SIZE * 4);
+    ibl::cubemap2equirectangular(cm.data(), SIZE, equirect.data(), SIZE * 2, SIZE);
+    check(max_diff(equirect, ref_cubemap2equirectangular(cm, SIZE, SIZE * 2, SIZE)) < 1e-5f, "cubemap2equirectangular");
+
+    std::vector<float> back(cm.size());
+    ibl::equirectangular2cubemap(equirect.data(), SIZE * 2, SIZE, back.data(), SIZE);
+    check(max_diff(back, ref_equirectangular2cubemap(equirect, SIZE * 2, SIZE, SIZE)) == 0.f, "equirectangular2cubemap");
+
+    float Eml[9][3];
+    double ref[9][3];
+    ibl::irradiance_SH(cm.data(), SIZE, 3, Eml);
+    ref_irradiance_SH(cm, SIZE, ref);
+    float sh_diff = 0;
+    for (int i = 0; i < 9; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            sh_diff = std::max(sh_diff, (float)std::abs(Eml[i][k] - ref[i][k]));
+        }
+    }
+    check(sh_diff < 1e-5f, "irradiance_SH");
+
+    // roughness 0 reflects the texel itself, alpha holds the NdotL weight
+    auto chain = ibl::create_chain(cm.data(), SIZE);
+    std::vector<float> mip0(cm.size());
+    ibl::prefilter(chain, 0.f, 64, mip0.data(), SIZE);
+    bool mirror = true;
+    for (size_t i = 0; i < cm.size(); i += 4) {
+        mirror = mirror && std::abs(mip0[i] - cm[i]) < 1e-4f && std::abs(mip0[i + 1] - cm[i + 1]) < 1e-4f
+            && std::abs(mip0[i + 2] - cm[i + 2]) < 1e-4f && mip0[i + 3] == 1.f;
+    }
+    check(mirror, "prefilter roughness 0");
+
+    std::vector<float> again(cm.size());
+    ibl::prefilter(chain, 0.5f, 64, mip0.data(), SIZE);
+    ibl::prefilter(chain, 0.5f, 64, again.data(), SIZE);
+    check(max_diff(mip0, again) == 0.f, "prefilter is deterministic");
+    ibl::destroy_chain(chain);
+
+    // a constant environment stays constant, scaled by the average NdotL in alpha
+    std::vector<float> white(cm.size(), 1.f);
+    chain = ibl::create_chain(white.data(), SIZE);
+    std::vector<float> rough(size_t(8) * 8 * 6 * 4);
+    ibl::prefilter(chain, 1.f, 256, rough.data(), 8);
+    bool constant = true;
+    for (size_t i = 0; i < rough.size(); i += 4) {
+        constant = constant && std::abs(rough[i] - rough[i + 3]) < 1e-5f && rough[i + 3] > 0.1f && rough[i + 3] <= 1.f;
+    }
+    check(constant, "prefilter constant environment");
+    ibl::destroy_chain(chain);
+
+    // DFG: scale + bias is ~1 for smooth surfaces seen head on, and never above 1
+    constexpr uint32_t LUT_SIZE = 64;
+    std::vector<float> lut(LUT_SIZE * LUT_SIZE * 2);
+    ibl::build_LUT(LUT_SIZE, 512, lut.data());
+    const float* smooth = &lut[(LUT_SIZE - 1) * 2];
+    bool bounded = true;
+    for (size_t i = 0; i < lut.size(); i += 2) {
+        bounded = bounded && lut[i] >= 0.f && lut[i + 1] >= 0.f && lut[i] + lut[i + 1] <= 1.01f;
+    }
+    check(smooth[0] + smooth[1] > 0.95f && smooth[1] < 0.05f && bounded, "LUT");
+
+    printf(failed ? "ibl_test: %d failure(s)\n" : "ibl_test: ok\n", failed);
+    return failed ? 1 : 0;
+}
@@ -6,14 +6,26 @@
 #include <cstring>
 #include <cstdlib>
 #include <stdlib.h>
+#include <vector>
 #include "bgfx_interface.h"
 #include "luabgfx.h"
 #include "imgui_impl_platform.h"
 #include "imgui_impl_bgfx.h"
 
+// All draw lists of a viewport are packed into one vertex/index buffer pair,
+// the buffers are kept between frames and only grow.
+struct RendererBuffers {
+	bgfx_dynamic_vertex_buffer_handle_t vb = BGFX_INVALID_HANDLE;
+	bgfx_dynamic_index_buffer_handle_t ib = BGFX_INVALID_HANDLE;
+	uint32_t vbCapacity = 0;
+	uint32_t ibCapacity = 0;
+	std::vector<uint32_t> indices;
+};
+
 struct RendererViewport {
 	int viewid = -1;
 	bgfx_frame_buffer_handle_t fb = BGFX_INVALID_HANDLE;
+	RendererBuffers buffers;
 };
 
 enum class RendererTextureType: uint16_t {
@@ -48,6 +60,128 @@ static uint16_t bgfxGetHandle(int id) {
 	return (uint16_t)(id & 0xffff);
 }
 
+static uint32_t bufferCapacity(uint32_t n) {
+	uint32_t capacity = 4096;
+	while (capacity < n) {
+		capacity *= 2;
+	}
+	return capacity;
+}
+
+static void destroyBuffers(RendererBuffers& buffers) {
+	if (BGFX_HANDLE_IS_VALID(buffers.vb)) {
+		BGFX(destroy_dynamic_vertex_buffer)(buffers.vb);
+		buffers.vb = BGFX_INVALID_HANDLE;
+	}
+	if (BGFX_HANDLE_IS_VALID(buffers.ib)) {
+		BGFX(destroy_dynamic_index_buffer)(buffers.ib);
+		buffers.ib = BGFX_INVALID_HANDLE;
+	}
+	buffers.vbCapacity = 0;
+	buffers.ibCapacity = 0;
+}
+
+static bool updateBuffers(RendererBuffers& buffers, const ImDrawData* drawData) {
+	uint32_t numVertices = (uint32_t)drawData->TotalVtxCount;
+	uint32_t numIndices = (uint32_t)drawData->TotalIdxCount;
+	if (numVertices > buffers.vbCapacity || !BGFX_HANDLE_IS_VALID(buffers.vb)) {
+		if (BGFX_HANDLE_IS_VALID(buffers.vb)) {
+			BGFX(destroy_dynamic_vertex_buffer)(buffers.vb);
+		}
+		buffers.vbCapacity = bufferCapacity(numVertices);
+		buffers.vb = BGFX(create_dynamic_vertex_buffer)(buffers.vbCapacity, &g_ctx.layout, BGFX_BUFFER_NONE);
+	}
+	if (numIndices > buffers.ibCapacity || !BGFX_HANDLE_IS_VALID(buffers.ib)) {
+		if (BGFX_HANDLE_IS_VALID(buffers.ib)) {
+			BGFX(destroy_dynamic_index_buffer)(buffers.ib);
+		}
+		buffers.ibCapacity = bufferCapacity(numIndices);
+		buffers.ib = BGFX(create_dynamic_index_buffer)(buffers.ibCapacity, BGFX_BUFFER_INDEX32);
+	}
+	if (!BGFX_HANDLE_IS_VALID(buffers.vb) || !BGFX_HANDLE_IS_VALID(buffers.ib)) {
+		destroyBuffers(buffers);
+		return false;
+	}
+
+	const bgfx_memory_t* vmem = BGFX(alloc)(numVertices * sizeof(ImDrawVert));
+	ImDrawVert* verts = (ImDrawVert*)vmem->data;
+	// indices are rebased to the packed vertex buffer, so commands of different lists can be merged.
+	buffers.indices.resize(numIndices);
+	uint32_t* indices = buffers.indices.data();
+	uint32_t baseVertex = 0;
+	for (int ii = 0; ii < drawData->CmdListsCount; ++ii) {
+		const ImDrawList* drawList = drawData->CmdLists[ii];
+		memcpy(verts, drawList->VtxBuffer.Data, drawList->VtxBuffer.Size * sizeof(ImDrawVert));
+		verts += drawList->VtxBuffer.Size;
+		for (const ImDrawCmd& cmd : drawList->CmdBuffer) {
+			if (cmd.UserCallback) {
+				continue;
+			}
+			const ImDrawIdx* src = drawList->IdxBuffer.Data + cmd.IdxOffset;
+			uint32_t* dst = indices + cmd.IdxOffset;
+			const uint32_t base = baseVertex + cmd.VtxOffset;
+			for (unsigned int i = 0; i < cmd.ElemCount; ++i) {
+				dst[i] = base + src[i];
+			}
+		}
+		indices += drawList->IdxBuffer.Size;
+		baseVertex += (uint32_t)drawList->VtxBuffer.Size;
+	}
+	BGFX(update_dynamic_vertex_buffer)(buffers.vb, 0, vmem);
+	BGFX(update_dynamic_index_buffer)(buffers.ib, 0, BGFX(copy)(buffers.indices.data(), numIndices * sizeof(uint32_t)));
+	return true;
+}
+
+struct RendererBatch {
+	ImTextureID texid = 0;
+	ImVec4 clip;
+	uint32_t start = 0;
+	uint32_t count = 0;
+};
+
+static void submitBatch(bgfx_encoder_t* encoder, RendererViewport* ud, const RendererBatch& batch, const ImVec2& clip_offset, const ImVec2& clip_scale) {
+	if (batch.count == 0) {
+		return;
+	}
+	RendererTexture texture;
+	texture.id = batch.texid;
+
+	const float x = (batch.clip.x - clip_offset.x) * clip_scale.x;
+	const float y = (batch.clip.y - clip_offset.y) * clip_scale.y;
+	const float w = (batch.clip.z - batch.clip.x) * clip_scale.x;
+	const float h = (batch.clip.w - batch.clip.y) * clip_scale.y;
+
+	BGFX(encoder_set_scissor)(encoder
+		, uint16_t(std::min(std::max(x, 0.0f), 65535.0f))
+		, uint16_t(std::min(std::max(y, 0.0f), 65535.0f))
+		, uint16_t(std::min(std::max(w, 0.0f), 65535.0f))
+		, uint16_t(std::min(std::max(h, 0.0f), 65535.0f))
+		);
+
+	constexpr uint64_t state = 0
+		| BGFX_STATE_WRITE_RGB
+		| BGFX_STATE_WRITE_A
+		| BGFX_STATE_MSAA
+		| BGFX_STATE_BLEND_FUNC(BGFX_STATE_BLEND_SRC_ALPHA, BGFX_STATE_BLEND_INV_SRC_ALPHA)
+		;
+	BGFX(encoder_set_state)(encoder, state, 0);
+
+	BGFX(encoder_set_dynamic_vertex_buffer)(encoder, 0, ud->buffers.vb, 0, UINT32_MAX);
+	BGFX(encoder_set_dynamic_index_buffer)(encoder, ud->buffers.ib, batch.start, batch.count);
+	if (texture.s.type == RendererTextureType::Font) {
+		BGFX(encoder_set_texture)(encoder, 0, g_ctx.fontTex, texture.s.handle, UINT32_MAX);
+		BGFX(encoder_submit)(encoder, ud->viewid, g_ctx.fontProgram, 0, BGFX_DISCARD_ALL);
+	}
+	else {
+		BGFX(encoder_set_texture)(encoder, 0, g_ctx.imageTex, texture.s.handle, UINT32_MAX);
+		BGFX(encoder_submit)(encoder, ud->viewid, g_ctx.imageProgram, 0, BGFX_DISCARD_ALL);
+	}
+}
+
+static bool sameClip(const ImVec4& a, const ImVec4& b) {
+	return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+}
+
 void ImGui_ImplBgfx_RenderDrawData(ImGuiViewport* viewport) {
 	RendererViewport* ud = (RendererViewport*)viewport->RendererUserData;
 	const ImDrawData* drawData = viewport->DrawData;
@@ -55,6 +189,10 @@ void ImGui_ImplBgfx_RenderDrawData(ImGuiViewport* viewport) {
 	const ImVec2 clip_offset = drawData->DisplayPos;
 	const ImVec2& clip_scale = drawData->FramebufferScale;
 
+	if (drawData->TotalIdxCount == 0) {
+		return;
+	}
+
 	bgfx_encoder_t* encoder = BGFX(encoder_begin)(false);
 	BGFX(set_view_name)(ud->viewid, "ImGui", 6);
 	BGFX(set_view_mode)(ud->viewid, BGFX_VIEW_MODE_SEQUENTIAL);
@@ -76,66 +214,47 @@ void ImGui_ImplBgfx_RenderDrawData(ImGuiViewport* viewport) {
 	const float fb_h = fb_y + clip_size.y * clip_scale.y;
 	BGFX(set_view_rect)(ud->viewid, uint16_t(fb_x), uint16_t(fb_y), uint16_t(fb_w), uint16_t(fb_h));
 
-	for (size_t ii = 0, num = drawData->CmdListsCount; ii < num; ++ii) {
-		const ImDrawList* drawList = drawData->CmdLists[(int)ii];
-		uint32_t numVertices = (uint32_t)drawList->VtxBuffer.size();
-		uint32_t numIndices = (uint32_t)drawList->IdxBuffer.size();
-
-		if (numVertices != BGFX(get_avail_transient_vertex_buffer)(numVertices, &g_ctx.layout)
-			|| numIndices != BGFX(get_avail_transient_index_buffer)(numIndices, false)) {
-			break;
-		}
-
-		bgfx_transient_vertex_buffer_t tvb;
-		bgfx_transient_index_buffer_t tib;
-		BGFX(alloc_transient_vertex_buffer)(&tvb, numVertices, &g_ctx.layout);
-		BGFX(alloc_transient_index_buffer)(&tib, numIndices, false);
-		ImDrawVert* verts = (ImDrawVert*)tvb.data;
-		memcpy(verts, drawList->VtxBuffer.begin(), numVertices * sizeof(ImDrawVert));
-		ImDrawIdx* indices = (ImDrawIdx*)tib.data;
-		memcpy(indices, drawList->IdxBuffer.begin(), numIndices * sizeof(ImDrawIdx));
+	if (!updateBuffers(ud->buffers, drawData)) {
+		BGFX(encoder_end)(encoder);
+		return;
+	}
 
+	RendererBatch batch;
+	uint32_t baseIndex = 0;
+	for (int ii = 0; ii < drawData->CmdListsCount; ++ii) {
+		const ImDrawList* drawList = drawData->CmdLists[ii];
 		for (const ImDrawCmd& cmd : drawList->CmdBuffer) {
+			if (cmd.UserCallback) {
+				submitBatch(encoder, ud, batch, clip_offset, clip_scale);
+				batch.count = 0;
+				if (cmd.UserCallback != ImDrawCallback_ResetRenderState) {
+					cmd.UserCallback(drawList, &cmd);
+				}
+				continue;
+			}
 			if (0 == cmd.ElemCount) {
 				continue;
 			}
 			ImTextureID texid = cmd.GetTexID();
 			assert(NULL != texid);
-			RendererTexture texture;
-			texture.id = texid;
-
-			const float x = (cmd.ClipRect.x - clip_offset.x) * clip_scale.x;
-			const float y = (cmd.ClipRect.y - clip_offset.y) * clip_scale.y;
-			const float w = (cmd.ClipRect.z - cmd.ClipRect.x) * clip_scale.x;
-			const float h = (cmd.ClipRect.w - cmd.ClipRect.y) * clip_scale.y;
-			
-			BGFX(encoder_set_scissor)(encoder
-				, uint16_t(std::min(std::max(x, 0.0f), 65535.0f))
-				, uint16_t(std::min(std::max(y, 0.0f), 65535.0f))
-				, uint16_t(std::min(std::max(w, 0.0f), 65535.0f))
-				, uint16_t(std::min(std::max(h, 0.0f), 65535.0f))
-				);
-
-			constexpr uint64_t state = 0
-				| BGFX_STATE_WRITE_RGB
-				| BGFX_STATE_WRITE_A
-				| BGFX_STATE_MSAA
-				| BGFX_STATE_BLEND_FUNC(BGFX_STATE_BLEND_SRC_ALPHA, BGFX_STATE_BLEND_INV_SRC_ALPHA)
-				;
-			BGFX(encoder_set_state)(encoder, state, 0);
-
-			BGFX(encoder_set_transient_vertex_buffer)(encoder, 0, &tvb, cmd.VtxOffset, numVertices);
-			BGFX(encoder_set_transient_index_buffer)(encoder, &tib, cmd.IdxOffset, cmd.ElemCount);
-			if (texture.s.type == RendererTextureType::Font) {
-				BGFX(encoder_set_texture)(encoder, 0, g_ctx.fontTex, texture.s.handle, UINT32_MAX);
-				BGFX(encoder_submit)(encoder, ud->viewid, g_ctx.fontProgram, 0, BGFX_DISCARD_STATE);
-			}
-			else {
-				BGFX(encoder_set_texture)(encoder, 0, g_ctx.imageTex, texture.s.handle, UINT32_MAX);
-				BGFX(encoder_submit)(encoder, ud->viewid, g_ctx.imageProgram, 0, BGFX_DISCARD_STATE);
+			const uint32_t start = baseIndex + cmd.IdxOffset;
+			if (batch.count > 0
+				&& batch.texid == texid
+				&& sameClip(batch.clip, cmd.ClipRect)
+				&& batch.start + batch.count == start
+			) {
+				batch.count += cmd.ElemCount;
+				continue;
 			}
+			submitBatch(encoder, ud, batch, clip_offset, clip_scale);
+			batch.texid = texid;
+			batch.clip = cmd.ClipRect;
+			batch.start = start;
+			batch.count = cmd.ElemCount;
 		}
+		baseIndex += (uint32_t)drawList->IdxBuffer.Size;
 	}
+	submitBatch(encoder, ud, batch, clip_offset, clip_scale);
 	BGFX(encoder_discard)(encoder, BGFX_DISCARD_ALL);
 	BGFX(encoder_end)(encoder);
 }
@@ -185,6 +304,7 @@ static void ImGui_ImplBgfx_DestroyWindow(ImGuiViewport* viewport) {
 		if (ud->viewid != -1) {
 			ImGui_ImplBgfx_FreeViewId(ud->viewid);
 		}
+		destroyBuffers(ud->buffers);
 		delete ud;
 		viewport->RendererUserData = nullptr;
 	}
@@ -271,7 +391,10 @@ void ImGui_ImplBgfx_Shutdown() {
 	ImGui::DestroyPlatformWindows();
 	ImGuiViewport* viewport = ImGui::GetMainViewport();
 	RendererViewport* ud = (RendererViewport*)viewport->RendererUserData;
-	delete ud;
+	if (ud) {
+		destroyBuffers(ud->buffers);
+		delete ud;
+	}
 	viewport->RendererUserData = nullptr;
 }
 
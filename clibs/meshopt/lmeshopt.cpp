@@ -0,0 +1,273 @@
+#include <lua.hpp>
+
+#include "meshopt.h"
+
+#include <string>
+#include <vector>
+
+static const char*
+get_string(lua_State *L, int idx, const char* field, size_t *sz){
+    if (lua_getfield(L, idx, field) != LUA_TSTRING){
+        luaL_error(L, "Need string field: %s", field);
+    }
+    const char* s = lua_tolstring(L, -1, sz);
+    lua_pop(L, 1);
+    return s;
+}
+
+static lua_Integer
+get_integer(lua_State *L, int idx, const char* field){
+    lua_getfield(L, idx, field);
+    lua_Integer v = luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+    return v;
+}
+
+static void
+push_acmr(lua_State *L, const std::vector<uint32_t> &indices, size_t vertex_count, const char* field){
+    lua_pushnumber(L, meshopt::analyze_acmr(indices.data(), indices.size(), vertex_count));
+    lua_setfield(L, -2, field);
+}
+
+// optimize {
+//     vertex_count = n,
+//     streams = { {data, stride}, ... },   -- interleaved vertices, all sharing the index buffer
+//     indices = data, index32 = bool,      -- optional, non-indexed mesh when absent
+//     position = offset,                   -- optional, float3 position in streams[1], enables overdraw optimization
+//     overdraw_threshold = 1.05,
+// }
+// returns { vertex_count, streams = {data, ...}, indices = data, index32, acmr_before, acmr_after }
+static int
+loptimize(lua_State *L){
+    luaL_checktype(L, 1, LUA_TTABLE);
+    const size_t vertex_count = (size_t)get_integer(L, 1, "vertex_count");
+
+    std::vector<meshopt::stream> streams;
+    if (lua_getfield(L, 1, "streams") != LUA_TTABLE){
+        return luaL_error(L, "Need streams table");
+    }
+    const lua_Integer stream_count = luaL_len(L, -1);
+    for (lua_Integer i=1; i<=stream_count; ++i){
+        lua_geti(L, -1, i);
+        luaL_checktype(L, -1, LUA_TTABLE);
+        lua_geti(L, -1, 1);
+        size_t sz;
+        const char* data = luaL_checklstring(L, -1, &sz);
+        lua_geti(L, -2, 2);
+        const size_t stride = (size_t)luaL_checkinteger(L, -1);
+        if (stride == 0 || sz < stride * vertex_count){
+            return luaL_error(L, "Stream %d is too small: %d bytes, stride: %d, vertex count: %d", (int)i, (int)sz, (int)stride, (int)vertex_count);
+        }
+        streams.push_back({data, stride});
+        lua_pop(L, 3);
+    }
+    lua_pop(L, 1);
+
+    std::vector<uint32_t> indices;
+    if (lua_getfield(L, 1, "indices") == LUA_TSTRING){
+        size_t sz;
+        const char* data = lua_tolstring(L, -1, &sz);
+        lua_getfield(L, 1, "index32");
+        const bool index32 = lua_toboolean(L, -1);
+        lua_pop(L, 1);
+        const size_t count = sz / (index32 ? 4 : 2);
+        indices.resize(count);
+        for (size_t i=0; i<count; ++i){
+            uint32_t v;
+            if (index32){
+                v = ((const uint32_t*)data)[i];
+            } else {
+                v = ((const uint16_t*)data)[i];
+            }
+            if (v >= vertex_count){
+                return luaL_error(L, "Index out of range: %d, vertex count: %d", (int)v, (int)vertex_count);
+            }
+            indices[i] = v;
+        }
+    } else {
+        indices.resize(vertex_count);
+        for (size_t i=0; i<vertex_count; ++i){
+            indices[i] = (uint32_t)i;
+        }
+    }
+    lua_pop(L, 1);
+    indices.resize(indices.size() / 3 * 3);
+
+    lua_getfield(L, 1, "position");
+    const bool has_position = lua_isinteger(L, -1);
+    const size_t position_offset = has_position ? (size_t)lua_tointeger(L, -1) : 0;
+    lua_pop(L, 1);
+    if (has_position && (streams.empty() || position_offset + sizeof(float) * 3 > streams[0].stride)){
+        return luaL_error(L, "Invalid position offset: %d", (int)position_offset);
+    }
+    lua_getfield(L, 1, "overdraw_threshold");
+    const float threshold = (float)luaL_optnumber(L, -1, 1.05);
+    lua_pop(L, 1);
+
+    lua_newtable(L);
+    push_acmr(L, indices, vertex_count, "acmr_before");
+
+    // 1. merge equal vertices
+    std::vector<uint32_t> remap;
+    const uint32_t unique_count = meshopt::generate_remap(remap, indices.data(), indices.size(), streams.data(), streams.size(), vertex_count);
+    std::vector<std::string> buffers(streams.size());
+    for (size_t s=0; s<streams.size(); ++s){
+        buffers[s].resize(unique_count * streams[s].stride);
+        meshopt::remap_vertices(buffers[s].data(), streams[s].data, vertex_count, streams[s].stride, remap.data());
+    }
+    meshopt::remap_indices(indices.data(), indices.data(), indices.size(), remap.data());
+
+    // 2. triangle order
+    meshopt::optimize_vertex_cache(indices.data(), indices.size(), unique_count);
+    if (has_position){
+        meshopt::optimize_overdraw(indices.data(), indices.size(), (const float*)(buffers[0].data() + position_offset), streams[0].stride, unique_count, threshold);
+    }
+
+    // 3. vertex order
+    const uint32_t fetch_count = meshopt::optimize_vertex_fetch_remap(remap, indices.data(), indices.size(), unique_count);
+    for (size_t s=0; s<streams.size(); ++s){
+        std::string v(fetch_count * streams[s].stride, '\0');
+        meshopt::remap_vertices(v.data(), buffers[s].data(), unique_count, streams[s].stride, remap.data());
+        buffers[s].swap(v);
+    }
+    meshopt::remap_indices(indices.data(), indices.data(), indices.size(), remap.data());
+
+    push_acmr(L, indices, fetch_count, "acmr_after");
+
+    lua_pushinteger(L, fetch_count);
+    lua_setfield(L, -2, "vertex_count");
+
+    lua_createtable(L, (int)buffers.size(), 0);
+    for (size_t s=0; s<buffers.size(); ++s){
+        lua_pushlstring(L, buffers[s].data(), buffers[s].size());
+        lua_rawseti(L, -2, (lua_Integer)s+1);
+    }
+    lua_setfield(L, -2, "streams");
+
+    const bool index32 = fetch_count > 0xffff;
+    if (index32){
+        lua_pushlstring(L, (const char*)indices.data(), indices.size() * sizeof(uint32_t));
+    } else {
+        std::vector<uint16_t> ib16(indices.begin(), indices.end());
+        lua_pushlstring(L, (const char*)ib16.data(), ib16.size() * sizeof(uint16_t));
+    }
+    lua_setfield(L, -2, "indices");
+    lua_pushinteger(L, (lua_Integer)indices.size());
+    lua_setfield(L, -2, "index_count");
+    lua_pushboolean(L, index32);
+    lua_setfield(L, -2, "index32");
+    return 1;
+}
+
+static int
+lacmr(lua_State *L){
+    size_t sz;
+    const char* data = luaL_checklstring(L, 1, &sz);
+    const bool index32 = lua_toboolean(L, 2);
+    const size_t vertex_count = (size_t)luaL_checkinteger(L, 3);
+    const uint32_t cache_size = (uint32_t)luaL_optinteger(L, 4, 16);
+    std::vector<uint32_t> indices(sz / (index32 ? 4 : 2));
+    for (size_t i=0; i<indices.size(); ++i){
+        indices[i] = index32 ? ((const uint32_t*)data)[i] : ((const uint16_t*)data)[i];
+        if (indices[i] >= vertex_count){
+            return luaL_error(L, "Index out of range: %d, vertex count: %d", (int)indices[i], (int)vertex_count);
+        }
+    }
+    lua_pushnumber(L, meshopt::analyze_acmr(indices.data(), indices.size(), vertex_count, cache_size));
+    return 1;
+}
+
+// lod {
+//     vertex_count = n,
+//     position = {data, stride, offset},   -- float3 position
+//     indices = data, index32 = bool,
+//     max_levels = 4, ratio = 0.5,
+// }
+// returns { indices = data, index32, levels = { {start, num, error}, ... }, sphere = {x, y, z, r} },
+// every level indexes the same vertices, level 1 is the source index list
+static int
+llod(lua_State *L){
+    luaL_checktype(L, 1, LUA_TTABLE);
+    const size_t vertex_count = (size_t)get_integer(L, 1, "vertex_count");
+    if (lua_getfield(L, 1, "position") != LUA_TTABLE){
+        return luaL_error(L, "Need position table");
+    }
+    lua_geti(L, -1, 1);
+    size_t vsz;
+    const char* vertices = luaL_checklstring(L, -1, &vsz);
+    lua_geti(L, -2, 2);
+    const size_t stride = (size_t)luaL_checkinteger(L, -1);
+    lua_geti(L, -3, 3);
+    const size_t offset = (size_t)luaL_optinteger(L, -1, 0);
+    lua_pop(L, 4);
+    if (offset + sizeof(float) * 3 > stride || vsz < stride * vertex_count){
+        return luaL_error(L, "Invalid position stream, %d bytes, stride: %d, offset: %d", (int)vsz, (int)stride, (int)offset);
+    }
+
+    size_t isz;
+    const char* data = get_string(L, 1, "indices", &isz);
+    lua_getfield(L, 1, "index32");
+    const bool index32 = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+    std::vector<uint32_t> indices(isz / (index32 ? 4 : 2));
+    for (size_t i=0; i<indices.size(); ++i){
+        indices[i] = index32 ? ((const uint32_t*)data)[i] : ((const uint16_t*)data)[i];
+        if (indices[i] >= vertex_count){
+            return luaL_error(L, "Index out of range: %d, vertex count: %d", (int)indices[i], (int)vertex_count);
+        }
+    }
+
+    lua_getfield(L, 1, "max_levels");
+    const uint32_t max_levels = (uint32_t)luaL_optinteger(L, -1, 4);
+    lua_getfield(L, 1, "ratio");
+    const float ratio = (float)luaL_optnumber(L, -1, 0.5);
+    lua_pop(L, 2);
+
+    meshopt::lod_chain chain;
+    meshopt::generate_lods(chain, indices.data(), indices.size(), (const float*)(vertices + offset), stride, vertex_count, max_levels, ratio);
+
+    lua_newtable(L);
+    if (index32){
+        lua_pushlstring(L, (const char*)chain.indices.data(), chain.indices.size() * sizeof(uint32_t));
+    } else {
+        std::vector<uint16_t> ib16(chain.indices.begin(), chain.indices.end());
+        lua_pushlstring(L, (const char*)ib16.data(), ib16.size() * sizeof(uint16_t));
+    }
+    lua_setfield(L, -2, "indices");
+    lua_pushboolean(L, index32);
+    lua_setfield(L, -2, "index32");
+
+    lua_createtable(L, (int)chain.levels.size(), 0);
+    for (size_t i=0; i<chain.levels.size(); ++i){
+        const auto& level = chain.levels[i];
+        lua_createtable(L, 3, 0);
+        lua_pushinteger(L, level.start);
+        lua_rawseti(L, -2, 1);
+        lua_pushinteger(L, level.num);
+        lua_rawseti(L, -2, 2);
+        lua_pushnumber(L, level.error);
+        lua_rawseti(L, -2, 3);
+        lua_rawseti(L, -2, (lua_Integer)i+1);
+    }
+    lua_setfield(L, -2, "levels");
+
+    lua_createtable(L, 4, 0);
+    for (int i=0; i<4; ++i){
+        lua_pushnumber(L, chain.sphere[i]);
+        lua_rawseti(L, -2, i+1);
+    }
+    lua_setfield(L, -2, "sphere");
+    return 1;
+}
+
+extern "C" int
+luaopen_meshopt(lua_State *L){
+    luaL_Reg lib[] = {
+        { "optimize",   loptimize },
+        { "acmr",       lacmr },
+        { "lod",        llod },
+        { nullptr,      nullptr },
+    };
+    luaL_newlib(L, lib);
+    return 1;
+}
@@ -0,0 +1,15 @@
+local lm = require "luamake"
+
+lm:lua_src "meshopt" {
+    sources = {
+        "meshopt.cpp",
+        "lmeshopt.cpp",
+    },
+}
+
+lm:exe "meshopt_test" {
+    sources = {
+        "meshopt.cpp",
+        "test/meshopt_test.cpp",
+    },
+}
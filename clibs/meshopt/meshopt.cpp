@@ -0,0 +1,686 @@
+#include "meshopt.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace meshopt {
+
+static constexpr uint32_t INVALID = ~0u;
+
+static uint32_t
+hash_vertex(const stream* streams, size_t stream_count, size_t v) {
+    // FNV-1a over the bytes of every stream
+    uint32_t h = 2166136261u;
+    for (size_t s = 0; s < stream_count; ++s) {
+        const uint8_t* p = (const uint8_t*)streams[s].data + v * streams[s].stride;
+        for (size_t i = 0; i < streams[s].stride; ++i) {
+            h = (h ^ p[i]) * 16777619u;
+        }
+    }
+    return h;
+}
+
+static bool
+equal_vertex(const stream* streams, size_t stream_count, size_t a, size_t b) {
+    for (size_t s = 0; s < stream_count; ++s) {
+        const uint8_t* data = (const uint8_t*)streams[s].data;
+        const size_t stride = streams[s].stride;
+        if (memcmp(data + a * stride, data + b * stride, stride) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t generate_remap(std::vector<uint32_t>& remap, const uint32_t* indices, size_t index_count, const stream* streams, size_t stream_count, size_t vertex_count) {
+    remap.assign(vertex_count, INVALID);
+    size_t buckets = 1;
+    while (buckets < vertex_count * 2) {
+        buckets *= 2;
+    }
+    std::vector<uint32_t> table(buckets, INVALID);
+    const size_t mask = buckets - 1;
+
+    uint32_t next = 0;
+    const size_t count = indices ? index_count : vertex_count;
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t v = indices ? indices[i] : (uint32_t)i;
+        assert(v < vertex_count);
+        if (remap[v] != INVALID) {
+            continue;
+        }
+        size_t bucket = hash_vertex(streams, stream_count, v) & mask;
+        for (size_t probe = 0; ; ++probe) {
+            const uint32_t e = table[bucket];
+            if (e == INVALID) {
+                table[bucket] = v;
+                remap[v] = next++;
+                break;
+            }
+            if (equal_vertex(streams, stream_count, e, v)) {
+                remap[v] = remap[e];
+                break;
+            }
+            bucket = (bucket + probe + 1) & mask;
+        }
+    }
+    return next;
+}
+
+void remap_vertices(void* dst, const void* src, size_t vertex_count, size_t stride, const uint32_t* remap) {
+    for (size_t i = 0; i < vertex_count; ++i) {
+        if (remap[i] != INVALID) {
+            memcpy((uint8_t*)dst + remap[i] * stride, (const uint8_t*)src + i * stride, stride);
+        }
+    }
+}
+
+void remap_indices(uint32_t* dst, const uint32_t* indices, size_t index_count, const uint32_t* remap) {
+    for (size_t i = 0; i < index_count; ++i) {
+        dst[i] = remap[indices[i]];
+    }
+}
+
+namespace forsyth {
+    static constexpr int CACHE_SIZE = 32;
+    static constexpr uint32_t MAX_VALENCE = 64;
+
+    struct score_table {
+        float cache[CACHE_SIZE];
+        float live[MAX_VALENCE];
+        score_table() {
+            for (int i = 0; i < CACHE_SIZE; ++i) {
+                // the last triangle's vertices get a fixed score so no preference for its edges
+                cache[i] = i < 3 ? 0.75f : std::pow(1.f - float(i - 3) / (CACHE_SIZE - 3), 1.5f);
+            }
+            live[0] = 0.f;
+            for (uint32_t i = 1; i < MAX_VALENCE; ++i) {
+                live[i] = 2.f / std::sqrt(float(i));
+            }
+        }
+    };
+
+    static float
+    vertex_score(const score_table& t, int cache_pos, uint32_t live) {
+        if (live == 0) {
+            return -1.f;
+        }
+        const float c = cache_pos >= 0 ? t.cache[cache_pos] : 0.f;
+        return c + (live < MAX_VALENCE ? t.live[live] : 2.f / std::sqrt(float(live)));
+    }
+}
+
+void optimize_vertex_cache(uint32_t* indices, size_t index_count, size_t vertex_count) {
+    using namespace forsyth;
+    static const score_table scores;
+    const size_t face_count = index_count / 3;
+    if (face_count == 0) {
+        return;
+    }
+
+    // triangles of every vertex, the first live[v] entries are not emitted yet
+    std::vector<uint32_t> live(vertex_count, 0);
+    for (size_t i = 0; i < face_count * 3; ++i) {
+        live[indices[i]]++;
+    }
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; ++v) {
+        offsets[v + 1] = offsets[v] + live[v];
+    }
+    std::vector<uint32_t> adjacency(face_count * 3);
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < face_count * 3; ++i) {
+            adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+        }
+    }
+
+    std::vector<int> cache_pos(vertex_count, -1);
+    std::vector<float> vscore(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v) {
+        vscore[v] = vertex_score(scores, -1, live[v]);
+    }
+    std::vector<float> tscore(face_count);
+    std::vector<bool> emitted(face_count, false);
+    for (size_t f = 0; f < face_count; ++f) {
+        tscore[f] = vscore[indices[f * 3]] + vscore[indices[f * 3 + 1]] + vscore[indices[f * 3 + 2]];
+    }
+
+    std::vector<uint32_t> result(face_count * 3);
+    uint32_t cache[CACHE_SIZE + 3];
+    uint32_t cache_count = 0;
+    size_t cursor = 0;      // input order fallback for dead ends
+
+    uint32_t best = uint32_t(std::max_element(tscore.begin(), tscore.end()) - tscore.begin());
+    for (size_t out = 0; out < face_count; ++out) {
+        const uint32_t* tri = indices + best * 3;
+        result[out * 3 + 0] = tri[0];
+        result[out * 3 + 1] = tri[1];
+        result[out * 3 + 2] = tri[2];
+        emitted[best] = true;
+
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t v = tri[k];
+            uint32_t* list = &adjacency[offsets[v]];
+            for (uint32_t j = 0; j < live[v]; ++j) {
+                if (list[j] == best) {
+                    std::swap(list[j], list[live[v] - 1]);
+                    live[v]--;
+                    break;
+                }
+            }
+        }
+
+        // LRU: the triangle's vertices move to the front
+        uint32_t new_cache[CACHE_SIZE + 3];
+        uint32_t new_count = 0;
+        for (int k = 0; k < 3; ++k) {
+            if (std::find(new_cache, new_cache + new_count, tri[k]) == new_cache + new_count) {
+                new_cache[new_count++] = tri[k];
+            }
+        }
+        for (uint32_t i = 0; i < cache_count; ++i) {
+            const uint32_t v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                new_cache[new_count++] = v;
+            }
+        }
+
+        for (uint32_t i = 0; i < new_count; ++i) {
+            const uint32_t v = new_cache[i];
+            cache_pos[v] = i < CACHE_SIZE ? int(i) : -1;
+            const float s = vertex_score(scores, cache_pos[v], live[v]);
+            const float diff = s - vscore[v];
+            vscore[v] = s;
+            const uint32_t* list = &adjacency[offsets[v]];
+            for (uint32_t j = 0; j < live[v]; ++j) {
+                tscore[list[j]] += diff;
+            }
+        }
+
+        cache_count = std::min<uint32_t>(new_count, CACHE_SIZE);
+        std::copy(new_cache, new_cache + cache_count, cache);
+
+        float best_score = -1.f;
+        best = INVALID;
+        for (uint32_t i = 0; i < cache_count; ++i) {
+            const uint32_t v = cache[i];
+            const uint32_t* list = &adjacency[offsets[v]];
+            for (uint32_t j = 0; j < live[v]; ++j) {
+                const uint32_t f = list[j];
+                if (tscore[f] > best_score) {
+                    best_score = tscore[f];
+                    best = f;
+                }
+            }
+        }
+        if (best == INVALID) {
+            while (cursor < face_count && emitted[cursor]) {
+                ++cursor;
+            }
+            if (cursor == face_count) {
+                break;
+            }
+            best = uint32_t(cursor);
+        }
+    }
+    std::copy(result.begin(), result.end(), indices);
+}
+
+// FIFO cache simulation with timestamps, reset by bumping the timestamp past the cache size
+struct fifo_cache {
+    std::vector<uint32_t> timestamps;
+    uint32_t timestamp;
+    uint32_t size;
+    fifo_cache(size_t vertex_count, uint32_t cache_size)
+        : timestamps(vertex_count, 0)
+        , timestamp(cache_size + 1)
+        , size(cache_size)
+    {}
+    uint32_t triangle(const uint32_t* tri) {
+        uint32_t misses = 0;
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t v = tri[k];
+            if (timestamp - timestamps[v] > size) {
+                timestamps[v] = timestamp++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+    void reset() {
+        timestamp += size + 1;
+    }
+};
+
+float analyze_acmr(const uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t cache_size) {
+    const size_t face_count = index_count / 3;
+    if (face_count == 0) {
+        return 0.f;
+    }
+    fifo_cache cache(vertex_count, cache_size);
+    size_t misses = 0;
+    for (size_t f = 0; f < face_count; ++f) {
+        misses += cache.triangle(indices + f * 3);
+    }
+    return float(misses) / float(face_count);
+}
+
+void optimize_overdraw(uint32_t* indices, size_t index_count, const float* positions, size_t position_stride, size_t vertex_count, float threshold) {
+    const size_t face_count = index_count / 3;
+    if (face_count == 0) {
+        return;
+    }
+    constexpr uint32_t CACHE_SIZE = 16;
+    fifo_cache cache(vertex_count, CACHE_SIZE);
+
+    // hard boundaries: a triangle with three misses starts a new patch
+    std::vector<uint32_t> hard;
+    for (size_t f = 0; f < face_count; ++f) {
+        if (cache.triangle(indices + f * 3) == 3 || f == 0) {
+            hard.push_back(uint32_t(f));
+        }
+    }
+    hard.push_back(uint32_t(face_count));
+
+    // soft boundaries: split a patch where the running ACMR is already within threshold of the whole patch
+    std::vector<uint32_t> clusters;
+    for (size_t c = 0; c + 1 < hard.size(); ++c) {
+        const uint32_t start = hard[c], end = hard[c + 1];
+        cache.reset();
+        uint32_t misses = 0;
+        for (uint32_t f = start; f < end; ++f) {
+            misses += cache.triangle(indices + f * 3);
+        }
+        const float target = threshold * float(misses) / float(end - start);
+
+        cache.reset();
+        clusters.push_back(start);
+        uint32_t first = start, running = 0;
+        for (uint32_t f = start; f < end; ++f) {
+            running += cache.triangle(indices + f * 3);
+            if (f + 1 < end && float(running) <= target * float(f + 1 - first)) {
+                clusters.push_back(f + 1);
+                cache.reset();
+                first = f + 1;
+                running = 0;
+            }
+        }
+    }
+    clusters.push_back(uint32_t(face_count));
+
+    auto position = [&](uint32_t v) {
+        return (const float*)((const uint8_t*)positions + v * position_stride);
+    };
+    double mesh_centroid[3] = { 0, 0, 0 };
+    for (size_t i = 0; i < face_count * 3; ++i) {
+        const float* p = position(indices[i]);
+        mesh_centroid[0] += p[0]; mesh_centroid[1] += p[1]; mesh_centroid[2] += p[2];
+    }
+    for (double& c : mesh_centroid) {
+        c /= double(face_count * 3);
+    }
+
+    // sort key: how far the cluster faces away from the mesh center
+    const size_t cluster_count = clusters.size() - 1;
+    std::vector<float> keys(cluster_count);
+    for (size_t c = 0; c < cluster_count; ++c) {
+        double centroid[3] = { 0, 0, 0 }, normal[3] = { 0, 0, 0 }, area = 0;
+        for (uint32_t f = clusters[c]; f < clusters[c + 1]; ++f) {
+            const float* p0 = position(indices[f * 3 + 0]);
+            const float* p1 = position(indices[f * 3 + 1]);
+            const float* p2 = position(indices[f * 3 + 2]);
+            const double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            const double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            const double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            const double a = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; ++k) {
+                centroid[k] += (p0[k] + p1[k] + p2[k]) * (a / 3);
+                normal[k] += n[k];
+            }
+            area += a;
+        }
+        const double inv_area = area > 0 ? 1.0 / area : 0.0;
+        const double nl = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        const double inv_nl = nl > 0 ? 1.0 / nl : 0.0;
+        double key = 0;
+        for (int k = 0; k < 3; ++k) {
+            key += (centroid[k] * inv_area - mesh_centroid[k]) * normal[k] * inv_nl;
+        }
+        keys[c] = float(key);
+    }
+
+    std::vector<uint32_t> order(cluster_count);
+    for (size_t c = 0; c < cluster_count; ++c) {
+        order[c] = uint32_t(c);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+    std::vector<uint32_t> result;
+    result.reserve(face_count * 3);
+    for (uint32_t c : order) {
+        result.insert(result.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+    }
+    std::copy(result.begin(), result.end(), indices);
+}
+
+uint32_t optimize_vertex_fetch_remap(std::vector<uint32_t>& remap, const uint32_t* indices, size_t index_count, size_t vertex_count) {
+    remap.assign(vertex_count, INVALID);
+    uint32_t next = 0;
+    for (size_t i = 0; i < index_count; ++i) {
+        uint32_t& r = remap[indices[i]];
+        if (r == INVALID) {
+            r = next++;
+        }
+    }
+    return next;
+}
+
+namespace simplifier {
+    // area weighted sum of squared distances to the planes of the triangles around a vertex
+    struct quadric {
+        double a00, a11, a22, a01, a02, a12;
+        double b0, b1, b2;
+        double c;
+        double w;
+    };
+
+    static void
+    add(quadric& q, const quadric& r) {
+        q.a00 += r.a00; q.a11 += r.a11; q.a22 += r.a22;
+        q.a01 += r.a01; q.a02 += r.a02; q.a12 += r.a12;
+        q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+        q.c += r.c;
+        q.w += r.w;
+    }
+
+    static quadric
+    plane(const double n[3], double d, double w) {
+        return {
+            n[0] * n[0] * w, n[1] * n[1] * w, n[2] * n[2] * w,
+            n[0] * n[1] * w, n[0] * n[2] * w, n[1] * n[2] * w,
+            n[0] * d * w, n[1] * d * w, n[2] * d * w,
+            d * d * w,
+            w,
+        };
+    }
+
+    // mean squared distance
+    static double
+    error(const quadric& q, const double p[3]) {
+        const double x = p[0], y = p[1], z = p[2];
+        const double r = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z
+            + 2 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z)
+            + 2 * (q.b0 * x + q.b1 * y + q.b2 * z)
+            + q.c;
+        return q.w > 0 ? std::abs(r) / q.w : 0;
+    }
+
+    static void
+    normal(const double* p0, const double* p1, const double* p2, double n[3]) {
+        const double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        const double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+
+    struct collapse {
+        uint32_t from;      // position id
+        uint32_t to;        // vertex index
+        double cost;
+    };
+}
+
+size_t simplify(uint32_t* dst, const uint32_t* indices, size_t index_count, const float* positions, size_t position_stride, size_t vertex_count, size_t target_index_count, float target_error, float* result_error) {
+    using namespace simplifier;
+    index_count = index_count / 3 * 3;
+    std::vector<uint32_t> result(indices, indices + index_count);
+    if (result_error) {
+        *result_error = 0.f;
+    }
+
+    // vertices at the same position share one position id, the first vertex with that position
+    std::vector<uint32_t> pid(vertex_count);
+    std::vector<double> pos(vertex_count * 3);
+    {
+        size_t buckets = 1;
+        while (buckets < vertex_count * 2) {
+            buckets *= 2;
+        }
+        std::vector<uint32_t> table(buckets, INVALID);
+        for (size_t v = 0; v < vertex_count; ++v) {
+            const float* p = (const float*)((const uint8_t*)positions + v * position_stride);
+            pos[v * 3 + 0] = p[0]; pos[v * 3 + 1] = p[1]; pos[v * 3 + 2] = p[2];
+            const stream ps { p, sizeof(float) * 3 };
+            size_t bucket = hash_vertex(&ps, 1, 0) & (buckets - 1);
+            for (size_t probe = 0; ; ++probe) {
+                const uint32_t e = table[bucket];
+                if (e == INVALID) {
+                    table[bucket] = uint32_t(v);
+                    pid[v] = uint32_t(v);
+                    break;
+                }
+                if (memcmp(&pos[e * 3], &pos[v * 3], sizeof(double) * 3) == 0) {
+                    pid[v] = e;
+                    break;
+                }
+                bucket = (bucket + probe + 1) & (buckets - 1);
+            }
+        }
+    }
+
+    // only vertices inside one attribute chart and away from borders may move
+    std::vector<uint8_t> movable(vertex_count, 1);
+    {
+        std::vector<uint32_t> wedge(vertex_count, INVALID);
+        for (uint32_t v : result) {
+            uint32_t& w = wedge[pid[v]];
+            if (w == INVALID) {
+                w = v;
+            } else if (w != v) {
+                movable[pid[v]] = 0;
+            }
+        }
+        // border and non manifold edges are not shared by exactly two triangles
+        std::vector<uint64_t> edges;
+        edges.reserve(index_count);
+        for (size_t i = 0; i < index_count; i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                const uint32_t a = pid[result[i + k]], b = pid[result[i + (k + 1) % 3]];
+                edges.push_back((uint64_t(std::min(a, b)) << 32) | std::max(a, b));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < edges.size(); ) {
+            size_t j = i;
+            while (j < edges.size() && edges[j] == edges[i]) {
+                ++j;
+            }
+            if (j - i != 2) {
+                movable[uint32_t(edges[i] >> 32)] = 0;
+                movable[uint32_t(edges[i])] = 0;
+            }
+            i = j;
+        }
+    }
+
+    std::vector<quadric> quadrics(vertex_count, quadric {});
+    for (size_t i = 0; i < index_count; i += 3) {
+        const uint32_t a = pid[result[i]], b = pid[result[i + 1]], c = pid[result[i + 2]];
+        double n[3];
+        normal(&pos[a * 3], &pos[b * 3], &pos[c * 3], n);
+        const double area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (area == 0) {
+            continue;
+        }
+        n[0] /= area; n[1] /= area; n[2] /= area;
+        const double d = -(n[0] * pos[a * 3] + n[1] * pos[a * 3 + 1] + n[2] * pos[a * 3 + 2]);
+        const quadric q = plane(n, d, area * 0.5);
+        add(quadrics[a], q);
+        add(quadrics[b], q);
+        add(quadrics[c], q);
+    }
+
+    const size_t target_faces = target_index_count / 3;
+    const double max_cost = double(target_error) * double(target_error);
+    double worst = 0;
+    std::vector<collapse> candidates;
+    std::vector<uint32_t> offsets(vertex_count + 1), adjacency;
+    std::vector<uint8_t> locked(vertex_count);
+    std::vector<uint32_t> collapse_to(vertex_count);
+    while (result.size() / 3 > target_faces) {
+        const size_t face_count = result.size() / 3;
+        candidates.clear();
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                const uint32_t a = result[i + k], b = result[i + (k + 1) % 3];
+                const uint32_t pa = pid[a], pb = pid[b];
+                if (movable[pa]) {
+                    candidates.push_back({ pa, b, error(quadrics[pa], &pos[pb * 3]) });
+                }
+                if (movable[pb]) {
+                    candidates.push_back({ pb, a, error(quadrics[pb], &pos[pa * 3]) });
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const collapse& l, const collapse& r) {
+            if (l.cost != r.cost) return l.cost < r.cost;
+            if (l.from != r.from) return l.from < r.from;
+            return l.to < r.to;
+        });
+
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (uint32_t v : result) {
+            offsets[pid[v] + 1]++;
+        }
+        for (size_t v = 0; v < vertex_count; ++v) {
+            offsets[v + 1] += offsets[v];
+        }
+        adjacency.resize(result.size());
+        {
+            std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < result.size(); ++i) {
+                adjacency[fill[pid[result[i]]]++] = uint32_t(i / 3);
+            }
+        }
+
+        // every collapse removes about two triangles, collapses in one pass don't share neighbours
+        const size_t limit = (face_count - target_faces) / 2 + 1;
+        std::fill(locked.begin(), locked.end(), 0);
+        std::fill(collapse_to.begin(), collapse_to.end(), INVALID);
+        size_t applied = 0;
+        for (const collapse& c : candidates) {
+            if (applied >= limit || c.cost > max_cost) {
+                break;
+            }
+            const uint32_t pto = pid[c.to];
+            if (locked[c.from] || locked[pto]) {
+                continue;
+            }
+            bool flips = false;
+            for (uint32_t j = offsets[c.from]; j < offsets[c.from + 1] && !flips; ++j) {
+                const uint32_t* tri = &result[adjacency[j] * 3];
+                const uint32_t p[3] = { pid[tri[0]], pid[tri[1]], pid[tri[2]] };
+                if (p[0] == pto || p[1] == pto || p[2] == pto) {
+                    continue;   // becomes degenerate
+                }
+                double n0[3], n1[3];
+                normal(&pos[p[0] * 3], &pos[p[1] * 3], &pos[p[2] * 3], n0);
+                const double* q[3];
+                for (int k = 0; k < 3; ++k) {
+                    q[k] = &pos[(p[k] == c.from ? pto : p[k]) * 3];
+                }
+                normal(q[0], q[1], q[2], n1);
+                flips = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0;
+            }
+            if (flips) {
+                continue;
+            }
+            collapse_to[c.from] = c.to;
+            add(quadrics[pto], quadrics[c.from]);
+            worst = std::max(worst, c.cost);
+            for (uint32_t j = offsets[c.from]; j < offsets[c.from + 1]; ++j) {
+                const uint32_t* tri = &result[adjacency[j] * 3];
+                locked[pid[tri[0]]] = locked[pid[tri[1]]] = locked[pid[tri[2]]] = 1;
+            }
+            movable[c.from] = 0;
+            applied++;
+        }
+        if (applied == 0) {
+            break;
+        }
+
+        size_t n = 0;
+        for (size_t i = 0; i < result.size(); i += 3) {
+            uint32_t tri[3];
+            for (int k = 0; k < 3; ++k) {
+                const uint32_t v = result[i + k];
+                tri[k] = collapse_to[pid[v]] != INVALID ? collapse_to[pid[v]] : v;
+            }
+            const uint32_t a = pid[tri[0]], b = pid[tri[1]], c = pid[tri[2]];
+            if (a != b && b != c && a != c) {
+                result[n++] = tri[0];
+                result[n++] = tri[1];
+                result[n++] = tri[2];
+            }
+        }
+        result.resize(n);
+    }
+
+    std::copy(result.begin(), result.end(), dst);
+    if (result_error) {
+        *result_error = float(std::sqrt(worst));
+    }
+    return result.size();
+}
+
+void generate_lods(lod_chain& chain, const uint32_t* indices, size_t index_count, const float* positions, size_t position_stride, size_t vertex_count, uint32_t max_levels, float ratio) {
+    index_count = index_count / 3 * 3;
+    chain.levels.clear();
+    chain.indices.assign(indices, indices + index_count);
+    chain.levels.push_back({ 0, uint32_t(index_count), 0.f });
+
+    float minv[3] = { INFINITY, INFINITY, INFINITY }, maxv[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (size_t i = 0; i < index_count; ++i) {
+        const float* p = (const float*)((const uint8_t*)positions + indices[i] * position_stride);
+        for (int k = 0; k < 3; ++k) {
+            minv[k] = std::min(minv[k], p[k]);
+            maxv[k] = std::max(maxv[k], p[k]);
+        }
+    }
+    float radius = 0.f;
+    for (int k = 0; k < 3; ++k) {
+        chain.sphere[k] = index_count ? (minv[k] + maxv[k]) * 0.5f : 0.f;
+    }
+    for (size_t i = 0; i < index_count; ++i) {
+        const float* p = (const float*)((const uint8_t*)positions + indices[i] * position_stride);
+        const float dx = p[0] - chain.sphere[0], dy = p[1] - chain.sphere[1], dz = p[2] - chain.sphere[2];
+        radius = std::max(radius, dx * dx + dy * dy + dz * dz);
+    }
+    chain.sphere[3] = std::sqrt(radius);
+    if (chain.sphere[3] == 0.f) {
+        return;
+    }
+
+    // every level is simplified from the source, so the errors don't stack up
+    std::vector<uint32_t> lod(index_count);
+    size_t previous = index_count;
+    float target = float(index_count / 3);
+    for (uint32_t level = 1; level < max_levels; ++level) {
+        target *= ratio;
+        float error = 0.f;
+        const size_t n = simplify(lod.data(), indices, index_count, positions, position_stride, vertex_count, size_t(target) * 3, INFINITY, &error);
+        if (n == 0 || float(n) > float(previous) * 0.8f) {
+            break;
+        }
+        optimize_vertex_cache(lod.data(), n, vertex_count);
+        chain.levels.push_back({ uint32_t(chain.indices.size()), uint32_t(n), error / chain.sphere[3] });
+        chain.indices.insert(chain.indices.end(), lod.begin(), lod.begin() + n);
+        previous = n;
+    }
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Index/vertex buffer optimization for the model compiler.
+// A mesh has one index list and any number of interleaved vertex streams that share it.
+namespace meshopt {
+    struct stream {
+        const void* data;
+        size_t stride;
+    };
+
+    // remap[i] is the new index of vertex i, equal vertices (all streams bitwise equal) share one index,
+    // new indices are assigned in first-use order. indices may be null for a non-indexed mesh.
+    // Returns the number of unique vertices.
+    uint32_t generate_remap(std::vector<uint32_t>& remap, const uint32_t* indices, size_t index_count, const stream* streams, size_t stream_count, size_t vertex_count);
+    void remap_vertices(void* dst, const void* src, size_t vertex_count, size_t stride, const uint32_t* remap);
+    void remap_indices(uint32_t* dst, const uint32_t* indices, size_t index_count, const uint32_t* remap);
+
+    // triangle order for the post-transform cache (Forsyth, LRU cache of 32 entries)
+    void optimize_vertex_cache(uint32_t* indices, size_t index_count, size_t vertex_count);
+    // reorders the clusters optimize_vertex_cache left so that outer facing ones draw first,
+    // threshold is how much the ACMR may get worse (1.05 = 5%)
+    void optimize_overdraw(uint32_t* indices, size_t index_count, const float* positions, size_t position_stride, size_t vertex_count, float threshold);
+    // vertex order of first use, fills remap like generate_remap
+    uint32_t optimize_vertex_fetch_remap(std::vector<uint32_t>& remap, const uint32_t* indices, size_t index_count, size_t vertex_count);
+
+    // quadric edge collapse simplification. Vertices are never moved or added, so every result
+    // indexes the same vertex buffer; border and attribute seam vertices are kept.
+    // Stops at target_index_count or when the next collapse would exceed target_error (object space distance).
+    // Returns the index count written to dst, result_error is the largest error of the applied collapses.
+    size_t simplify(uint32_t* dst, const uint32_t* indices, size_t index_count, const float* positions, size_t position_stride, size_t vertex_count, size_t target_index_count, float target_error, float* result_error);
+
+    struct lod_level {
+        uint32_t start;             // first index in the concatenated index list
+        uint32_t num;
+        float error;                // simplification error relative to the bounding sphere radius
+    };
+    struct lod_chain {
+        float sphere[4];            // bounding sphere of the vertices: center, radius
+        std::vector<lod_level> levels;
+        std::vector<uint32_t> indices;
+    };
+    // level 0 is the source indices, each next level targets ratio of the previous triangle count,
+    // the chain ends when a level can't get below 80% of the previous one or max_levels is reached
+    void generate_lods(lod_chain& chain, const uint32_t* indices, size_t index_count, const float* positions, size_t position_stride, size_t vertex_count, uint32_t max_levels, float ratio);
+
+    // average cache miss ratio: transformed vertices per triangle with a FIFO cache
+    float analyze_acmr(const uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t cache_size = 16);
+}
@@ -0,0 +1,122 @@
+// Runs the model compiler pipeline (remap, vertex cache, overdraw, vertex fetch) on a
+// shuffled, non-indexed grid and reports the ACMR before and after.
+#include "../meshopt.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+struct vertex {
+    float p[3];
+    float uv[2];
+};
+
+static constexpr uint32_t GRID = 64;
+
+static std::vector<vertex> make_grid() {
+    std::vector<std::array<uint32_t, 3>> tris;
+    auto corner = [](uint32_t x, uint32_t y) {
+        return vertex { { float(x), 0.f, float(y) }, { float(x) / GRID, float(y) / GRID } };
+    };
+    std::vector<vertex> vertices;
+    for (uint32_t y = 0; y < GRID; ++y) {
+        for (uint32_t x = 0; x < GRID; ++x) {
+            const vertex a = corner(x, y), b = corner(x + 1, y), c = corner(x + 1, y + 1), d = corner(x, y + 1);
+            for (const vertex& v : { a, c, b, a, d, c }) {
+                vertices.push_back(v);
+            }
+        }
+    }
+    // shuffle the triangles, like an exporter that does not care
+    std::mt19937 rng(7);
+    const size_t face_count = vertices.size() / 3;
+    for (size_t i = face_count - 1; i > 0; --i) {
+        const size_t j = rng() % (i + 1);
+        for (int k = 0; k < 3; ++k) {
+            std::swap(vertices[i * 3 + k], vertices[j * 3 + k]);
+        }
+    }
+    return vertices;
+}
+
+using triangle = std::array<float, 9>;
+
+static std::vector<triangle> triangles(const std::vector<vertex>& vertices, const std::vector<uint32_t>& indices) {
+    std::vector<triangle> result;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        // rotate so the smallest vertex is first, winding is kept
+        size_t first = 0;
+        for (size_t k = 1; k < 3; ++k) {
+            if (memcmp(vertices[indices[i + k]].p, vertices[indices[i + first]].p, sizeof(float) * 3) < 0) {
+                first = k;
+            }
+        }
+        triangle t;
+        for (size_t k = 0; k < 3; ++k) {
+            memcpy(&t[k * 3], vertices[indices[i + (first + k) % 3]].p, sizeof(float) * 3);
+        }
+        result.push_back(t);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+int main() {
+    const std::vector<vertex> source = make_grid();
+    std::vector<uint32_t> indices(source.size());
+    for (size_t i = 0; i < indices.size(); ++i) {
+        indices[i] = uint32_t(i);
+    }
+    const auto expected = triangles(source, indices);
+    const float acmr_before = meshopt::analyze_acmr(indices.data(), indices.size(), source.size());
+
+    std::vector<uint32_t> remap;
+    const meshopt::stream s { source.data(), sizeof(vertex) };
+    const uint32_t unique_count = meshopt::generate_remap(remap, nullptr, 0, &s, 1, source.size());
+    std::vector<vertex> vertices(unique_count);
+    meshopt::remap_vertices(vertices.data(), source.data(), source.size(), sizeof(vertex), remap.data());
+    meshopt::remap_indices(indices.data(), indices.data(), indices.size(), remap.data());
+    const float acmr_indexed = meshopt::analyze_acmr(indices.data(), indices.size(), unique_count);
+
+    meshopt::optimize_vertex_cache(indices.data(), indices.size(), unique_count);
+    const float acmr_cache = meshopt::analyze_acmr(indices.data(), indices.size(), unique_count);
+    meshopt::optimize_overdraw(indices.data(), indices.size(), vertices[0].p, sizeof(vertex), unique_count, 1.05f);
+    const float acmr_overdraw = meshopt::analyze_acmr(indices.data(), indices.size(), unique_count);
+
+    const uint32_t fetch_count = meshopt::optimize_vertex_fetch_remap(remap, indices.data(), indices.size(), unique_count);
+    std::vector<vertex> fetched(fetch_count);
+    meshopt::remap_vertices(fetched.data(), vertices.data(), unique_count, sizeof(vertex), remap.data());
+    meshopt::remap_indices(indices.data(), indices.data(), indices.size(), remap.data());
+    const float acmr_after = meshopt::analyze_acmr(indices.data(), indices.size(), fetch_count);
+
+    printf("vertices: %zu -> %u\n", source.size(), fetch_count);
+    printf("ACMR: source %.3f, indexed %.3f, vertex cache %.3f, overdraw %.3f, final %.3f\n",
+        acmr_before, acmr_indexed, acmr_cache, acmr_overdraw, acmr_after);
+
+    int failed = 0;
+    auto check = [&](bool ok, const char* what) {
+        if (!ok) {
+            printf("FAILED: %s\n", what);
+            failed++;
+        }
+    };
+    check(fetch_count == (GRID + 1) * (GRID + 1), "duplicate vertices are merged");
+    check(triangles(fetched, indices) == expected, "triangles and winding are kept");
+    check(acmr_before == 3.f, "non-indexed ACMR");
+    check(acmr_after < 0.8f && acmr_after < acmr_indexed * 0.5f, "vertex cache order");
+    check(acmr_overdraw <= acmr_cache * 1.05f + 1e-3f, "overdraw stays within threshold");
+    check(acmr_after == acmr_overdraw, "vertex fetch order keeps the triangle order");
+    uint32_t next = 0;
+    for (uint32_t v : indices) {
+        if (v > next) {
+            check(false, "vertices in first use order");
+            break;
+        }
+        next = std::max(next, v + 1);
+    }
+    printf(failed ? "meshopt_test: %d failure(s)\n" : "meshopt_test: ok\n", failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+#include <lua.hpp>
+
+#include "profiler.h"
+
+// Every ltask service has its own lua_State, the track of the state is kept in an upvalue.
+// A scope is a pair of enter/leave calls, which also works across a yield:
+//     local t = profiler.enter()
+//     ...
+//     profiler.leave(id, t)
+// leave returns its extra arguments, to wrap a call: return leave(id, enter(), f(...))
+
+struct lua_track {
+    uint32_t track;
+};
+
+static uint32_t
+get_track(lua_State *L) {
+    auto t = (lua_track*)lua_touserdata(L, lua_upvalueindex(1));
+    return t->track ? t->track : profiler::thread_track();
+}
+
+static int
+lenable(lua_State *L) {
+    profiler::enable(lua_toboolean(L, 1));
+    return 0;
+}
+
+static int
+lenabled(lua_State *L) {
+    lua_pushboolean(L, profiler::enabled());
+    return 1;
+}
+
+static int
+lintern(lua_State *L) {
+    size_t sz;
+    const char* name = luaL_checklstring(L, 1, &sz);
+    lua_pushinteger(L, profiler::intern(name, sz));
+    return 1;
+}
+
+// track(id, name), events of this lua_State go to track id
+static int
+ltrack(lua_State *L) {
+    auto t = (lua_track*)lua_touserdata(L, lua_upvalueindex(1));
+    lua_Integer id = luaL_checkinteger(L, 1);
+    luaL_argcheck(L, id > 0 && id < profiler::THREAD_TRACK, 1, "invalid track id");
+    size_t sz;
+    const char* name = luaL_checklstring(L, 2, &sz);
+    t->track = (uint32_t)id;
+    profiler::track_name(t->track, name, sz);
+    return 0;
+}
+
+// returns 0 when the profiler is disabled, leave ignores it
+static int
+lenter(lua_State *L) {
+    lua_pushinteger(L, profiler::enabled() ? (lua_Integer)profiler::now() : 0);
+    return 1;
+}
+
+static int
+lleave(lua_State *L) {
+    lua_Integer start = luaL_checkinteger(L, 2);
+    if (start) {
+        lua_Integer name = luaL_checkinteger(L, 1);
+        profiler::record((profiler::name_t)name, get_track(L), (uint64_t)start, profiler::now());
+    }
+    return lua_gettop(L) - 2;
+}
+
+static int
+lchrome(lua_State *L) {
+    std::string s = profiler::chrome_trace();
+    lua_pushlstring(L, s.data(), s.size());
+    return 1;
+}
+
+static int
+lbinary(lua_State *L) {
+    std::string s = profiler::binary_capture();
+    lua_pushlstring(L, s.data(), s.size());
+    return 1;
+}
+
+// stat() returns { [name] = { count = n, total = ns, max = ns } } of the captured scopes
+static int
+lstat(lua_State *L) {
+    auto result = profiler::summarize();
+    lua_createtable(L, 0, (int)result.size());
+    for (auto& r : result) {
+        lua_createtable(L, 0, 3);
+        lua_pushinteger(L, (lua_Integer)r.count);
+        lua_setfield(L, -2, "count");
+        lua_pushinteger(L, (lua_Integer)r.total);
+        lua_setfield(L, -2, "total");
+        lua_pushinteger(L, (lua_Integer)r.max);
+        lua_setfield(L, -2, "max");
+        lua_setfield(L, -2, r.name.c_str());
+    }
+    return 1;
+}
+
+static int
+lclear(lua_State *L) {
+    profiler::clear();
+    return 0;
+}
+
+extern "C" int
+luaopen_profiler(lua_State *L) {
+    luaL_checkversion(L);
+    luaL_Reg l[] = {
+        { "enable", lenable },
+        { "enabled", lenabled },
+        { "intern", lintern },
+        { "track", ltrack },
+        { "enter", lenter },
+        { "leave", lleave },
+        { "chrome", lchrome },
+        { "binary", lbinary },
+        { "stat", lstat },
+        { "clear", lclear },
+        { NULL, NULL },
+    };
+    luaL_newlibtable(L, l);
+    auto t = (lua_track*)lua_newuserdatauv(L, sizeof(lua_track), 0);
+    t->track = 0;
+    luaL_setfuncs(L, l, 1);
+    return 1;
+}
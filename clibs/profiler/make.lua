@@ -0,0 +1,15 @@
+local lm = require "luamake"
+
+lm:lua_src "profiler" {
+    sources = {
+        "profiler.cpp",
+        "lprofiler.cpp",
+    },
+}
+
+lm:exe "profiler_test" {
+    sources = {
+        "profiler.cpp",
+        "test/profiler_test.cpp",
+    },
+}
@@ -0,0 +1,236 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace profiler {
+    std::atomic<bool> g_enabled { false };
+
+    namespace {
+        // single producer ring, head is only written by the owner thread.
+        // Readers copy [max(tail, head - RING_SIZE + 1), head), the slot the owner may be writing
+        // is left out, and drop what the owner overwrote meanwhile.
+        struct ring {
+            event events[RING_SIZE];
+            std::atomic<uint64_t> head { 0 };
+            std::atomic<uint64_t> tail { 0 };
+            uint32_t track;
+        };
+
+        struct registry {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<ring>> rings;     // a ring outlives its thread, the ltask workers never exit
+            std::unordered_map<std::string, name_t> ids;
+            std::vector<std::string> names;
+            std::map<uint32_t, std::string> tracks;
+        };
+
+        registry& reg() {
+            static registry r;
+            return r;
+        }
+
+        thread_local ring* t_ring = nullptr;
+
+        ring& local_ring() {
+            if (!t_ring) {
+                auto& r = reg();
+                std::lock_guard<std::mutex> lock(r.mutex);
+                auto p = std::make_unique<ring>();
+                p->track = THREAD_TRACK + (uint32_t)r.rings.size();
+                t_ring = p.get();
+                r.rings.push_back(std::move(p));
+            }
+            return *t_ring;
+        }
+
+        struct snapshot {
+            std::vector<event> events;
+            std::vector<std::string> names;
+            std::map<uint32_t, std::string> tracks;
+        };
+
+        snapshot take_snapshot() {
+            auto& r = reg();
+            snapshot s;
+            std::lock_guard<std::mutex> lock(r.mutex);
+            for (auto& p : r.rings) {
+                const uint64_t head = p->head.load(std::memory_order_acquire);
+                const uint64_t tail = p->tail.load(std::memory_order_relaxed);
+                const uint64_t begin = std::max(tail, head >= RING_SIZE ? head - RING_SIZE + 1 : 0);
+                const size_t n = s.events.size();
+                for (uint64_t i = begin; i < head; ++i) {
+                    s.events.push_back(p->events[i & (RING_SIZE - 1)]);
+                }
+                // by now the owner may be writing index `after - 1`, over the slot of `after - 1 - RING_SIZE`
+                const uint64_t after = p->head.load(std::memory_order_acquire) + 1;
+                if (after > begin + RING_SIZE) {
+                    const size_t dropped = (size_t)std::min(after - RING_SIZE - begin, head - begin);
+                    s.events.erase(s.events.begin() + n, s.events.begin() + n + dropped);
+                }
+            }
+            s.names = r.names;
+            s.tracks = r.tracks;
+            for (auto& p : r.rings) {
+                s.tracks.emplace(p->track, "thread " + std::to_string(p->track - THREAD_TRACK));
+            }
+            return s;
+        }
+
+        void append_json_string(std::string& out, std::string_view str) {
+            out += '"';
+            for (unsigned char c : str) {
+                switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                default:
+                    if (c < 0x20) {
+                        char buf[8];
+                        snprintf(buf, sizeof(buf), "\\u%04x", c);
+                        out += buf;
+                    } else {
+                        out += (char)c;
+                    }
+                    break;
+                }
+            }
+            out += '"';
+        }
+
+        template <typename T>
+        void append_pod(std::string& out, T v) {
+            out.append((const char*)&v, sizeof(v));
+        }
+
+        void append_blob(std::string& out, std::string_view str) {
+            append_pod(out, (uint32_t)str.size());
+            out.append(str);
+        }
+    }
+
+    void enable(bool on) {
+        g_enabled.store(on, std::memory_order_relaxed);
+    }
+
+    uint64_t now() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    name_t intern(const char* name, size_t sz) {
+        auto& r = reg();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        auto [it, inserted] = r.ids.try_emplace(std::string(name, sz), (name_t)r.names.size());
+        if (inserted) {
+            r.names.push_back(it->first);
+        }
+        return it->second;
+    }
+
+    void track_name(uint32_t track, const char* name, size_t sz) {
+        auto& r = reg();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.tracks[track].assign(name, sz);
+    }
+
+    uint32_t thread_track() {
+        return local_ring().track;
+    }
+
+    void record(name_t name, uint32_t track, uint64_t start, uint64_t end) {
+        ring& r = local_ring();
+        const uint64_t head = r.head.load(std::memory_order_relaxed);
+        r.events[head & (RING_SIZE - 1)] = { start, end - start, name, track };
+        r.head.store(head + 1, std::memory_order_release);
+    }
+
+    std::string chrome_trace() {
+        snapshot s = take_snapshot();
+        std::sort(s.events.begin(), s.events.end(), [](const event& a, const event& b) {
+            if (a.track != b.track) return a.track < b.track;
+            if (a.start != b.start) return a.start < b.start;
+            return a.duration > b.duration;     // parents first
+        });
+        uint64_t origin = UINT64_MAX;
+        for (auto& e : s.events) {
+            origin = std::min(origin, e.start);
+        }
+        std::string out = R"({"displayTimeUnit":"ms","traceEvents":[)";
+        out += R"({"name":"process_name","ph":"M","pid":1,"args":{"name":"ant"}})";
+        for (auto& [track, name] : s.tracks) {
+            char buf[64];
+            snprintf(buf, sizeof(buf), R"(,{"name":"thread_name","ph":"M","pid":1,"tid":%u,"args":{"name":)", track);
+            out += buf;
+            append_json_string(out, name);
+            out += "}}";
+        }
+        for (auto& e : s.events) {
+            out += R"(,{"name":)";
+            append_json_string(out, e.name < s.names.size() ? std::string_view(s.names[e.name]) : "?");
+            char buf[128];
+            snprintf(buf, sizeof(buf), R"(,"ph":"X","ts":%.3f,"dur":%.3f,"pid":1,"tid":%u})",
+                (e.start - origin) / 1000.0, e.duration / 1000.0, e.track);
+            out += buf;
+        }
+        out += "]}";
+        return out;
+    }
+
+    // "APRF", version, names, tracks, events. Integers are little endian, times in nanoseconds.
+    std::string binary_capture() {
+        snapshot s = take_snapshot();
+        std::string out = "APRF";
+        append_pod(out, (uint32_t)1);
+        append_pod(out, (uint32_t)s.names.size());
+        for (auto& name : s.names) {
+            append_blob(out, name);
+        }
+        append_pod(out, (uint32_t)s.tracks.size());
+        for (auto& [track, name] : s.tracks) {
+            append_pod(out, track);
+            append_blob(out, name);
+        }
+        append_pod(out, (uint32_t)s.events.size());
+        for (auto& e : s.events) {
+            append_pod(out, e.start);
+            append_pod(out, e.duration);
+            append_pod(out, e.name);
+            append_pod(out, e.track);
+        }
+        return out;
+    }
+
+    std::vector<summary> summarize() {
+        snapshot s = take_snapshot();
+        std::vector<summary> result(s.names.size());
+        for (size_t i = 0; i < s.names.size(); ++i) {
+            result[i] = { std::move(s.names[i]), 0, 0, 0 };
+        }
+        for (auto& e : s.events) {
+            if (e.name < result.size()) {
+                auto& r = result[e.name];
+                r.count++;
+                r.total += e.duration;
+                r.max = std::max(r.max, e.duration);
+            }
+        }
+        result.erase(std::remove_if(result.begin(), result.end(), [](const summary& r) { return r.count == 0; }), result.end());
+        std::sort(result.begin(), result.end(), [](const summary& a, const summary& b) { return a.name < b.name; });
+        return result;
+    }
+
+    void clear() {
+        auto& r = reg();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (auto& p : r.rings) {
+            p->tail.store(p->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scope profiler for captures that can be opened in chrome://tracing or Perfetto.
+// A scope is written once, when it ends, as a complete event (start + duration) into a ring
+// buffer owned by the writing thread, so writers never lock and never wait for each other.
+// An event belongs to a track: a thread by default, or anything else that runs on several
+// threads in turn, like an ltask service. The ring keeps the last RING_SIZE - 1 events of a thread.
+namespace profiler {
+    using name_t = uint32_t;
+
+    static constexpr uint32_t RING_SIZE = 1 << 16;      // events per thread, a power of 2
+    static constexpr uint32_t THREAD_TRACK = 1 << 20;   // tracks of threads start here
+
+    struct event {
+        uint64_t start;     // nanoseconds
+        uint64_t duration;
+        name_t name;
+        uint32_t track;
+    };
+
+    extern std::atomic<bool> g_enabled;
+    inline bool enabled() {
+        return g_enabled.load(std::memory_order_relaxed);
+    }
+    void enable(bool on);
+
+    uint64_t now();
+    // the same name always gets the same id
+    name_t intern(const char* name, size_t sz);
+    inline name_t intern(const char* name) {
+        return intern(name, std::char_traits<char>::length(name));
+    }
+    void track_name(uint32_t track, const char* name, size_t sz);
+    // track of the calling thread, named "thread N" until track_name is called for it
+    uint32_t thread_track();
+    void record(name_t name, uint32_t track, uint64_t start, uint64_t end);
+
+    struct summary {
+        std::string name;
+        uint64_t count;
+        uint64_t total;     // nanoseconds
+        uint64_t max;
+    };
+
+    // snapshots of everything recorded since the last clear, safe while other threads record
+    std::string chrome_trace();
+    std::string binary_capture();
+    std::vector<summary> summarize();   // per name, sorted by name
+    void clear();
+
+    struct scope {
+        name_t name;
+        uint64_t start;
+        explicit scope(name_t n)
+            : name(n)
+            , start(enabled() ? now() : 0)
+        {}
+        ~scope() {
+            if (start) {
+                record(name, thread_track(), start, now());
+            }
+        }
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+    };
+}
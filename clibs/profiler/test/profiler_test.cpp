@@ -0,0 +1,132 @@
+// Overhead budget of a scope, then captures from several threads, ring overflow and clear.
+#include "../profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr double ENABLED_BUDGET_NS = 150.0;
+static constexpr double DISABLED_BUDGET_NS = 5.0;
+
+static size_t count(const std::string& s, const char* what) {
+    size_t n = 0;
+    for (size_t pos = s.find(what); pos != std::string::npos; pos = s.find(what, pos + 1)) {
+        n++;
+    }
+    return n;
+}
+
+// best of a few runs, a preempted run says nothing about the profiler
+static double scope_cost(profiler::name_t name, int n) {
+    double best = 1e9;
+    for (int run = 0; run < 5; ++run) {
+        const uint64_t start = profiler::now();
+        for (int i = 0; i < n; ++i) {
+            profiler::scope s(name);
+        }
+        best = std::min(best, double(profiler::now() - start) / n);
+    }
+    return best;
+}
+
+int main() {
+    int failed = 0;
+    auto check = [&](bool ok, const char* what) {
+        if (!ok) {
+            printf("FAILED: %s\n", what);
+            failed++;
+        }
+    };
+
+    const profiler::name_t outer = profiler::intern("outer");
+    const profiler::name_t inner = profiler::intern("inner \"quoted\"");
+    check(profiler::intern("outer") == outer, "a name is interned once");
+
+    const double disabled = scope_cost(outer, 1000000);
+    profiler::enable(true);
+    const double enabled = scope_cost(outer, 1000000);
+    printf("scope cost: %.1f ns enabled, %.1f ns disabled\n", enabled, disabled);
+    check(enabled < ENABLED_BUDGET_NS, "enabled scope under budget");
+    check(disabled < DISABLED_BUDGET_NS, "disabled scope under budget");
+
+    std::string capture = profiler::chrome_trace();
+    check(count(capture, "\"ph\":\"X\"") == profiler::RING_SIZE - 1, "the ring keeps the last RING_SIZE - 1 events");
+    profiler::clear();
+    capture = profiler::chrome_trace();
+    check(count(capture, "\"ph\":\"X\"") == 0, "clear drops the events");
+
+    constexpr int THREADS = 4;
+    constexpr int SCOPES = 1000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t) {
+        threads.emplace_back([=] {
+            const std::string name = "worker " + std::to_string(t);
+            profiler::track_name(profiler::thread_track(), name.data(), name.size());
+            for (int i = 0; i < SCOPES; ++i) {
+                profiler::scope a(outer);
+                profiler::scope b(inner);
+            }
+        });
+    }
+    // an ltask service moves between threads, its events stay on its own track
+    profiler::track_name(42, "service", 7);
+    {
+        const uint64_t start = profiler::now();
+        profiler::record(inner, 42, start, profiler::now());
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    capture = profiler::chrome_trace();
+    check(count(capture, "\"ph\":\"X\"") == THREADS * SCOPES * 2 + 1, "every scope of every thread is captured");
+    check(count(capture, "\"name\":\"thread_name\"") >= THREADS + 1, "every track is named");
+    check(capture.find("\"worker 3\"") != std::string::npos, "thread names");
+    check(capture.find("\"tid\":42") != std::string::npos, "service track");
+    check(capture.find("inner \\\"quoted\\\"") != std::string::npos, "names are escaped");
+    check(count(capture, "{") == count(capture, "}") && count(capture, "[") == count(capture, "]"), "balanced json");
+
+    uint64_t inner_count = 0, outer_total = 0, inner_total = 0;
+    for (auto& r : profiler::summarize()) {
+        if (r.name == "inner \"quoted\"") {
+            inner_count = r.count;
+            inner_total = r.total;
+        } else if (r.name == "outer") {
+            outer_total = r.total;
+        }
+    }
+    check(inner_count == THREADS * SCOPES + 1, "summary counts every scope");
+    // the service scope has no outer scope, it takes well under a millisecond
+    check(outer_total + 1000000 >= inner_total, "an outer scope includes its inner scope");
+
+    const std::string binary = profiler::binary_capture();
+    check(binary.compare(0, 4, "APRF") == 0, "binary magic");
+    const size_t event_size = sizeof(uint64_t) * 2 + sizeof(uint32_t) * 2;
+    uint32_t events = 0;
+    memcpy(&events, binary.data() + binary.size() - size_t(THREADS * SCOPES * 2 + 1) * event_size - sizeof(uint32_t), sizeof(events));
+    check(events == THREADS * SCOPES * 2 + 1, "binary event count");
+
+    // a scope records while another thread takes captures
+    profiler::clear();
+    std::atomic<bool> stop { false };
+    std::thread writer([&] {
+        while (!stop) {
+            profiler::scope s(outer);
+        }
+    });
+    bool sane = true;
+    for (int i = 0; i < 20; ++i) {
+        const std::string c = profiler::chrome_trace();
+        sane = sane && count(c, "\"ph\":\"X\"") <= profiler::RING_SIZE * 2;
+    }
+    stop = true;
+    writer.join();
+    check(sane, "captures while recording");
+
+    printf(failed ? "profiler_test: %d failure(s)\n" : "profiler_test: ok\n", failed);
+    return failed ? 1 : 0;
+}
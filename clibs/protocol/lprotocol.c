@@ -7,6 +7,8 @@
 #include <stdio.h>
 
 #define MAX_MSG_SIZE 0xffff
+// long chunks have a 4 bytes size, the fileserver sends them after SHAKEHANDS 2
+#define MAX_LONG_MSG_SIZE 0x4000000
 
 static int
 read_size(const char * msg) {
@@ -165,15 +167,91 @@ readchunk(lua_State *L, char *buffer, int *size) {
 	return chunk;
 }
 
+static const char *
+queue_string(lua_State *L, int index, size_t *sz) {
+	if (lua_geti(L, 1, index) != LUA_TSTRING)
+		luaL_error(L, "Invalid input message at (%d) %s", index, lua_typename(L, lua_type(L, -1)));
+	const char * msg = lua_tolstring(L, -1, sz);
+	lua_pop(L, 1);	// the string is still referenced by the input table
+	return msg;
+}
+
+// A long chunk is only taken when it is complete, the input table is not touched before,
+// so a large chunk arriving in many pieces is copied once.
+static int
+readchunk_long(lua_State *L) {
+	luaL_checktype(L, 1, LUA_TTABLE);
+	int n = (int)lua_rawlen(L, 1);
+	size_t total = 0;
+	size_t sz;
+	int i;
+	for (i=1;i<=n;i++) {
+		queue_string(L, i, &sz);
+		total += sz;
+	}
+	if (total < 4)
+		return 0;
+	uint8_t header[4];
+	int index = 1;
+	size_t offset = 0;
+	const char * msg = queue_string(L, index, &sz);
+	for (i=0;i<4;) {
+		if (offset < sz) {
+			header[i++] = (uint8_t)msg[offset++];
+		} else {
+			msg = queue_string(L, ++index, &sz);
+			offset = 0;
+		}
+	}
+	size_t message_size = header[0] | header[1] << 8 | header[2] << 16 | (size_t)header[3] << 24;
+	if (message_size > MAX_LONG_MSG_SIZE)
+		return luaL_error(L, "Message is too long (%d)", (int)message_size);
+	if (total - 4 < message_size)
+		return 0;
+	if (sz - offset >= message_size) {
+		lua_pushlstring(L, msg + offset, message_size);
+		offset += message_size;
+	} else {
+		luaL_Buffer b;
+		char * ptr = luaL_buffinitsize(L, &b, message_size);
+		size_t need = message_size;
+		for (;;) {
+			size_t len = sz - offset;
+			if (len > need)
+				len = need;
+			memcpy(ptr, msg + offset, len);
+			ptr += len;
+			offset += len;
+			need -= len;
+			if (need == 0)
+				break;
+			msg = queue_string(L, ++index, &sz);
+			offset = 0;
+		}
+		luaL_pushresultsize(&b, message_size);
+	}
+	if (offset < sz) {
+		lua_pushlstring(L, msg + offset, sz - offset);
+		lua_seti(L, 1, 1);
+		remove_input(L, index+1, 2, n);
+	} else {
+		remove_input(L, index+1, 1, n);
+	}
+	return 1;
+}
+
 /*
 	params:
 	table messages { strings, ... }
+	boolean long : chunks with a 4 bytes size
 	
 	return:
 	string or none
  */
 static int
 lreadchunk(lua_State *L) {
+	if (lua_toboolean(L, 2))
+		return readchunk_long(L);
 	int size;
 	char buffer[MAX_MSG_SIZE + 2];
 	const char *chunk = readchunk(L, buffer, &size);
@@ -74,3 +74,25 @@ end
 
 PACK( { "hello" }, "\7\0\5\0hello" )
 PACK( { "hello" , "world" }, "\14\0\5\0hello\5\0world" )
+
+local function LONG(m, r, t)
+	assert( core.readchunk(m, true) == r )
+	assert_result(m, t)
+end
+
+LONG( { "\0\0\0" }, nil, { "\0\0\0" } )
+LONG( { "\0\0\0\0" }, "", {} )
+LONG( { "\5\0\0\0hello" }, "hello", {} )
+LONG( { "\5\0", "\0\0he", "llo" }, "hello", {} )
+LONG( { "\5\0\0\0hell" }, nil, { "\5\0\0\0hell" } )
+LONG( { "", "\5\0\0", "\0", "h", "", "ello\1\0" }, "hello", { "\1\0" } )
+LONG( { "\5\0\0\0hello\0\0", "\0\0" }, "hello", { "\0\0", "\0\0" } )
+
+local big = str:rep(4)
+local pieces = { string.pack("<I4", #big) }
+for i = 1, #big, 1000 do
+	pieces[#pieces+1] = big:sub(i, i + 999)
+end
+LONG( { table.unpack(pieces, 1, #pieces - 1) }, nil, { table.unpack(pieces, 1, #pieces - 1) } )
+LONG( pieces, big, {} )
+assert(string.pack("<s4", big) == string.pack("<I4", #big) .. big)
@@ -16,16 +16,70 @@
 #define ZLIB_UTF8_FLAG (1<<11)
 #define FILECHUNK (4096 * 4)
 
+// deflate with a preset dictionary, the same dictionary must be given to uncompress
+static int
+compress_dict(void *dst, size_t *dstsz, const void *src, size_t sz, const char *dict, size_t dictsz) {
+	zng_stream s;
+	memset(&s, 0, sizeof(s));
+	if (zng_deflateInit(&s, Z_DEFAULT_COMPRESSION) != Z_OK)
+		return Z_MEM_ERROR;
+	int r = zng_deflateSetDictionary(&s, (const uint8_t *)dict, (uint32_t)dictsz);
+	if (r == Z_OK) {
+		s.next_in = (const uint8_t *)src;
+		s.avail_in = (uint32_t)sz;
+		s.next_out = (uint8_t *)dst;
+		s.avail_out = (uint32_t)*dstsz;
+		r = zng_deflate(&s, Z_FINISH);
+		r = (r == Z_STREAM_END) ? Z_OK : Z_BUF_ERROR;
+		*dstsz = s.total_out;
+	}
+	zng_deflateEnd(&s);
+	return r;
+}
+
+static int
+uncompress_dict(void *dst, size_t *dstsz, const void *src, size_t sz, const char *dict, size_t dictsz) {
+	zng_stream s;
+	memset(&s, 0, sizeof(s));
+	s.next_in = (const uint8_t *)src;
+	s.avail_in = (uint32_t)sz;
+	if (zng_inflateInit(&s) != Z_OK)
+		return Z_MEM_ERROR;
+	s.next_out = (uint8_t *)dst;
+	s.avail_out = (uint32_t)*dstsz;
+	int r = zng_inflate(&s, Z_FINISH);
+	if (r == Z_NEED_DICT) {
+		r = zng_inflateSetDictionary(&s, (const uint8_t *)dict, (uint32_t)dictsz);
+		if (r == Z_OK)
+			r = zng_inflate(&s, Z_FINISH);
+	}
+	if (r == Z_STREAM_END) {
+		r = Z_OK;
+	} else if (r == Z_OK || (r == Z_BUF_ERROR && s.avail_out == 0)) {
+		r = Z_BUF_ERROR;
+	} else if (r == Z_NEED_DICT || r == Z_BUF_ERROR) {
+		r = Z_DATA_ERROR;
+	}
+	*dstsz = s.total_out;
+	zng_inflateEnd(&s);
+	return r;
+}
+
 static int
 lcompress(lua_State *L) {
 	size_t sz;
 	const char * src = luaL_checklstring(L, 1, &sz);
-	size_t len = zng_compressBound(sz);
+	size_t dictsz;
+	const char * dict = luaL_optlstring(L, 2, NULL, &dictsz);
+	size_t len = zng_compressBound(sz) + (dict ? 4 : 0);	// dictionary id in the header
 	char * buf = (char *) malloc(len + 1);
 	if (buf == NULL) {
 		return luaL_error(L, "Compress OOM");
 	}
-	if (zng_compress((void *)(buf + 1), &len, (void *)src, sz) != Z_OK) {
+	int r = dict
+		? compress_dict((void *)(buf + 1), &len, (void *)src, sz, dict, dictsz)
+		: zng_compress((void *)(buf + 1), &len, (void *)src, sz);
+	if (r != Z_OK) {
 		free(buf);
 		return luaL_error(L, "Compress error");
 	}
@@ -48,12 +102,20 @@ static int
 luncompress(lua_State *L) {
 	size_t sz;
 	const char *src = luaL_checklstring(L, 1, &sz);
+	size_t dictsz;
+	const char * dict = luaL_optlstring(L, 2, NULL, &dictsz);
+	if (sz < 1)
+		return luaL_error(L, "Uncompress data corrupted");
 	int idx = src[0];
+	if (idx < 0 || idx > 32)
+		return luaL_error(L, "Uncompress data corrupted");
 	size_t dsz = (1ull << idx) * (sz - 1);
 	void *buf = malloc(dsz);
 	if (buf == NULL)
 		return luaL_error(L, "Uncompress OOM");
-	int r = zng_uncompress(buf, &dsz, (void *)(src + 1), sz - 1);
+	int r = dict
+		? uncompress_dict(buf, &dsz, (void *)(src + 1), sz - 1, dict, dictsz)
+		: zng_uncompress(buf, &dsz, (void *)(src + 1), sz - 1);
 	if (r == Z_OK) {
 		lua_pushlstring(L, buf, dsz);
 		free(buf);
@@ -21,6 +21,7 @@ local socket = require "bee.socket"
 local platform = require "bee.platform"
 local serialization = require "bee.serialization"
 local protocol = require "protocol"
+local zip = require "zip"
 local ltask = require "ltask"
 local fs = require "bee.filesystem"
 
@@ -119,12 +120,19 @@ local repo = vfs.new {
 	slot = config.vfs.slot or "",
 }
 
+local PROTOCOL_VERSION <const> = "2"
+local PREFETCH_WINDOW <const> = 2 * 1024 * 1024	-- bytes of prefetched blobs requested and not received
+local PREFETCH_BATCH <const> = 256	-- hashes in a GETS
+
 local connection = {
 	request = {},
 	sendq = {},
 	recvq = {},
 	fd = nil,
 	flags = 0,
+	version = 1,	-- 2 after SHAKEHANDS 2 : long chunks, GETS, MANIFEST and ZBLOB
+	dictionary = nil,
+	prefetch = nil,
 }
 
 local function connection_send(...)
@@ -139,12 +147,52 @@ local function request_send(...)
 	connection_send(...)
 end
 
+-- GETS the blobs of the manifest not in the repo, keeping PREFETCH_WINDOW bytes in flight
+local function prefetch()
+	local p = connection.prefetch
+	if not p or connection.fd == nil then
+		return
+	end
+	local batch = {}
+	while p.inflight < PREFETCH_WINDOW and #batch < PREFETCH_BATCH do
+		local hash = p.queue[p.index]
+		if not hash then
+			break
+		end
+		p.index = p.index + 1
+		-- may be requested on demand, or received, since the manifest
+		if not connection.request[hash] and not repo:exist(hash) then
+			connection.request[hash] = "GET"
+			p.pending[hash] = p.size[hash]
+			p.inflight = p.inflight + p.size[hash]
+			batch[#batch+1] = hash
+		end
+	end
+	if #batch > 0 then
+		connection_send("GETS", table.unpack(batch))
+	elseif p.inflight == 0 then
+		LOG("Prefetch done", p.index - 1)
+		connection.prefetch = nil
+	end
+end
+
+local function prefetch_done(hash)
+	local p = connection.prefetch
+	local size = p and p.pending[hash]
+	if size then
+		p.pending[hash] = nil
+		p.inflight = p.inflight - size
+		prefetch()
+	end
+end
+
 local function request_resolve(arg)
 	local req = connection.request[arg]
 	if not req then
 		return
 	end
-	connection.request[req] = nil
+	connection.request[arg] = nil
+	prefetch_done(arg)
 	ltask.multi_wakeup(arg, true)
 end
 
@@ -155,6 +203,7 @@ local function request_reject(arg, err)
 	end
 	connection.request[arg] = nil
 	LOG("[ERROR] " .. err)
+	prefetch_done(arg)
 	ltask.multi_wakeup(arg)
 end
 
@@ -306,6 +355,38 @@ function NETWORK.ROOT(hash)
 		ltask.fork(getdir, path)
 	end
 	ltask.multi_wakeup "ROOT"
+	if connection.version >= 2 and config.vfs.prefetch ~= false then
+		request_send("MANIFEST", hash)
+	end
+end
+
+function NETWORK.SHAKEHANDS(version, dictionary)
+	LOG("[response] SHAKEHANDS", version, #dictionary)
+	connection.version = tonumber(version)
+	connection.dictionary = dictionary ~= "" and dictionary or nil
+end
+
+function NETWORK.MANIFEST(root, manifest)
+	if root ~= repo.root then
+		return
+	end
+	local queue = {}
+	local size = {}
+	for hash, sz in zip.uncompress(manifest):gmatch "(%x+) (%d+)" do
+		if not repo:exist(hash) then
+			queue[#queue+1] = hash
+			size[hash] = tonumber(sz)
+		end
+	end
+	LOG("[response] MANIFEST", root, #queue)
+	connection.prefetch = {
+		queue = queue,
+		size = size,
+		index = 1,
+		pending = {},
+		inflight = 0,
+	}
+	prefetch()
 end
 
 -- REMARK: Main thread may reading the file while writing, if file server update file.
@@ -318,6 +399,14 @@ function NETWORK.BLOB(hash, data)
 	end
 end
 
+function NETWORK.ZBLOB(hash, data)
+	data = zip.uncompress(data, connection.dictionary)
+	LOG("[response] ZBLOB", hash, #data)
+	if repo:write_blob(hash, data) then
+		request_resolve(hash)
+	end
+end
+
 function NETWORK.FILE(hash, size)
 	LOG("[response] FILE", hash, size)
 	repo:write_file(hash, size)
@@ -352,6 +441,7 @@ end
 
 local function work_offline()
 	repo:init()
+	connection.prefetch = nil
 	local uncomplete_req = {}
 	for hash in pairs(connection.request) do
 		table.insert(uncomplete_req, hash)
@@ -364,7 +454,7 @@ local function work_offline()
 end
 
 local function work_online()
-	request_send("SHAKEHANDS")
+	request_send("SHAKEHANDS", PROTOCOL_VERSION)
 	request_send("ROOT")
 end
 
@@ -468,7 +558,8 @@ local function init_event()
 			end
 			table.insert(reading, data)
 			while true do
-				local msg = protocol.readchunk(reading)
+				-- the chunks after SHAKEHANDS 2 are long
+				local msg = protocol.readchunk(reading, connection.version >= 2)
 				if not msg then
 					break
 				end
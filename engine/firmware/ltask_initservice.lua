@@ -30,6 +30,37 @@ function vfs.directory(what)
 	return call("DIRECTORY", what)
 end
 
+-- Every request handler of the service is a profiler scope, on the track of the service.
+-- The handlers are wrapped only with ANT_PROFILER set, or when the profiler is enabled as the
+-- service starts, so the dispatch costs nothing more otherwise.
+local profiler = require "profiler"
+if os.getenv "ANT_PROFILER" or profiler.enabled() then
+	local enter, leave = profiler.enter, profiler.leave
+	local label = ltask.label() or name
+	profiler.track(ltask.self(), label)
+	local dispatch = ltask.dispatch
+	local wrapped = false
+	function ltask.dispatch(handler)
+		if not wrapped then
+			wrapped = true
+			local service = dispatch()
+			if getmetatable(service) == nil then
+				setmetatable(service, { __newindex = function (t, k, v)
+					if type(v) == "function" then
+						local id = profiler.intern(label .. "." .. tostring(k))
+						local f = v
+						v = function (...)
+							return leave(id, enter(), f(...))
+						end
+					end
+					rawset(t, k, v)
+				end })
+			end
+		end
+		return dispatch(handler)
+	end
+end
+
 --TODO: remove they
 require "log"
 require "filesystem"
@@ -117,6 +117,18 @@ function vfs:open(hash)
 	return fastio.readall_v_noerr(self.localpath .. "/" .. hash)
 end
 
+function vfs:exist(hash)
+	if self.zipfile and self.zipfile:exist(hash) then
+		return true
+	end
+	local f = io.open(self.localpath .. "/" .. hash, "rb")
+	if f then
+		f:close()
+		return true
+	end
+	return false
+end
+
 local function get_cachepath(setting, name)
 	name = name:lower()
 	local filename = name:match "[/]?([^/]*)$"
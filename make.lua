@@ -133,6 +133,12 @@ if lm.os ~= "ios" and lm.os ~= "android" then
             "tools",
         }
     }
+    -- luamake benchmark, see test/benchmark/main.lua for the options
+    lm:build "benchmark" {
+        deps = "all",
+        "$bin/ant", "@test/benchmark/main.lua",
+        "--output", "$builddir/benchmark.json",
+    }
 end
 
 lm:default {
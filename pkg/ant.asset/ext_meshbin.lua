@@ -129,6 +129,19 @@ local function loader(filename)
     return init(mesh)
 end
 
+-- the buffers as strings, for the meshes the cpu reads: the resource gives its memory to the gpu
+local function load_cpu(filename)
+    local mesh = serialize.load(filename)
+    for _, name in ipairs {"vb", "vb2", "ib"} do
+        local b = mesh[name]
+        if b then
+            load_mem(b, filename)
+            b.str = mem2str(b)
+        end
+    end
+    return mesh
+end
+
 local function unloader(res, obj)
     delete(res)
 end
@@ -144,4 +157,5 @@ return {
     end,
     loader = loader,
     unloader = unloader,
+    load_cpu = load_cpu,
 }
\ No newline at end of file
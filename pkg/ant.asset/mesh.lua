@@ -9,6 +9,7 @@ local imesh = {}
 
 imesh.init_mesh = ext_meshbin.init
 imesh.delete_mesh = ext_meshbin.delete
+imesh.load_cpu_mesh = ext_meshbin.load_cpu
 
 local function meshset_append(meshset, mesh)
 	local function update_buffer(b, ob)
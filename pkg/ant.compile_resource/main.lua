@@ -8,6 +8,7 @@ local sha1    = require "sha1"
 local depends = require "depends"
 local ltask   = require "ltask"
 local lfs     = require "bee.filesystem"
+local shader  = require "material.shader"
 
 local function init_setting(vfs, setting)
     local os, renderer = setting:match "^(%w+)-(%w+)$"
@@ -86,4 +87,6 @@ return {
     init_setting  = init_setting,
     compile_file = compile_file,
     verify_file = verify_file,
+    shader_stat = shader.stat,
+    reset_shader_stat = shader.reset_stat,
 }
@@ -22,6 +22,7 @@ local ENABLE_IBL_LUT<const>         = settings:get "graphic/ibl/enable_lut"
 local USE_CS_SKINNING<const>        = settings:get "graphic/skinning/use_cs"
 
 local ENABLE_CS<const>              = settings:get "graphic/lighting/cluster_shading/enable"
+local ENABLE_LOCAL_SHADOW<const>    = settings:get "graphic/shadow/enable" and settings:get "graphic/shadow/local/enable"
 local ENABLE_BLOOM<const>           = settings:get "graphic/postprocess/bloom/enable"
 local ENABLE_FXAA<const>            = settings:get "graphic/postprocess/fxaa/enable"
 local FXAA_USE_GREEN_AS_LUMA<const> = settings:get "graphic/postprocess/fxaa/use_green_as_luma"
@@ -187,7 +188,7 @@ end
 
 local function writefile(filename, data)
 	local f <close> = assert(io.open(filename:string(), "wb"))
-	f:write(serialize.stringify(data))
+	f:write(serialize.binary(data))
 end
 
 local function merge_cfg_setting(setting, fx)
@@ -461,13 +462,16 @@ local function check_material_properties(properties, shaderuniforms)
     end
 end
 
-local function add_lighting_sv(systems, lighting)
+local function add_lighting_sv(systems, lighting, receive_shadow)
     if lighting == "on" then
         systems[#systems+1] = "b_light_info"
         if ENABLE_CS then
             systems[#systems+1] = "b_light_grids"
             systems[#systems+1] = "b_light_index_lists"
         end
+        if ENABLE_LOCAL_SHADOW and receive_shadow == "on" then
+            systems[#systems+1] = "b_local_shadow"
+        end
     end
 end
 
@@ -536,7 +540,7 @@ local function create_shader_cfg(setting, inputfolder, output, mat, stages)
         end
     end
 
-    add_lighting_sv(ao.systems, lighting)
+    add_lighting_sv(ao.systems, lighting, mat.fx.setting.receive_shadow)
     check_material_properties(properties, ao.attribs)
     if stages.depth then
         ao.depth = attrib_obj()
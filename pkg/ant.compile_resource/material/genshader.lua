@@ -6,6 +6,7 @@ local L        = import_package "ant.render.core".layout
 
 local settings      = import_package "ant.settings"
 local ENABLE_SHADOW<const>      = settings:get "graphic/shadow/enable"
+local ENABLE_LOCAL_SHADOW<const> = ENABLE_SHADOW and settings:get "graphic/shadow/local/enable"
 
 local FILTER_MODE_MACROS<const> = {
     pcf  = "SM_PCF=1",
@@ -834,6 +835,9 @@ local function macros_from_setting(setting, m)
         if mm then
             table.move(mm, 1, #mm, #m+1, m)
         end
+        if ENABLE_LOCAL_SHADOW then
+            m[#m+1] = "ENABLE_LOCAL_SHADOW=1"
+        end
     end
 
     if setting.position_only then
@@ -5,6 +5,10 @@ local lfs        = require "bee.filesystem"
 local ltask      = require "ltask"
 local depends    = require "depends"
 local clonefile  = require "clonefile"
+local shadercache = require "material.shadercache"
+local fastio     = require "fastio"
+
+local SHADERCACHE <const> = shadercache.root()
 
 local function cmdtostr(commands)
     return table.concat(commands, " ")
@@ -21,6 +25,7 @@ local function writefile(filename, data)
 end
 
 local compiling = {}
+local compiling_content = {}
 
 local function compile_finish(key, ...)
     ltask.multi_wakeup(compiling[key], ...)
@@ -28,6 +33,51 @@ local function compile_finish(key, ...)
     return ...
 end
 
+local function check_output(success, errmsg, outmsg)
+    if success then
+        local INFO = outmsg:upper()
+        for _, term in ipairs {
+            "ERROR",
+            "FAILED TO BUILD SHADER"
+        } do
+            local VARYING_ERROR<const> = ("Failed to parse varying def file"):upper()
+            if INFO:find(term, 1, true) and not INFO:find(VARYING_ERROR, 1, true) then
+                return false, errmsg
+            end
+        end
+    end
+    return success, errmsg
+end
+
+-- the binary of a preprocessed source, from the shared cache or shaderc
+local function compile_content(commands, key, binfile)
+    if compiling_content[key] then
+        local ok, errmsg, compiled = ltask.multi_wait(compiling_content[key])
+        if ok then
+            lfs.copy_file(compiled, binfile, lfs.copy_options.overwrite_existing)
+        end
+        return ok, errmsg
+    end
+    if shadercache.fetch(SHADERCACHE, key, binfile) then
+        shadercache.count "hit"
+        return true
+    end
+    compiling_content[key] = {}
+    print "shader compile:"
+    local ok, errmsg = check_output(subprocess.spawn {
+        SHADERC:string(),
+        commands,
+        "-o", binfile:string(),
+    })
+    if ok then
+        shadercache.count "miss"
+        shadercache.store(SHADERCACHE, key, binfile)
+    end
+    ltask.multi_wakeup(compiling_content[key], ok, errmsg, binfile:string())
+    compiling_content[key] = nil
+    return ok, errmsg
+end
+
 local function run(setting, commands, input, output)
     local cmdstring = cmdtostr(commands)
     local path = setting.shaderpath / get_filename(cmdstring, input)
@@ -46,6 +96,7 @@ local function run(setting, commands, input, output)
         if lfs.exists(path / "bin") and lfs.exists(path / ".dep")  then
             local deps, dirty_path = depends.read_if_not_dirty(setting.vfs, path / ".dep")
             if deps then
+                shadercache.count "local_hit"
                 clonefile(path / "bin", output)
                 return compile_finish(pathkey, true, deps)
             elseif dirty_path then
@@ -57,49 +108,48 @@ local function run(setting, commands, input, output)
         lfs.remove_all(path)
     end
     lfs.create_directories(path)
-    local C = {
+    local preprocessed = path / "preprocessed"
+    local success, errmsg = check_output(subprocess.spawn {
         SHADERC:string(),
         commands,
-        "-o", (path / "bin"):string(),
+        "-o", preprocessed:string(),
         "--depends",
-    }
-    print "shader compile:"
-    local success, errmsg, outmsg = subprocess.spawn(C)
-    if success then
-        local INFO = outmsg:upper()
-        for _, term in ipairs {
-            "ERROR",
-            "FAILED TO BUILD SHADER"
-        } do
-            local VARYING_ERROR<const> = ("Failed to parse varying def file"):upper()
-            if INFO:find(term, 1, true) and not INFO:find(VARYING_ERROR, 1, true) then
-                success = false
-                break
-            end
-        end
-    end
+        "--preprocess",
+    })
     if not success then
         return compile_finish(pathkey, false, errmsg)
     end
+    --the includes are only known from the depfile of the preprocess, without it the
+    --project cache would never see an edited include
+    local depfile = path / "preprocessed.d"
+    local f = io.open(depfile:string())
+    if not f then
+        return compile_finish(pathkey, false, ("`%s` does not exist."):format(depfile))
+    end
     local deps = depends.new()
     depends.add_lpath(deps, input:string())
-    local f = io.open((path / "bin.d"):string())
-    if f then
-        f:read "l"
-        for line in f:lines() do
-            local path = line:match "^%s*(.-)%s*\\?$"
-            if path then
-                depends.add_lpath(deps, path)
-            end
+    f:read "l"
+    for line in f:lines() do
+        local path = line:match "^%s*(.-)%s*\\?$"
+        if path then
+            depends.add_lpath(deps, path)
         end
-        f:close()
+    end
+    f:close()
+    local key = shadercache.key(commands, fastio.readall_f(preprocessed:string()))
+    success, errmsg = compile_content(commands, key, path / "bin")
+    if not success then
+        return compile_finish(pathkey, false, errmsg)
     end
     depends.writefile(path / ".dep", deps)
     writefile(path / ".arguments", cmdstring)
+    writefile(path / ".key", key)
     clonefile(path / "bin", output)
     return compile_finish(pathkey, true, deps)
 end
 
 return {
     run = run,
+    stat = shadercache.stat,
+    reset_stat = shadercache.reset_stat,
 }
@@ -0,0 +1,126 @@
+local SHADERC = require "tool_exe_path"("shaderc")
+local lfs    = require "bee.filesystem"
+local fastio = require "fastio"
+local sha1   = require "sha1"
+
+-- Content addressed shader binaries, shared by every project on this machine.
+-- The key is the preprocessed source plus everything else that changes the binary,
+-- so the same permutation from different materials or projects is compiled once.
+-- Entries are written to a temporary file and renamed, concurrent writers of the same
+-- key write the same content, the last rename wins.
+
+local CACHE_VERSION <const> = 1
+local COMPILER_VERSION <const> = fastio.sha1(SHADERC:string())
+
+-- options with a local path argument, the path is not part of the key
+local PATH_OPTIONS <const> = {
+    ["-f"] = true,
+    ["-i"] = true,
+    ["-o"] = true,
+    ["--varyingdef"] = true,
+}
+
+local stat = {
+    local_hit = 0,  -- the project shader directory is up to date
+    hit = 0,        -- found in the shared cache
+    miss = 0,       -- compiled by shaderc
+}
+
+local m = {}
+
+function m.root()
+    local root = os.getenv "ANT_SHADER_CACHE"
+    if root then
+        return lfs.path(root)
+    end
+    return SHADERC:parent_path():parent_path() / "shadercache"
+end
+
+local function flatten(commands, t)
+    for _, v in ipairs(commands) do
+        if type(v) == "table" then
+            flatten(v, t)
+        else
+            t[#t+1] = tostring(v)
+        end
+    end
+    return t
+end
+
+local function strip_line_directives(source)
+    return (source:gsub("\n#%s*line[^\n]*", "\n"):gsub("^#%s*line[^\n]*", ""))
+end
+
+function m.key(commands, preprocessed)
+    local args = flatten(commands, {})
+    local t = { ("version %d %s"):format(CACHE_VERSION, COMPILER_VERSION) }
+    local debug = false
+    local i = 1
+    while i <= #args do
+        local a = args[i]
+        if PATH_OPTIONS[a] then
+            if a == "--varyingdef" then
+                t[#t+1] = "varying " .. sha1(fastio.readall_f(args[i+1]))
+            end
+            i = i + 2
+        else
+            debug = debug or a == "--debug"
+            t[#t+1] = a
+            i = i + 1
+        end
+    end
+    if debug then
+        -- debug binaries carry the source path
+        for j = 1, #args - 1 do
+            if args[j] == "-f" then
+                t[#t+1] = args[j+1]
+            end
+        end
+    end
+    t[#t+1] = sha1(strip_line_directives(preprocessed))
+    return sha1(table.concat(t, "\n"))
+end
+
+local function entry(root, key)
+    return root / key:sub(1, 2) / key
+end
+
+function m.fetch(root, key, output)
+    local path = entry(root, key)
+    if not lfs.exists(path) then
+        return false
+    end
+    lfs.copy_file(path, output, lfs.copy_options.overwrite_existing)
+    return true
+end
+
+function m.store(root, key, binfile)
+    local path = entry(root, key)
+    if lfs.exists(path) then
+        return
+    end
+    lfs.create_directories(path:parent_path())
+    local tmp = lfs.path(("%s.%s.tmp"):format(path:string(), sha1(tostring {} .. os.time() .. os.clock()):sub(1, 8)))
+    lfs.copy_file(binfile, tmp, lfs.copy_options.overwrite_existing)
+    if not pcall(lfs.rename, tmp, path) then
+        lfs.remove(tmp)
+    end
+end
+
+function m.count(what)
+    stat[what] = stat[what] + 1
+end
+
+function m.stat()
+    return {
+        local_hit = stat.local_hit,
+        hit = stat.hit,
+        miss = stat.miss,
+    }
+end
+
+function m.reset_stat()
+    stat.local_hit, stat.hit, stat.miss = 0, 0, 0
+end
+
+return m
@@ -1,5 +1,4 @@
 local shader = require "material.shader"
-local subprocess = require "subprocess"
 local lfs = require "bee.filesystem"
 local toolset = {}
 
@@ -105,31 +104,8 @@ local function gen_commands(config)
 end
 
 function toolset.compile(config)
-	if true then
-		local commands = gen_commands(config)
-		return shader.run(config.setting, commands, config.input, config.output)
-	else
-		local prerocessfile = lfs.path(config.output:string() .. ".prerocess")
-		local commands = gen_commands(config)
-		commands[#commands+1] = "--preprocess"
-		local success, errmsg = shader.run(config.setting, commands, config.input, prerocessfile)
-		if not success then
-			return success, errmsg
-		end
-		local deps = errmsg
-		success, errmsg = subprocess.spawn {
-			"--platform",	config.platform,
-			"--type",		stage_types[config.stage],
-			"-p",			get_shader_option(config.platform, config.renderer, config.stage),
-			"-f",			prerocessfile:string(),
-			"-o", 			(config.output / "bin"):string(),
-			"--raw",
-		}
-		if not success then
-			return false, errmsg
-		end
-		return true, deps
-	end
+	local commands = gen_commands(config)
+	return shader.run(config.setting, commands, config.input, config.output)
 end
 
 return toolset
@@ -1 +1 @@
-return 25
+return 26
@@ -2,6 +2,7 @@ local gltfutil  = require "model.glTF.util"
 local utility   = require "model.utility"
 local meshutil	= require "model.meshutil"
 local packer 	= require "model.pack_vertex_data"
+local meshopt	= require "meshopt"
 local pack_vertex_data = packer.pack
 
 local function get_layout(name, accessor)
@@ -355,6 +356,7 @@ local function fetch_vb_buffers(math3d, gltfscene, prim, ib_table, meshexport)
 			memory = {bindata, 1, #bindata},
 			start = 0,
 			num = numv,
+			stride = new_vertices[1] and #new_vertices[1] or 0,
 		}
 	end
 
@@ -452,6 +454,58 @@ end
 
 -- end
 
+local LOD_MIN_TRIANGLES <const> = 512
+
+-- merge equal vertices, then reorder triangles for the post-transform cache and overdraw,
+-- and vertices for fetch. vb and vb2 share the index buffer, so they are remapped together.
+local function optimize_mesh(group)
+	local vb, vb2, ib = group.vb, group.vb2, group.ib
+	if vb.num == 0 then
+		return
+	end
+	local streams = {{vb.memory[1], vb.stride}}
+	if vb2 then
+		streams[2] = {vb2.memory[1], vb2.stride}
+	end
+	local r = meshopt.optimize {
+		vertex_count	= vb.num,
+		streams			= streams,
+		indices			= ib and ib.memory[1] or nil,
+		index32			= ib and ib.flag == 'd',
+		position		= vb.declname:match "^p3%d[nN][iI]f" and 0 or nil,
+	}
+
+	local indices, index32, index_count = r.indices, r.index32, r.index_count
+	-- simplified index ranges for the runtime LOD selection, ib.num stays the full detail count
+	if vb.declname:match "^p3%d[nN][iI]f" and index_count >= LOD_MIN_TRIANGLES * 3 then
+		local lod = meshopt.lod {
+			vertex_count	= r.vertex_count,
+			position		= {r.streams[1], vb.stride, 0},
+			indices			= indices,
+			index32			= index32,
+		}
+		if #lod.levels > 1 then
+			local levels = {}
+			for i, l in ipairs(lod.levels) do
+				levels[i] = {start = l[1], num = l[2], error = l[3]}
+			end
+			group.lod = {sphere = lod.sphere, levels = levels}
+			indices = lod.indices
+		end
+	end
+
+	local function set_vb(b, bindata)
+		b.memory = {bindata, 1, #bindata}
+		b.num = r.vertex_count
+		b.stride = nil
+	end
+	set_vb(vb, r.streams[1])
+	if vb2 then
+		set_vb(vb2, r.streams[2])
+	end
+	group.ib = to_ib(indices, index32 and 'd' or '', index_count)
+end
+
 local function save_meshbin_files(status, resname, meshgroup)
 	local cfgname = ("meshes/%s.meshbin"):format(resname)
 
@@ -506,6 +560,7 @@ end
 			end
 
 			local stemname = ("%s_P%d"):format(meshname, primidx)
+			optimize_mesh(group)
 
 			meshexport.meshbinfile = save_meshbin_files(status, stemname, group)
 			meshexport.declname = {
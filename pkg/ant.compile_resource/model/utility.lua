@@ -35,7 +35,7 @@ end
 
 function m.save_txt_file(status, path, data, conv, suffix)
     m.apply_patch(status, path, data, function (name, desc)
-        writeFile(status, name, serialize.stringify(conv(desc)), suffix)
+        writeFile(status, name, serialize.binary(conv(desc)), suffix)
     end)
 end
 
@@ -1 +1 @@
-return 28
+return 29
@@ -8,9 +8,6 @@ local fastio		= require "fastio"
 local stringify 	= import_package "ant.serialize".stringify
 
 local TEXTUREC 		= require "tool_exe_path"("texturec")
-local shpkg			= import_package "ant.sh"
-local SH			= shpkg.sh
-local texcube		= import_package "ant.texture".cube
 local btime			= require "bee.time"
 
 local setting		= import_package "ant.settings"
@@ -125,10 +122,13 @@ local compress_SH; do
     compress_SH = P[irradianceSH_bandnum]
 end
 
-local function build_Eml(cm)
+local function build_Eml(content, facesize)
     print("start build irradiance SH, bandnum:", irradianceSH_bandnum)
 	local now = btime.monotonic()
-    local Eml = SH.calc_Eml(cm, irradianceSH_bandnum)
+    local Eml = image.ibl.irradiance_SH(content, facesize, irradianceSH_bandnum)
+    for i, e in ipairs(Eml) do
+        Eml[i] = math3d.vector(e)
+    end
     print("finish build irradiance SH, time used: ", btime.monotonic() - now, " ms")
     return Eml
 end
@@ -141,8 +141,8 @@ local function serialize_results(Eml)
 	return s
 end
 
-local function build_irradiance_sh(cm)
-    local Eml = compress_SH(build_Eml(cm))
+local function build_irradiance_sh(content, facesize)
+    local Eml = compress_SH(build_Eml(content, facesize))
 	return serialize_results(Eml)
 end
 
@@ -225,8 +225,7 @@ return function (output, setting, param)
 				error "build SH need cubemap texture"
 			end
 			assert(info.bitsPerPixel // 8 == 16)
-			local cm = texcube.create{w=info.width, h=info.height, texelsize=16, data=content}
-			config.irradiance_SH = build_irradiance_sh(cm)
+			config.irradiance_SH = build_irradiance_sh(content, info.width)
 		end
 	else
 		buildcmd = "<image from memory>"
@@ -6,6 +6,7 @@ local fs         = require "filesystem"
 local efk_cb     = require "effekseer.callback"
 local textureman = require "textureman.client"
 local assetmgr   = import_package "ant.asset"
+local setting    = import_package "ant.settings"
 
 local function init_fx_files()
     local tasks = {}
@@ -103,6 +104,7 @@ function efkasset.init_efk_ctx(maxcount, viewid, default_texid)
     return lefk.startup{
         max_count       = maxcount,
         viewid          = viewid,
+        worker_threads  = setting:get "efk/worker_threads",
         shader_load     = efk_cb.shader_load,
         texture_load    = efk_cb.texture_load,
         texture_get     = efk_cb.texture_get,
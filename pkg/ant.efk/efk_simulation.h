@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Effekseer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+
+// Simulation half of efk_ctx, shared with the headless benchmark.
+// The manager is created without auto flip: the draw sets are flipped once per frame, then the
+// frame is simulated in fixed steps. Instance chunks of one step are updated by Effekseer's
+// worker threads, Update() returns when all of them are done, so the draw after it never
+// sees a half simulated frame.
+struct efk_simulation {
+	static constexpr float FRAME_RATE = 60.f;		// Effekseer effects are authored in 60 fps frames
+	static constexpr int MAX_STEPS = 4;				// a long frame gets larger steps instead of more
+
+	Effekseer::ManagerRef manager;
+	uint32_t worker_threads = 0;
+	int64_t update_time = 0;						// microseconds of the last frame
+
+	static uint32_t
+	default_worker_threads() {
+		const uint32_t n = std::thread::hardware_concurrency();
+		return n > 2 ? n / 2 : 0;
+	}
+
+	void init(int32_t max_count, uint32_t threads) {
+		manager = Effekseer::Manager::Create(max_count, false);
+		manager->GetSetting()->SetCoordinateSystem(Effekseer::CoordinateSystem::LH);
+		worker_threads = (threads > 1 && manager->LaunchWorkerThreads(threads)) ? threads : 0;
+	}
+
+	// delta in seconds, 0 advances one frame
+	void update(float delta) {
+		const auto start = std::chrono::steady_clock::now();
+		manager->Flip();
+
+		const float delta_frames = delta > 0.f ? delta * FRAME_RATE : 1.f;
+		const int iterations = std::clamp((int)std::round(delta_frames), 1, MAX_STEPS);
+		Effekseer::Manager::UpdateParameter param;
+		param.DeltaFrame = delta_frames / iterations;
+		param.UpdateInterval = 1;
+		param.SyncUpdate = true;
+		for (int i = 0; i < iterations; ++i) {
+			manager->Update(param);
+		}
+		update_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+};
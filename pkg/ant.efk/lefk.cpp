@@ -1,10 +1,13 @@
 #include <lua.hpp>
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <mutex>
 
 #include <bgfx/c99/bgfx.h>
 
 #include "efkbgfx/renderer/bgfxrenderer.h"
+#include "efk_simulation.h"
 #include "../../clibs/bgfx/bgfx_interface.h"
 #include <Effekseer/Effekseer.DefaultEffectLoader.h>
 
@@ -39,13 +42,13 @@ public:
 	efk_ctx() = default;
 	~efk_ctx() = default;
 public:
-	bool init(EffekseerRendererBGFX::InitArgs &efkargs) {
+	bool init(EffekseerRendererBGFX::InitArgs &efkargs, uint32_t worker_threads) {
 		renderer = EffekseerRendererBGFX::CreateRenderer(&efkargs);
 		if (renderer == nullptr){
 			return false;
 		}
-		manager = Effekseer::Manager::Create(efkargs.squareMaxCount);
-		manager->GetSetting()->SetCoordinateSystem(Effekseer::CoordinateSystem::LH);
+		sim.init(efkargs.squareMaxCount, worker_threads);
+		manager = sim.manager;
 
 		manager->SetModelRenderer(CreateModelRenderer(renderer, &efkargs));
 		manager->SetSpriteRenderer(renderer->CreateSpriteRenderer());
@@ -65,17 +68,64 @@ public:
 		renderer->SetProjectionMatrix(projmat);
 		renderer->SetTime(renderer->GetTime() + delta);
 		drawParameter.ViewProjectionMatrix = renderer->GetCameraProjectionMatrix();
+		this->delta = delta;
 	}
 
 	void update() {
-		// Stabilize in	a variable frame environment
-		// float deltaFrames = delta * 60.0f;
-		// int iterations =	std::max(1,	(int)roundf(deltaFrames));
-		// float advance = deltaFrames / iterations;
-		// for (int	i =	0; i < iterations; i++)	{
-		//	   ctx->manager->Update(advance);
-		// }
-		manager->Update();
+		sim.update(delta);
+	}
+
+	// Lua calls come from the world service while frame() runs in the efk update service.
+	// Transforms only go to the back buffer, everything else that touches the manager
+	// holds the lock, so it waits for the frame or the frame waits for it.
+	std::unique_lock<std::mutex> lock() {
+		return std::unique_lock<std::mutex>(mutex);
+	}
+
+	void push_transform(int handle, const Effekseer::Matrix44 &mat) {
+		std::lock_guard<std::mutex> l(transform_mutex);
+		transforms[back].push_back({handle, mat});
+	}
+
+	// the last transform queued for a slot since the last frame, with the lock held
+	bool queued_transform(int handle, Effekseer::Matrix44 &mat) {
+		std::lock_guard<std::mutex> l(transform_mutex);
+		const auto &q = transforms[back];
+		for (auto it = q.rbegin(); it != q.rend(); ++it) {
+			if (it->handle == handle) {
+				mat = it->mat;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// the handle of a removed slot is reused, its queued transforms must not reach the new one
+	void drop_transforms(int handle) {
+		std::lock_guard<std::mutex> l(transform_mutex);
+		auto &q = transforms[back];
+		q.erase(std::remove_if(q.begin(), q.end(), [handle](const pending_transform &t) {
+			return t.handle == handle;
+		}), q.end());
+	}
+
+	void frame() {
+		auto l = lock();
+		int front;
+		{
+			std::lock_guard<std::mutex> tl(transform_mutex);
+			front = back;
+			back ^= 1;
+		}
+		for (const auto &t : transforms[front]) {
+			if (slot_valid(t.handle)) {
+				slot_update(effects[t.handle], t.mat);
+			}
+		}
+		transforms[front].clear();
+		update();
+		render();
+		reset();
 	}
 
 	void render() {
@@ -148,6 +198,7 @@ public:
 		assert(slot_valid(handle));
 		auto& slot = effects[handle];
 		slot_stop(slot, false);
+		drop_transforms(handle);
 		slot.eptr = nullptr;
 		slot.next = this->freelist;
 		this->freelist = handle;
@@ -228,7 +279,8 @@ public:
 	}
 
 	void
-	slot_play(struct efk_slot& slot, float speed, int32_t startframe, bool fadeout){
+	slot_play(int handle, float speed, int32_t startframe, bool fadeout){
+		auto& slot = effects[handle];
 		if (manager->Exists(slot.inst)) {
 			slot_show(slot, fadeout);
 			slot_stop(slot, fadeout);
@@ -237,6 +289,14 @@ public:
 		slot.fadeout = false;	//reset fadeout to false
 		slot.inst = manager->Play(slot.eptr, Effekseer::Vector3D(0, 0, 0), startframe);
 		manager->SetSpeed(slot.inst, speed);
+		// start at the transform queued for this frame, or stay hidden until the first one comes
+		Effekseer::Matrix44 mat;
+		if (queued_transform(handle, mat)) {
+			Effekseer::Matrix43 effekMat; ToMatrix43(mat, effekMat);
+			manager->SetMatrix(slot.inst, effekMat);
+		} else {
+			manager->SetShown(slot.inst, false);
+		}
 	}
 
 	void
@@ -280,11 +340,22 @@ public:
 	}
 public:
 	EffekseerRenderer::RendererRef		renderer;
+	efk_simulation						sim;
 	Effekseer::ManagerRef				manager;
+	float								delta = 0.f;
 	Effekseer::Manager::DrawParameter	drawParameter;
 
 	std::vector<efk_slot> 				effects;
 	int	freelist = -1;
+
+	struct pending_transform {
+		int handle;
+		Effekseer::Matrix44 mat;
+	};
+	std::mutex							mutex;
+	std::mutex							transform_mutex;
+	std::vector<pending_transform>		transforms[2];
+	int									back = 0;
 };
 
 static efk_ctx*
@@ -354,16 +425,34 @@ lefkctx_setstate(lua_State *L) {
 	auto projmat = TOM(L, 3);
 	auto delta = (float)luaL_checknumber(L, 4) * 0.001f;
 
+	auto lock = ctx->lock();
 	ctx->set_state(*viewmat, *projmat, delta);
 	return 0;
 }
 
 static int
-lefkctx_render(lua_State *L){
+lefkctx_stat(lua_State *L){
 	auto ctx = EC(L, 1);
-	ctx->update();
-	ctx->render();
-	ctx->reset();
+	int64_t update_time;
+	int32_t instance_count;
+	{
+		auto lock = ctx->lock();
+		update_time = ctx->sim.update_time;
+		instance_count = ctx->manager->GetTotalInstanceCount();
+	}
+	lua_createtable(L, 0, 3);
+	lua_pushinteger(L, update_time);
+	lua_setfield(L, -2, "update_time");
+	lua_pushinteger(L, instance_count);
+	lua_setfield(L, -2, "instance_count");
+	lua_pushinteger(L, ctx->sim.worker_threads);
+	lua_setfield(L, -2, "worker_threads");
+	return 1;
+}
+
+static int
+lefkctx_render(lua_State *L){
+	EC(L, 1)->frame();
 	return 0;
 }
 
@@ -389,7 +478,10 @@ lefkctx_new(lua_State *L) {
 	const float mag = (float)luaL_optnumber(L, 4, 1.f);
 
 	struct efk_box *box = (struct efk_box *)lua_newuserdatauv(L, sizeof(*box), 0);
-	new	(&box->eptr) Effekseer::EffectRef(Effekseer::Effect::Create(ctx->manager, content.data(), (int)content.size(), mag,	u16_materialPath));
+	{
+		auto lock = ctx->lock();
+		new	(&box->eptr) Effekseer::EffectRef(Effekseer::Effect::Create(ctx->manager, content.data(), (int)content.size(), mag,	u16_materialPath));
+	}
 	if (luaL_newmetatable(L, "EFK_INSTANCE")) {
 		lua_pushcfunction(L, lefk_release);
 		lua_setfield(L, -2, "__gc");
@@ -410,20 +502,26 @@ lefkctx_create(lua_State *L) {
 		return luaL_error(L, "Released effect");
 	}
 
+	auto lock = ctx->lock();
 	lua_pushinteger(L, ctx->slot_new(box->eptr));
 	return 1;
 }
 
 static int
 lefkctx_destroy(lua_State *L) {
-	EC(L, 1)->slot_remove((int)luaL_checkinteger(L, 2));
+	auto ctx = EC(L, 1);
+	const int handle = (int)luaL_checkinteger(L, 2);
+	auto lock = ctx->lock();
+	ctx->slot_remove(handle);
 	return 0;
 }
 
 static int
 lefkctx_update_transform(lua_State *L) {
 	auto ctx = EC(L, 1);
-	ctx->slot_update(ctx->slot_from_lua(L, 2), *TOM(L, 3));
+	const int handle = (int)luaL_checkinteger(L, 2);
+	ctx->slot_valid(L, handle);
+	ctx->push_transform(handle, *TOM(L, 3));
 	return 0;
 }
 
@@ -448,7 +546,7 @@ lefkctx_update_transforms(lua_State *L){
 	for	(uint32_t ii=0; ii<num; ++ii){
 		const auto& t = td[ii];
 		ctx->slot_valid(L, t.handle);
-		ctx->slot_update(ctx->effects[t.handle], *reinterpret_cast<const Effekseer::Matrix44*>(t.data));
+		ctx->push_transform(t.handle, *reinterpret_cast<const Effekseer::Matrix44*>(t.data));
 	}
 
 	return 0;
@@ -459,6 +557,7 @@ lefkctx_is_alive(lua_State *L) {
 	auto ctx = EC(L);
 	const int handle = (int)luaL_checkinteger(L, 2);
 
+	auto lock = ctx->lock();
 	lua_pushboolean(L,
 		ctx->slot_valid(handle) &&
 		ctx->manager->Exists(ctx->effects[handle].inst));
@@ -468,11 +567,13 @@ lefkctx_is_alive(lua_State *L) {
 static int
 lefkctx_play(lua_State *L) {
 	auto ctx = EC(L, 1);
-	auto& slot = ctx->slot_from_lua(L, 2);
+	const int handle = (int)luaL_checkinteger(L, 2);
+	ctx->slot_valid(L, handle);
 	const float speed = (float)luaL_optnumber(L, 3, 1.0f);
 	const int32_t startframe = (int32_t)luaL_optinteger(L, 4, 0);
 	const bool fadeout = lua_toboolean(L, 5);
-	ctx->slot_play(slot, speed, startframe, fadeout);
+	auto lock = ctx->lock();
+	ctx->slot_play(handle, speed, startframe, fadeout);
 	return 0;
 }
 
@@ -481,6 +582,7 @@ lefkctx_stop(lua_State *L){
 	auto ctx = EC(L);
 	auto& slot = ctx->slot_from_lua(L, 2);
 	const bool fadeout = lua_toboolean(L, 3);
+	auto lock = ctx->lock();
 	if (fadeout) {
 		slot.fadeout = true;
 	} else {
@@ -493,7 +595,9 @@ static int
 lefkctx_set_visible(lua_State *L) {
 	auto ctx = EC(L, 1);
 	auto& slot = ctx->slot_from_lua(L, 2);
-	slot.shown = (lua_type(L, 3) == LUA_TBOOLEAN) ? lua_toboolean(L, 3) : true;
+	const bool shown = (lua_type(L, 3) == LUA_TBOOLEAN) ? lua_toboolean(L, 3) : true;
+	auto lock = ctx->lock();
+	slot.shown = shown;
 	return 0;
 }
 
@@ -501,7 +605,9 @@ static int
 lefkctx_pause(lua_State *L) {
 	auto ctx = EC(L, 1);
 	auto& slot = ctx->slot_from_lua(L, 2);
-	ctx->slot_pause(slot, lua_type(L, 3) == LUA_TBOOLEAN ? lua_toboolean(L, 3) : false);
+	const bool pause = lua_type(L, 3) == LUA_TBOOLEAN ? lua_toboolean(L, 3) : false;
+	auto lock = ctx->lock();
+	ctx->slot_pause(slot, pause);
 	return 0;
 }
 
@@ -509,7 +615,9 @@ static int
 lefkctx_set_time(lua_State *L) {
 	auto ctx = EC(L, 1);
 	const float frame = std::max(0.f, (float)luaL_optnumber(L, 3, 0.f));
-	ctx->slot_set_time(ctx->slot_from_lua(L, 2), frame);
+	auto& slot = ctx->slot_from_lua(L, 2);
+	auto lock = ctx->lock();
+	ctx->slot_set_time(slot, frame);
 	return 0;
 }
 
@@ -519,6 +627,7 @@ lefkctx_set_speed(lua_State *L) {
 	auto& slot = ctx->slot_from_lua(L, 2);
 
 	const float speed = (float)lua_tonumber(L, 3);
+	auto lock = ctx->lock();
 	ctx->slot_speed(slot, speed);
 	return 0;
 }
@@ -548,6 +657,7 @@ lefkctx_set_texture(lua_State *L){
 	const char* tex = luaL_checkstring(L, 3);
 	const Effekseer::TextureType tt = totexturetype(L, 4);
 	const int texindex = luaL_optinteger(L, 5, 0);
+	auto lock = ctx->lock();
 	ctx->slot_set_texture(slot, tex, tt, texindex);
 	return 0;
 }
@@ -556,6 +666,7 @@ static int
 lefkctx_set_light_direction(lua_State *L) {
 	auto ctx = EC(L);
 	auto direction = TOV(L, 2);
+	auto lock = ctx->lock();
 	ctx->renderer->SetLightDirection(*direction);
 	return 0;
 }
@@ -564,6 +675,7 @@ static int
 lefkctx_set_light_color(lua_State *L) {
 	auto ctx = EC(L, 1);
 	auto color = TOC(L,	2);
+	auto lock = ctx->lock();
 	ctx->renderer->SetLightColor(*color);
 	return 0;
 }
@@ -572,6 +684,7 @@ static int
 lefkctx_set_ambient_color(lua_State *L) {
 	auto ctx = EC(L, 1);
 	auto ambient = TOC(L, 2);
+	auto lock = ctx->lock();
 	ctx->renderer->SetLightAmbientColor(*ambient);
 	return 0;
 }
@@ -611,6 +724,10 @@ lefk_startup(lua_State *L){
 
 	EffekseerRendererBGFX::InitArgs	efkArgs;
 	fetch_efk_args(L, 2, efkArgs);
+	lua_getfield(L, 1, "worker_threads");
+	const lua_Integer threads = luaL_optinteger(L, -1, -1);
+	const uint32_t worker_threads = threads < 0 ? efk_simulation::default_worker_threads() : (uint32_t)threads;
+	lua_pop(L, 1);
 
 	auto ctx = (efk_ctx*)lua_newuserdatauv(L, sizeof(efk_ctx), 0);
 	new	(ctx)efk_ctx();
@@ -621,6 +738,7 @@ lefk_startup(lua_State *L){
 			{"handle",				lefkctx_handle},
 			{"setstate",			lefkctx_setstate},
 			{"render",				lefkctx_render},
+			{"stat",				lefkctx_stat},
 			{"new",					lefkctx_new},
 			{"create",				lefkctx_create},
 			{"destroy",				lefkctx_destroy},
@@ -646,7 +764,7 @@ lefk_startup(lua_State *L){
 
 	new	(ctx) efk_ctx();
 
-	if (!ctx->init(efkArgs)){
+	if (!ctx->init(efkArgs, worker_threads)){
 		return luaL_error(L, "create efk_ctx init failed");
 	}
 	return 1;
@@ -656,6 +774,7 @@ static int
 lefk_shutdown(lua_State *L){
 	auto ctx = EC(L);
 	ctx->manager.Reset();
+	ctx->sim.manager.Reset();
 	ctx->renderer.Reset();
 	ctx->~efk_ctx();
 	return 0;
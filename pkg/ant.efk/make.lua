@@ -56,3 +56,32 @@ lm:lua_src "efk" {
         flags = "/Zc:preprocessor",
     },
 }
+
+lm:exe "efk_bench" {
+    includes = {
+        lm.AntDir .. "/3rd/Effekseer/Dev/Cpp/Effekseer",
+    },
+    sources = {
+        "test/efk_bench.cpp",
+        lm.AntDir .. "/3rd/Effekseer/Dev/Cpp/Effekseer/Effekseer/**/*.cpp",
+    },
+    gcc = {
+        flags = {
+            "-Wno-sign-compare",
+            "-Wno-unused-but-set-variable",
+            "-Wno-format",
+            "-Wno-unused-variable",
+        }
+    },
+    clang = {
+        flags = {
+            "-Wno-delete-non-abstract-non-virtual-dtor",
+            "-Wno-unused-but-set-variable",
+            "-Wno-unused-variable",
+            "-Wno-inconsistent-missing-override",
+        }
+    },
+    msvc = {
+        flags = "/Zc:preprocessor",
+    },
+}
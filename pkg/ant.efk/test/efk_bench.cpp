@@ -0,0 +1,90 @@
+// Headless Effekseer simulation benchmark: plays N instances of an effect without a renderer
+// and reports the simulation time per frame, single threaded and with the worker pool.
+// usage: efk_bench [effect.efk] [instances] [frames] [worker threads]
+#include "../efk_simulation.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+static constexpr const char* DEFAULT_EFFECT = "test/features/pkg/ant.test.features/assets/efk/miner_efk/miner_dust.efk";
+static constexpr int32_t MAX_INSTANCES = 65536;
+
+struct result {
+    double average;     // milliseconds
+    double worst;
+    int32_t instances;
+};
+
+static result
+run(const std::vector<char>& content, int count, int frames, uint32_t threads) {
+    efk_simulation sim;
+    sim.init(MAX_INSTANCES, threads);
+    auto effect = Effekseer::Effect::Create(sim.manager, content.data(), (int32_t)content.size());
+    if (effect == nullptr) {
+        fprintf(stderr, "efk_bench: invalid effect\n");
+        exit(1);
+    }
+
+    std::vector<Effekseer::Handle> handles(count, -1);
+    const int side = (int)std::ceil(std::sqrt((double)count));
+    auto play = [&](int i) {
+        handles[i] = sim.manager->Play(effect, float(i % side) * 2.f, 0.f, float(i / side) * 2.f);
+    };
+
+    // warm up, so every instance is somewhere in its loop
+    for (int i = 0; i < count; ++i) {
+        play(i);
+        sim.update(1.f / efk_simulation::FRAME_RATE);
+    }
+
+    std::vector<int64_t> times;
+    times.reserve(frames);
+    for (int f = 0; f < frames; ++f) {
+        sim.update(1.f / efk_simulation::FRAME_RATE);
+        times.push_back(sim.update_time);
+        for (int i = 0; i < count; ++i) {
+            if (!sim.manager->Exists(handles[i])) {
+                play(i);
+            }
+        }
+    }
+    result r;
+    int64_t total = 0;
+    for (auto t : times) {
+        total += t;
+    }
+    r.average = total / 1000.0 / std::max<size_t>(times.size(), 1);
+    r.worst = *std::max_element(times.begin(), times.end()) / 1000.0;
+    r.instances = sim.manager->GetTotalInstanceCount();
+    sim.manager->StopAllEffects();
+    return r;
+}
+
+int main(int argc, char* argv[]) {
+    const char* path = argc > 1 ? argv[1] : DEFAULT_EFFECT;
+    const int count = argc > 2 ? atoi(argv[2]) : 500;
+    const int frames = argc > 3 ? atoi(argv[3]) : 600;
+    const int threads = argc > 4 ? atoi(argv[4]) : -1;
+    const uint32_t worker_threads = threads < 0 ? efk_simulation::default_worker_threads() : (uint32_t)threads;
+
+    std::ifstream f(path, std::ios::binary);
+    if (!f) {
+        fprintf(stderr, "efk_bench: can't open %s\n", path);
+        return 1;
+    }
+    const std::vector<char> content((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+    printf("%s, %d effects, %d frames\n", path, count, frames);
+    const result single = run(content, count, frames, 0);
+    printf("single thread:     %.3f ms/frame, worst %.3f ms, %d instances\n", single.average, single.worst, single.instances);
+    if (worker_threads > 1) {
+        const result pool = run(content, count, frames, worker_threads);
+        printf("%2u worker threads: %.3f ms/frame, worst %.3f ms, %d instances, x%.2f\n",
+            worker_threads, pool.average, pool.worst, pool.instances, single.average / pool.average);
+    }
+    return 0;
+}
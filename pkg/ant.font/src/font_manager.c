@@ -69,6 +69,7 @@ struct truetype_font;
 
 struct font_manager {
 	int version;
+	int evict;
 	int count;
 	int16_t list_head;
 	struct font_slot slots[FONT_MANAGER_SLOTS];
@@ -406,6 +407,10 @@ font_manager_update_unsafe(struct font_manager *F, int fontid, int codepoint, st
 		}
 		last_node->version = F->version;
 		F->list_head = slot;
+		if (F->slots[slot].codepoint_key >= 0) {
+			// the glyph in this slot is replaced, texture coords given out before are stale
+			++F->evict;
+		}
 		F->slots[slot].codepoint_key = -1;
 		hash_insert(F, cp, slot);
 	}
@@ -450,6 +455,14 @@ font_manager_update(struct font_manager *F, int fontid, int codepoint, struct fo
 	return r;
 }
 
+int
+font_manager_evict(struct font_manager *F) {
+	lock(F);
+	int r = F->evict;
+	unlock(F);
+	return r;
+}
+
 void
 font_manager_flush(struct font_manager *F) {
 	// todo : atomic inc
@@ -507,6 +520,7 @@ void
 font_manager_init(struct font_manager *F, void *L) {
 	mutex_init(F->mutex);
 	F->version = 1;
+	F->evict = 0;
 	F->count = 0;
 	F->ttf = NULL;
 	F->L = NULL;
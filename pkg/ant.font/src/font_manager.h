@@ -21,6 +21,7 @@ const char* font_manager_glyph(struct font_manager *F, int fontid, int codepoint
 int font_manager_touch(struct font_manager *, int font, int codepoint, struct font_glyph *glyph);
 const char * font_manager_update(struct font_manager *, int font, int codepoint, struct font_glyph *glyph, uint8_t *buffer);
 void font_manager_flush(struct font_manager *);
+int font_manager_evict(struct font_manager *F);
 void font_manager_scale(struct font_manager *F, struct font_glyph *glyph, int size);
 int font_manager_underline(struct font_manager *F, int fontid, int size, float *underline_position, float *thickness);
 float font_manager_sdf_mask(struct font_manager *F);
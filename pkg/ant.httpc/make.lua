@@ -28,4 +28,22 @@ lm:lua_src "httpc" {
 			"-fobjc-arc"
 		},
 	},
+	linux = {
+		sources = {
+			"src/httpc_linux.cpp",
+			"src/httpc_epoll.cpp",
+		},
+	},
 }
+
+if lm.os == "linux" then
+	lm:exe "httpc_test" {
+		sources = {
+			"src/httpc_epoll.cpp",
+			"test/httpc_test.cpp",
+		},
+		links = {
+			"pthread",
+		},
+	}
+end
@@ -0,0 +1,665 @@
+#include "httpc_epoll.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace httpc {
+    static constexpr size_t MAX_HEADER = 64 * 1024;
+    static constexpr int MAX_REDIRECTS = 8;
+    static constexpr auto IDLE_TIMEOUT = std::chrono::seconds(30);
+
+    using clock = std::chrono::steady_clock;
+
+    struct Url {
+        std::string host;
+        std::string port;
+        std::string path;
+    };
+
+    static std::string sys_errmsg(const char* what, int err = errno) {
+        return std::string(what) + ": " + std::strerror(err);
+    }
+
+    static bool parse_url(std::string_view url, Url& u, std::string& errmsg) {
+        if (url.substr(0, 8) == "https://") {
+            errmsg = "https is not supported";
+            return false;
+        }
+        if (url.substr(0, 7) != "http://") {
+            errmsg = "invalid url: " + std::string(url);
+            return false;
+        }
+        url.remove_prefix(7);
+        size_t slash = url.find('/');
+        std::string_view authority = url.substr(0, slash);
+        u.path = slash == std::string_view::npos ? "/" : std::string(url.substr(slash));
+        if (size_t hash = u.path.find('#'); hash != std::string::npos) {
+            u.path.resize(hash);
+        }
+        size_t colon = authority.rfind(':');
+        if (colon != std::string_view::npos && authority.find(']', colon) == std::string_view::npos) {
+            u.host = authority.substr(0, colon);
+            u.port = authority.substr(colon + 1);
+        }
+        else {
+            u.host = authority;
+            u.port = "80";
+        }
+        if (u.host.size() > 2 && u.host.front() == '[' && u.host.back() == ']') {
+            u.host = u.host.substr(1, u.host.size() - 2);
+        }
+        if (u.host.empty() || u.port.empty()) {
+            errmsg = "invalid url: " + std::string(url);
+            return false;
+        }
+        return true;
+    }
+
+    bool check_url(std::string_view url, std::string& errmsg) {
+        Url u;
+        return parse_url(url, u, errmsg);
+    }
+
+    static bool iequals(std::string_view a, std::string_view b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+            return (x | 0x20) == (y | 0x20);
+        });
+    }
+
+    static std::string_view trim(std::string_view s) {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+        return s;
+    }
+
+    template <typename T>
+    static bool to_number(std::string_view s, T& v, int base = 10) {
+        auto [p, ec] = std::from_chars(s.data(), s.data() + s.size(), v, base);
+        return ec == std::errc() && p != s.data();
+    }
+
+    struct Loop::Transfer {
+        enum class State {
+            Connecting,
+            Sending,
+            Headers,
+            Body,
+            Done,
+        };
+        enum class Chunk {
+            Size,
+            Data,
+            DataEnd,
+            Trailer,
+        };
+        Request req;
+        std::string url;
+        int redirects = 0;
+        int fd = -1;
+        int file = -1;
+        State state = State::Connecting;
+        std::string out;
+        size_t sent = 0;
+        std::string in;
+        int code = 0;
+        std::string location;
+        bool chunked = false;
+        Chunk chunk = Chunk::Size;
+        uint64_t chunk_left = 0;
+        int64_t content_length = -1;
+        uint64_t received = 0;
+        uint64_t offset = 0;        // bytes of .part kept from an earlier attempt
+        std::string memory;
+        clock::time_point active;
+        bool progressed = false;
+
+        ~Transfer() {
+            if (fd >= 0) ::close(fd);
+            if (file >= 0) ::close(file);
+        }
+        std::string part() const {
+            return req.file + ".part";
+        }
+        bool redirecting() const {
+            return code >= 300 && code < 400 && code != 304 && !location.empty();
+        }
+        uint64_t total() const {
+            return content_length < 0 ? 0 : offset + (uint64_t)content_length;
+        }
+    };
+
+    Loop::Loop() {}
+
+    Loop::~Loop() {
+        transfers.clear();
+        if (evfd >= 0) ::close(evfd);
+        if (epfd >= 0) ::close(epfd);
+    }
+
+    bool Loop::init(std::string& errmsg) {
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (epfd < 0) {
+            errmsg = sys_errmsg("epoll_create1");
+            return false;
+        }
+        evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (evfd < 0) {
+            errmsg = sys_errmsg("eventfd");
+            return false;
+        }
+        epoll_event ev {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, evfd, &ev) < 0) {
+            errmsg = sys_errmsg("epoll_ctl");
+            return false;
+        }
+        return true;
+    }
+
+    void Loop::wakeup() {
+        uint64_t one = 1;
+        [[maybe_unused]] ssize_t n = ::write(evfd, &one, sizeof(one));
+    }
+
+    namespace {
+        struct Driver {
+            int epfd;
+            Events& events;
+
+            void fail(Loop::Transfer& t, const std::string& errmsg) {
+                if (t.fd >= 0) {
+                    ::close(t.fd);
+                    t.fd = -1;
+                }
+                if (t.file >= 0) {
+                    ::close(t.file);
+                    t.file = -1;
+                }
+                t.state = Loop::Transfer::State::Done;
+                events.error(t.req.id, errmsg);
+            }
+
+            bool open_file(Loop::Transfer& t, std::string& errmsg) {
+                t.file = ::open(t.part().c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+                if (t.file < 0) {
+                    errmsg = sys_errmsg("open");
+                    return false;
+                }
+                struct stat st;
+                if (fstat(t.file, &st) < 0) {
+                    errmsg = sys_errmsg("fstat");
+                    return false;
+                }
+                t.offset = (uint64_t)st.st_size;
+                return true;
+            }
+
+            bool connect(Loop::Transfer& t) {
+                Url u;
+                std::string errmsg;
+                if (!parse_url(t.url, u, errmsg)) {
+                    fail(t, errmsg);
+                    return false;
+                }
+                if (!t.req.file.empty() && t.file < 0 && !open_file(t, errmsg)) {
+                    fail(t, errmsg);
+                    return false;
+                }
+                addrinfo hints {};
+                hints.ai_family = AF_UNSPEC;
+                hints.ai_socktype = SOCK_STREAM;
+                addrinfo* ai = nullptr;
+                // resolving blocks the loop, addresses of a session are usually few and cached by the system
+                if (int err = getaddrinfo(u.host.c_str(), u.port.c_str(), &hints, &ai); err != 0) {
+                    fail(t, std::string("getaddrinfo: ") + gai_strerror(err));
+                    return false;
+                }
+                int err = 0;
+                for (addrinfo* p = ai; p; p = p->ai_next) {
+                    int fd = ::socket(p->ai_family, p->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, p->ai_protocol);
+                    if (fd < 0) {
+                        err = errno;
+                        continue;
+                    }
+                    if (::connect(fd, p->ai_addr, p->ai_addrlen) == 0 || errno == EINPROGRESS) {
+                        t.fd = fd;
+                        break;
+                    }
+                    err = errno;
+                    ::close(fd);
+                }
+                freeaddrinfo(ai);
+                if (t.fd < 0) {
+                    fail(t, sys_errmsg("connect", err));
+                    return false;
+                }
+                const bool post = !t.req.body.empty();
+                t.out.clear();
+                t.out += post ? "POST " : "GET ";
+                t.out += u.path;
+                t.out += " HTTP/1.1\r\nHost: ";
+                t.out += u.host.find(':') == std::string::npos ? u.host : "[" + u.host + "]";
+                if (u.port != "80") {
+                    t.out += ":" + u.port;
+                }
+                t.out += "\r\nUser-Agent: ant-httpc\r\nAccept-Encoding: identity\r\nConnection: close\r\n";
+                if (t.offset > 0) {
+                    t.out += "Range: bytes=" + std::to_string(t.offset) + "-\r\n";
+                }
+                if (post) {
+                    t.out += "Content-Type: " + t.req.content_type + "\r\n";
+                    t.out += "Content-Length: " + std::to_string(t.req.body.size()) + "\r\n";
+                }
+                t.out += "\r\n";
+                t.sent = 0;
+                t.in.clear();
+                t.code = 0;
+                t.location.clear();
+                t.chunked = false;
+                t.chunk = Loop::Transfer::Chunk::Size;
+                t.content_length = -1;
+                t.received = 0;
+                t.memory.clear();
+                t.state = Loop::Transfer::State::Connecting;
+                t.active = clock::now();
+                epoll_event ev {};
+                ev.events = EPOLLOUT | EPOLLIN | EPOLLRDHUP;
+                ev.data.ptr = &t;
+                if (epoll_ctl(epfd, EPOLL_CTL_ADD, t.fd, &ev) < 0) {
+                    fail(t, sys_errmsg("epoll_ctl"));
+                    return false;
+                }
+                return true;
+            }
+
+            void restart(Loop::Transfer& t) {
+                epoll_ctl(epfd, EPOLL_CTL_DEL, t.fd, nullptr);
+                ::close(t.fd);
+                t.fd = -1;
+                connect(t);
+            }
+
+            bool send(Loop::Transfer& t) {
+                if (t.state == Loop::Transfer::State::Connecting) {
+                    int err = 0;
+                    socklen_t len = sizeof(err);
+                    getsockopt(t.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                    if (err != 0) {
+                        fail(t, sys_errmsg("connect", err));
+                        return false;
+                    }
+                    t.state = Loop::Transfer::State::Sending;
+                }
+                while (t.sent < t.out.size() + t.req.body.size()) {
+                    const bool head = t.sent < t.out.size();
+                    const std::string& s = head ? t.out : t.req.body;
+                    const size_t pos = head ? t.sent : t.sent - t.out.size();
+                    ssize_t n = ::send(t.fd, s.data() + pos, s.size() - pos, MSG_NOSIGNAL);
+                    if (n < 0) {
+                        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                            return true;
+                        }
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        fail(t, sys_errmsg("send"));
+                        return false;
+                    }
+                    t.sent += (size_t)n;
+                    t.active = clock::now();
+                }
+                t.state = Loop::Transfer::State::Headers;
+                epoll_event ev {};
+                ev.events = EPOLLIN | EPOLLRDHUP;
+                ev.data.ptr = &t;
+                epoll_ctl(epfd, EPOLL_CTL_MOD, t.fd, &ev);
+                return true;
+            }
+
+            bool headers(Loop::Transfer& t, std::string& errmsg) {
+                size_t end = t.in.find("\r\n\r\n");
+                if (end == std::string::npos) {
+                    if (t.in.size() > MAX_HEADER) {
+                        errmsg = "response header is too large";
+                        return false;
+                    }
+                    return true;
+                }
+                std::string_view head(t.in.data(), end + 2);
+                size_t eol = head.find("\r\n");
+                std::string_view status = head.substr(0, eol);
+                if (status.substr(0, 5) != "HTTP/" || status.size() < 12 || !to_number(status.substr(9, 3), t.code)) {
+                    errmsg = "invalid response";
+                    return false;
+                }
+                int64_t range_start = -1;
+                head.remove_prefix(eol + 2);
+                while (!head.empty()) {
+                    eol = head.find("\r\n");
+                    std::string_view line = head.substr(0, eol);
+                    head.remove_prefix(eol + 2);
+                    size_t colon = line.find(':');
+                    if (colon == std::string_view::npos) {
+                        continue;
+                    }
+                    std::string_view name = trim(line.substr(0, colon));
+                    std::string_view value = trim(line.substr(colon + 1));
+                    if (iequals(name, "content-length")) {
+                        if (!to_number(value, t.content_length)) {
+                            errmsg = "invalid content-length";
+                            return false;
+                        }
+                    }
+                    else if (iequals(name, "transfer-encoding")) {
+                        t.chunked = value.size() >= 7 && iequals(value.substr(value.size() - 7), "chunked");
+                    }
+                    else if (iequals(name, "location")) {
+                        t.location = value;
+                    }
+                    else if (iequals(name, "content-range") && value.substr(0, 6) == "bytes ") {
+                        to_number(value.substr(6, value.find('-') - 6), range_start);
+                    }
+                }
+                if (t.chunked) {
+                    t.content_length = -1;
+                }
+                std::string body = t.in.substr(end + 4);
+                t.in.clear();
+                if (t.code >= 100 && t.code < 200) {
+                    t.in = std::move(body);
+                    return headers(t, errmsg);
+                }
+                if (t.redirecting()) {
+                    if (++t.redirects > MAX_REDIRECTS) {
+                        errmsg = "too many redirects";
+                        return false;
+                    }
+                    if (t.location.front() == '/') {
+                        t.location = t.url.substr(0, t.url.find('/', 7)) + t.location;
+                    }
+                    if (!check_url(t.location, errmsg)) {
+                        return false;
+                    }
+                    // the body of a redirect is not needed, the connection is closed anyway
+                    t.url = t.location;
+                    restart(t);
+                    return true;
+                }
+                if (t.file >= 0) {
+                    if (t.code == 416 && t.offset > 0) {
+                        // the part does not match the file anymore, start over
+                        if (ftruncate(t.file, 0) < 0) {
+                            errmsg = sys_errmsg("ftruncate");
+                            return false;
+                        }
+                        t.offset = 0;
+                        restart(t);
+                        return true;
+                    }
+                    const bool append = t.code == 206 && t.offset > 0 && (uint64_t)range_start == t.offset;
+                    if (!append) {
+                        t.offset = 0;
+                        if (ftruncate(t.file, 0) < 0) {
+                            errmsg = sys_errmsg("ftruncate");
+                            return false;
+                        }
+                    }
+                    if (lseek(t.file, (off_t)t.offset, SEEK_SET) < 0) {
+                        errmsg = sys_errmsg("lseek");
+                        return false;
+                    }
+                }
+                t.state = Loop::Transfer::State::Body;
+                t.progressed = true;
+                if (t.code == 204 || t.code == 304 || (!t.chunked && t.content_length == 0)) {
+                    finish(t);
+                    return true;
+                }
+                return body.empty() || data(t, body.data(), body.size(), errmsg);
+            }
+
+            bool output(Loop::Transfer& t, const char* p, size_t n, std::string& errmsg) {
+                t.received += n;
+                t.progressed = true;
+                if (t.file < 0) {
+                    t.memory.append(p, n);
+                    return true;
+                }
+                while (n > 0) {
+                    ssize_t w = ::write(t.file, p, n);
+                    if (w < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        errmsg = sys_errmsg("write");
+                        return false;
+                    }
+                    p += w;
+                    n -= (size_t)w;
+                }
+                return true;
+            }
+
+            bool data(Loop::Transfer& t, const char* p, size_t n, std::string& errmsg) {
+                using Chunk = Loop::Transfer::Chunk;
+                if (!t.chunked) {
+                    if (t.content_length >= 0) {
+                        n = std::min<uint64_t>(n, (uint64_t)t.content_length - t.received);
+                    }
+                    if (!output(t, p, n, errmsg)) {
+                        return false;
+                    }
+                    if (t.content_length >= 0 && t.received == (uint64_t)t.content_length) {
+                        finish(t);
+                    }
+                    return true;
+                }
+                while (n > 0 && t.state == Loop::Transfer::State::Body) {
+                    if (t.chunk == Chunk::Data) {
+                        size_t m = (size_t)std::min<uint64_t>(n, t.chunk_left);
+                        if (!output(t, p, m, errmsg)) {
+                            return false;
+                        }
+                        p += m;
+                        n -= m;
+                        t.chunk_left -= m;
+                        if (t.chunk_left == 0) {
+                            t.chunk = Chunk::DataEnd;
+                        }
+                        continue;
+                    }
+                    // size lines, the CRLF after the data and the trailer are collected in t.in
+                    const char* lf = (const char*)std::memchr(p, '\n', n);
+                    size_t m = lf ? size_t(lf - p) + 1 : n;
+                    t.in.append(p, m);
+                    p += m;
+                    n -= m;
+                    if (!lf) {
+                        if (t.in.size() > MAX_HEADER) {
+                            errmsg = "invalid chunk";
+                            return false;
+                        }
+                        continue;
+                    }
+                    std::string_view line = trim(std::string_view(t.in).substr(0, t.in.size() - 1));
+                    switch (t.chunk) {
+                    case Chunk::Size:
+                        if (!to_number(line.substr(0, line.find(';')), t.chunk_left, 16)) {
+                            errmsg = "invalid chunk";
+                            return false;
+                        }
+                        t.chunk = t.chunk_left == 0 ? Chunk::Trailer : Chunk::Data;
+                        break;
+                    case Chunk::DataEnd:
+                        if (!line.empty()) {
+                            errmsg = "invalid chunk";
+                            return false;
+                        }
+                        t.chunk = Chunk::Size;
+                        break;
+                    case Chunk::Trailer:
+                        if (line.empty()) {
+                            finish(t);
+                        }
+                        break;
+                    default:
+                        break;
+                    }
+                    t.in.clear();
+                }
+                return true;
+            }
+
+            void finish(Loop::Transfer& t) {
+                epoll_ctl(epfd, EPOLL_CTL_DEL, t.fd, nullptr);
+                ::close(t.fd);
+                t.fd = -1;
+                t.state = Loop::Transfer::State::Done;
+                if (t.progressed) {
+                    events.progress(t.req.id, t.offset + t.received, t.total());
+                }
+                if (t.file >= 0) {
+                    ::close(t.file);
+                    t.file = -1;
+                    if (t.code >= 200 && t.code < 300) {
+                        if (::rename(t.part().c_str(), t.req.file.c_str()) < 0) {
+                            events.error(t.req.id, sys_errmsg("rename"));
+                            return;
+                        }
+                    }
+                    else {
+                        // an error page is not the file
+                        ::unlink(t.part().c_str());
+                    }
+                    events.completion(t.req.id, t.code, nullptr);
+                }
+                else if (!t.req.body.empty()) {
+                    events.response(t.req.id, t.memory);
+                    events.completion(t.req.id, t.code, nullptr);
+                }
+                else {
+                    events.completion(t.req.id, t.code, &t.memory);
+                }
+            }
+
+            void eof(Loop::Transfer& t) {
+                if (t.state == Loop::Transfer::State::Body && !t.chunked && t.content_length < 0) {
+                    finish(t);
+                    return;
+                }
+                // the part is kept, the next download of the file resumes it
+                fail(t, t.state == Loop::Transfer::State::Body ? "connection closed before the end of the body" : "connection closed");
+            }
+
+            void receive(Loop::Transfer& t) {
+                char buf[64 * 1024];
+                for (;;) {
+                    ssize_t n = ::recv(t.fd, buf, sizeof(buf), 0);
+                    if (n < 0) {
+                        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                            return;
+                        }
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        fail(t, sys_errmsg("recv"));
+                        return;
+                    }
+                    if (n == 0) {
+                        eof(t);
+                        return;
+                    }
+                    t.active = clock::now();
+                    std::string errmsg;
+                    bool ok;
+                    if (t.state == Loop::Transfer::State::Headers) {
+                        t.in.append(buf, (size_t)n);
+                        ok = headers(t, errmsg);
+                    }
+                    else {
+                        ok = data(t, buf, (size_t)n, errmsg);
+                    }
+                    if (!ok) {
+                        fail(t, errmsg);
+                        return;
+                    }
+                    if (t.state == Loop::Transfer::State::Done || t.state == Loop::Transfer::State::Connecting) {
+                        // finished or restarted on another socket
+                        return;
+                    }
+                }
+            }
+
+            void update(Loop::Transfer& t, uint32_t ev) {
+                if (t.state == Loop::Transfer::State::Connecting || t.state == Loop::Transfer::State::Sending) {
+                    if (ev & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+                        if (!send(t)) {
+                            return;
+                        }
+                    }
+                    if (t.state != Loop::Transfer::State::Headers) {
+                        return;
+                    }
+                }
+                if (ev & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) {
+                    receive(t);
+                }
+            }
+        };
+    }
+
+    void Loop::add(Request&& req, Events& events) {
+        auto t = std::make_unique<Transfer>();
+        t->req = std::move(req);
+        t->url = t->req.url;
+        Driver d { epfd, events };
+        d.connect(*t);
+        transfers.emplace_back(std::move(t));
+    }
+
+    void Loop::poll(int timeout_ms, Events& events) {
+        epoll_event evs[64];
+        int n = epoll_wait(epfd, evs, 64, timeout_ms);
+        Driver d { epfd, events };
+        for (int i = 0; i < n; ++i) {
+            if (!evs[i].data.ptr) {
+                uint64_t v;
+                [[maybe_unused]] ssize_t r = ::read(evfd, &v, sizeof(v));
+                continue;
+            }
+            auto& t = *(Transfer*)evs[i].data.ptr;
+            if (t.state != Transfer::State::Done) {
+                d.update(t, evs[i].events);
+            }
+        }
+        const auto now = clock::now();
+        for (auto& t : transfers) {
+            if (t->state == Transfer::State::Done) {
+                continue;
+            }
+            if (now - t->active > IDLE_TIMEOUT) {
+                d.fail(*t, "timeout");
+                continue;
+            }
+            if (t->progressed && t->state == Transfer::State::Body) {
+                events.progress(t->req.id, t->offset + t->received, t->total());
+            }
+            t->progressed = false;
+        }
+        transfers.erase(std::remove_if(transfers.begin(), transfers.end(), [](auto const& t) {
+            return t->state == Transfer::State::Done;
+        }), transfers.end());
+    }
+}
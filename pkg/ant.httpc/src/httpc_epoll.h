@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// HTTP/1.1 transfers on one epoll loop, the Linux backend of httpc runs it on the session thread.
+// Sockets are non-blocking and bodies go to the output as they arrive, a file download is written
+// to `file.part` and renamed at the end. An existing `file.part` is resumed with a range request.
+// There is no TLS, https urls are refused.
+namespace httpc {
+    struct Events {
+        virtual ~Events() = default;
+        virtual void progress(int64_t id, uint64_t n, uint64_t total) = 0;   // total is 0 when unknown
+        virtual void response(int64_t id, std::string_view data) = 0;        // the body of an upload
+        virtual void completion(int64_t id, int code, const std::string* content) = 0;  // content of a download to memory
+        virtual void error(int64_t id, const std::string& errmsg) = 0;
+    };
+
+    struct Request {
+        int64_t id = 0;
+        std::string url;
+        std::string file;           // empty: download to memory
+        std::string body;           // not empty: POST
+        std::string content_type;
+    };
+
+    // checks the url without any I/O
+    bool check_url(std::string_view url, std::string& errmsg);
+
+    class Loop {
+    public:
+        Loop();
+        ~Loop();
+        Loop(const Loop&) = delete;
+        Loop& operator=(const Loop&) = delete;
+        bool init(std::string& errmsg);
+        // the loop thread only
+        void add(Request&& req, Events& events);
+        void poll(int timeout_ms, Events& events);
+        size_t size() const { return transfers.size(); }
+        // any thread, returns from poll early
+        void wakeup();
+        struct Transfer;
+    private:
+        int epfd = -1;
+        int evfd = -1;
+        std::vector<std::unique_ptr<Transfer>> transfers;
+    };
+}
@@ -0,0 +1,203 @@
+#include <lua.hpp>
+#include <bee/lua/udata.h>
+#include <bee/thread/simplethread.h>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include "channel.h"
+#include "httpc_epoll.h"
+
+extern "C" {
+#include <3rd/lua-seri/lua-seri.h>
+}
+
+struct HttpcSession: public httpc::Events {
+    bee::thread_handle thread = nullptr;
+    MessageChannel request;
+    MessageChannel message;
+    int64_t taskid = 0;
+    httpc::Loop loop;
+    lua_State* L = nullptr;
+    std::atomic<bool> stop = false;
+    std::string errmsg;
+
+    HttpcSession() noexcept {
+    }
+    ~HttpcSession() noexcept {
+        if (thread) {
+            stop = true;
+            loop.wakeup();
+            bee::thread_wait(thread);
+        }
+        request.select([](void* req) {
+            delete (httpc::Request*)req;
+        });
+        if (L) {
+            lua_close(L);
+        }
+    }
+    bool init() noexcept {
+        if (!loop.init(errmsg)) {
+            return false;
+        }
+        L = luaL_newstate();
+        thread = bee::thread_create(+[](void* ud) noexcept {
+            ((HttpcSession*)ud)->threadFunc();
+        }, this);
+        return true;
+    }
+    void threadFunc() noexcept {
+        while (!stop) {
+            request.select([&](void* req) {
+                std::unique_ptr<httpc::Request> r((httpc::Request*)req);
+                loop.add(std::move(*r), *this);
+            });
+            loop.poll(100, *this);
+        }
+    }
+    void newMessage(int64_t id, const char* type) {
+        lua_settop(L, 0);
+        lua_newtable(L);
+        lua_pushinteger(L, id);
+        lua_setfield(L, -2, "id");
+        lua_pushstring(L, type);
+        lua_setfield(L, -2, "type");
+    }
+    void progress(int64_t id, uint64_t n, uint64_t total) override {
+        newMessage(id, "progress");
+        lua_pushinteger(L, (lua_Integer)n);
+        lua_setfield(L, -2, "n");
+        if (total != 0) {
+            lua_pushinteger(L, (lua_Integer)total);
+            lua_setfield(L, -2, "total");
+        }
+        message.push(seri_pack(L, 0, NULL));
+    }
+    void response(int64_t id, std::string_view data) override {
+        newMessage(id, "response");
+        lua_pushlstring(L, data.data(), data.size());
+        lua_setfield(L, -2, "data");
+        message.push(seri_pack(L, 0, NULL));
+    }
+    void completion(int64_t id, int code, const std::string* content) override {
+        newMessage(id, "completion");
+        lua_pushinteger(L, code);
+        lua_setfield(L, -2, "code");
+        if (content) {
+            lua_pushlstring(L, content->data(), content->size());
+            lua_setfield(L, -2, "content");
+        }
+        message.push(seri_pack(L, 0, NULL));
+    }
+    void error(int64_t id, const std::string& msg) override {
+        newMessage(id, "error");
+        lua_pushlstring(L, msg.data(), msg.size());
+        lua_setfield(L, -2, "errmsg");
+        message.push(seri_pack(L, 0, NULL));
+    }
+    void select(SelectHandler handler) {
+        message.select(handler);
+    }
+    std::optional<int64_t> createTask(httpc::Request&& req) noexcept {
+        if (!httpc::check_url(req.url, errmsg)) {
+            return std::nullopt;
+        }
+        int64_t id = ++taskid;
+        req.id = id;
+        request.push(new httpc::Request(std::move(req)));
+        loop.wakeup();
+        return id;
+    }
+};
+
+static std::string lua_checkstring(lua_State* L, int idx) {
+    size_t sz = 0;
+    const char* str = luaL_checklstring(L, idx, &sz);
+    return { str, sz };
+}
+
+static int session(lua_State* L) {
+    auto& s = bee::lua::newudata<HttpcSession>(L);
+    if (!s.init()) {
+        lua_pushnil(L);
+        lua_pushstring(L, ("session: " + s.errmsg).c_str());
+        return 2;
+    }
+    return 1;
+}
+
+static int push_task(lua_State* L, HttpcSession& s, httpc::Request&& req) {
+    if (auto id = s.createTask(std::move(req))) {
+        lua_pushinteger(L, *id);
+        return 1;
+    }
+    lua_pushnil(L);
+    lua_pushstring(L, s.errmsg.c_str());
+    return 2;
+}
+
+static int download(lua_State* L) {
+    auto& s = bee::lua::checkudata<HttpcSession>(L, 1);
+    httpc::Request req;
+    req.url = lua_checkstring(L, 2);
+    if (!lua_isnoneornil(L, 3)) {
+        req.file = lua_checkstring(L, 3);
+    }
+    return push_task(L, s, std::move(req));
+}
+
+static int upload(lua_State* L) {
+    auto& s = bee::lua::checkudata<HttpcSession>(L, 1);
+    httpc::Request req;
+    req.url = lua_checkstring(L, 2);
+    auto file = lua_checkstring(L, 3);
+    auto name = lua_checkstring(L, 4);
+    auto boundary = lua_checkstring(L, 5);
+    std::ifstream f(file, std::ios::binary);
+    if (!f) {
+        lua_pushnil(L);
+        lua_pushstring(L, ("upload: cannot open " + file).c_str());
+        return 2;
+    }
+    req.content_type = "multipart/form-data; boundary=\"" + boundary + "\"";
+    req.body = "--" + boundary + "\r\n";
+    req.body += "Content-Disposition: form-data; name=\"file\"; filename=\"" + name + "\"\r\n\r\n";
+    req.body.append(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    req.body += "\r\n--" + boundary + "--\r\n";
+    return push_task(L, s, std::move(req));
+}
+
+static int select(lua_State* L) {
+    auto& s = bee::lua::checkudata<HttpcSession>(L, 1);
+    lua_newtable(L);
+    lua_Integer n = 0;
+    s.select([&](void* data) {
+        seri_unpackptr(L, data);
+        lua_seti(L, -2, ++n);
+    });
+    return 1;
+}
+
+extern "C"
+int luaopen_httpc(lua_State* L) {
+    luaL_checkversion(L);
+    luaL_Reg l[] = {
+        { "session", session },
+        { "download", download },
+        { "upload", upload },
+        { "select", select },
+        { NULL, NULL },
+    };
+    luaL_newlib(L, l);
+    return 1;
+}
+
+namespace bee::lua {
+    template <>
+    struct udata<HttpcSession> {
+        static inline auto metatable = +[](lua_State*){};
+    };
+}
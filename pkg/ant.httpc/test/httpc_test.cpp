@@ -0,0 +1,372 @@
+// Runs the epoll transfers against a loopback HTTP server on a thread of this process:
+// many concurrent downloads, chunked and close delimited bodies, redirects, resuming a
+// cut download from its .part file, and uploads.
+#include "../src/httpc_epoll.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr size_t DATA_SIZE = 3 * 1024 * 1024 + 17;
+
+static std::string make_data() {
+    std::string s(DATA_SIZE, 0);
+    uint32_t x = 12345;
+    for (auto& c : s) {
+        x = x * 1664525u + 1013904223u;
+        c = char(x >> 24);
+    }
+    return s;
+}
+
+static const std::string g_data = make_data();
+
+struct Server {
+    int fd = -1;
+    int port = 0;
+    std::atomic<bool> stop = false;
+    std::atomic<int> range_requests = 0;
+    std::atomic<int> connections = 0;
+    std::thread thread;
+    std::vector<std::thread> clients;
+
+    bool start() {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 128) < 0) {
+            return false;
+        }
+        socklen_t len = sizeof(addr);
+        getsockname(fd, (sockaddr*)&addr, &len);
+        port = ntohs(addr.sin_port);
+        thread = std::thread([this] {
+            for (;;) {
+                int c = accept(fd, nullptr, nullptr);
+                if (c < 0 || stop) {
+                    if (c >= 0) close(c);
+                    return;
+                }
+                connections++;
+                clients.emplace_back([this, c] { serve(c); });
+            }
+        });
+        return true;
+    }
+    void shutdown() {
+        stop = true;
+        int c = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+        connect(c, (sockaddr*)&addr, sizeof(addr));
+        close(c);
+        thread.join();
+        for (auto& t : clients) t.join();
+        close(fd);
+    }
+    static void send_all(int c, const char* p, size_t n, size_t piece = 0) {
+        while (n > 0) {
+            ssize_t w = ::send(c, p, piece ? std::min(piece, n) : n, MSG_NOSIGNAL);
+            if (w <= 0) return;
+            p += w;
+            n -= w;
+            if (piece) std::this_thread::yield();
+        }
+    }
+    static void send_all(int c, const std::string& s) {
+        send_all(c, s.data(), s.size());
+    }
+    void serve(int c) {
+        std::string req;
+        char buf[4096];
+        size_t end;
+        while ((end = req.find("\r\n\r\n")) == std::string::npos) {
+            ssize_t n = recv(c, buf, sizeof(buf), 0);
+            if (n <= 0) { close(c); return; }
+            req.append(buf, n);
+        }
+        std::string path = req.substr(req.find(' ') + 1);
+        path.resize(path.find(' '));
+        size_t offset = 0;
+        bool range = false;
+        if (size_t r = req.find("Range: bytes="); r != std::string::npos) {
+            offset = strtoull(req.c_str() + r + 13, nullptr, 10);
+            range = true;
+            range_requests++;
+        }
+        auto header = [&](int code, const std::string& extra) {
+            send_all(c, "HTTP/1.1 " + std::to_string(code) + " X\r\nServer: loopback\r\n" + extra + "\r\n");
+        };
+        if (path == "/data" || path == "/cut") {
+            if (range && offset > DATA_SIZE) {
+                header(416, "Content-Length: 0\r\n");
+            }
+            else if (range) {
+                header(206, "Content-Length: " + std::to_string(DATA_SIZE - offset) + "\r\nContent-Range: bytes "
+                    + std::to_string(offset) + "-" + std::to_string(DATA_SIZE - 1) + "/" + std::to_string(DATA_SIZE) + "\r\n");
+                send_all(c, g_data.data() + offset, DATA_SIZE - offset);
+            }
+            else {
+                header(200, "Content-Length: " + std::to_string(DATA_SIZE) + "\r\n");
+                // /cut drops the connection halfway unless it is resumed
+                send_all(c, g_data.data(), path == "/cut" ? DATA_SIZE / 2 : DATA_SIZE);
+            }
+        }
+        else if (path == "/chunked") {
+            header(200, "Transfer-Encoding: chunked\r\n");
+            for (size_t pos = 0; pos < DATA_SIZE;) {
+                size_t n = std::min<size_t>(DATA_SIZE - pos, 1000 + pos % 70000);
+                char size[32];
+                snprintf(size, sizeof(size), "%zx;ext=1\r\n", n);
+                send_all(c, size);
+                send_all(c, g_data.data() + pos, n, 333);
+                send_all(c, "\r\n");
+                pos += n;
+            }
+            send_all(c, "0\r\nX-Trailer: 1\r\n\r\n");
+        }
+        else if (path == "/close") {
+            header(200, "");
+            send_all(c, g_data.data(), DATA_SIZE, 4096);
+        }
+        else if (path == "/redirect") {
+            header(302, "Location: /data\r\nContent-Length: 5\r\n");
+            send_all(c, "moved");
+        }
+        else if (path == "/upload") {
+            size_t cl = strtoull(req.c_str() + req.find("Content-Length: ") + 16, nullptr, 10);
+            std::string body = req.substr(end + 4);
+            while (body.size() < cl) {
+                ssize_t n = recv(c, buf, sizeof(buf), 0);
+                if (n <= 0) break;
+                body.append(buf, n);
+            }
+            std::string reply = "got " + std::to_string(body.size()) + (body.find(g_data.substr(0, 1000)) != std::string::npos ? " data" : "");
+            header(201, "Content-Length: " + std::to_string(reply.size()) + "\r\n");
+            send_all(c, reply);
+        }
+        else {
+            header(404, "Content-Length: 7\r\n");
+            send_all(c, "missing");
+        }
+        close(c);
+    }
+};
+
+struct Result {
+    int code = 0;
+    bool done = false;
+    std::string content;
+    std::string response;
+    std::string errmsg;
+    uint64_t first_progress = 0;
+    uint64_t last_progress = 0;
+    uint64_t total = 0;
+    int progress_count = 0;
+};
+
+struct Collector: httpc::Events {
+    std::map<int64_t, Result> results;
+    size_t finished = 0;
+    void progress(int64_t id, uint64_t n, uint64_t total) override {
+        auto& r = results[id];
+        if (r.progress_count++ == 0) r.first_progress = n;
+        r.last_progress = n;
+        r.total = total;
+    }
+    void response(int64_t id, std::string_view data) override {
+        results[id].response = data;
+    }
+    void completion(int64_t id, int code, const std::string* content) override {
+        auto& r = results[id];
+        r.code = code;
+        r.done = true;
+        if (content) r.content = *content;
+        finished++;
+    }
+    void error(int64_t id, const std::string& errmsg) override {
+        auto& r = results[id];
+        r.errmsg = errmsg;
+        r.done = true;
+        finished++;
+    }
+};
+
+static std::string read_file(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    return { std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>() };
+}
+
+static bool exists(const std::string& path) {
+    return access(path.c_str(), F_OK) == 0;
+}
+
+int main() {
+    int failed = 0;
+    auto check = [&](bool ok, const char* what) {
+        if (!ok) {
+            printf("FAILED: %s\n", what);
+            failed++;
+        }
+    };
+
+    Server server;
+    if (!server.start()) {
+        printf("httpc_test: cannot listen on loopback\n");
+        return 1;
+    }
+    const std::string base = "http://127.0.0.1:" + std::to_string(server.port);
+    char tmpl[] = "/tmp/httpc_test_XXXXXX";
+    const std::string dir = mkdtemp(tmpl);
+
+    httpc::Loop loop;
+    std::string errmsg;
+    if (!loop.init(errmsg)) {
+        printf("httpc_test: %s\n", errmsg.c_str());
+        return 1;
+    }
+    Collector events;
+    int64_t next_id = 0;
+    auto add = [&](const std::string& path, const std::string& file = {}, const std::string& body = {}) {
+        const int64_t id = ++next_id;
+        httpc::Request req;
+        req.id = id;
+        req.url = base + path;
+        req.file = file;
+        req.body = body;
+        req.content_type = "application/octet-stream";
+        loop.add(std::move(req), events);
+        return id;
+    };
+    auto run = [&]() {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+        while (loop.size() > 0 && std::chrono::steady_clock::now() < deadline) {
+            loop.poll(10, events);
+        }
+        return loop.size() == 0;
+    };
+
+    std::string msg;
+    check(!httpc::check_url("https://example.com/", msg) && msg == "https is not supported", "https is refused");
+    check(!httpc::check_url("ftp://example.com/", msg), "other schemes are refused");
+    check(httpc::check_url("http://[::1]:8080/a?b#c", msg), "ipv6 hosts are accepted");
+
+    // concurrent downloads to memory
+    constexpr int CONCURRENT = 48;
+    std::vector<int64_t> ids;
+    for (int i = 0; i < CONCURRENT; ++i) {
+        ids.push_back(add(i % 3 == 0 ? "/chunked" : i % 3 == 1 ? "/data" : "/close"));
+    }
+    check(loop.size() == CONCURRENT, "downloads are concurrent");
+    check(run(), "concurrent downloads finish");
+    bool all_ok = true, all_progress = true;
+    for (auto id : ids) {
+        auto& r = events.results[id];
+        all_ok = all_ok && r.code == 200 && r.content == g_data;
+        all_progress = all_progress && r.progress_count > 0 && r.last_progress == DATA_SIZE;
+    }
+    check(all_ok, "every body is complete");
+    check(all_progress, "progress reaches the body size");
+    check(events.results[ids[1]].total == DATA_SIZE, "progress total from the content length");
+    check(events.results[ids[0]].total == 0, "no progress total for chunked bodies");
+
+    // redirect and error status
+    auto redirect = add("/redirect");
+    auto missing = add("/missing", dir + "/missing.bin");
+    check(run(), "redirect and 404 finish");
+    check(events.results[redirect].code == 200 && events.results[redirect].content == g_data, "redirect is followed");
+    check(events.results[missing].code == 404, "404 is reported");
+    check(!exists(dir + "/missing.bin") && !exists(dir + "/missing.bin.part"), "an error page is not written to the file");
+
+    // a cut download keeps its part, the next download resumes it
+    const std::string file = dir + "/data.bin";
+    auto cut = add("/cut", file);
+    check(run(), "cut download finishes");
+    check(!events.results[cut].errmsg.empty(), "a cut download is an error");
+    check(!exists(file), "a cut download has no file");
+    check(read_file(file + ".part") == g_data.substr(0, DATA_SIZE / 2), "a cut download keeps its part");
+    const int ranges = server.range_requests;
+    auto resumed = add("/cut", file);
+    check(run(), "resumed download finishes");
+    auto& rr = events.results[resumed];
+    check(rr.code == 206, "resumed with a range request");
+    check(server.range_requests == ranges + 1, "the server saw one range request");
+    check(rr.first_progress >= DATA_SIZE / 2 && rr.last_progress == DATA_SIZE && rr.total == DATA_SIZE, "resumed progress counts the part");
+    check(read_file(file) == g_data && !exists(file + ".part"), "resumed file is complete");
+
+    // a part longer than the file is thrown away
+    {
+        std::ofstream f(file + ".part", std::ios::binary);
+        f << std::string(DATA_SIZE + 10, 'x');
+    }
+    auto stale = add("/data", file);
+    check(run(), "stale part download finishes");
+    check(events.results[stale].code == 200 && read_file(file) == g_data, "a stale part is downloaded again");
+
+    // a part from another file is replaced when the server ignores the range
+    {
+        std::ofstream f(file + ".part", std::ios::binary);
+        f << "stale";
+    }
+    auto ignored = add("/chunked", file);
+    check(run(), "range ignored download finishes");
+    check(events.results[ignored].code == 200 && read_file(file) == g_data, "the part is truncated on 200");
+
+    // many files at once
+    std::vector<int64_t> files;
+    for (int i = 0; i < 16; ++i) {
+        files.push_back(add("/data", dir + "/f" + std::to_string(i)));
+    }
+    check(run(), "file downloads finish");
+    bool files_ok = true;
+    for (int i = 0; i < 16; ++i) {
+        files_ok = files_ok && events.results[files[i]].code == 200 && read_file(dir + "/f" + std::to_string(i)) == g_data;
+    }
+    check(files_ok, "every file is complete");
+
+    // upload
+    auto up = add("/upload", {}, "--b\r\n" + g_data + "\r\n--b--\r\n");
+    check(run(), "upload finishes");
+    check(events.results[up].code == 201, "upload status");
+    check(events.results[up].response == "got " + std::to_string(DATA_SIZE + 14) + " data", "upload response");
+
+    // connection refused
+    httpc::Request req;
+    req.id = ++next_id;
+    req.url = "http://127.0.0.1:1/";
+    loop.add(std::move(req), events);
+    check(run(), "refused connection finishes");
+    check(!events.results[next_id].errmsg.empty(), "refused connection is an error");
+
+    // wakeup from another thread returns early
+    std::thread waker([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        loop.wakeup();
+    });
+    auto start = std::chrono::steady_clock::now();
+    loop.poll(5000, events);
+    waker.join();
+    check(std::chrono::steady_clock::now() - start < std::chrono::seconds(2), "wakeup interrupts poll");
+
+    printf("connections: %d, range requests: %d\n", server.connections.load(), server.range_requests.load());
+    server.shutdown();
+    std::string cmd = "rm -rf " + dir;
+    [[maybe_unused]] int rc = system(cmd.c_str());
+    printf(failed ? "httpc_test: %d failure(s)\n" : "httpc_test: ok\n", failed);
+    return failed ? 1 : 0;
+}
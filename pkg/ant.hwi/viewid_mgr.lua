@@ -26,10 +26,17 @@ end
 
 add_view "csm_fb"
 add_view "skinning"
+add_view "csm_static1"
+add_view "csm_static2"
+add_view "csm_static3"
+add_view "csm_static4"
 add_view "csm1"
 add_view "csm2"
 add_view "csm3"
 add_view "csm4"
+for i=1, 8 do
+	add_view("local_shadow" .. i)
+end
 add_view "evsm"
 add_view "ibl"
 add_view "pre_depth"
@@ -0,0 +1,149 @@
+local ecs   = ...
+local world = ecs.world
+local w     = world.w
+
+--pickup/native: picking by ray casts against the triangles of the meshes on the CPU, see ant.render/pick/mesh_bvh.h
+--the answer comes at once, there is no ID pass and no readback
+local mp_sys = ecs.system "mesh_pick_system"
+
+local setting   = import_package "ant.settings"
+local NATIVE<const> = setting:get "pickup/native"
+
+local imp = {}
+if not NATIVE then
+	return imp
+end
+
+local mu        = import_package "ant.math".util
+local layoutmgr = import_package "ant.render".layoutmgr
+local math3d    = require "math3d"
+
+local imesh     = ecs.require "ant.asset|mesh"
+local ivm       = ecs.require "ant.render|visible_mask"
+local queuemgr  = ecs.require "ant.render|queue_mgr"
+
+local PM        = world:clibs "pick.mesh"
+
+local INV_Z<const> = setting:get "graphic/inv_z"
+
+--mesh file: {id=, refs=}, id is false when the mesh can not be picked
+local MESHES = {}
+
+local function load_mesh(meshfile)
+	--the meshes made in code, like the .primitive ones, have no file to load
+	if not meshfile:match "%.meshbin$" then
+		log.warn(("mesh %s is not picked, it is not a meshbin"):format(meshfile))
+		return false
+	end
+	local m = imesh.load_cpu_mesh(meshfile)
+	local vb, ib = m.vb, m.ib
+	--the positions must be the floats at the beginning of a vertex
+	if not vb.declname:match "^p3%d[nN][iI]f" then
+		log.warn(("mesh %s is not picked, its positions are not floats"):format(meshfile))
+		return false
+	end
+	local stride = layoutmgr.layout_stride(vb.declname)
+	local vbstr = vb.start > 0 and vb.str:sub(vb.start * stride + 1) or vb.str
+	if ib then
+		local index32 = ib.flag == 'd'
+		local ibstr = ib.start > 0 and ib.str:sub(ib.start * (index32 and 4 or 2) + 1) or ib.str
+		return (PM.mesh(vbstr, stride, vb.num, ibstr, ib.num, index32))
+	end
+	return (PM.mesh(vbstr, stride, vb.num))
+end
+
+local function mesh_ref(meshfile)
+	local m = MESHES[meshfile]
+	if m == nil then
+		m = {id = load_mesh(meshfile), refs = 0}
+		MESHES[meshfile] = m
+	end
+	m.refs = m.refs + 1
+	return m.id
+end
+
+local function mesh_unref(meshfile)
+	local m = MESHES[meshfile]
+	if m == nil then
+		return
+	end
+	m.refs = m.refs - 1
+	if m.refs == 0 then
+		if m.id then
+			PM.mesh_release(m.id)
+		end
+		MESHES[meshfile] = nil
+	end
+end
+
+function mp_sys:init()
+	PM.init(queuemgr.queue_index "pickup_queue")
+end
+
+function mp_sys:exit()
+	PM.exit()
+end
+
+--the skinned meshes are not picked, their triangles are not where the bind pose is
+function mp_sys:entity_ready()
+	for e in w:select "filter_result mesh:in skinning:absent pick_mesh:absent eid:in" do
+		if ivm.check(e, "pickup_queue") then
+			local id = mesh_ref(e.mesh)
+			if id then
+				w:extend(e, "pick_mesh?out")
+				e.pick_mesh = {mesh = id}
+				w:submit(e)
+			else
+				mesh_unref(e.mesh)
+			end
+		end
+	end
+end
+
+function mp_sys:entity_remove()
+	for e in w:select "REMOVED pick_mesh mesh:in" do
+		mesh_unref(e.mesh)
+	end
+end
+
+local function main_view()
+	local mq = w:first "main_queue camera_ref:in render_target:in"
+	local ce <close> = world:entity(mq.camera_ref, "camera:in")
+	return mq.render_target.view_rect, ce.camera.viewprojmat
+end
+
+local function to_NDC(x, y, vr)
+	local ratio = vr.ratio
+	if ratio and ratio ~= 1 then
+		x, y = mu.cvt_size(x, ratio), mu.cvt_size(y, ratio)
+	end
+	return mu.pt2D_to_NDC({x, y}, vr)
+end
+
+--the entity under a point of the screen, with the hit point and normal in world space
+function imp.ray(x, y)
+	local vr, vp = main_view()
+	local eye, at = mu.NDC_near_far_pt(to_NDC(x, y, vr))
+	if INV_Z then
+		eye, at = at, eye
+	end
+	local ivp = math3d.inverse(vp)
+	eye = math3d.transformH(ivp, eye, 1)
+	at = math3d.transformH(ivp, at, 1)
+	local ox, oy, oz = math3d.index(eye, 1, 2, 3)
+	local dx, dy, dz = math3d.index(math3d.sub(at, eye), 1, 2, 3)
+	local eid, px, py, pz, nx, ny, nz = PM.ray(ox, oy, oz, dx, dy, dz)
+	if eid then
+		return eid, math3d.vector(px, py, pz), math3d.vector(nx, ny, nz)
+	end
+end
+
+--the entities with a triangle in a rect of the screen
+function imp.rect(x0, y0, x1, y1)
+	local vr, vp = main_view()
+	local p0, p1 = to_NDC(x0, y0, vr), to_NDC(x1, y1, vr)
+	local zmin = math3d.get_homogeneous_depth() and -1 or 0
+	return PM.rect(math3d.serialize(vp), p0[1], p0[2], p1[1], p1[2], zmin, 1)
+end
+
+return imp
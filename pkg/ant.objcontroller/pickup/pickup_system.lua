@@ -23,8 +23,11 @@ local RM		= ecs.require "ant.material|material"
 local hwi		= import_package "ant.hwi"
 
 local queuemgr  = ecs.require "ant.render|queue_mgr"
+local imp       = ecs.require "ant.objcontroller|pickup.mesh_pick"
 
 local INV_Z<const> = setting:get "graphic/inv_z"
+--pickup/native: ray casts on the CPU instead of the ID pass, see mesh_pick.lua
+local NATIVE<const> = setting:get "pickup/native"
 
 local function packeid_as_rgba(eid)
     return {(eid & 0x000000ff) / 0xff,
@@ -233,6 +236,9 @@ local function which_material(e)
 end
 
 function pickup_sys:init()
+	if NATIVE then
+		return
+	end
 	create_pick_entity()
 
 	FEATURE_MATERIALS[featureset.flag ""] 				= assetmgr.resource '/pkg/ant.objcontroller/pickup/assets/pickup_opacity.material'
@@ -331,6 +337,9 @@ local function create_pickup_state(srcstate, dststate)
 end
 
 function pickup_sys:entity_ready()
+	if NATIVE then
+		return
+	end
 	for e in w:select "filter_result render_object:update filter_material:in eid:in" do
 		if ivm.check(e, "pickup_queue") then
 			local ro = e.render_object
@@ -352,6 +361,18 @@ end
 
 local ipu = {}
 function ipu.pick(x, y, cb)
+	if NATIVE then
+		local eid = imp.ray(x, y)
+		if not eid then
+			log.info("not found any eid")
+		end
+		world:pub {"pickup", eid, x, y}
+		return
+	end
 	open_pickup(x, y, cb)
 end
+
+--with pickup/native only, the answer of a point and of a rect of the screen in the same frame
+ipu.ray		= imp.ray
+ipu.rect	= imp.rect
 return ipu
@@ -96,6 +96,9 @@ local SYS_ATTRIBS = {
 	u_tetra_normal_Red		= uniform_value(ZERO),
 
 	--s_omni_shadowmap	= texture_value(9),
+	--   point and spot lights, see local_shadow_system.lua
+	b_local_shadow		= buffer_value(14, "r"),
+	s_local_shadowmap	= texture_value(15, "SAMPLER2D"),
 
 	s_ssao				= texture_value(9, "SAMPLER2D"),
 	--postprocess
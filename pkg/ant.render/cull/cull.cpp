@@ -8,6 +8,7 @@ extern "C"{
 }
 
 #include "../render/queue.h"
+#include "occlusion.h"
 
 #include <cassert>
 #include <cstring>
@@ -23,6 +24,7 @@ using cull_infos = std::unordered_map<uint64_t, tags>;
 struct cullqueue_info{
 	math_t	mid;
 	int 	Qidx;
+	bool	occlusion;
 };
 
 struct cullqueue_cache {
@@ -48,6 +50,7 @@ struct cullqueue_cache {
 		struct cullqueue_info& q = cq[count++];
 		q.mid = mid;
 		q.Qidx = queue_alloc(w->Q);
+		q.occlusion = false;
 
 		return q;
 	}
@@ -58,35 +61,83 @@ struct cullqueue_cache {
 		}
 	}
 
-	void add_queue(math_t mid, uint8_t queue_index){
+	void add_queue(math_t mid, uint8_t queue_index, bool occlusion){
 		struct cullqueue_info& q = find_cullqueue(mid);
 		queue_set(w->Q, q.Qidx, queue_index, true);
+		q.occlusion = q.occlusion || occlusion;
 	}
 };
 
+struct occluder_mesh {
+	std::vector<float>		positions;
+	std::vector<uint32_t>	indices;
+};
+
 struct cull_cached {
-	cull_cached(struct ecs_context* ctx) : render_obj(ctx), hitch_obj(ctx){}
+	cull_cached(struct ecs_context* ctx) : render_obj(ctx), hitch_obj(ctx), occluder_obj(ctx){}
 	ecs::cached_context<component::render_object_visible, component::render_object, component::visible, component::bounding> render_obj;
 	ecs::cached_context<component::hitch_visible, component::hitch, component::visible, component::bounding> hitch_obj;
+	ecs::cached_context<component::occluder, component::visible, component::bounding, component::scene> occluder_obj;
+
+	// occluder.mesh is an index + 1 of meshes, 0 means the bounding box is the occluder
+	std::vector<occluder_mesh> meshes;
+	std::vector<int> free_meshes;
+	occlusion_buffer occlusion;
 }; 
 
 template<typename ObjType>
 struct cull_operation{
 	template<typename EntityType>
-	static void cull(struct ecs_world*w, EntityType &e, struct cullqueue_cache *cc){
+	static void cull(struct ecs_world*w, EntityType &e, struct cullqueue_cache *cc, const occlusion_buffer *ob){
 		const auto &b = e.template get<component::bounding>();
 
 		if (!math_isnull(b.scene_aabb)){
 			auto &o = e.template get<ObjType>();
+			int occluded = -1;	// tested once, for the first queue that needs it
 			for (uint8_t ii=0; ii<cc->count; ++ii){
 				struct cullqueue_info& q = cc->cq[ii];
-				const bool isculled = math3d_frustum_intersect_aabb(w->math3d->M, q.mid, b.scene_aabb) < 0;
+				bool isculled = math3d_frustum_intersect_aabb(w->math3d->M, q.mid, b.scene_aabb) < 0;
+				if (!isculled && q.occlusion && ob){
+					if (occluded < 0){
+						const float *aabb = math_value(w->math3d->M, b.scene_aabb);
+						occluded = ob->occluded(aabb, aabb+4);
+					}
+					isculled = occluded;
+				}
 				queue_set_by_index(w->Q, o.cull_idx, q.Qidx, isculled);
 			}
 		}
 	}
 };
 
+static const occlusion_buffer*
+draw_occluders(struct ecs_world *w, math_t viewprojmat){
+	auto M = w->math3d->M;
+	auto cc = w->cull_cached;
+	// begin() clears the whole buffer, not worth it for a scene without occluders
+	if (ecs::count<component::occluder>(w->ecs) == 0){
+		return nullptr;
+	}
+	occlusion_buffer &ob = cc->occlusion;
+	ob.begin(math_value(M, viewprojmat));
+	for (auto& e : ecs::cached_select(cc->occluder_obj)) {
+		const auto &o = e.get<component::occluder>();
+		if (o.mesh == 0){
+			const auto &b = e.get<component::bounding>();
+			if (!math_isnull(b.scene_aabb)){
+				const float *aabb = math_value(M, b.scene_aabb);
+				ob.draw_box(aabb, aabb+4);
+			}
+		} else {
+			const auto &m = cc->meshes[o.mesh-1];
+			const auto &s = e.get<component::scene>();
+			const float *wm = math_isnull(s.worldmat) ? nullptr : math_value(M, s.worldmat);
+			ob.draw_triangles(m.positions.data(), sizeof(float) * 3, m.indices.data(), (uint32_t)m.indices.size(), wm);
+		}
+	}
+	return ob.empty() ? nullptr : &ob;
+}
+
 static int
 linit(lua_State *L) {
 	auto w = getworld(L);
@@ -107,22 +158,78 @@ lcull(lua_State *L) {
 
 	cullqueue_cache cqc(w);
 
+	const occlusion_buffer *ob = nullptr;
+	bool occluders_drawn = false;
 	for (auto& i : ecs::array<component::cull_args>(w->ecs)){
-		cqc.add_queue(i.frustum_planes, i.queue_index);
+		cqc.add_queue(i.frustum_planes, i.queue_index, i.occlusion != 0);
+		if (i.occlusion && !occluders_drawn){
+			ob = draw_occluders(w, i.viewprojmat);
+			occluders_drawn = true;
+		}
 	}
 
 	if (!cqc.empty()){
 		for (auto e : ecs::cached_select(w->cull_cached->render_obj)) {
-			cull_operation<component::render_object>::cull(w, e, &cqc);
+			cull_operation<component::render_object>::cull(w, e, &cqc, ob);
 		}
 
 		for (auto& e : ecs::cached_select(w->cull_cached->hitch_obj)) {
-			cull_operation<component::hitch>::cull(w, e, &cqc);
+			cull_operation<component::hitch>::cull(w, e, &cqc, ob);
 		}
 	}
 	return 0;
 }
 
+// occluder_mesh({x, y, z, ...}, {i0, i1, i2, ...}) returns the id for occluder.mesh
+static int
+loccluder_mesh(lua_State *L) {
+	auto w = getworld(L);
+	luaL_checktype(L, 1, LUA_TTABLE);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	occluder_mesh m;
+	const lua_Integer nv = luaL_len(L, 1);
+	luaL_argcheck(L, nv > 0 && nv % 3 == 0, 1, "need x, y, z of each vertex");
+	m.positions.resize((size_t)nv);
+	for (lua_Integer i = 0; i < nv; ++i) {
+		lua_geti(L, 1, i+1);
+		m.positions[i] = (float)luaL_checknumber(L, -1);
+		lua_pop(L, 1);
+	}
+	const lua_Integer ni = luaL_len(L, 2);
+	luaL_argcheck(L, ni > 0 && ni % 3 == 0, 2, "need triangle list indices");
+	m.indices.resize((size_t)ni);
+	for (lua_Integer i = 0; i < ni; ++i) {
+		lua_geti(L, 2, i+1);
+		const lua_Integer v = luaL_checkinteger(L, -1);
+		luaL_argcheck(L, v >= 0 && v < nv / 3, 2, "index out of range");
+		m.indices[i] = (uint32_t)v;
+		lua_pop(L, 1);
+	}
+	auto cc = w->cull_cached;
+	int idx;
+	if (cc->free_meshes.empty()) {
+		idx = (int)cc->meshes.size();
+		cc->meshes.emplace_back(std::move(m));
+	} else {
+		idx = cc->free_meshes.back();
+		cc->free_meshes.pop_back();
+		cc->meshes[idx] = std::move(m);
+	}
+	lua_pushinteger(L, idx + 1);
+	return 1;
+}
+
+static int
+loccluder_mesh_release(lua_State *L) {
+	auto w = getworld(L);
+	auto cc = w->cull_cached;
+	const lua_Integer id = luaL_checkinteger(L, 1);
+	luaL_argcheck(L, id > 0 && id <= (lua_Integer)cc->meshes.size(), 1, "invalid occluder mesh");
+	cc->meshes[id-1] = occluder_mesh{};
+	cc->free_meshes.push_back((int)id-1);
+	return 0;
+}
+
 extern "C" int
 luaopen_system_cull(lua_State *L) {
 	luaL_checkversion(L);
@@ -130,6 +237,8 @@ luaopen_system_cull(lua_State *L) {
 		{ "init", linit },
 		{ "exit", lexit },
 		{ "cull", lcull },
+		{ "occluder_mesh", loccluder_mesh },
+		{ "occluder_mesh_release", loccluder_mesh_release },
 		{ NULL, NULL },
 	};
 	luaL_newlibtable(L,l);
@@ -6,6 +6,7 @@ local math3d				= require "math3d"
 local queuemgr				= ecs.require "queue_mgr"
 local setting				= import_package "ant.settings"
 local disable_cull<const>	= setting:get "graphic/disable_cull"
+local occlusion_cull<const>	= setting:get "graphic/occlusion_cull"
 
 local cullcore = world:clibs "cull.core"
 
@@ -13,6 +14,8 @@ local CULL_ARGS = setmetatable({}, {__index = function (t, k)
 	local v = {
 		queue_index		= queuemgr.queue_index(k),
 		frustum_planes	= nil,
+		viewprojmat		= nil,
+		occlusion		= 0,
 	}
 	t[k] = v
 	return v
@@ -26,10 +29,15 @@ cull_sys.exit = cullcore.exit
 
 local function build_cull_args()
 	w:clear "cull_args"
-	for qe in w:select "visible queue_name:in camera_ref:in cull_args:new" do
+	-- the queues see through the main camera, like pre_depth_queue, are occlusion culled too
+	local mq = occlusion_cull and w:first "main_queue camera_ref:in"
+	local occlusion_camera = mq and mq.camera_ref
+	for qe in w:select "visible cull_external:absent queue_name:in camera_ref:in cull_args:new" do
 		local ce <close> = world:entity(qe.camera_ref, "camera:in")
 		local ca = CULL_ARGS[qe.queue_name]
 		ca.frustum_planes = math3d.frustum_planes(ce.camera.viewprojmat)
+		ca.viewprojmat = ce.camera.viewprojmat
+		ca.occlusion = qe.camera_ref == occlusion_camera and 1 or 0
 		qe.cull_args = ca
 	end
 end
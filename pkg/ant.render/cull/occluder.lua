@@ -0,0 +1,22 @@
+local ecs = ...
+local world = ecs.world
+
+local cullcore = world:clibs "cull.core"
+
+-- occluder = true: the bounding box of the entity is solid.
+-- occluder = { vertices = {x, y, z, ...}, indices = {...} }: object space triangles, they must stay
+-- inside the visible surface of the entity, or they hide what is visible through it.
+local m = ecs.component "occluder"
+
+function m.init(v)
+    if type(v) ~= "table" then
+        return { mesh = 0 }
+    end
+    return { mesh = cullcore.occluder_mesh(v.vertices, v.indices) }
+end
+
+function m.remove(v)
+    if v.mesh ~= 0 then
+        cullcore.occluder_mesh_release(v.mesh)
+    end
+end
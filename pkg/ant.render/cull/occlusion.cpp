@@ -0,0 +1,214 @@
+#include "occlusion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    constexpr float NEAR_W = 1e-3f;
+
+    struct clip_vertex {
+        float x, y, w;
+    };
+
+    struct screen_vertex {
+        float x, y, iw;
+    };
+
+    inline void
+    mul_matrix(float r[16], const float a[16], const float b[16]) {
+        for (int c = 0; c < 4; ++c) {
+            for (int i = 0; i < 4; ++i) {
+                r[c * 4 + i] = a[i] * b[c * 4] + a[4 + i] * b[c * 4 + 1] + a[8 + i] * b[c * 4 + 2] + a[12 + i] * b[c * 4 + 3];
+            }
+        }
+    }
+
+    inline clip_vertex
+    transform(const float m[16], const float* p) {
+        return {
+            m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12],
+            m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13],
+            m[3] * p[0] + m[7] * p[1] + m[11] * p[2] + m[15],
+        };
+    }
+
+    inline screen_vertex
+    to_screen(const clip_vertex& v) {
+        const float iw = 1.f / v.w;
+        return {
+            (v.x * iw * 0.5f + 0.5f) * occlusion_buffer::WIDTH,
+            (v.y * iw * 0.5f + 0.5f) * occlusion_buffer::HEIGHT,
+            iw,
+        };
+    }
+
+    void
+    raster(float* depth, screen_vertex a, screen_vertex b, screen_vertex c) {
+        float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (!(std::fabs(area) > 1e-8f)) {
+            return;
+        }
+        if (area < 0.f) {
+            std::swap(b, c);
+            area = -area;
+        }
+        const int x0 = std::max(0, (int)std::floor(std::min({ a.x, b.x, c.x })));
+        const int x1 = std::min(occlusion_buffer::WIDTH - 1, (int)std::ceil(std::max({ a.x, b.x, c.x })));
+        const int y0 = std::max(0, (int)std::floor(std::min({ a.y, b.y, c.y })));
+        const int y1 = std::min(occlusion_buffer::HEIGHT - 1, (int)std::ceil(std::max({ a.y, b.y, c.y })));
+        if (x0 > x1 || y0 > y1) {
+            return;
+        }
+
+        // edge functions, positive inside; e_bc is the barycentric weight of a times area
+        auto edge = [](const screen_vertex& p, const screen_vertex& q, float x, float y) {
+            return (q.x - p.x) * (y - p.y) - (q.y - p.y) * (x - p.x);
+        };
+        const float dx_bc = -(c.y - b.y), dx_ca = -(a.y - c.y), dx_ab = -(b.y - a.y);
+        const float inv_area = 1.f / area;
+        const float ddx = (dx_bc * a.iw + dx_ca * b.iw + dx_ab * c.iw) * inv_area;
+        const float ddy = ((c.x - b.x) * a.iw + (a.x - c.x) * b.iw + (b.x - a.x) * c.iw) * inv_area;
+        // the farthest depth the triangle may have inside a pixel
+        const float slack = 0.5f * (std::fabs(ddx) + std::fabs(ddy));
+        const float dmin = std::min({ a.iw, b.iw, c.iw });
+
+        const float fx0 = x0 + 0.5f;
+        for (int y = y0; y <= y1; ++y) {
+            const float fy = y + 0.5f;
+            const float e_bc = edge(b, c, fx0, fy);
+            const float e_ca = edge(c, a, fx0, fy);
+            const float e_ab = edge(a, b, fx0, fy);
+            const float d0 = (e_bc * a.iw + e_ca * b.iw + e_ab * c.iw) * inv_area - slack;
+            float* row = depth + y * occlusion_buffer::WIDTH;
+            // branchless, the compiler turns it into SIMD
+            for (int x = x0; x <= x1; ++x) {
+                const float fx = float(x - x0);
+                const bool inside = (e_bc + dx_bc * fx >= 0.f) & (e_ca + dx_ca * fx >= 0.f) & (e_ab + dx_ab * fx >= 0.f);
+                const float d = std::max(dmin, d0 + ddx * fx);
+                row[x] = (inside & (d > row[x])) ? d : row[x];
+            }
+        }
+    }
+
+    // clips a triangle to w >= NEAR_W, the result has up to 4 vertices
+    int
+    clip_near(const clip_vertex in[3], clip_vertex out[4]) {
+        int n = 0;
+        for (int i = 0; i < 3; ++i) {
+            const clip_vertex& p = in[i];
+            const clip_vertex& q = in[(i + 1) % 3];
+            const bool pin = p.w >= NEAR_W, qin = q.w >= NEAR_W;
+            if (pin) {
+                out[n++] = p;
+            }
+            if (pin != qin) {
+                const float t = (NEAR_W - p.w) / (q.w - p.w);
+                out[n++] = { p.x + (q.x - p.x) * t, p.y + (q.y - p.y) * t, NEAR_W };
+            }
+        }
+        return n;
+    }
+}
+
+void
+occlusion_buffer::begin(const float vp[16]) {
+    memcpy(viewproj, vp, sizeof(viewproj));
+    memset(depth, 0, sizeof(depth));
+    triangles = 0;
+    // w is constant for an orthographic projection
+    enable = vp[3] != 0.f || vp[7] != 0.f || vp[11] != 0.f;
+}
+
+void
+occlusion_buffer::draw_triangles(const float* positions, uint32_t stride, const uint32_t* indices, uint32_t index_count, const float* worldmat) {
+    if (!enable) {
+        return;
+    }
+    float m[16];
+    if (worldmat) {
+        mul_matrix(m, viewproj, worldmat);
+    } else {
+        memcpy(m, viewproj, sizeof(m));
+    }
+    auto vertex = [&](uint32_t i) {
+        return transform(m, (const float*)((const uint8_t*)positions + i * stride));
+    };
+    for (uint32_t i = 0; i + 2 < index_count; i += 3) {
+        const clip_vertex tri[3] = { vertex(indices[i]), vertex(indices[i + 1]), vertex(indices[i + 2]) };
+        clip_vertex poly[4];
+        const int n = clip_near(tri, poly);
+        for (int j = 1; j + 1 < n; ++j) {
+            raster(depth, to_screen(poly[0]), to_screen(poly[j]), to_screen(poly[j + 1]));
+        }
+        triangles += n >= 3;
+    }
+}
+
+void
+occlusion_buffer::draw_box(const float minv[3], const float maxv[3]) {
+    float corners[8][3];
+    for (int i = 0; i < 8; ++i) {
+        corners[i][0] = (i & 1) ? maxv[0] : minv[0];
+        corners[i][1] = (i & 2) ? maxv[1] : minv[1];
+        corners[i][2] = (i & 4) ? maxv[2] : minv[2];
+    }
+    static const uint32_t indices[36] = {
+        0, 2, 1, 1, 2, 3,   // -z
+        4, 5, 6, 5, 7, 6,   // +z
+        0, 1, 4, 1, 5, 4,   // -y
+        2, 6, 3, 3, 6, 7,   // +y
+        0, 4, 2, 2, 4, 6,   // -x
+        1, 3, 5, 3, 7, 5,   // +x
+    };
+    draw_triangles(&corners[0][0], sizeof(corners[0]), indices, 36, nullptr);
+}
+
+bool
+occlusion_buffer::occluded(const float minv[3], const float maxv[3]) const {
+    if (!enable || triangles == 0) {
+        return false;
+    }
+    float minx = INFINITY, miny = INFINITY, maxx = -INFINITY, maxy = -INFINITY, nearest = 0.f;
+    for (int i = 0; i < 8; ++i) {
+        const float p[3] = {
+            (i & 1) ? maxv[0] : minv[0],
+            (i & 2) ? maxv[1] : minv[1],
+            (i & 4) ? maxv[2] : minv[2],
+        };
+        const clip_vertex c = transform(viewproj, p);
+        if (c.w < NEAR_W) {
+            return false;       // crosses the camera plane
+        }
+        const screen_vertex s = to_screen(c);
+        minx = std::min(minx, s.x);
+        maxx = std::max(maxx, s.x);
+        miny = std::min(miny, s.y);
+        maxy = std::max(maxy, s.y);
+        nearest = std::max(nearest, s.iw);
+    }
+    int x0 = (int)std::floor(minx);
+    int x1 = std::max(x0, (int)std::ceil(maxx) - 1);
+    int y0 = (int)std::floor(miny);
+    int y1 = std::max(y0, (int)std::ceil(maxy) - 1);
+    if (x1 < 0 || x0 >= WIDTH || y1 < 0 || y0 >= HEIGHT) {
+        return false;           // off screen, left to the frustum test
+    }
+    // occluders are sampled at pixel centres, a pixel on a silhouette is filled even if the AABB
+    // passes beside the occluder in it; the pixel next to it, outward, is empty then
+    x0 = std::max(0, x0 - 1);
+    x1 = std::min(WIDTH - 1, x1 + 1);
+    y0 = std::max(0, y0 - 1);
+    y1 = std::min(HEIGHT - 1, y1 + 1);
+    for (int y = y0; y <= y1; ++y) {
+        const float* row = depth + y * WIDTH;
+        bool visible = false;
+        for (int x = x0; x <= x1; ++x) {
+            visible |= row[x] <= nearest;
+        }
+        if (visible) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+// CPU occlusion culling. Occluders are rasterized into a small depth buffer, then the screen
+// space bounds of an AABB is tested against it. Depth is 1/w, interpolates linearly on screen and
+// does not depend on the projection conventions (inv_z, infinite far), bigger is nearer.
+// Both sides are conservative: an occluder writes the farthest depth it may have in a pixel,
+// an AABB takes the nearest depth of its corners, and is occluded only if every pixel it touches
+// and the pixels around them hold something nearer, as occluders cover the pixels by their centres.
+// Orthographic projections are not supported, the buffer stays empty.
+struct occlusion_buffer {
+    static constexpr int WIDTH = 256;       // a multiple of 8, rows are processed in SIMD width
+    static constexpr int HEIGHT = 144;
+
+    float viewproj[16];                     // column major
+    float depth[WIDTH * HEIGHT];
+    uint32_t triangles;
+    bool enable;
+
+    void begin(const float vp[16]);
+    // world space triangles, worldmat (column major) may be null
+    void draw_triangles(const float* positions, uint32_t stride, const uint32_t* indices, uint32_t index_count, const float* worldmat);
+    void draw_box(const float minv[3], const float maxv[3]);
+    bool occluded(const float minv[3], const float maxv[3]) const;
+    bool empty() const {
+        return triangles == 0;
+    }
+};
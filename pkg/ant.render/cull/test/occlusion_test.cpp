@@ -0,0 +1,106 @@
+// A wall in front of the camera and a grid of boxes behind it, every box fully behind the wall
+// is occluded, the others are not.
+#include "../occlusion.h"
+
+#include <cmath>
+#include <cstdio>
+
+static occlusion_buffer buffer;
+
+// left handed perspective looking along +z, column major
+static void perspective(float m[16], float fovy, float aspect, float n) {
+    const float f = 1.f / std::tan(fovy * 0.5f);
+    for (int i = 0; i < 16; ++i) {
+        m[i] = 0.f;
+    }
+    m[0] = f / aspect;
+    m[5] = f;
+    m[10] = 1.f;
+    m[11] = 1.f;
+    m[14] = -n;
+}
+
+int main() {
+    int failed = 0;
+    auto check = [&](bool ok, const char* what) {
+        if (!ok) {
+            printf("FAILED: %s\n", what);
+            failed++;
+        }
+    };
+    auto box_occluded = [&](float x, float y, float z, float half) {
+        const float minv[3] = { x - half, y - half, z - half };
+        const float maxv[3] = { x + half, y + half, z + half };
+        return buffer.occluded(minv, maxv);
+    };
+
+    float vp[16];
+    perspective(vp, 3.14159265f / 3.f, 16.f / 9.f, 0.1f);
+    buffer.begin(vp);
+    check(!box_occluded(0, 0, 40, 0.5f), "nothing is occluded without occluders");
+
+    const float wall_min[3] = { -10, -5, 20 };
+    const float wall_max[3] = { 10, 5, 21 };
+    buffer.draw_box(wall_min, wall_max);
+    check(!buffer.empty(), "the wall is drawn");
+    check(!buffer.occluded(wall_min, wall_max), "an occluder never hides itself");
+
+    // a 9x5 grid of boxes at z = 40. Seen from the camera the wall covers |x/z| < 0.5, |y/z| < 0.25,
+    // a box is behind it when its outermost corner, on its near face at z = 39, is inside.
+    int occluded = 0, visible = 0, wrong = 0;
+    for (int iy = -2; iy <= 2; ++iy) {
+        for (int ix = -4; ix <= 4; ++ix) {
+            const float x = ix * 8.f, y = iy * 4.f;
+            const bool behind = (std::fabs(x) + 1.f) / 39.f < 0.5f && (std::fabs(y) + 1.f) / 39.f < 0.25f;
+            const bool result = box_occluded(x, y, 40.f, 1.f);
+            occluded += result;
+            visible += !result;
+            if (behind != result) {
+                printf("box (%g, %g): %s\n", x, y, result ? "occluded" : "visible");
+                wrong++;
+            }
+        }
+    }
+    printf("grid: %d occluded, %d visible\n", occluded, visible);
+    check(wrong == 0, "boxes behind the wall are occluded, the others are not");
+    check(occluded == 25, "25 boxes are fully behind the wall");
+
+    check(!box_occluded(19.f, 0, 40, 1.f), "a box partly outside the wall silhouette");
+    check(box_occluded(18.f, 0, 40, 1.f), "a box just inside the wall silhouette");
+    check(!box_occluded(0, 0, 10, 1.f), "a box in front of the wall");
+
+    // the edge of a wall and a thin box beside it, both in the same pixel column
+    buffer.begin(vp);
+    const float edge_min[3] = { -10, -5, 20 };
+    const float edge_max[3] = { 10.06f, 5, 21 };
+    buffer.draw_box(edge_min, edge_max);
+    const float beside_min[3] = { 20.14f, -0.5f, 40 };
+    const float beside_max[3] = { 20.19f, 0.5f, 40 };
+    check(!buffer.occluded(beside_min, beside_max), "a box beside the wall edge within a pixel");
+    buffer.begin(vp);
+    buffer.draw_box(wall_min, wall_max);
+    check(!box_occluded(0, 0, 0.05f, 1.f), "a box around the camera");
+    check(!box_occluded(0, 0, -30, 1.f), "a box behind the camera");
+    check(box_occluded(0, 0, 1000, 50.f), "a large box far away");
+
+    // the same wall as triangles with a world matrix, crossing the camera plane
+    buffer.begin(vp);
+    const float quad[4][3] = { { -1, -1, 0 }, { 1, -1, 0 }, { 1, 1, 0 }, { -1, 1, 0 } };
+    const uint32_t indices[6] = { 0, 1, 2, 0, 2, 3 };
+    const float wm[16] = { 10, 0, 0, 0, 0, 5, 0, 0, 0, 0, 1, 0, 0, 0, 20, 1 };
+    buffer.draw_triangles(&quad[0][0], sizeof(quad[0]), indices, 6, wm);
+    check(box_occluded(0, 0, 40, 1.f), "the quad hides a box behind it");
+    check(!box_occluded(0, 0, 19, 0.5f), "the quad does not hide a box in front of it");
+    const float floor_quad[4][3] = { { -100, -2, -50 }, { 100, -2, -50 }, { 100, -2, 500 }, { -100, -2, 500 } };
+    buffer.draw_triangles(&floor_quad[0][0], sizeof(floor_quad[0]), indices, 6, nullptr);
+    check(box_occluded(0, -6, 100, 1.f), "a box under the floor crossing the camera plane");
+    check(!box_occluded(60, 0, 100, 1.f), "a box above the floor, beside the quad");
+
+    float ortho[16] = { 0.1f, 0, 0, 0, 0, 0.1f, 0, 0, 0, 0, 0.01f, 0, 0, 0, 0, 1 };
+    buffer.begin(ortho);
+    buffer.draw_box(wall_min, wall_max);
+    check(!box_occluded(0, 0, 40, 1.f), "orthographic projections are not culled");
+
+    printf(failed ? "render_occlusion_test: %d failure(s)\n" : "render_occlusion_test: ok\n", failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+#include "ecs/world.h"
+#include "ecs/jobs.h"
+
+#include "light_binning.h"
+
+#include <cstring>
+#include <vector>
+
+struct cluster_light {
+	cluster_light(uint32_t x, uint32_t y, uint32_t z, uint32_t max_light) : binning(x, y, z, max_light) {}
+	light_binning binning;
+	std::vector<cluster_light_info> lights;
+};
+
+static inline light_binning*
+get_binning(lua_State *L, struct ecs_world *w) {
+	if (w->cluster_light == nullptr) {
+		luaL_error(L, "light.cluster is not initialized");
+	}
+	return &w->cluster_light->binning;
+}
+
+static void
+check_matrix(lua_State *L, int idx, float m[16]) {
+	size_t sz;
+	const char *s = luaL_checklstring(L, idx, &sz);
+	luaL_argcheck(L, sz == sizeof(float) * 16, idx, "need a serialized matrix");
+	memcpy(m, s, sizeof(float) * 16);
+}
+
+// init(x, y, z, max_light)
+static int
+linit(lua_State *L) {
+	auto w = getworld(L);
+	const lua_Integer x = luaL_checkinteger(L, 1);
+	const lua_Integer y = luaL_checkinteger(L, 2);
+	const lua_Integer z = luaL_checkinteger(L, 3);
+	const lua_Integer max_light = luaL_checkinteger(L, 4);
+	luaL_argcheck(L, x > 0 && y > 0 && z > 0 && x * y * z <= 0x100000, 1, "invalid cluster size");
+	luaL_argcheck(L, max_light > 0, 4, "invalid max light");
+	w->cluster_light = new struct cluster_light((uint32_t)x, (uint32_t)y, (uint32_t)z, (uint32_t)max_light);
+	return 0;
+}
+
+static int
+lexit(lua_State *L) {
+	auto w = getworld(L);
+	delete w->cluster_light;
+	w->cluster_light = nullptr;
+	return 0;
+}
+
+// build(math3d.serialize(inverse(projmat)), near, far, homogeneous_depth, origin_bottom_left)
+static int
+lbuild(lua_State *L) {
+	auto w = getworld(L);
+	auto b = get_binning(L, w);
+	float invproj[16];
+	check_matrix(L, 1, invproj);
+	const float n = (float)luaL_checknumber(L, 2);
+	const float f = (float)luaL_checknumber(L, 3);
+	luaL_argcheck(L, 0.f < n && n < f, 2, "invalid near and far");
+	b->build(invproj, n, f, lua_toboolean(L, 4), lua_toboolean(L, 5));
+	return 0;
+}
+
+// assign(math3d.serialize(viewmat), lights, first) : grids, grids_size, indices, indices_size
+// lights is the content of the light buffer, see light.lua, the lights from first (0 based) are assigned.
+// The pointers are valid until the next assign, for bgfx.memory_buffer.
+static int
+lassign(lua_State *L) {
+	auto w = getworld(L);
+	auto b = get_binning(L, w);
+	float view[16];
+	check_matrix(L, 1, view);
+	size_t sz;
+	const char *lights = luaL_checklstring(L, 2, &sz);
+	luaL_argcheck(L, sz % sizeof(cluster_light_info) == 0, 2, "invalid light buffer");
+	const uint32_t num = (uint32_t)(sz / sizeof(cluster_light_info));
+	const lua_Integer first = luaL_checkinteger(L, 3);
+	luaL_argcheck(L, 0 <= first && first <= num, 3, "invalid first light");
+
+	// the light buffer is a string, it may not be aligned for the floats
+	static_assert(sizeof(cluster_light_info) == sizeof(float) * 16);
+	auto& info = w->cluster_light->lights;
+	info.resize(num);
+	if (num > 0) {
+		memcpy(info.data(), lights, sz);
+	}
+	b->begin(view, info.data(), (uint32_t)first, num);
+	if (w->jobs) {
+		w->jobs->parallel_for(b->slice_num(), [b](size_t slice, unsigned) {
+			b->bin((uint32_t)slice);
+		});
+	} else {
+		for (uint32_t z = 0; z < b->slice_num(); ++z) {
+			b->bin(z);
+		}
+	}
+	const uint32_t n = b->compact();
+	lua_pushlightuserdata(L, (void*)b->grids());
+	lua_pushinteger(L, b->cluster_num() * 2 * sizeof(uint32_t));
+	lua_pushlightuserdata(L, (void*)b->indices());
+	lua_pushinteger(L, n * sizeof(uint32_t));
+	return 4;
+}
+
+extern "C" int
+luaopen_light_cluster(lua_State *L) {
+	luaL_checkversion(L);
+	luaL_Reg l[] = {
+		{ "init", linit },
+		{ "exit", lexit },
+		{ "build", lbuild },
+		{ "assign", lassign },
+		{ NULL, NULL },
+	};
+	luaL_newlibtable(L,l);
+	lua_pushnil(L);
+	luaL_setfuncs(L,l,1);
+	return 1;
+}
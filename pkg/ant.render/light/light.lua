@@ -277,11 +277,15 @@ local function create_light_buffers()
 end
 
 local light_buffer = bgfx.create_dynamic_vertex_buffer(1, layoutmgr.get "t40".handle, "ra")
+local light_data, light_first, light_version = "", 0, 0
 
 local function update_light_buffers()
 	local lights, culledlightcount = create_light_buffers()
+	light_data = table.concat(lights, "")
+	light_first = #lights - culledlightcount
+	light_version = light_version + 1
 	if #lights ~= 0 then
-		bgfx.update(light_buffer, 0, bgfx.memory_buffer(table.concat(lights, "")))
+		bgfx.update(light_buffer, 0, bgfx.memory_buffer(light_data))
 	end
 	imaterial.system_attrib_update("u_light_count", math3d.vector(#lights, culledlightcount, CLUSTER_MAX_LIGHT_COUNT, 0))
 end
@@ -290,6 +294,12 @@ function ilight.light_buffer()
 	return light_buffer
 end
 
+--the content of the light buffer, the lights from first (0 based) are culled by the cluster shading
+--version changes with the content
+function ilight.light_data()
+	return light_data, light_first, light_version
+end
+
 local lightsys = ecs.system "light_system"
 
 function lightsys:component_init()
@@ -0,0 +1,298 @@
+#include "light_binning.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if !defined(LIGHT_BINNING_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#	include <emmintrin.h>
+#	define LIGHT_BINNING_SSE2 1
+#elif !defined(LIGHT_BINNING_SCALAR) && (defined(__aarch64__) || defined(_M_ARM64))
+#	include <arm_neon.h>
+#	define LIGHT_BINNING_NEON 1
+#endif
+
+namespace {
+	// 4 lanes, the operations are the same as the scalar ones, so the results are the same
+#if defined(LIGHT_BINNING_SSE2)
+	struct f4 { __m128 v; };
+	struct m4 { __m128 v; };
+	inline f4 load(const float* p) { return { _mm_loadu_ps(p) }; }
+	inline f4 splat(float f) { return { _mm_set1_ps(f) }; }
+	inline f4 operator+(f4 a, f4 b) { return { _mm_add_ps(a.v, b.v) }; }
+	inline f4 operator-(f4 a, f4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+	inline f4 operator*(f4 a, f4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+	inline f4 operator/(f4 a, f4 b) { return { _mm_div_ps(a.v, b.v) }; }
+	inline f4 vmin(f4 a, f4 b) { return { _mm_min_ps(a.v, b.v) }; }
+	inline f4 vmax(f4 a, f4 b) { return { _mm_max_ps(a.v, b.v) }; }
+	inline f4 vsqrt(f4 a) { return { _mm_sqrt_ps(a.v) }; }
+	inline m4 le(f4 a, f4 b) { return { _mm_cmple_ps(a.v, b.v) }; }
+	inline m4 gt(f4 a, f4 b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+	inline f4 select(m4 m, f4 a, f4 b) { return { _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)) }; }
+	inline uint32_t bits(m4 m) { return (uint32_t)_mm_movemask_ps(m.v); }
+#elif defined(LIGHT_BINNING_NEON)
+	struct f4 { float32x4_t v; };
+	struct m4 { uint32x4_t v; };
+	inline f4 load(const float* p) { return { vld1q_f32(p) }; }
+	inline f4 splat(float f) { return { vdupq_n_f32(f) }; }
+	inline f4 operator+(f4 a, f4 b) { return { vaddq_f32(a.v, b.v) }; }
+	inline f4 operator-(f4 a, f4 b) { return { vsubq_f32(a.v, b.v) }; }
+	inline f4 operator*(f4 a, f4 b) { return { vmulq_f32(a.v, b.v) }; }
+	inline f4 operator/(f4 a, f4 b) { return { vdivq_f32(a.v, b.v) }; }
+	inline f4 vmin(f4 a, f4 b) { return { vminq_f32(a.v, b.v) }; }
+	inline f4 vmax(f4 a, f4 b) { return { vmaxq_f32(a.v, b.v) }; }
+	inline f4 vsqrt(f4 a) { return { vsqrtq_f32(a.v) }; }
+	inline m4 le(f4 a, f4 b) { return { vcleq_f32(a.v, b.v) }; }
+	inline m4 gt(f4 a, f4 b) { return { vcgtq_f32(a.v, b.v) }; }
+	inline f4 select(m4 m, f4 a, f4 b) { return { vbslq_f32(m.v, a.v, b.v) }; }
+	inline uint32_t bits(m4 m) {
+		static const uint32_t lane[4] = { 1, 2, 4, 8 };
+		return vaddvq_u32(vandq_u32(m.v, vld1q_u32(lane)));
+	}
+#else
+	struct f4 { float v[4]; };
+	struct m4 { uint32_t v; };
+	template <typename F>
+	inline f4 map(f4 a, f4 b, F f) { return { { f(a.v[0], b.v[0]), f(a.v[1], b.v[1]), f(a.v[2], b.v[2]), f(a.v[3], b.v[3]) } }; }
+	inline f4 load(const float* p) { return { { p[0], p[1], p[2], p[3] } }; }
+	inline f4 splat(float f) { return { { f, f, f, f } }; }
+	inline f4 operator+(f4 a, f4 b) { return map(a, b, [](float x, float y) { return x + y; }); }
+	inline f4 operator-(f4 a, f4 b) { return map(a, b, [](float x, float y) { return x - y; }); }
+	inline f4 operator*(f4 a, f4 b) { return map(a, b, [](float x, float y) { return x * y; }); }
+	inline f4 operator/(f4 a, f4 b) { return map(a, b, [](float x, float y) { return x / y; }); }
+	inline f4 vmin(f4 a, f4 b) { return map(a, b, [](float x, float y) { return x < y ? x : y; }); }
+	inline f4 vmax(f4 a, f4 b) { return map(a, b, [](float x, float y) { return x > y ? x : y; }); }
+	inline f4 vsqrt(f4 a) { return { { std::sqrt(a.v[0]), std::sqrt(a.v[1]), std::sqrt(a.v[2]), std::sqrt(a.v[3]) } }; }
+	inline m4 le(f4 a, f4 b) {
+		uint32_t m = 0;
+		for (int i = 0; i < 4; ++i) m |= (a.v[i] <= b.v[i] ? 1u : 0u) << i;
+		return { m };
+	}
+	inline m4 gt(f4 a, f4 b) {
+		uint32_t m = 0;
+		for (int i = 0; i < 4; ++i) m |= (a.v[i] > b.v[i] ? 1u : 0u) << i;
+		return { m };
+	}
+	inline f4 select(m4 m, f4 a, f4 b) {
+		f4 r;
+		for (int i = 0; i < 4; ++i) r.v[i] = (m.v & (1u << i)) ? a.v[i] : b.v[i];
+		return r;
+	}
+	inline uint32_t bits(m4 m) { return m.v; }
+#endif
+
+	inline f4 saturate(f4 x) {
+		return vmin(vmax(x, splat(0.f)), splat(1.f));
+	}
+
+	inline void
+	transform_point(const float m[16], const float p[3], float r[3]) {
+		for (int i = 0; i < 3; ++i) {
+			r[i] = m[i] * p[0] + m[4+i] * p[1] + m[8+i] * p[2] + m[12+i];
+		}
+	}
+
+	// screen2view() of cs_cluster_aabb.sc, screen is in [0, 1]
+	inline void
+	screen_to_view(const float invproj[16], float sx, float sy, float depth, bool origin_bottom_left, float r[3]) {
+		if (!origin_bottom_left) {
+			sy = 1.f - sy;
+		}
+		const float ndc[4] = { sx * 2.f - 1.f, sy * 2.f - 1.f, depth, 1.f };
+		float clip[4];
+		for (int i = 0; i < 4; ++i) {
+			clip[i] = invproj[i] * ndc[0] + invproj[4+i] * ndc[1] + invproj[8+i] * ndc[2] + invproj[12+i] * ndc[3];
+		}
+		for (int i = 0; i < 3; ++i) {
+			r[i] = clip[i] / clip[3];
+		}
+	}
+}
+
+void
+light_binning::light_soa::resize(size_t n) {
+	// a block of 4 may be read past the last light
+	const size_t padded = (n + 3) & ~(size_t)3;
+	for (auto v : { &px, &py, &pz, &range, &dx, &dy, &dz, &spot, &intensity, &inner, &outter }) {
+		v->resize(padded);
+	}
+	id.resize(n);
+}
+
+light_binning::light_binning(uint32_t x, uint32_t y, uint32_t z, uint32_t max_light)
+	: size{ x, y, z }
+	, max_count(max_light) {
+	assert(x > 0 && y > 0 && z > 0 && max_light > 0);
+	aabbs.resize(cluster_num() * 6);
+	slice_z.resize(z * 2);
+	slices.resize(z);
+	for (auto& s : slices) {
+		s.counts.resize(x * y);
+	}
+	grid.resize(cluster_num() * 2);
+}
+
+void
+light_binning::build(const float invproj[16], float n, float f, bool homogeneous_depth, bool origin_bottom_left) {
+	const float near_ss = homogeneous_depth ? -1.f : 0.f;
+	for (uint32_t z = 0; z < size[2]; ++z) {
+		// which_z()
+		const float zn = n * std::pow(f / n, (float)z / size[2]);
+		const float zf = n * std::pow(f / n, (float)(z + 1) / size[2]);
+		float minz = INFINITY, maxz = -INFINITY;
+		for (uint32_t y = 0; y < size[1]; ++y) {
+			for (uint32_t x = 0; x < size[0]; ++x) {
+				float* b = &aabbs[(x + size[0] * y + size[0] * size[1] * z) * 6];
+				b[0] = b[1] = b[2] = INFINITY;
+				b[3] = b[4] = b[5] = -INFINITY;
+				for (int i = 0; i < 4; ++i) {
+					float p[3];
+					screen_to_view(invproj, (float)(x + (i & 1)) / size[0], (float)(y + (i >> 1)) / size[1], near_ss, origin_bottom_left, p);
+					// the ray from the eye through the corner, at the near and the far plane of the slice
+					for (float d : { zn, zf }) {
+						const float t = d / p[2];
+						const float v[3] = { p[0] * t, p[1] * t, p[2] * t };
+						for (int j = 0; j < 3; ++j) {
+							b[j] = std::min(b[j], v[j]);
+							b[3+j] = std::max(b[3+j], v[j]);
+						}
+					}
+				}
+				minz = std::min(minz, b[2]);
+				maxz = std::max(maxz, b[5]);
+			}
+		}
+		slice_z[z * 2] = minz;
+		slice_z[z * 2 + 1] = maxz;
+	}
+}
+
+void
+light_binning::begin(const float view[16], const cluster_light_info* l, uint32_t first, uint32_t num) {
+	light_num = num > first ? num - first : 0;
+	lights.resize(light_num);
+	for (uint32_t i = 0; i < light_num; ++i) {
+		const auto& li = l[first + i];
+		float p[3];
+		transform_point(view, li.pos, p);
+		float d[3];
+		for (int j = 0; j < 3; ++j) {
+			d[j] = view[j] * li.dir[0] + view[4+j] * li.dir[1] + view[8+j] * li.dir[2];
+		}
+		const float len = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+		const float inv = len > 0.f ? 1.f / len : 0.f;
+		lights.px[i] = p[0];
+		lights.py[i] = p[1];
+		lights.pz[i] = p[2];
+		lights.range[i] = li.range;
+		lights.dx[i] = d[0] * inv;
+		lights.dy[i] = d[1] * inv;
+		lights.dz[i] = d[2] * inv;
+		lights.spot[i] = li.type == SPOT_LIGHT ? 1.f : 0.f;
+		lights.intensity[i] = li.intensity;
+		lights.inner[i] = li.inner_cutoff;
+		lights.outter[i] = li.outter_cutoff;
+		lights.id[i] = first + i;
+	}
+}
+
+void
+light_binning::bin(uint32_t z) {
+	auto& s = slices[z];
+	s.indices.clear();
+
+	// the lights reaching the depth of the slice
+	const float minz = slice_z[z * 2], maxz = slice_z[z * 2 + 1];
+	auto& sl = s.lights;
+	sl.resize(light_num);
+	size_t n = 0;
+	for (uint32_t i = 0; i < light_num; ++i) {
+		const float r = lights.range[i] * 1.001f;
+		if (lights.pz[i] + r < minz || lights.pz[i] - r > maxz) {
+			continue;
+		}
+		sl.px[n] = lights.px[i]; sl.py[n] = lights.py[i]; sl.pz[n] = lights.pz[i];
+		sl.range[n] = lights.range[i];
+		sl.dx[n] = lights.dx[i]; sl.dy[n] = lights.dy[i]; sl.dz[n] = lights.dz[i];
+		sl.spot[n] = lights.spot[i];
+		sl.intensity[n] = lights.intensity[i];
+		sl.inner[n] = lights.inner[i]; sl.outter[n] = lights.outter[i];
+		sl.id[n] = lights.id[i];
+		++n;
+	}
+
+	// check_light_interset_aabb(), the attenuation is checked from this count on
+	const uint32_t halfcount = (uint32_t)(max_count * 0.3f);
+	const uint32_t tiles = size[0] * size[1];
+	for (uint32_t t = 0; t < tiles; ++t) {
+		const float* b = &aabbs[(z * tiles + t) * 6];
+		const f4 minx = splat(b[0]), miny = splat(b[1]), minz4 = splat(b[2]);
+		const f4 maxx = splat(b[3]), maxy = splat(b[4]), maxz4 = splat(b[5]);
+		const f4 cx = splat((b[0] + b[3]) * 0.5f), cy = splat((b[1] + b[4]) * 0.5f), cz = splat((b[2] + b[5]) * 0.5f);
+		uint32_t count = 0;
+		for (size_t i = 0; i < n && count < max_count; i += 4) {
+			const f4 px = load(&sl.px[i]), py = load(&sl.py[i]), pz = load(&sl.pz[i]);
+			const f4 r = load(&sl.range[i]);
+			// sphere_closest_pt_to_aabb()
+			const f4 dx = vmax(minx, vmin(px, maxx)) - px;
+			const f4 dy = vmax(miny, vmin(py, maxy)) - py;
+			const f4 dz = vmax(minz4, vmin(pz, maxz4)) - pz;
+			uint32_t hit = bits(le(dx * dx + dy * dy + dz * dz, r * r));
+			if (n - i < 4) {
+				hit &= (1u << (n - i)) - 1;
+			}
+			if (hit == 0) {
+				continue;
+			}
+			uint32_t valid = 0xf;
+			if (count + 4 > halfcount) {
+				// check_light_valid(), at the center of the cluster
+				const f4 lx = cx - px, ly = cy - py, lz = cz - pz;
+				const f4 dis2 = lx * lx + ly * ly + lz * lz;
+				const f4 dis = vsqrt(dis2);
+				const f4 x = dis / r;
+				const f4 x2 = x * x;
+				f4 att = saturate(splat(1.f) - x2 * x2) / dis2;
+				const f4 inner = load(&sl.inner[i]), outter = load(&sl.outter[i]);
+				const f4 cosv = (load(&sl.dx[i]) * lx + load(&sl.dy[i]) * ly + load(&sl.dz[i]) * lz) / dis;
+				const f4 st = saturate((cosv - outter) / (inner - outter));
+				const f4 spot = att * (st * st * (splat(3.f) - splat(2.f) * st));
+				att = select(gt(load(&sl.spot[i]), splat(0.5f)), spot, att);
+				valid = bits(gt(load(&sl.intensity[i]) * att, splat(ATTENUATION_THRESHOLD)));
+			}
+			for (uint32_t j = 0; j < 4 && count < max_count; ++j) {
+				if ((hit & (1u << j)) && (count < halfcount || (valid & (1u << j)))) {
+					s.indices.push_back(sl.id[i + j]);
+					++count;
+				}
+			}
+		}
+		s.counts[t] = count;
+	}
+}
+
+uint32_t
+light_binning::compact() {
+	const uint32_t tiles = size[0] * size[1];
+	size_t total = 0;
+	for (const auto& s : slices) {
+		total += s.indices.size();
+	}
+	index.resize(total);
+	uint32_t offset = 0;
+	for (uint32_t z = 0; z < size[2]; ++z) {
+		const auto& s = slices[z];
+		if (!s.indices.empty()) {
+			memcpy(&index[offset], s.indices.data(), s.indices.size() * sizeof(uint32_t));
+		}
+		for (uint32_t t = 0; t < tiles; ++t) {
+			uint32_t* g = &grid[(z * tiles + t) * 2];
+			g[0] = offset;
+			g[1] = s.counts[t];
+			offset += s.counts[t];
+		}
+	}
+	index_count = offset;
+	return index_count;
+}
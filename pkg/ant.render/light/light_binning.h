@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CPU light assignment of the cluster shading (graphic/lighting/cluster_shading/assign).
+// Fills the buffers of cs_lightcull.sc from the CPU: light_grids is { offset, count } per
+// cluster, the cluster (x, y, z) is x + X*y + X*Y*z as in which_cluster(), and the index
+// list is compact, the lists of the clusters follow each other.
+// The lights of a cluster are in the order of the light buffer and keep the same test as
+// the compute shader, so both paths give the same lists. Four lights are tested at once.
+// The depth slices are independent, bin() may run on different slices in parallel.
+
+// struct light_info of cluster_shading.sh, in world space
+struct cluster_light_info {
+	float pos[3];
+	float range;
+	float dir[3];
+	float enable;
+	float color[4];
+	float type;
+	float intensity;
+	float inner_cutoff;
+	float outter_cutoff;
+};
+
+class light_binning {
+public:
+	static constexpr float ATTENUATION_THRESHOLD = 0.008f;	// LIGHT_ATTENUATION_THRESHOLD
+	static constexpr float SPOT_LIGHT = 2.f;
+
+	light_binning(uint32_t x, uint32_t y, uint32_t z, uint32_t max_light);
+
+	// the view space boxes of the clusters, as cs_cluster_aabb.sc
+	// invproj is the inverse of the projection without inverse z and infinite far, column major
+	void build(const float invproj[16], float n, float f, bool homogeneous_depth, bool origin_bottom_left);
+	// the lights [first, num) are assigned, the directional lights before them are not
+	void begin(const float view[16], const cluster_light_info* lights, uint32_t first, uint32_t num);
+	void bin(uint32_t slice);
+	// merges the slices into the grids and the index list, returns the number of indices
+	uint32_t compact();
+
+	uint32_t cluster_num() const { return size[0] * size[1] * size[2]; }
+	uint32_t slice_num() const { return size[2]; }
+	uint32_t max_light() const { return max_count; }
+	// the box of a cluster, min xyz, max xyz
+	const float* cluster_aabb(uint32_t cluster) const { return &aabbs[cluster * 6]; }
+	// offset, count for each cluster
+	const uint32_t* grids() const { return grid.data(); }
+	const uint32_t* indices() const { return index.data(); }
+	uint32_t index_num() const { return index_count; }
+
+private:
+	// the lights in view space, 4 lights in a block
+	struct light_soa {
+		std::vector<float> px, py, pz, range, dx, dy, dz, spot, intensity, inner, outter;
+		std::vector<uint32_t> id;
+		void resize(size_t n);
+		size_t size() const { return id.size(); }
+	};
+	struct slice_result {
+		light_soa lights;
+		std::vector<uint32_t> counts;
+		std::vector<uint32_t> indices;
+	};
+	uint32_t size[3];
+	uint32_t max_count;
+	uint32_t index_count = 0;
+	std::vector<float> aabbs;
+	std::vector<float> slice_z;	// the z range of each slice, near, far
+	light_soa lights;
+	uint32_t light_num = 0;
+	std::vector<slice_result> slices;
+	std::vector<uint32_t> grid;
+	std::vector<uint32_t> index;
+};
@@ -0,0 +1,278 @@
+// The cluster boxes have to hold the points which_cluster() maps to them, and the binned lists
+// have to be the lists of a brute force assignment: every light against every cluster, with the
+// test of cs_lightcull.sc. Then the binning is timed against the brute force.
+#include "../light_binning.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+static const uint32_t X = 16, Y = 9, Z = 24;
+static const float NEAR = 0.1f, FAR = 300.f;
+
+static float frand(float a, float b) {
+    return a + (b - a) * (float)rand() / (float)RAND_MAX;
+}
+
+// left handed perspective and its inverse, depth in [0, 1] or [-1, 1], column major
+static void perspective(float p[16], float ip[16], bool homogeneous) {
+    const float sy = 1.f / std::tan(3.14159265f / 6.f), sx = sy * 9.f / 16.f;
+    const float a = homogeneous ? (FAR + NEAR) / (FAR - NEAR) : FAR / (FAR - NEAR);
+    const float b = homogeneous ? -2.f * NEAR * FAR / (FAR - NEAR) : -NEAR * FAR / (FAR - NEAR);
+    for (int i = 0; i < 16; ++i) {
+        p[i] = ip[i] = 0.f;
+    }
+    p[0] = sx; p[5] = sy; p[10] = a; p[11] = 1.f; p[14] = b;
+    ip[0] = 1.f / sx; ip[5] = 1.f / sy; ip[11] = 1.f / b; ip[14] = 1.f; ip[15] = -a / b;
+}
+
+// which_cluster(), for a view space point
+static uint32_t which_cluster(const float p[16], const float v[3], bool origin_bottom_left) {
+    const float cx = p[0] * v[0], cy = p[5] * v[1], cw = v[2];
+    float sx = (cx / cw) * 0.5f + 0.5f, sy = (cy / cw) * 0.5f + 0.5f;
+    if (!origin_bottom_left) {
+        sy = 1.f - sy;
+    }
+    const float scale = Z / std::log2(FAR / NEAR), bias = -(float)Z * std::log2(NEAR) / std::log2(FAR / NEAR);
+    const uint32_t z = std::min(Z - 1, (uint32_t)std::max(std::log2(v[2]) * scale + bias, 0.f));
+    const uint32_t x = std::min(X - 1, (uint32_t)(sx * X)), y = std::min(Y - 1, (uint32_t)(sy * Y));
+    return x + X * y + X * Y * z;
+}
+
+static void lookat(float m[16], const float eye[3], float yaw) {
+    const float c = std::cos(yaw), s = std::sin(yaw);
+    // rotation about y, then translation
+    const float r[9] = { c, 0.f, s, 0.f, 1.f, 0.f, -s, 0.f, c };
+    for (int i = 0; i < 3; ++i) {
+        m[i] = r[i];
+        m[4+i] = r[3+i];
+        m[8+i] = r[6+i];
+        m[12+i] = -(r[i] * eye[0] + r[3+i] * eye[1] + r[6+i] * eye[2]);
+        m[3+i*4] = 0.f;
+    }
+    m[15] = 1.f;
+}
+
+static std::vector<cluster_light_info> make_lights(uint32_t num, uint32_t directional) {
+    std::vector<cluster_light_info> lights(num);
+    for (uint32_t i = 0; i < num; ++i) {
+        auto& l = lights[i];
+        l = cluster_light_info {};
+        l.enable = 1.f;
+        l.color[0] = l.color[1] = l.color[2] = 1.f;
+        if (i < directional) {
+            l.type = 0.f;
+            l.range = 3.4e38f;
+            l.dir[1] = -1.f;
+            l.intensity = 130000.f;
+            continue;
+        }
+        l.pos[0] = frand(-120.f, 120.f);
+        l.pos[1] = frand(-5.f, 30.f);
+        l.pos[2] = frand(-20.f, 250.f);
+        l.range = frand(1.f, 25.f);
+        l.intensity = frand(0.01f, 20.f);
+        if (rand() & 1) {
+            l.type = light_binning::SPOT_LIGHT;
+            l.dir[0] = frand(-1.f, 1.f);
+            l.dir[1] = frand(-1.f, -0.2f);
+            l.dir[2] = frand(-1.f, 1.f);
+            const float o = frand(0.2f, 1.2f);
+            l.outter_cutoff = std::cos(o);
+            l.inner_cutoff = std::cos(o * frand(0.3f, 0.9f));
+        } else {
+            l.type = 1.f;
+        }
+    }
+    return lights;
+}
+
+// cs_lightcull.sc, written literally
+static void brute_force(const light_binning& b, const float view[16], const std::vector<cluster_light_info>& lights, uint32_t first,
+    uint32_t max_light, std::vector<std::vector<uint32_t>>& lists) {
+    lists.assign(b.cluster_num(), {});
+    const uint32_t halfcount = (uint32_t)(max_light * 0.3f);
+    for (uint32_t c = 0; c < b.cluster_num(); ++c) {
+        const float* a = b.cluster_aabb(c);
+        for (uint32_t li = first; li < lights.size() && lists[c].size() < max_light; ++li) {
+            const auto& l = lights[li];
+            float p[3], d[3];
+            for (int i = 0; i < 3; ++i) {
+                p[i] = view[i] * l.pos[0] + view[4+i] * l.pos[1] + view[8+i] * l.pos[2] + view[12+i];
+                d[i] = view[i] * l.dir[0] + view[4+i] * l.dir[1] + view[8+i] * l.dir[2];
+            }
+            const float len = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+            const float inv = len > 0.f ? 1.f / len : 0.f;
+            for (int i = 0; i < 3; ++i) {
+                d[i] = d[i] * inv;
+            }
+            bool valid = true;
+            if (lists[c].size() >= halfcount) {
+                float pt2l[3];
+                for (int i = 0; i < 3; ++i) {
+                    pt2l[i] = (a[i] + a[3+i]) * 0.5f - p[i];
+                }
+                const float dis2 = pt2l[0] * pt2l[0] + pt2l[1] * pt2l[1] + pt2l[2] * pt2l[2];
+                const float dis = std::sqrt(dis2);
+                const float x = dis / l.range;
+                const float x2 = x * x;
+                float att = std::min(std::max(1.f - x2 * x2, 0.f), 1.f) / dis2;
+                if (l.type == light_binning::SPOT_LIGHT) {
+                    const float cosv = (d[0] * pt2l[0] + d[1] * pt2l[1] + d[2] * pt2l[2]) / dis;
+                    const float t = std::min(std::max((cosv - l.outter_cutoff) / (l.inner_cutoff - l.outter_cutoff), 0.f), 1.f);
+                    att = att * (t * t * (3.f - 2.f * t));
+                }
+                valid = l.intensity * att > light_binning::ATTENUATION_THRESHOLD;
+            }
+            if (!valid) {
+                continue;
+            }
+            float sq = 0.f;
+            for (int i = 0; i < 3; ++i) {
+                const float closest = std::max(a[i], std::min(p[i], a[3+i]));
+                sq += (closest - p[i]) * (closest - p[i]);
+            }
+            if (sq <= l.range * l.range) {
+                lists[c].push_back(li);
+            }
+        }
+    }
+}
+
+static void bin_all(light_binning& b, unsigned threads) {
+    if (threads <= 1) {
+        for (uint32_t z = 0; z < b.slice_num(); ++z) {
+            b.bin(z);
+        }
+    } else {
+        std::vector<std::thread> pool;
+        for (unsigned t = 0; t < threads; ++t) {
+            pool.emplace_back([&b, t, threads]() {
+                for (uint32_t z = t; z < b.slice_num(); z += threads) {
+                    b.bin(z);
+                }
+            });
+        }
+        for (auto& th : pool) {
+            th.join();
+        }
+    }
+    b.compact();
+}
+
+int main() {
+    int failed = 0;
+    auto check = [&](bool ok, const char* what) {
+        if (!ok) {
+            printf("FAILED: %s\n", what);
+            failed++;
+        }
+    };
+
+    float proj[16], invproj[16];
+
+    // the boxes of the clusters
+    for (int mode = 0; mode < 4; ++mode) {
+        const bool homogeneous = mode & 1, bottom_left = (mode & 2) != 0;
+        perspective(proj, invproj, homogeneous);
+        light_binning b(X, Y, Z, 32);
+        b.build(invproj, NEAR, FAR, homogeneous, bottom_left);
+        srand(7);
+        int outside = 0;
+        for (int i = 0; i < 200000; ++i) {
+            const float z = NEAR * std::pow(FAR / NEAR, frand(0.f, 1.f));
+            const float v[3] = { frand(-1.f, 1.f) * z * invproj[0], frand(-1.f, 1.f) * z * invproj[5], z };
+            const float* a = b.cluster_aabb(which_cluster(proj, v, bottom_left));
+            const float eps = 1e-3f * z;
+            for (int j = 0; j < 3; ++j) {
+                if (v[j] < a[j] - eps || v[j] > a[3+j] + eps) {
+                    outside++;
+                    break;
+                }
+            }
+        }
+        check(outside == 0, "which_cluster() maps a point into its cluster box");
+    }
+
+    // the lists against the brute force
+    perspective(proj, invproj, false);
+    struct scene_case {
+        uint32_t lights;
+        uint32_t max_light;
+    };
+    const scene_case cases[] = { { 0, 128 }, { 1, 128 }, { 3, 128 }, { 64, 128 }, { 600, 16 }, { 2000, 128 }, { 2000, 8 } };
+    for (const auto& sc : cases) {
+        srand(sc.lights + sc.max_light);
+        const uint32_t directional = 1;
+        auto lights = make_lights(sc.lights + directional, directional);
+        float view[16];
+        const float eye[3] = { 5.f, 8.f, -10.f };
+        lookat(view, eye, 0.3f);
+
+        light_binning b(X, Y, Z, sc.max_light);
+        b.build(invproj, NEAR, FAR, false, false);
+        std::vector<std::vector<uint32_t>> expect;
+        brute_force(b, view, lights, directional, sc.max_light, expect);
+
+        for (unsigned threads : { 1u, 4u }) {
+            b.begin(view, lights.data(), directional, (uint32_t)lights.size());
+            bin_all(b, threads);
+            uint32_t mismatch = 0, offset = 0, capped = 0;
+            bool compact = true;
+            for (uint32_t c = 0; c < b.cluster_num(); ++c) {
+                const uint32_t* g = b.grids() + c * 2;
+                compact = compact && g[0] == offset;
+                offset += g[1];
+                capped += g[1] == sc.max_light;
+                if (g[1] != expect[c].size() || !std::equal(expect[c].begin(), expect[c].end(), b.indices() + g[0])) {
+                    mismatch++;
+                }
+            }
+            if (threads == 1) {
+                printf("%u lights, max %u: %u indices, %u clusters full\n", sc.lights, sc.max_light, b.index_num(), capped);
+            }
+            check(mismatch == 0, "the binned lists are the brute force lists");
+            check(compact && offset == b.index_num(), "the lists are compact");
+        }
+    }
+
+    // timing, 1024 lights
+    {
+        srand(3);
+        auto lights = make_lights(1025, 1);
+        float view[16];
+        const float eye[3] = { 0.f, 10.f, -20.f };
+        lookat(view, eye, 0.f);
+        light_binning b(X, Y, Z, 128);
+        b.build(invproj, NEAR, FAR, false, false);
+
+        const int RUNS = 10;
+        std::vector<std::vector<uint32_t>> expect;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < RUNS; ++i) {
+            brute_force(b, view, lights, 1, 128, expect);
+        }
+        const double brute = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / RUNS;
+
+        const unsigned threads = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+        double binned[2];
+        for (int k = 0; k < 2; ++k) {
+            start = std::chrono::steady_clock::now();
+            for (int i = 0; i < RUNS; ++i) {
+                b.begin(view, lights.data(), 1, (uint32_t)lights.size());
+                bin_all(b, k == 0 ? 1 : threads);
+            }
+            binned[k] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / RUNS;
+        }
+        printf("1024 lights, %u clusters: brute force %.2f ms, binned %.2f ms, %u threads %.2f ms\n",
+            b.cluster_num(), brute, binned[0], threads, binned[1]);
+        check(binned[0] < brute, "the binning is faster than the brute force");
+    }
+
+    printf(failed ? "light binning: %d failure(s)\n" : "light binning: ok\n", failed);
+    return failed ? 1 : 0;
+}
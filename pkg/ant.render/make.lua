@@ -39,10 +39,72 @@ lm:lua_src "render" {
     },
     sources = {
         "cull/cull.cpp",
+        "cull/occlusion.cpp",
+        "shadow/csm_cache.cpp",
+        "shadow/shadow_cache.cpp",
+        "shadow/caster_cull.cpp",
+        "shadow/shadow_cull.cpp",
+        "shadow/shadow_atlas.cpp",
+        "shadow/local_shadow.cpp",
+        "light/light_binning.cpp",
+        "light/cluster_light.cpp",
+        "pick/mesh_bvh.cpp",
+        "pick/mesh_pick.cpp",
     },
     objdeps = "compile_ecs",
     deps = {
         "material_core",
         "render_core",
     }
-}
\ No newline at end of file
+}
+lm:exe "render_lod_test" {
+    includes = {
+        lm.AntDir .. "/clibs/meshopt",
+    },
+    sources = {
+        lm.AntDir .. "/clibs/meshopt/meshopt.cpp",
+        "render/test/lod_test.cpp",
+    },
+}
+
+lm:exe "render_occlusion_test" {
+    sources = {
+        "cull/occlusion.cpp",
+        "cull/test/occlusion_test.cpp",
+    },
+}
+
+lm:exe "render_csm_cache_test" {
+    sources = {
+        "shadow/csm_cache.cpp",
+        "shadow/test/csm_cache_test.cpp",
+    },
+}
+
+lm:exe "render_caster_cull_test" {
+    sources = {
+        "shadow/caster_cull.cpp",
+        "shadow/test/caster_cull_test.cpp",
+    },
+}
+
+lm:exe "render_light_binning_test" {
+    sources = {
+        "light/light_binning.cpp",
+        "light/test/light_binning_test.cpp",
+    },
+}
+
+lm:exe "render_shadow_atlas_test" {
+    sources = {
+        "shadow/shadow_atlas.cpp",
+        "shadow/test/shadow_atlas_test.cpp",
+    },
+}
+
+lm:exe "render_mesh_bvh_test" {
+    sources = {
+        "pick/mesh_bvh.cpp",
+        "pick/test/mesh_bvh_test.cpp",
+    },
+}
@@ -0,0 +1,494 @@
+#include "mesh_bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+static constexpr uint32_t MAX_LEAF = 4;
+static constexpr uint32_t BINS = 12;
+// the traversal stack holds at most one node a level
+static constexpr uint32_t MAX_DEPTH = 60;
+
+struct mesh_bvh::build_tri {
+	float min[3], max[3], c[3];
+	float v[9];
+	uint32_t tri;
+};
+
+static inline float
+dot3(const float a[3], const float b[3]) {
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static inline void
+cross3(const float a[3], const float b[3], float r[3]) {
+	r[0] = a[1] * b[2] - a[2] * b[1];
+	r[1] = a[2] * b[0] - a[0] * b[2];
+	r[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static inline float
+half_area(const float mn[3], const float mx[3]) {
+	const float dx = mx[0] - mn[0], dy = mx[1] - mn[1], dz = mx[2] - mn[2];
+	return dx * dy + dy * dz + dz * dx;
+}
+
+static inline void
+grow(float mn[3], float mx[3], const float pmin[3], const float pmax[3]) {
+	for (int i = 0; i < 3; ++i) {
+		mn[i] = std::min(mn[i], pmin[i]);
+		mx[i] = std::max(mx[i], pmax[i]);
+	}
+}
+
+static inline void
+empty_box(float mn[3], float mx[3]) {
+	for (int i = 0; i < 3; ++i) {
+		mn[i] = std::numeric_limits<float>::max();
+		mx[i] = -std::numeric_limits<float>::max();
+	}
+}
+
+// the range of t the ray is in the box, clipped to [0, tmax]; a NaN from a ray on a slab is ignored by min and max
+static inline bool
+ray_box(const float o[3], const float inv[3], const float mn[3], const float mx[3], float tmax, float& tnear) {
+	float t0 = 0.f, t1 = tmax;
+	for (int i = 0; i < 3; ++i) {
+		float a = (mn[i] - o[i]) * inv[i];
+		float b = (mx[i] - o[i]) * inv[i];
+		if (a > b) {
+			std::swap(a, b);
+		}
+		t0 = std::max(t0, a);
+		t1 = std::min(t1, b);
+	}
+	tnear = t0;
+	return t0 <= t1;
+}
+
+// -1 out of a plane, 1 in all of them, 0 across
+static inline int
+box_planes(const float mn[3], const float mx[3], const float (*planes)[4], int num) {
+	bool inside = true;
+	for (int p = 0; p < num; ++p) {
+		const float* n = planes[p];
+		float outer = n[3], inner = n[3];
+		for (int i = 0; i < 3; ++i) {
+			outer += n[i] * (n[i] >= 0.f ? mx[i] : mn[i]);
+			inner += n[i] * (n[i] >= 0.f ? mn[i] : mx[i]);
+		}
+		if (outer < 0.f) {
+			return -1;
+		}
+		inside = inside && inner >= 0.f;
+	}
+	return inside ? 1 : 0;
+}
+
+static inline bool
+triangle_planes(const float v[9], const float (*planes)[4], int num) {
+	for (int p = 0; p < num; ++p) {
+		const float* n = planes[p];
+		if (dot3(n, v) + n[3] < 0.f && dot3(n, v + 3) + n[3] < 0.f && dot3(n, v + 6) + n[3] < 0.f) {
+			return false;
+		}
+	}
+	return true;
+}
+
+mesh_bvh::mesh_bvh(const void* vertices, uint32_t stride, uint32_t num_vertices, const void* indices, uint32_t num_indices, bool index32) {
+	auto position = [&](uint32_t i, float* p) {
+		memcpy(p, (const uint8_t*)vertices + (size_t)i * stride, sizeof(float) * 3);
+	};
+	auto vertex_index = [&](uint32_t i) -> uint32_t {
+		if (indices == nullptr) {
+			return i;
+		}
+		return index32 ? ((const uint32_t*)indices)[i] : ((const uint16_t*)indices)[i];
+	};
+	const uint32_t count = (indices ? num_indices : num_vertices) / 3;
+
+	std::vector<build_tri> tris;
+	tris.reserve(count);
+	for (uint32_t t = 0; t < count; ++t) {
+		build_tri b;
+		bool valid = true;
+		for (uint32_t k = 0; k < 3; ++k) {
+			const uint32_t vi = vertex_index(t * 3 + k);
+			if (vi >= num_vertices) {
+				valid = false;
+				break;
+			}
+			position(vi, &b.v[k * 3]);
+		}
+		if (!valid) {
+			continue;
+		}
+		for (int i = 0; i < 3; ++i) {
+			b.min[i] = std::min({ b.v[i], b.v[3 + i], b.v[6 + i] });
+			b.max[i] = std::max({ b.v[i], b.v[3 + i], b.v[6 + i] });
+			b.c[i] = (b.min[i] + b.max[i]) * 0.5f;
+		}
+		b.tri = t;
+		tris.push_back(b);
+	}
+
+	empty_box(box, box + 3);
+	if (tris.empty()) {
+		return;
+	}
+	tree.reserve(tris.size() * 2 / MAX_LEAF + 1);
+	tree.push_back(node {});
+	build(tris, 0, (uint32_t)tris.size(), 0, 0);
+	memcpy(box, tree[0].min, sizeof(float) * 3);
+	memcpy(box + 3, tree[0].max, sizeof(float) * 3);
+
+	verts.resize(tris.size() * 9);
+	index.resize(tris.size());
+	for (size_t i = 0; i < tris.size(); ++i) {
+		memcpy(&verts[i * 9], tris[i].v, sizeof(float) * 9);
+		index[i] = tris[i].tri;
+	}
+}
+
+// the node idx over tris[first, first + count), split by the binned surface area heuristic
+void
+mesh_bvh::build(std::vector<build_tri>& tris, uint32_t first, uint32_t count, uint32_t idx, uint32_t depth) {
+	float mn[3], mx[3], cmin[3], cmax[3];
+	empty_box(mn, mx);
+	empty_box(cmin, cmax);
+	for (uint32_t i = first; i < first + count; ++i) {
+		grow(mn, mx, tris[i].min, tris[i].max);
+		grow(cmin, cmax, tris[i].c, tris[i].c);
+	}
+	{
+		auto& n = tree[idx];
+		memcpy(n.min, mn, sizeof(mn));
+		memcpy(n.max, mx, sizeof(mx));
+		n.first = first;
+		n.count = count;
+	}
+	if (count <= MAX_LEAF || depth >= MAX_DEPTH) {
+		return;
+	}
+
+	int axis = -1;
+	uint32_t split_bin = 0;
+	float best = std::numeric_limits<float>::max();
+	for (int a = 0; a < 3; ++a) {
+		const float extent = cmax[a] - cmin[a];
+		if (!(extent > 0.f)) {
+			continue;
+		}
+		struct bin { float min[3], max[3]; uint32_t count; } bins[BINS];
+		for (auto& b : bins) {
+			empty_box(b.min, b.max);
+			b.count = 0;
+		}
+		const float scale = BINS / extent;
+		for (uint32_t i = first; i < first + count; ++i) {
+			const uint32_t b = std::min(BINS - 1, (uint32_t)((tris[i].c[a] - cmin[a]) * scale));
+			grow(bins[b].min, bins[b].max, tris[i].min, tris[i].max);
+			++bins[b].count;
+		}
+		// the cost of the right side of each split, then sweep from the left
+		float right_cost[BINS];
+		float rmin[3], rmax[3];
+		empty_box(rmin, rmax);
+		uint32_t rcount = 0;
+		for (uint32_t b = BINS - 1; b > 0; --b) {
+			grow(rmin, rmax, bins[b].min, bins[b].max);
+			rcount += bins[b].count;
+			right_cost[b] = rcount ? half_area(rmin, rmax) * rcount : 0.f;
+		}
+		float lmin[3], lmax[3];
+		empty_box(lmin, lmax);
+		uint32_t lcount = 0;
+		for (uint32_t b = 0; b < BINS - 1; ++b) {
+			grow(lmin, lmax, bins[b].min, bins[b].max);
+			lcount += bins[b].count;
+			if (lcount == 0 || lcount == count) {
+				continue;
+			}
+			const float cost = half_area(lmin, lmax) * lcount + right_cost[b + 1];
+			if (cost < best) {
+				best = cost;
+				axis = a;
+				split_bin = b + 1;
+			}
+		}
+	}
+	// a leaf when the centroids are all at one point, or when splitting costs more than the triangles of a small leaf
+	if (axis < 0 || (count <= MAX_LEAF * 4 && best >= half_area(mn, mx) * count)) {
+		return;
+	}
+
+	const float scale = BINS / (cmax[axis] - cmin[axis]);
+	auto mid = std::partition(tris.begin() + first, tris.begin() + first + count, [&](const build_tri& t) {
+		return std::min(BINS - 1, (uint32_t)((t.c[axis] - cmin[axis]) * scale)) < split_bin;
+	});
+	const uint32_t left = (uint32_t)(mid - tris.begin()) - first;
+	const uint32_t child = (uint32_t)tree.size();
+	tree.push_back(node {});
+	tree.push_back(node {});
+	tree[idx].first = child;
+	tree[idx].count = 0;
+	build(tris, first, left, child, depth + 1);
+	build(tris, first + left, count - left, child + 1, depth + 1);
+}
+
+bool
+mesh_bvh::intersect(const float org[3], const float dir[3], float tmax, mesh_hit& hit) const {
+	if (tree.empty()) {
+		return false;
+	}
+	const float inv[3] = { 1.f / dir[0], 1.f / dir[1], 1.f / dir[2] };
+	float best = tmax;
+	bool found = false;
+	float tnear;
+	if (!ray_box(org, inv, tree[0].min, tree[0].max, best, tnear)) {
+		return false;
+	}
+	uint32_t stack[MAX_DEPTH + 4];
+	uint32_t sp = 0;
+	stack[sp++] = 0;
+	while (sp > 0) {
+		const node& n = tree[stack[--sp]];
+		if (n.count > 0) {
+			for (uint32_t i = n.first; i < n.first + n.count; ++i) {
+				// Moller-Trumbore, both faces
+				const float* v = &verts[i * 9];
+				const float e1[3] = { v[3] - v[0], v[4] - v[1], v[5] - v[2] };
+				const float e2[3] = { v[6] - v[0], v[7] - v[1], v[8] - v[2] };
+				float p[3], q[3];
+				cross3(dir, e2, p);
+				const float det = dot3(e1, p);
+				if (det == 0.f) {
+					continue;
+				}
+				const float idet = 1.f / det;
+				const float s[3] = { org[0] - v[0], org[1] - v[1], org[2] - v[2] };
+				const float u = dot3(s, p) * idet;
+				if (u < 0.f || u > 1.f) {
+					continue;
+				}
+				cross3(s, e1, q);
+				const float w = dot3(dir, q) * idet;
+				if (w < 0.f || u + w > 1.f) {
+					continue;
+				}
+				const float t = dot3(e2, q) * idet;
+				if (t < 0.f || t > best) {
+					continue;
+				}
+				best = t;
+				hit = mesh_hit { t, index[i], u, w, {} };
+				cross3(e1, e2, hit.normal);
+				found = true;
+			}
+			continue;
+		}
+		// the nearer child is pushed last, to be visited first
+		float t0, t1;
+		const node& l = tree[n.first];
+		const node& r = tree[n.first + 1];
+		const bool hl = ray_box(org, inv, l.min, l.max, best, t0);
+		const bool hr = ray_box(org, inv, r.min, r.max, best, t1);
+		if (hl && hr) {
+			if (t0 <= t1) {
+				stack[sp++] = n.first + 1;
+				stack[sp++] = n.first;
+			} else {
+				stack[sp++] = n.first;
+				stack[sp++] = n.first + 1;
+			}
+		} else if (hl) {
+			stack[sp++] = n.first;
+		} else if (hr) {
+			stack[sp++] = n.first + 1;
+		}
+	}
+	return found;
+}
+
+bool
+mesh_bvh::overlap(const float (*planes)[4], int num) const {
+	if (tree.empty()) {
+		return false;
+	}
+	uint32_t stack[MAX_DEPTH + 4];
+	uint32_t sp = 0;
+	stack[sp++] = 0;
+	while (sp > 0) {
+		const node& n = tree[stack[--sp]];
+		const int r = box_planes(n.min, n.max, planes, num);
+		if (r < 0) {
+			continue;
+		}
+		if (r > 0) {
+			return true;
+		}
+		if (n.count == 0) {
+			stack[sp++] = n.first;
+			stack[sp++] = n.first + 1;
+			continue;
+		}
+		for (uint32_t i = n.first; i < n.first + n.count; ++i) {
+			if (triangle_planes(&verts[i * 9], planes, num)) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// the inverse of a column major matrix, false when it is singular
+static bool
+invert(const float* m, float* r) {
+	float inv[16];
+	inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+	inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+	const float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+	if (det == 0.f || !std::isfinite(det)) {
+		return false;
+	}
+	const float idet = 1.f / det;
+	for (int i = 0; i < 16; ++i) {
+		r[i] = inv[i] * idet;
+	}
+	return true;
+}
+
+// m * (v, w), the xyz
+static inline void
+transform(const float* m, const float v[3], float w, float r[3]) {
+	for (int i = 0; i < 3; ++i) {
+		r[i] = m[i] * v[0] + m[4 + i] * v[1] + m[8 + i] * v[2] + m[12 + i] * w;
+	}
+}
+
+bool
+pick_ray(const pick_instance* instances, size_t num, const float org[3], const float dir[3], pick_result& result) {
+	const float inv[3] = { 1.f / dir[0], 1.f / dir[1], 1.f / dir[2] };
+	const float inf = std::numeric_limits<float>::infinity();
+	std::vector<std::pair<float, size_t>> order;
+	for (size_t i = 0; i < num; ++i) {
+		float tnear;
+		if (instances[i].mesh && ray_box(org, inv, instances[i].aabb, instances[i].aabb + 3, inf, tnear)) {
+			order.emplace_back(tnear, i);
+		}
+	}
+	std::sort(order.begin(), order.end());
+
+	float best = inf;
+	float best_inv[16];
+	const pick_instance* found = nullptr;
+	mesh_hit found_hit;
+	for (const auto& [tnear, i] : order) {
+		if (tnear > best) {
+			break;
+		}
+		const auto& inst = instances[i];
+		float wi[16];
+		if (!invert(inst.world, wi)) {
+			continue;
+		}
+		// t is the same along the ray in both spaces, the local direction is not normalized
+		float lo[3], ld[3];
+		transform(wi, org, 1.f, lo);
+		transform(wi, dir, 0.f, ld);
+		mesh_hit hit;
+		if (inst.mesh->intersect(lo, ld, best, hit)) {
+			best = hit.t;
+			found = &inst;
+			found_hit = hit;
+			memcpy(best_inv, wi, sizeof(wi));
+		}
+	}
+	if (found == nullptr) {
+		return false;
+	}
+
+	result.id = found->id;
+	result.t = best;
+	result.triangle = found_hit.triangle;
+	for (int i = 0; i < 3; ++i) {
+		result.point[i] = org[i] + dir[i] * best;
+	}
+	// the inverse transpose for the normal
+	const float* ln = found_hit.normal;
+	float* n = result.normal;
+	for (int i = 0; i < 3; ++i) {
+		n[i] = best_inv[i * 4] * ln[0] + best_inv[i * 4 + 1] * ln[1] + best_inv[i * 4 + 2] * ln[2];
+	}
+	const float len = std::sqrt(dot3(n, n));
+	const float s = len > 0.f ? (dot3(n, dir) > 0.f ? -1.f : 1.f) / len : 0.f;
+	n[0] *= s; n[1] *= s; n[2] *= s;
+	return true;
+}
+
+void
+pick_volume(const pick_instance* instances, size_t num, const float (*planes)[4], int num_planes, std::vector<uint64_t>& ids) {
+	std::vector<float> local(num_planes * 4);
+	for (size_t i = 0; i < num; ++i) {
+		const auto& inst = instances[i];
+		if (inst.mesh == nullptr) {
+			continue;
+		}
+		const int r = box_planes(inst.aabb, inst.aabb + 3, planes, num_planes);
+		if (r < 0) {
+			continue;
+		}
+		if (r > 0) {
+			ids.push_back(inst.id);
+			continue;
+		}
+		// dot(plane, world * p) is dot(plane * world, p)
+		const float* m = inst.world;
+		for (int p = 0; p < num_planes; ++p) {
+			for (int j = 0; j < 4; ++j) {
+				local[p * 4 + j] = planes[p][0] * m[j * 4] + planes[p][1] * m[j * 4 + 1] + planes[p][2] * m[j * 4 + 2] + planes[p][3] * m[j * 4 + 3];
+			}
+		}
+		if (inst.mesh->overlap((const float (*)[4])local.data(), num_planes)) {
+			ids.push_back(inst.id);
+		}
+	}
+}
+
+void
+pick_frustum(const float viewproj[16], float x0, float y0, float x1, float y1, float zmin, float zmax, float planes[6][4]) {
+	// clip = viewproj * p, a point is in when x0 * clip.w <= clip.x <= x1 * clip.w, and so on
+	float row[4][4];
+	for (int r = 0; r < 4; ++r) {
+		for (int c = 0; c < 4; ++c) {
+			row[r][c] = viewproj[c * 4 + r];
+		}
+	}
+	const struct { int r; float k; float sign; } sides[6] = {
+		{ 0, x0, 1.f }, { 0, x1, -1.f },
+		{ 1, y0, 1.f }, { 1, y1, -1.f },
+		{ 2, zmin, 1.f }, { 2, zmax, -1.f },
+	};
+	for (int p = 0; p < 6; ++p) {
+		const auto& s = sides[p];
+		for (int c = 0; c < 4; ++c) {
+			planes[p][c] = s.sign * (row[s.r][c] - s.k * row[3][c]);
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Picking on the CPU, without a render pass or a readback.
+// A mesh gets a bounding volume hierarchy over its triangles, in its local space. An instance is a
+// mesh with its world matrix and world aabb; a ray or a convex volume is tested against the aabbs
+// first, then against the triangles of the meshes in their local space.
+
+struct mesh_hit {
+	float t;			// org + t * dir
+	uint32_t triangle;	// the index of the triangle in the mesh
+	float u, v;			// barycentrics of the hit, for the second and third vertex
+	float normal[3];	// the geometric normal from the winding order, not normalized
+};
+
+class mesh_bvh {
+public:
+	// The positions are 3 floats at the beginning of each vertex of stride bytes.
+	// The indices are 16 or 32 bits, or null for a triangle list; triangles with an index past
+	// num_vertices are skipped.
+	mesh_bvh(const void* vertices, uint32_t stride, uint32_t num_vertices, const void* indices, uint32_t num_indices, bool index32);
+
+	// the nearest triangle hit in [0, tmax], both faces count; dir need not be normalized
+	bool intersect(const float org[3], const float dir[3], float tmax, mesh_hit& hit) const;
+	// any triangle in the convex volume, a point p is in when dot(plane.xyz, p) + plane.w >= 0 for all planes.
+	// It is conservative: a triangle is out only when all its vertices are out of the same plane.
+	bool overlap(const float (*planes)[4], int num) const;
+
+	// min xyz, max xyz
+	const float* bounds() const { return box; }
+	uint32_t triangles() const { return (uint32_t)index.size(); }
+	uint32_t nodes() const { return (uint32_t)tree.size(); }
+
+private:
+	struct node {
+		float min[3];
+		uint32_t first;		// the first triangle of a leaf, the left child of an inner node (the right one follows it)
+		float max[3];
+		uint32_t count;		// 0 for an inner node
+	};
+	struct build_tri;
+	void build(std::vector<build_tri>& tris, uint32_t first, uint32_t count, uint32_t idx, uint32_t depth);
+
+	std::vector<node> tree;
+	std::vector<float> verts;		// 9 floats a triangle, in the order of the leaves
+	std::vector<uint32_t> index;	// the triangle of the mesh for each triangle of verts
+	float box[6];
+};
+
+struct pick_instance {
+	uint64_t id;
+	const mesh_bvh* mesh;
+	float world[16];	// column major
+	float aabb[6];		// in world space, min xyz, max xyz
+};
+
+struct pick_result {
+	uint64_t id;
+	float t;
+	float point[3];
+	float normal[3];	// in world space, facing the ray
+	uint32_t triangle;
+};
+
+// the nearest instance the ray hits, in world space
+bool pick_ray(const pick_instance* instances, size_t num, const float org[3], const float dir[3], pick_result& result);
+// the instances with a triangle in the convex volume, see mesh_bvh::overlap
+void pick_volume(const pick_instance* instances, size_t num, const float (*planes)[4], int num_planes, std::vector<uint64_t>& ids);
+// the 6 planes of the part of the view volume in a rect of the normalized device coordinates,
+// x0 < x1, y0 < y1, zmin and zmax are the depth range of the device (-1 or 0, and 1)
+void pick_frustum(const float viewproj[16], float x0, float y0, float x1, float y1, float zmin, float zmax, float planes[6][4]);
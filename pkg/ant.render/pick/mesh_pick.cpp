@@ -0,0 +1,203 @@
+#include "ecs/world.h"
+#include "ecs/select.h"
+#include "ecs/component.hpp"
+
+extern "C"{
+	#include "math3d.h"
+	#include "math3dfunc.h"
+}
+
+#include "../render/queue.h"
+#include "mesh_bvh.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+struct mesh_pick {
+	mesh_pick(struct ecs_context* ctx) : pick_obj(ctx) {}
+	ecs::cached_context<component::pick_mesh, component::render_object, component::visible, component::bounding, component::eid> pick_obj;
+
+	// pick_mesh.mesh is an index + 1 of meshes
+	std::vector<std::unique_ptr<mesh_bvh>> meshes;
+	std::vector<int> free_meshes;
+	std::vector<pick_instance> instances;
+	std::vector<uint64_t> ids;
+	uint8_t queue = 0;
+};
+
+static inline struct mesh_pick*
+get_pick(lua_State *L, struct ecs_world *w) {
+	if (w->mesh_pick == nullptr) {
+		luaL_error(L, "pick.mesh is not initialized");
+	}
+	return w->mesh_pick;
+}
+
+// the selectable entities with a pick mesh, in the pickup queue, with their world matrix and world aabb
+static void
+collect_instances(struct ecs_world *w, struct mesh_pick *mp) {
+	auto M = w->math3d->M;
+	mp->instances.clear();
+	for (auto& e : ecs::cached_select(mp->pick_obj)) {
+		const auto& pm = e.get<component::pick_mesh>();
+		const auto& ro = e.get<component::render_object>();
+		const auto& b = e.get<component::bounding>();
+		if (pm.mesh <= 0 || pm.mesh > (int)mp->meshes.size() || !mp->meshes[pm.mesh-1]
+			|| math_isnull(b.scene_aabb) || math_isnull(ro.worldmat)
+			|| !queue_check(w->Q, ro.visible_idx, mp->queue)) {
+			continue;
+		}
+		pick_instance inst;
+		inst.id = (uint64_t)e.get<component::eid>();
+		inst.mesh = mp->meshes[pm.mesh-1].get();
+		memcpy(inst.world, math_value(M, ro.worldmat), sizeof(inst.world));
+		const float *aabb = math_value(M, b.scene_aabb);
+		memcpy(inst.aabb, aabb, sizeof(float) * 3);
+		memcpy(inst.aabb + 3, aabb + 4, sizeof(float) * 3);
+		mp->instances.push_back(inst);
+	}
+}
+
+// init(queue_index), the entities in the queue are picked
+static int
+linit(lua_State *L) {
+	auto w = getworld(L);
+	const lua_Integer queue = luaL_checkinteger(L, 1);
+	luaL_argcheck(L, queue >= 0 && queue < MAX_VISIBLE_QUEUE, 1, "invalid queue index");
+	w->mesh_pick = new struct mesh_pick(w->ecs);
+	w->mesh_pick->queue = (uint8_t)queue;
+	return 0;
+}
+
+static int
+lexit(lua_State *L) {
+	auto w = getworld(L);
+	delete w->mesh_pick;
+	w->mesh_pick = nullptr;
+	return 0;
+}
+
+// mesh(vb, stride, vbnum [, ib, ibnum, index32]) returns the id for pick_mesh.mesh and the number of triangles.
+// The positions are 3 floats at the beginning of each vertex, without ib the vertices are a triangle list.
+static int
+lmesh(lua_State *L) {
+	auto mp = get_pick(L, getworld(L));
+	size_t vbsize;
+	const char *vb = luaL_checklstring(L, 1, &vbsize);
+	const lua_Integer stride = luaL_checkinteger(L, 2);
+	const lua_Integer vbnum = luaL_checkinteger(L, 3);
+	luaL_argcheck(L, stride >= (lua_Integer)sizeof(float) * 3, 2, "the stride is less than a position");
+	luaL_argcheck(L, vbnum >= 0 && (vbnum == 0 || (size_t)(vbnum - 1) * stride + sizeof(float) * 3 <= vbsize), 3, "the vertices are out of vb");
+	const char *ib = nullptr;
+	lua_Integer ibnum = 0;
+	bool index32 = false;
+	if (!lua_isnoneornil(L, 4)) {
+		size_t ibsize;
+		ib = luaL_checklstring(L, 4, &ibsize);
+		ibnum = luaL_checkinteger(L, 5);
+		index32 = lua_toboolean(L, 6);
+		luaL_argcheck(L, ibnum >= 0 && (size_t)ibnum * (index32 ? 4 : 2) <= ibsize, 5, "the indices are out of ib");
+	}
+	// the strings are not aligned for the index type, copy them
+	std::vector<uint8_t> indices(ib ? (size_t)ibnum * (index32 ? 4 : 2) : 0);
+	if (ib) {
+		memcpy(indices.data(), ib, indices.size());
+	}
+	auto bvh = std::make_unique<mesh_bvh>(vb, (uint32_t)stride, (uint32_t)vbnum, ib ? indices.data() : nullptr, (uint32_t)ibnum, index32);
+	const uint32_t triangles = bvh->triangles();
+	int idx;
+	if (mp->free_meshes.empty()) {
+		idx = (int)mp->meshes.size();
+		mp->meshes.emplace_back(std::move(bvh));
+	} else {
+		idx = mp->free_meshes.back();
+		mp->free_meshes.pop_back();
+		mp->meshes[idx] = std::move(bvh);
+	}
+	lua_pushinteger(L, idx + 1);
+	lua_pushinteger(L, triangles);
+	return 2;
+}
+
+static int
+lmesh_release(lua_State *L) {
+	auto mp = get_pick(L, getworld(L));
+	const lua_Integer id = luaL_checkinteger(L, 1);
+	luaL_argcheck(L, id > 0 && id <= (lua_Integer)mp->meshes.size() && mp->meshes[id-1], 1, "invalid pick mesh");
+	mp->meshes[id-1].reset();
+	mp->free_meshes.push_back((int)id-1);
+	return 0;
+}
+
+// ray(ox, oy, oz, dx, dy, dz) returns eid, x, y, z, nx, ny, nz of the nearest hit in world space, or nothing
+static int
+lray(lua_State *L) {
+	auto w = getworld(L);
+	auto mp = get_pick(L, w);
+	float org[3], dir[3];
+	for (int i = 0; i < 3; ++i) {
+		org[i] = (float)luaL_checknumber(L, 1 + i);
+		dir[i] = (float)luaL_checknumber(L, 4 + i);
+	}
+	collect_instances(w, mp);
+	pick_result r;
+	if (!pick_ray(mp->instances.data(), mp->instances.size(), org, dir, r)) {
+		return 0;
+	}
+	lua_pushinteger(L, (lua_Integer)r.id);
+	for (int i = 0; i < 3; ++i) {
+		lua_pushnumber(L, r.point[i]);
+	}
+	for (int i = 0; i < 3; ++i) {
+		lua_pushnumber(L, r.normal[i]);
+	}
+	return 7;
+}
+
+// rect(viewproj, x0, y0, x1, y1, zmin, zmax) returns the eids with a triangle in the rect of the normalized device
+// coordinates; viewproj is a serialized matrix, zmin and zmax are the depth range of the device
+static int
+lrect(lua_State *L) {
+	auto w = getworld(L);
+	auto mp = get_pick(L, w);
+	size_t sz;
+	const char *vp = luaL_checklstring(L, 1, &sz);
+	luaL_argcheck(L, sz == sizeof(float) * 16, 1, "need a serialized matrix");
+	float viewproj[16];
+	memcpy(viewproj, vp, sizeof(viewproj));
+	const float x0 = (float)luaL_checknumber(L, 2), y0 = (float)luaL_checknumber(L, 3);
+	const float x1 = (float)luaL_checknumber(L, 4), y1 = (float)luaL_checknumber(L, 5);
+	const float zmin = (float)luaL_checknumber(L, 6), zmax = (float)luaL_checknumber(L, 7);
+	float planes[6][4];
+	pick_frustum(viewproj, std::min(x0, x1), std::min(y0, y1), std::max(x0, x1), std::max(y0, y1), zmin, zmax, planes);
+
+	collect_instances(w, mp);
+	mp->ids.clear();
+	pick_volume(mp->instances.data(), mp->instances.size(), planes, 6, mp->ids);
+	lua_createtable(L, (int)mp->ids.size(), 0);
+	for (size_t i = 0; i < mp->ids.size(); ++i) {
+		lua_pushinteger(L, (lua_Integer)mp->ids[i]);
+		lua_seti(L, -2, (lua_Integer)i+1);
+	}
+	return 1;
+}
+
+extern "C" int
+luaopen_pick_mesh(lua_State *L) {
+	luaL_checkversion(L);
+	luaL_Reg l[] = {
+		{ "init", linit },
+		{ "exit", lexit },
+		{ "mesh", lmesh },
+		{ "mesh_release", lmesh_release },
+		{ "ray", lray },
+		{ "rect", lrect },
+		{ NULL, NULL },
+	};
+	luaL_newlibtable(L,l);
+	lua_pushnil(L);
+	luaL_setfuncs(L,l,1);
+	return 1;
+}
@@ -0,0 +1,434 @@
+// Rays and rects against cubes and spheres with known answers, and against a brute force
+// test of every triangle: the hierarchy must find the same nearest hit, whatever the index
+// format, the vertex stride and the transform of the instance.
+#include "../mesh_bvh.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static float frand(float a, float b) {
+    return a + (b - a) * (float)rand() / (float)RAND_MAX;
+}
+
+struct mesh {
+    std::vector<float> positions;   // xyz
+    std::vector<uint32_t> indices;
+};
+
+// 24 vertices, 12 triangles, counter clockwise seen from outside
+static mesh cube(float h) {
+    mesh m;
+    const float n[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+    for (int f = 0; f < 6; ++f) {
+        const float* z = n[f];
+        // two axes across the face, u x v = z
+        const float u[3] = { z[2], z[0], z[1] };
+        const float v[3] = { z[1] * u[2] - z[2] * u[1], z[2] * u[0] - z[0] * u[2], z[0] * u[1] - z[1] * u[0] };
+        const uint32_t base = (uint32_t)m.positions.size() / 3;
+        const float corners[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+        for (auto& c : corners) {
+            for (int i = 0; i < 3; ++i) {
+                m.positions.push_back(h * (z[i] + c[0] * u[i] + c[1] * v[i]));
+            }
+        }
+        m.indices.insert(m.indices.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+    }
+    return m;
+}
+
+static mesh sphere(float r, uint32_t rings, uint32_t segments) {
+    mesh m;
+    for (uint32_t i = 0; i <= rings; ++i) {
+        const float theta = 3.14159265f * i / rings;
+        for (uint32_t j = 0; j <= segments; ++j) {
+            const float phi = 2.f * 3.14159265f * j / segments;
+            m.positions.insert(m.positions.end(), { r * std::sin(theta) * std::cos(phi), r * std::cos(theta), r * std::sin(theta) * std::sin(phi) });
+        }
+    }
+    for (uint32_t i = 0; i < rings; ++i) {
+        for (uint32_t j = 0; j < segments; ++j) {
+            const uint32_t a = i * (segments + 1) + j, b = a + segments + 1;
+            m.indices.insert(m.indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+        }
+    }
+    return m;
+}
+
+static mesh soup(uint32_t n) {
+    mesh m;
+    for (uint32_t t = 0; t < n; ++t) {
+        const float c[3] = { frand(-10, 10), frand(-10, 10), frand(-10, 10) };
+        for (int k = 0; k < 3; ++k) {
+            m.positions.insert(m.positions.end(), { c[0] + frand(-1, 1), c[1] + frand(-1, 1), c[2] + frand(-1, 1) });
+        }
+    }
+    return m;
+}
+
+static mesh_bvh build(const mesh& m) {
+    return mesh_bvh(m.positions.data(), 12, (uint32_t)m.positions.size() / 3,
+        m.indices.empty() ? nullptr : m.indices.data(), (uint32_t)m.indices.size(), true);
+}
+
+// the nearest triangle by testing all of them, in the space of the mesh
+static bool brute(const mesh& m, const float o[3], const float d[3], float& best, uint32_t& tri) {
+    const uint32_t count = (uint32_t)(m.indices.empty() ? m.positions.size() / 3 : m.indices.size()) / 3;
+    bool found = false;
+    best = INFINITY;
+    for (uint32_t t = 0; t < count; ++t) {
+        double v[3][3];
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t vi = m.indices.empty() ? t * 3 + k : m.indices[t * 3 + k];
+            for (int i = 0; i < 3; ++i) {
+                v[k][i] = m.positions[vi * 3 + i];
+            }
+        }
+        const double e1[3] = { v[1][0] - v[0][0], v[1][1] - v[0][1], v[1][2] - v[0][2] };
+        const double e2[3] = { v[2][0] - v[0][0], v[2][1] - v[0][1], v[2][2] - v[0][2] };
+        const double p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+        const double det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+        if (det == 0.0) {
+            continue;
+        }
+        const double s[3] = { o[0] - v[0][0], o[1] - v[0][1], o[2] - v[0][2] };
+        const double u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / det;
+        const double q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+        const double w = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) / det;
+        const double tt = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / det;
+        if (u < 0 || w < 0 || u + w > 1 || tt < 0 || tt > best) {
+            continue;
+        }
+        best = (float)tt;
+        tri = t;
+        found = true;
+    }
+    return found;
+}
+
+// column major: rotation about y, uniform scale, then translation
+static void trs(float m[16], float angle, float s, float x, float y, float z) {
+    const float c = std::cos(angle), n = std::sin(angle);
+    const float r[16] = {
+        c * s, 0, -n * s, 0,
+        0, s, 0, 0,
+        n * s, 0, c * s, 0,
+        x, y, z, 1,
+    };
+    memcpy(m, r, sizeof(r));
+}
+
+static void world_aabb(const mesh_bvh& b, const float m[16], float aabb[6]) {
+    const float* box = b.bounds();
+    for (int i = 0; i < 3; ++i) {
+        aabb[i] = INFINITY;
+        aabb[3 + i] = -INFINITY;
+    }
+    for (int c = 0; c < 8; ++c) {
+        const float p[3] = { box[(c & 1) ? 3 : 0], box[(c & 2) ? 4 : 1], box[(c & 4) ? 5 : 2] };
+        for (int i = 0; i < 3; ++i) {
+            const float v = m[i] * p[0] + m[4 + i] * p[1] + m[8 + i] * p[2] + m[12 + i];
+            aabb[i] = std::fmin(aabb[i], v);
+            aabb[3 + i] = std::fmax(aabb[3 + i], v);
+        }
+    }
+}
+
+static pick_instance instance(uint64_t id, const mesh_bvh& b, float angle, float s, float x, float y, float z) {
+    pick_instance inst;
+    inst.id = id;
+    inst.mesh = &b;
+    trs(inst.world, angle, s, x, y, z);
+    world_aabb(b, inst.world, inst.aabb);
+    return inst;
+}
+
+// left handed perspective looking along +z, depth 0 at n, 1 at f, column major
+static void perspective(float m[16], float fovy, float aspect, float n, float f) {
+    const float c = 1.f / std::tan(fovy * 0.5f);
+    for (int i = 0; i < 16; ++i) {
+        m[i] = 0.f;
+    }
+    m[0] = c / aspect;
+    m[5] = c;
+    m[10] = f / (f - n);
+    m[11] = 1.f;
+    m[14] = -n * f / (f - n);
+}
+
+static bool near_eq(float a, float b, float eps) {
+    return std::fabs(a - b) <= eps * (1.f + std::fabs(a) + std::fabs(b));
+}
+
+int main() {
+    int failed = 0;
+    auto check = [&](bool ok, const char* what) {
+        if (!ok) {
+            printf("FAILED: %s\n", what);
+            failed++;
+        }
+    };
+
+    // a cube of half size 0.5
+    {
+        const mesh m = cube(0.5f);
+        const mesh_bvh b = build(m);
+        check(b.triangles() == 12, "the cube has 12 triangles");
+        check(b.bounds()[0] == -0.5f && b.bounds()[5] == 0.5f, "the bounds of the cube");
+        const float o[3] = { 0.1f, 0.2f, 5.f }, d[3] = { 0, 0, -1 };
+        mesh_hit h;
+        check(b.intersect(o, d, INFINITY, h) && near_eq(h.t, 4.5f, 1e-6f), "a ray down -z hits the front face");
+        check(h.normal[2] > 0.f && h.normal[0] == 0.f && h.normal[1] == 0.f, "the normal of the front face");
+        check(!b.intersect(o, d, 4.f, h), "a hit past tmax is no hit");
+        const float inside[3] = { 0, 0, 0 };
+        check(b.intersect(inside, d, INFINITY, h) && near_eq(h.t, 0.5f, 1e-6f), "a ray from inside hits the back of a face");
+        const float miss[3] = { 0.6f, 0.f, 5.f };
+        check(!b.intersect(miss, d, INFINITY, h), "a ray beside the cube misses");
+        const float away[3] = { 0, 0, 1 };
+        check(!b.intersect(o, away, INFINITY, h), "a ray away from the cube misses");
+        // along an edge of the slabs, a zero component of the direction
+        const float edge[3] = { 0.5f, 0.f, 5.f };
+        check(b.intersect(edge, d, INFINITY, h) && near_eq(h.t, 4.5f, 1e-6f), "a ray on the plane of a face hits its edge");
+    }
+
+    // the index formats and the vertex stride
+    {
+        srand(3);
+        const mesh m = sphere(2.f, 24, 48);
+        const uint32_t nv = (uint32_t)m.positions.size() / 3;
+        std::vector<uint16_t> i16(m.indices.begin(), m.indices.end());
+        // position, normal, uv: 32 bytes a vertex
+        std::vector<float> wide(nv * 8, 7.f);
+        std::vector<float> list;
+        for (uint32_t v = 0; v < nv; ++v) {
+            memcpy(&wide[v * 8], &m.positions[v * 3], 12);
+        }
+        for (uint32_t idx : m.indices) {
+            list.insert(list.end(), { m.positions[idx * 3], m.positions[idx * 3 + 1], m.positions[idx * 3 + 2] });
+        }
+        const mesh_bvh a(m.positions.data(), 12, nv, m.indices.data(), (uint32_t)m.indices.size(), true);
+        const mesh_bvh b(wide.data(), 32, nv, i16.data(), (uint32_t)i16.size(), false);
+        const mesh_bvh c(list.data(), 12, (uint32_t)list.size() / 3, nullptr, 0, false);
+        bool same = a.triangles() == b.triangles() && a.triangles() == c.triangles(), radius = true;
+        for (int r = 0; r < 500; ++r) {
+            const float o[3] = { frand(-5, 5), frand(-5, 5), -8.f };
+            const float d[3] = { -o[0] * frand(0.f, 0.5f), -o[1] * frand(0.f, 0.5f), 8.f };
+            mesh_hit ha, hb, hc;
+            const bool ka = a.intersect(o, d, INFINITY, ha), kb = b.intersect(o, d, INFINITY, hb), kc = c.intersect(o, d, INFINITY, hc);
+            same = same && ka == kb && ka == kc;
+            if (ka && kb && kc) {
+                same = same && ha.t == hb.t && ha.triangle == hb.triangle && ha.t == hc.t && ha.triangle == hc.triangle;
+                const float p[3] = { o[0] + d[0] * ha.t, o[1] + d[1] * ha.t, o[2] + d[2] * ha.t };
+                radius = radius && std::fabs(std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]) - 2.f) < 0.02f;
+            }
+        }
+        check(same, "16 and 32 bit indices, a wider stride and a triangle list give the same hits");
+        check(radius, "the hits on the sphere are on its surface");
+        const uint32_t bad[6] = { 0, 1, 2, 0, 1, nv };
+        const mesh_bvh d(m.positions.data(), 12, nv, bad, 6, true);
+        check(d.triangles() == 1, "a triangle with an index out of the vertices is skipped");
+        const mesh_bvh e(m.positions.data(), 12, 0, nullptr, 0, false);
+        const float o[3] = { 0, 0, 0 }, dir[3] = { 1, 0, 0 };
+        mesh_hit h;
+        check(e.triangles() == 0 && !e.intersect(o, dir, INFINITY, h), "an empty mesh has no hit");
+    }
+
+    // against the brute force
+    {
+        srand(7);
+        const mesh m = soup(3000);
+        const mesh_bvh b = build(m);
+        int mismatch = 0, hits = 0;
+        for (int r = 0; r < 2000; ++r) {
+            const float o[3] = { frand(-15, 15), frand(-15, 15), frand(-15, 15) };
+            const float d[3] = { frand(-1, 1), frand(-1, 1), frand(-1, 1) };
+            mesh_hit h;
+            float t;
+            uint32_t tri = 0;
+            const bool kb = b.intersect(o, d, INFINITY, h);
+            const bool kt = brute(m, o, d, t, tri);
+            if (kb != kt || (kb && !near_eq(h.t, t, 1e-4f))) {
+                ++mismatch;
+            }
+            hits += kb;
+        }
+        check(mismatch == 0, "the nearest hit is the one of the brute force");
+        check(hits > 200, "the random rays hit the soup");
+        check(b.nodes() < b.triangles(), "the leaves hold several triangles");
+
+        const mesh big = sphere(10.f, 256, 512);
+        const mesh_bvh bb = build(big);
+        std::vector<float> rays;
+        for (int r = 0; r < 200; ++r) {
+            rays.insert(rays.end(), { frand(-12, 12), frand(-12, 12), -20.f, frand(-0.3f, 0.3f), frand(-0.3f, 0.3f), 1.f });
+        }
+        auto now = [] { return std::chrono::steady_clock::now(); };
+        int agree = 0;
+        const auto t0 = now();
+        for (size_t r = 0; r < rays.size(); r += 6) {
+            mesh_hit h;
+            agree += bb.intersect(&rays[r], &rays[r + 3], INFINITY, h);
+        }
+        const auto t1 = now();
+        for (size_t r = 0; r < rays.size(); r += 6) {
+            float t;
+            uint32_t tri;
+            agree -= brute(big, &rays[r], &rays[r + 3], t, tri);
+        }
+        const auto t2 = now();
+        check(agree == 0, "the big sphere is hit by the same rays");
+        const double us_bvh = std::chrono::duration<double, std::micro>(t1 - t0).count() / 200;
+        const double us_brute = std::chrono::duration<double, std::micro>(t2 - t1).count() / 200;
+        printf("sphere of %u triangles, %u nodes: %.2f us a ray against %.1f us testing every triangle\n",
+            bb.triangles(), bb.nodes(), us_bvh, us_brute);
+    }
+
+    // instances: the transform, the nearest instance, the world normal
+    {
+        const mesh cm = cube(0.5f);
+        const mesh sm = sphere(1.f, 32, 64);
+        const mesh_bvh cb = build(cm), sb = build(sm);
+        std::vector<pick_instance> scene = {
+            instance(1, cb, 0.f, 2.f, 10.f, 0.f, 0.f),              // a cube of size 2 at x 10
+            instance(2, sb, 0.f, 2.f, 20.f, 0.f, 0.f),              // a sphere of radius 2 behind it
+            instance(3, cb, 0.785398f, 1.f, 0.f, 0.f, 10.f),        // a cube turned by 45 degrees
+            instance(4, sb, 0.f, 3.f, 0.f, 0.f, -10.f),             // a sphere of radius 3
+        };
+        pick_result r;
+        const float o[3] = { 0, 0, 0 };
+        const float dx[3] = { 1, 0, 0 };
+        check(pick_ray(scene.data(), scene.size(), o, dx, r) && r.id == 1, "the nearest instance along the ray");
+        check(near_eq(r.t, 9.f, 1e-5f) && near_eq(r.point[0], 9.f, 1e-5f), "the hit point is on the scaled cube");
+        check(near_eq(r.normal[0], -1.f, 1e-5f) && std::fabs(r.normal[1]) < 1e-5f, "the normal faces the ray");
+
+        // the turned cube is hit at its edge, sqrt(2) / 2 from its center
+        const float dz[3] = { 0, 0, 1 };
+        check(pick_ray(scene.data(), scene.size(), o, dz, r) && r.id == 3 && near_eq(r.t, 10.f - 0.70710678f, 1e-5f), "a rotated instance");
+        const float n45 = 0.70710678f;
+        check(std::fabs(std::fabs(r.normal[0]) - n45) < 1e-4f && near_eq(r.normal[2], -n45, 1e-4f), "the normal of a rotated face");
+
+        // the scaled sphere, with a direction not normalized
+        const float dnz[3] = { 0, 0, -4 };
+        check(pick_ray(scene.data(), scene.size(), o, dnz, r) && r.id == 4 && std::fabs(r.point[2] + 7.f) < 0.01f, "a scaled sphere, t along a longer direction");
+        check(near_eq(r.normal[2], 1.f, 1e-3f), "the normal of a scaled instance is normalized");
+
+        // past the cube to the sphere
+        const float o2[3] = { 0, 1.5f, 0 };
+        check(pick_ray(scene.data(), scene.size(), o2, dx, r) && r.id == 2, "a ray over the cube hits the sphere behind");
+        const float up[3] = { 0, 1, 0 };
+        check(!pick_ray(scene.data(), scene.size(), o, up, r), "a ray hitting nothing");
+
+        // the aabb of the sphere is hit, the sphere is not
+        const float o3[3] = { 0.9f, 0.9f, 0.f };
+        const float dz2[3] = { 0.f, 0.f, -1.f };
+        scene[3] = instance(4, sb, 0.f, 1.f, 0.f, 0.f, -10.f);
+        check(!pick_ray(&scene[3], 1, o3, dz2, r), "a corner of the bounds is not the sphere");
+
+        // a singular matrix is skipped
+        pick_instance flat = instance(5, cb, 0.f, 0.f, 0.f, 0.f, 3.f);
+        check(!pick_ray(&flat, 1, o, dz, r), "a scale of zero is never hit");
+
+        // a random scene against the brute force in the space of each instance
+        srand(13);
+        std::vector<pick_instance> many;
+        for (uint64_t i = 0; i < 200; ++i) {
+            many.push_back(instance(100 + i, (i & 1) ? cb : sb, frand(0.f, 6.28f), frand(0.2f, 2.f), frand(-30, 30), frand(-30, 30), frand(-30, 30)));
+        }
+        int mismatch = 0, hits = 0;
+        for (int k = 0; k < 1000; ++k) {
+            const float ro[3] = { frand(-40, 40), frand(-40, 40), frand(-40, 40) };
+            const float rd[3] = { -ro[0] + frand(-20, 20), -ro[1] + frand(-20, 20), -ro[2] + frand(-20, 20) };
+            float best = INFINITY;
+            uint64_t id = 0;
+            for (const auto& inst : many) {
+                // the inverse of a rotation about y, a uniform scale and a translation
+                const float* m = inst.world;
+                const float s2 = m[0] * m[0] + m[2] * m[2];
+                float lo[3], ld[3];
+                const float t[3] = { ro[0] - m[12], ro[1] - m[13], ro[2] - m[14] };
+                for (int i = 0; i < 3; ++i) {
+                    lo[i] = (m[i * 4] * t[0] + m[i * 4 + 1] * t[1] + m[i * 4 + 2] * t[2]) / s2;
+                    ld[i] = (m[i * 4] * rd[0] + m[i * 4 + 1] * rd[1] + m[i * 4 + 2] * rd[2]) / s2;
+                }
+                float tt;
+                uint32_t tri;
+                if (brute((inst.mesh == &cb) ? cm : sm, lo, ld, tt, tri) && tt < best) {
+                    best = tt;
+                    id = inst.id;
+                }
+            }
+            const bool k1 = pick_ray(many.data(), many.size(), ro, rd, r);
+            if (k1 != (id != 0) || (k1 && (r.id != id && !near_eq(r.t, best, 1e-4f)))) {
+                ++mismatch;
+            }
+            hits += k1;
+        }
+        check(mismatch == 0, "the nearest instance is the one of the brute force");
+        printf("200 instances, 1000 rays: %d hits\n", hits);
+    }
+
+    // rects: a camera at the origin looking along +z
+    {
+        const mesh cm = cube(0.5f);
+        const mesh_bvh cb = build(cm);
+        float vp[16];
+        perspective(vp, 1.5707963f, 1.f, 0.1f, 100.f);
+        std::vector<pick_instance> scene = {
+            instance(1, cb, 0.f, 1.f, -5.f, 0.f, 10.f),     // left
+            instance(2, cb, 0.f, 1.f, 5.f, 0.f, 10.f),      // right
+            instance(3, cb, 0.f, 1.f, 0.f, 0.f, -10.f),     // behind the camera
+            instance(4, cb, 0.f, 1.f, 0.f, 0.f, 200.f),     // past the far plane
+            instance(5, cb, 0.f, 1.f, 0.f, 5.f, 10.f),      // top
+        };
+        float planes[6][4];
+        std::vector<uint64_t> ids;
+        pick_frustum(vp, -1.f, -1.f, 1.f, 1.f, 0.f, 1.f, planes);
+        pick_volume(scene.data(), scene.size(), planes, 6, ids);
+        check(ids == std::vector<uint64_t>({ 1, 2, 5 }), "the whole screen selects the instances in the view volume");
+
+        ids.clear();
+        pick_frustum(vp, -1.f, -1.f, 0.f, 1.f, 0.f, 1.f, planes);
+        pick_volume(scene.data(), scene.size(), planes, 6, ids);
+        check(ids == std::vector<uint64_t>({ 1, 5 }), "the left half of the screen, and what crosses its edge");
+
+        ids.clear();
+        pick_frustum(vp, -0.2f, 0.2f, 0.2f, 1.f, 0.f, 1.f, planes);
+        pick_volume(scene.data(), scene.size(), planes, 6, ids);
+        check(ids == std::vector<uint64_t>({ 5 }), "the top of the screen");
+
+        // the depth range of a device with homogeneous depth
+        ids.clear();
+        pick_frustum(vp, -1.f, -1.f, 1.f, 1.f, -1.f, 1.f, planes);
+        pick_volume(scene.data(), scene.size(), planes, 6, ids);
+        check(ids.size() == 3 && ids[0] == 1, "a depth range from -1");
+
+        // a rect across the bounds of a thin diagonal strip misses its triangles
+        mesh strip;
+        const uint32_t SEG = 64;
+        for (uint32_t i = 0; i <= SEG; ++i) {
+            const float x = -4.f + 8.f * i / SEG;
+            strip.positions.insert(strip.positions.end(), { x, x - 0.05f, 10.f, x, x + 0.05f, 10.f });
+        }
+        for (uint32_t i = 0; i < SEG; ++i) {
+            const uint32_t a = i * 2;
+            strip.indices.insert(strip.indices.end(), { a, a + 2, a + 1, a + 1, a + 2, a + 3 });
+        }
+        const mesh_bvh sb = build(strip);
+        pick_instance diag = instance(9, sb, 0.f, 1.f, 0.f, 0.f, 0.f);
+        ids.clear();
+        // x in [2, 3], y in [-3, -2] at z 10: in the bounds of the strip, away from the diagonal
+        pick_frustum(vp, 0.2f, -0.3f, 0.3f, -0.2f, 0.f, 1.f, planes);
+        pick_volume(&diag, 1, planes, 6, ids);
+        check(ids.empty(), "the bounds of a mesh in the rect are not enough");
+        ids.clear();
+        pick_frustum(vp, 0.2f, 0.2f, 0.3f, 0.3f, 0.f, 1.f, planes);
+        pick_volume(&diag, 1, planes, 6, ids);
+        check(ids.size() == 1 && ids[0] == 9, "a rect on the diagonal selects the strip");
+    }
+
+    printf(failed ? "mesh bvh: %d failure(s)\n" : "mesh bvh: ok\n", failed);
+    return failed ? 1 : 0;
+}
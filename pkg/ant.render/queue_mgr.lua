@@ -59,6 +59,11 @@ do
 	register_queue("csm2_queue", 			shadow_material_idx)
 	register_queue("csm3_queue", 			shadow_material_idx)
 	register_queue("csm4_queue", 			shadow_material_idx)
+	-- the static casters of graphic/shadow/static_cache
+	register_queue("csm_static1_queue",		shadow_material_idx)
+	register_queue("csm_static2_queue",		shadow_material_idx)
+	register_queue("csm_static3_queue",		shadow_material_idx)
+	register_queue("csm_static4_queue",		shadow_material_idx)
 	register_queue("bake_lightmap_queue",	alloc_material())
 
 	m.alloc_material = alloc_material
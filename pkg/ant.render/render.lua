@@ -15,6 +15,7 @@ local ig			= ecs.require "ant.group|group"
 local ivm			= ecs.require "visible_mask"
 local queuemgr		= ecs.require "queue_mgr"
 local INV_Z<const>	= setting:get "graphic/inv_z"
+local SC			= setting:get "graphic/shadow/enable" and setting:get "graphic/shadow/static_cache" and world:clibs "shadow.cache" or nil
 
 local irender		= {}
 
@@ -87,14 +88,26 @@ function irender.read_render_buffer_content(format, rb_idx, force_read, size)
 	return memory_handle, size.w, size.h, size.w * elem_size
 end
 
+-- a static caster hidden at runtime has to leave the cached static shadow layer
+local function shadow_shown(e)
+	if SC then
+		w:extend(e, "cast_shadow?in visible?in eid:in")
+		if e.cast_shadow then
+			SC.shown(e.eid, e.visible and ivm.check(e, "cast_shadow"))
+		end
+	end
+end
+
 function irender.set_visible_by_eid(eid, visible)
 	local e <close> = world:entity(eid, "visible?out")
 	e.visible = visible
+	shadow_shown(e)
 end
 
 function irender.set_visible(e, visible)
 	w:extend(e, "visible?out")
 	e.visible = visible
+	shadow_shown(e)
 end
 
 function irender.is_visible(e)
@@ -104,6 +117,7 @@ end
 
 function irender.set_castshadow(e, cast)
 	ivm.set_masks(e, "cast_shadow", cast)
+	shadow_shown(e)
 end
 
 function irender.is_castshadow(e)
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+
+// Mesh LOD selection. The model compiler writes every level into one index buffer,
+// a level is a range of it and all levels share the vertex buffers.
+static constexpr uint8_t MAX_LOD = 4;
+
+struct lod_level {
+    uint32_t start;     // relative to the index buffer start of the mesh
+    uint32_t num;
+    float error;        // object space error relative to the bounding sphere radius
+};
+
+struct lod_node {
+    float sphere[4];    // object space bounding sphere: center, radius
+    lod_level levels[MAX_LOD];
+    uint8_t num;
+    uint8_t current;
+    void clear() {
+        num = current = 0;
+    }
+};
+
+struct lod_camera {
+    float eye[3];
+    float proj_scale;   // projmat[1][1], 1/tan(fovy/2)
+    float viewport_h;
+    float threshold;    // allowed screen space error in pixels
+    float hysteresis;   // a coarser level is taken only below threshold * (1 - hysteresis)
+};
+
+// radius in pixels of the bounding sphere, wm is a column major world matrix.
+// Returns a huge size when the eye is inside the sphere.
+inline float
+lod_screen_radius(const lod_node& n, const float wm[16], const lod_camera& c) {
+    const float* s = n.sphere;
+    float center[3];
+    for (int i = 0; i < 3; ++i) {
+        center[i] = wm[i] * s[0] + wm[4 + i] * s[1] + wm[8 + i] * s[2] + wm[12 + i];
+    }
+    float scale2 = 0.f;
+    for (int col = 0; col < 3; ++col) {
+        const float* a = wm + col * 4;
+        const float l2 = a[0] * a[0] + a[1] * a[1] + a[2] * a[2];
+        scale2 = l2 > scale2 ? l2 : scale2;
+    }
+    const float radius = s[3] * std::sqrt(scale2);
+    const float dx = center[0] - c.eye[0], dy = center[1] - c.eye[1], dz = center[2] - c.eye[2];
+    const float dist = std::sqrt(dx * dx + dy * dy + dz * dz);
+    if (dist <= radius) {
+        return INFINITY;
+    }
+    return radius * c.proj_scale / dist * c.viewport_h * 0.5f;
+}
+
+// the coarsest level whose error stays under the threshold, from the current level
+inline uint8_t
+lod_select(const lod_node& n, float screen_radius, const lod_camera& c) {
+    if (n.num == 0) {
+        return 0;
+    }
+    uint8_t level = 0;
+    for (uint8_t i = n.num - 1; i > 0; --i) {
+        const float limit = i > n.current ? c.threshold * (1.f - c.hysteresis) : c.threshold;
+        if (n.levels[i].error * screen_radius <= limit) {
+            level = i;
+            break;
+        }
+    }
+    return level;
+}
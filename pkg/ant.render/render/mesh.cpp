@@ -60,6 +60,14 @@ mesh_fetch(struct mesh_container* MESH, int Midx){
     return nullptr;
 }
 
+void
+mesh_update_lod(struct mesh_container* MESH, int Midx, const float* worldmat, const struct lod_camera &camera){
+    auto &lod = MESH->fetch(Midx)->lod;
+    if (lod.num > 1){
+        lod.current = lod_select(lod, lod_screen_radius(lod, worldmat, camera), camera);
+    }
+}
+
 static int
 lmesh_dealloc(lua_State *L){
     auto w = getworld(L);
@@ -184,6 +192,60 @@ lmesh_fetch(lua_State *L){
     return 3;
 }
 
+static float
+get_number(lua_State *L, int idx, const char* field){
+    lua_getfield(L, idx, field);
+    const float v = (float)luaL_checknumber(L, -1);
+    lua_pop(L, 1);
+    return v;
+}
+
+// set_lod(mesh_idx, { sphere = {x, y, z, r}, levels = { {start=, num=, error=}, ... } }), nil to remove
+static int
+lmesh_set_lod(lua_State *L){
+    auto w = getworld(L);
+    const int Midx = (int)luaL_checkinteger(L, 1);
+    if (!w->MESH->isvalid(Midx)){
+        return luaL_error(L, "Invalid mesh index");
+    }
+    auto &lod = w->MESH->fetch(Midx)->lod;
+    lod.clear();
+    if (lua_isnoneornil(L, 2)){
+        return 0;
+    }
+    luaL_checktype(L, 2, LUA_TTABLE);
+
+    if (lua_getfield(L, 2, "sphere") != LUA_TTABLE){
+        return luaL_error(L, "Need lod sphere");
+    }
+    for (int i=0; i<4; ++i){
+        lua_geti(L, -1, i+1);
+        lod.sphere[i] = (float)luaL_checknumber(L, -1);
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+
+    if (lua_getfield(L, 2, "levels") != LUA_TTABLE){
+        return luaL_error(L, "Need lod levels");
+    }
+    const lua_Integer n = luaL_len(L, -1);
+    if (n > MAX_LOD){
+        return luaL_error(L, "Too many lod levels: %d, max: %d", (int)n, (int)MAX_LOD);
+    }
+    for (lua_Integer i=1; i<=n; ++i){
+        lua_geti(L, -1, i);
+        luaL_checktype(L, -1, LUA_TTABLE);
+        auto &l = lod.levels[i-1];
+        l.start = (uint32_t)get_number(L, -1, "start");
+        l.num   = (uint32_t)get_number(L, -1, "num");
+        l.error = get_number(L, -1, "error");
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+    lod.num = (uint8_t)n;
+    return 0;
+}
+
 extern "C" int
 luaopen_render_mesh(lua_State *L){
     luaL_checkversion(L);
@@ -195,6 +257,7 @@ luaopen_render_mesh(lua_State *L){
         { "set_start",	lmesh_set_start},
         { "set_num",	lmesh_set_num},
         { "set_handle",	lmesh_set_handle},
+        { "set_lod",	lmesh_set_lod},
 
         { "fetch_range",lmesh_fetch_range},
         { "fetch_handle",lmesh_fetch_handle},
@@ -2,6 +2,8 @@
 
 #include <cstdint>
 
+#include "lod.h"
+
 struct buffer_node {
     uint32_t start;
     uint32_t num;
@@ -25,14 +27,18 @@ enum BufferType : uint8_t {
 
 struct mesh_node {
     buffer_node buffers[BT_count];
+    lod_node lod;
     void clear() {
         for (auto &b :buffers){
             b.clear();
         }
+        lod.clear();
     }
 };
 
 struct mesh_container;
 struct mesh_container* mesh_create();
 void mesh_destroy(struct mesh_container *MESH);
-const struct mesh_node* mesh_fetch(struct mesh_container* MESH, int Midx);
\ No newline at end of file
+const struct mesh_node* mesh_fetch(struct mesh_container* MESH, int Midx);
+// select the LOD level submitted for the mesh, worldmat is column major
+void mesh_update_lod(struct mesh_container* MESH, int Midx, const float* worldmat, const struct lod_camera &camera);
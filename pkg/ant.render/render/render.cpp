@@ -13,6 +13,7 @@ extern "C"{
 #include "queue.h"
 #include "hash.h"
 #include "mesh.h"
+#include "../shadow/csm_cache.h"
 
 #include "lua.hpp"
 #include "luabgfx.h"
@@ -127,10 +128,16 @@ mesh_submit(struct ecs_world* w, const component::render_object* ro,  int vid){
 
 	const auto& ib = mesh->buffers[BT_indexbuffer];
 	if (ib.num > 0){
+		uint32_t ib_start = ib.start, ib_num = ib.num;
+		if (mesh->lod.num > 0){
+			const auto& l = mesh->lod.levels[mesh->lod.current];
+			ib_start += l.start;
+			ib_num = l.num;
+		}
 		switch (BUFFER_TYPE(ib.handle)){
-			case BGFX_HANDLE_INDEX_BUFFER: w->bgfx->encoder_set_index_buffer(w->holder->encoder, bgfx_index_buffer_handle_t{(uint16_t)ib.handle}, ib.start, ib.num); break;
+			case BGFX_HANDLE_INDEX_BUFFER: w->bgfx->encoder_set_index_buffer(w->holder->encoder, bgfx_index_buffer_handle_t{(uint16_t)ib.handle}, ib_start, ib_num); break;
 			case BGFX_HANDLE_DYNAMIC_INDEX_BUFFER:	//walk through
-			case BGFX_HANDLE_DYNAMIC_INDEX_BUFFER_32: w->bgfx->encoder_set_dynamic_index_buffer(w->holder->encoder, bgfx_dynamic_index_buffer_handle_t{(uint16_t)ib.handle}, ib.start, ib.num); break;
+			case BGFX_HANDLE_DYNAMIC_INDEX_BUFFER_32: w->bgfx->encoder_set_dynamic_index_buffer(w->holder->encoder, bgfx_dynamic_index_buffer_handle_t{(uint16_t)ib.handle}, ib_start, ib_num); break;
 			default: assert(false && "Unknown index buffer type"); break;
 		}
 	}
@@ -248,6 +255,10 @@ enum queue_type : uint8_t{
 	csm3_queue,
 	csm4_queue,
 	efk_queue,
+	csm_static1_queue,
+	csm_static2_queue,
+	csm_static3_queue,
+	csm_static4_queue,
 	UNKNOW_queue,
 	Count_queue = UNKNOW_queue,
 };
@@ -262,6 +273,10 @@ struct submit_context {
 	int Qidx = -1;
 	uint64_t queuemasks[MAX_VISIBLE_QUEUE/64];
 
+	// main camera for the mesh LOD selection
+	lod_camera lod;
+	bool lod_valid = false;
+
 	void init_render_args(){
 		ra_count = 0;
 		if (Qidx == -1){
@@ -283,6 +298,25 @@ struct submit_context {
 	}
 };
 
+static inline bool
+is_csm_static_queue(queue_type qt){
+	return csm_static1_queue <= qt && qt <= csm_static4_queue;
+}
+
+// with the static shadow cache, the static casters are drawn in the csm_static queues only,
+// the others in the csm queues only
+static inline bool
+shadow_cache_skip(const submit_context *ctx, const component::render_args* ra, const component::render_object* ro){
+	const auto sc = ctx->w->shadow_cache;
+	if (sc == nullptr)
+		return false;
+	const queue_type qt = ctx->queue_types[ra->queue_index];
+	const bool is_static = is_csm_static_queue(qt);
+	if (!is_static && (qt < csm1_queue || qt > csm4_queue))
+		return false;
+	return sc->is_static(ro->rm_idx) != is_static;
+}
+
 struct obj_submitter {
 	struct obj {
 		const component::render_object *ro;
@@ -316,6 +350,9 @@ struct obj_submitter {
 				if (!obj_visible(ctx->w->Q, *so.ro, ra->queue_index))
 					continue;
 
+				if (shadow_cache_skip(ctx, ra, so.ro))
+					continue;
+
 				auto mi = find_submit_material(ctx->L, ctx->w, ra, so.ro->rm_idx);
 				if (!mi)
 					continue;
@@ -344,6 +381,10 @@ struct obj_submitter {
 			if (!find_submit_mesh(ctx->w, ro, io))
 				continue;
 
+			if (ctx->lod_valid && !io){
+				mesh_update_lod(ctx->w->MESH, ro->mesh_idx, math_value(ctx->w->math3d->M, ro->worldmat), ctx->lod);
+			}
+
 			add(ro, io);
 		#ifdef RENDER_DEBUG
 			append_eid(e.component<component::eid>());
@@ -383,6 +424,9 @@ struct hitch_submitter {
 		#endif //RENDER_DEBUG
 
 		void submit(submit_context *ctx, const component::render_args* ra, obj_transforms &trans) {
+			// hitches are not classified by the shadow cache, they are drawn every frame
+			if (is_csm_static_queue(ctx->queue_types[ra->queue_index]))
+				return;
 			for (uint16_t ih=0; ih<num; ++ih){
 				const obj& h = objects[ih];
 				if (h.g->empty() || !queue_check(ctx->w->Q, h.ro->visible_idx, ra->queue_index))
@@ -753,18 +797,43 @@ lset_queue_type(lua_State *L){
 		queue_types[qidx] = queue_type::csm4_queue;
 	} else if (0 == strcmp(queuename, "efk_queue")){
 		queue_types[qidx] = queue_type::efk_queue;
+	} else if (0 == strcmp(queuename, "csm_static1_queue")){
+		queue_types[qidx] = queue_type::csm_static1_queue;
+	} else if (0 == strcmp(queuename, "csm_static2_queue")){
+		queue_types[qidx] = queue_type::csm_static2_queue;
+	} else if (0 == strcmp(queuename, "csm_static3_queue")){
+		queue_types[qidx] = queue_type::csm_static3_queue;
+	} else if (0 == strcmp(queuename, "csm_static4_queue")){
+		queue_types[qidx] = queue_type::csm_static4_queue;
 	} else {
 		queue_types[qidx] = queue_type::UNKNOW_queue;
 	}
 	return 0;
 }
 
+// set_lod_camera(x, y, z, projmat[1][1], viewport height, threshold = 1 pixel, hysteresis = 0.25)
+static int
+lset_lod_camera(lua_State *L){
+	auto w = getworld(L);
+	auto &ctx = w->submit_cache->ctx;
+	for (int i=0; i<3; ++i){
+		ctx.lod.eye[i] = (float)luaL_checknumber(L, i+1);
+	}
+	ctx.lod.proj_scale	= (float)luaL_checknumber(L, 4);
+	ctx.lod.viewport_h	= (float)luaL_checknumber(L, 5);
+	ctx.lod.threshold	= (float)luaL_optnumber(L, 6, 1.0);
+	ctx.lod.hysteresis	= (float)luaL_optnumber(L, 7, 0.25);
+	ctx.lod_valid = true;
+	return 0;
+}
+
 extern "C" int
 luaopen_render_cache(lua_State *L){
 	luaL_checkversion(L);
 	luaL_Reg l[] = {
 		{ "submit_stat",	lsubmit_stat},
 		{ "set_queue_type", lset_queue_type},
+		{ "set_lod_camera", lset_lod_camera},
 		{ nullptr, 			nullptr},
 	};
 	luaL_newlibtable(L,l);
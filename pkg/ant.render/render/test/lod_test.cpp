@@ -0,0 +1,115 @@
+// Builds the LOD chain of a dense sphere like the model compiler does, then moves it away
+// from the camera and checks the triangle count the submit path would draw.
+#include "meshopt.h"
+#include "../lod.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static constexpr uint32_t RINGS = 64;
+static constexpr uint32_t SEGMENTS = 128;
+
+static void make_sphere(std::vector<float>& positions, std::vector<uint32_t>& indices) {
+    const float pi = 3.14159265f;
+    for (uint32_t r = 0; r <= RINGS; ++r) {
+        for (uint32_t s = 0; s <= SEGMENTS; ++s) {
+            const float theta = pi * r / RINGS, phi = 2.f * pi * s / SEGMENTS;
+            positions.push_back(std::sin(theta) * std::cos(phi));
+            positions.push_back(std::cos(theta));
+            positions.push_back(std::sin(theta) * std::sin(phi));
+        }
+    }
+    for (uint32_t r = 0; r < RINGS; ++r) {
+        for (uint32_t s = 0; s < SEGMENTS; ++s) {
+            const uint32_t a = r * (SEGMENTS + 1) + s, b = a + 1, c = a + SEGMENTS + 1, d = c + 1;
+            for (uint32_t v : { a, c, b, b, c, d }) {
+                indices.push_back(v);
+            }
+        }
+    }
+}
+
+int main() {
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    make_sphere(positions, indices);
+    const size_t vertex_count = positions.size() / 3;
+
+    meshopt::lod_chain chain;
+    meshopt::generate_lods(chain, indices.data(), indices.size(), positions.data(), sizeof(float) * 3, vertex_count, MAX_LOD, 0.5f);
+
+    lod_node node;
+    node.clear();
+    for (int i = 0; i < 4; ++i) {
+        node.sphere[i] = chain.sphere[i];
+    }
+    node.num = uint8_t(chain.levels.size());
+    for (uint8_t i = 0; i < node.num; ++i) {
+        node.levels[i] = { chain.levels[i].start, chain.levels[i].num, chain.levels[i].error };
+        printf("level %d: %u triangles, error %.5f\n", i, node.levels[i].num / 3, node.levels[i].error);
+    }
+
+    int failed = 0;
+    auto check = [&](bool ok, const char* what) {
+        if (!ok) {
+            printf("FAILED: %s\n", what);
+            failed++;
+        }
+    };
+    check(node.num == MAX_LOD, "all levels are generated");
+    for (uint8_t i = 1; i < node.num; ++i) {
+        check(node.levels[i].num < node.levels[i - 1].num, "every level has fewer triangles");
+        check(node.levels[i].error > node.levels[i - 1].error, "every level has a larger error");
+    }
+    bool in_range = true;
+    for (uint32_t v : chain.indices) {
+        in_range = in_range && v < vertex_count;
+    }
+    check(in_range, "every level indexes the source vertices");
+
+    // 60 degrees vertical fov, 1080p, the sphere is scaled by 2 and sits at the origin
+    const lod_camera camera { { 0.f, 0.f, 0.f }, 1.f / std::tan(3.14159265f / 6.f), 1080.f, 1.f, 0.25f };
+    float wm[16] = { 2, 0, 0, 0, 0, 2, 0, 0, 0, 0, 2, 0, 0, 0, 0, 1 };
+    auto draw_at = [&](float distance) {
+        wm[14] = distance;
+        node.current = lod_select(node, lod_screen_radius(node, wm, camera), camera);
+        return node.levels[node.current].num / 3;
+    };
+
+    node.current = 0;
+    check(draw_at(1.f) == node.levels[0].num / 3, "full detail with the camera inside the bounds");
+    check(draw_at(4.f) == node.levels[0].num / 3, "full detail up close");
+    uint32_t last = node.levels[0].num / 3;
+    bool monotonic = true;
+    for (float d = 4.f; d <= 4096.f; d *= 1.25f) {
+        const uint32_t n = draw_at(d);
+        monotonic = monotonic && n <= last;
+        last = n;
+    }
+    check(monotonic, "triangle count never grows with distance");
+    check(last == node.levels[node.num - 1].num / 3, "coarsest level far away");
+    for (float d : { 16.f, 64.f, 256.f, 1024.f }) {
+        node.current = 0;
+        printf("distance %6.0f: %u triangles\n", d, draw_at(d));
+    }
+
+    // find the distance where level 1 kicks in, then wobble around it
+    node.current = 0;
+    float switch_at = 4.f;
+    while (draw_at(switch_at) == node.levels[0].num / 3) {
+        switch_at *= 1.01f;
+    }
+    uint32_t changes = 0;
+    uint8_t previous = node.current;
+    for (int i = 0; i < 100; ++i) {
+        draw_at(switch_at * (i & 1 ? 0.95f : 1.05f));
+        changes += node.current != previous;
+        previous = node.current;
+    }
+    check(changes == 0, "hysteresis keeps the level around the switch distance");
+    check(draw_at(switch_at * 0.5f) == node.levels[0].num / 3, "back to full detail when close again");
+
+    printf(failed ? "render_lod_test: %d failure(s)\n" : "render_lod_test: ok\n", failed);
+    return failed ? 1 : 0;
+}
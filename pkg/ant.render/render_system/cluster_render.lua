@@ -30,6 +30,11 @@ local CLUSTER_SIZE<const>               = CLUSTER_SHADING.size
 local CLUSTER_COUNT<const>              = CLUSTER_SIZE[1] * CLUSTER_SIZE[2] * CLUSTER_SIZE[3]
 local CLUSTER_MAX_LIGHT_COUNT<const>    = CLUSTER_SHADING.max_light
 
+--the lights are assigned with compute shaders ("gpu"), by light.cluster on the CPU ("cpu", see light/light_binning.h),
+--or by the CPU for few lights and without compute shaders ("auto")
+local ASSIGN<const>                     = CLUSTER_SHADING.assign or "gpu"
+local CPU_ASSIGN_LIGHTS<const>          = CLUSTER_SHADING.cpu_lights or 0
+
 --[[
     struct light_grids {
         uint offset;
@@ -51,6 +56,7 @@ local LIGHT_GRID_BUFFER_SIZE<const> = CLUSTER_COUNT * 2
     };
 ]]
 local LIGHT_INFO_SIZE_IN_VEC4<const>     = 4  --sizeof(light_info), vec4 * 4
+local LIGHT_INFO_SIZE<const>             = LIGHT_INFO_SIZE_IN_VEC4 * 16
 
 --[[
     struct light_aabb{
@@ -95,6 +101,11 @@ local cluster_buffers = {
 
 local CLUSTER_BUILDAABB_EID, CLUSTER_LIGHTCULL_EID
 
+local CL, GPU_ASSIGN
+local HOMOGENEOUS_DEPTH, ORIGIN_BOTTOM_LEFT
+--what the CPU assignment was made with
+local last_invproj, last_view, last_light_version
+
 local main_viewid<const> = hwi.viewid_get "main_view"
 
 local cr_camera_mb      = world:sub{"main_queue", "camera_changed"}
@@ -125,8 +136,23 @@ local function create_compute_entity(material)
 end
 
 function cfs:init()
-    CLUSTER_BUILDAABB_EID = create_compute_entity "/pkg/ant.resources/materials/cluster_build.material"
-    CLUSTER_LIGHTCULL_EID = create_compute_entity "/pkg/ant.resources/materials/cluster_light_cull.material"
+    local caps = bgfx.get_caps()
+    HOMOGENEOUS_DEPTH, ORIGIN_BOTTOM_LEFT = caps.homogeneousDepth, caps.originBottomLeft
+    GPU_ASSIGN = ASSIGN ~= "cpu" and caps.supported.COMPUTE
+    if ASSIGN ~= "gpu" or not GPU_ASSIGN then
+        CL = world:clibs "light.cluster"
+        CL.init(CLUSTER_SIZE[1], CLUSTER_SIZE[2], CLUSTER_SIZE[3], CLUSTER_MAX_LIGHT_COUNT)
+    end
+    if GPU_ASSIGN then
+        CLUSTER_BUILDAABB_EID = create_compute_entity "/pkg/ant.resources/materials/cluster_build.material"
+        CLUSTER_LIGHTCULL_EID = create_compute_entity "/pkg/ant.resources/materials/cluster_light_cull.material"
+    end
+end
+
+function cfs:exit()
+    if CL then
+        CL.exit()
+    end
 end
 
 local function update_scene_render_param()
@@ -142,6 +168,9 @@ function cfs:init_world()
     cluster_buffers.light_info.handle = ilight.light_buffer()
     --render
     update_scene_render_param()
+    if not GPU_ASSIGN then
+        return
+    end
 
     --build
     local be = world:entity(CLUSTER_BUILDAABB_EID, "dispatch:in")
@@ -167,7 +196,18 @@ local function cull_lights(viewid)
     end
 end
 
-local function check_rebuild_cluster_aabb()
+local function use_cpu_assign()
+    if not GPU_ASSIGN then
+        return true
+    end
+    if not CL then
+        return false
+    end
+    local data, first = ilight.light_data()
+    return #data // LIGHT_INFO_SIZE - first <= CPU_ASSIGN_LIGHTS
+end
+
+local function check_rebuild_cluster_aabb(cpu)
     local C
     for _ in cr_camera_mb:each() do
         C = irq.main_camera_entity()
@@ -192,14 +232,47 @@ local function check_rebuild_cluster_aabb()
             num_depth_slices / log_farnear, -num_depth_slices * log_near / log_farnear,
             vr.w / CLUSTER_SIZE[1], vr.h/CLUSTER_SIZE[2]))
 
-        local be = world:entity(CLUSTER_BUILDAABB_EID, "dispatch:in")
         --no invz, no infinite far, could not use C.camera.projmat
-        be.dispatch.material["u_normal_inv_proj"] = math3d.inverse(math3d.projmat(C.camera.frustum))
-        icompute.dispatch(main_viewid, be.dispatch)
+        local invproj = math3d.inverse(math3d.projmat(C.camera.frustum))
+        if cpu then
+            invproj = math3d.serialize(invproj)
+            if invproj ~= last_invproj then
+                CL.build(invproj, near, far, HOMOGENEOUS_DEPTH, ORIGIN_BOTTOM_LEFT)
+                last_invproj, last_view = invproj, nil
+            end
+        else
+            local be = world:entity(CLUSTER_BUILDAABB_EID, "dispatch:in")
+            be.dispatch.material["u_normal_inv_proj"] = invproj
+            icompute.dispatch(main_viewid, be.dispatch)
+        end
+        return C
+    end
+end
+
+--the same buffers as cs_lightcull.sc, with compact index lists
+local function assign_lights(C)
+    local data, first, version = ilight.light_data()
+    local view = math3d.serialize(C.camera.viewmat)
+    if view == last_view and version == last_light_version then
+        return
+    end
+    last_view, last_light_version = view, version
+
+    local grids, grids_size, indices, indices_size = CL.assign(view, data, first)
+    bgfx.update(cluster_buffers.light_grids.handle, 0, bgfx.memory_buffer(grids, grids_size))
+    if indices_size > 0 then
+        bgfx.update(cluster_buffers.light_index_lists.handle, 0, bgfx.memory_buffer(indices, indices_size))
     end
 end
 
 function cfs:render_preprocess()
-    check_rebuild_cluster_aabb()
-    cull_lights(main_viewid)
+    local cpu = use_cpu_assign()
+    local C = check_rebuild_cluster_aabb(cpu)
+    if cpu then
+        assign_lights(C)
+    else
+        --the compute shaders write the buffers
+        last_view = nil
+        cull_lights(main_viewid)
+    end
 end
@@ -79,6 +79,7 @@ local function update_ro(ro, m)
 	local ib = m.ib
 	if ib then
 		MESH.set(ro.mesh_idx, "ib", ib.start, ib.num, ib.handle)
+		MESH.set_lod(ro.mesh_idx, m.lod)
 	end
 end
 
@@ -283,6 +284,10 @@ local function update_camera_properties()
 				local camerapos = math3d.index(ce.scene.worldmat, 4)
 				imaterial.system_attrib_update("u_eyepos", camerapos)
 
+				local x, y, z = math3d.index(camerapos, 1, 2, 3)
+				local proj_scale = math3d.index(math3d.index(camera.projmat, 2), 2)
+				RC.set_lod_camera(x, y, z, proj_scale, qe.render_target.view_rect.h)
+
 				local f = camera.frustum
 				local nn, ff = f.n, f.f
 				local inv_nn, inv_ff = 1.0/nn, 1.0/ff
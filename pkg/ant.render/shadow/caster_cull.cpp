@@ -0,0 +1,158 @@
+#include "caster_cull.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+static constexpr csm_window EMPTY_WINDOW = { INFINITY, INFINITY, INFINITY, -INFINITY, -INFINITY, -INFINITY };
+
+// the box of the transformed box, from its center and half extents
+static csm_window
+transform_aabb(const float m[16], const float aabb[6]) {
+	const float c[3] = { (aabb[0] + aabb[3]) * 0.5f, (aabb[1] + aabb[4]) * 0.5f, (aabb[2] + aabb[5]) * 0.5f };
+	const float e[3] = { (aabb[3] - aabb[0]) * 0.5f, (aabb[4] - aabb[1]) * 0.5f, (aabb[5] - aabb[2]) * 0.5f };
+	float tc[3], te[3];
+	for (int i = 0; i < 3; ++i) {
+		tc[i] = m[i] * c[0] + m[4+i] * c[1] + m[8+i] * c[2] + m[12+i];
+		te[i] = std::fabs(m[i]) * e[0] + std::fabs(m[4+i]) * e[1] + std::fabs(m[8+i]) * e[2];
+	}
+	return csm_window { tc[0] - te[0], tc[1] - te[1], tc[2] - te[2], tc[0] + te[0], tc[1] + te[1], tc[2] + te[2] };
+}
+
+static void
+merge(csm_window& r, const csm_window& b) {
+	r.minx = std::min(r.minx, b.minx); r.maxx = std::max(r.maxx, b.maxx);
+	r.miny = std::min(r.miny, b.miny); r.maxy = std::max(r.maxy, b.maxy);
+	r.minz = std::min(r.minz, b.minz); r.maxz = std::max(r.maxz, b.maxz);
+}
+
+static bool
+intersect(const csm_window& a, const csm_window& b, csm_window& r) {
+	r = csm_window {
+		std::max(a.minx, b.minx), std::max(a.miny, b.miny), std::max(a.minz, b.minz),
+		std::min(a.maxx, b.maxx), std::min(a.maxy, b.maxy), std::min(a.maxz, b.maxz),
+	};
+	return r.minx <= r.maxx && r.miny <= r.maxy && r.minz <= r.maxz;
+}
+
+// the view space box against the slice planes, conservative
+static bool
+in_slice(const csm_slice& s, const csm_window& v) {
+	if (v.maxz < s.n || v.minz > s.f) {
+		return false;
+	}
+	// the farthest point of the box along each plane normal
+	return	v.maxx - s.l1 * (s.l1 >= 0 ? v.minz : v.maxz) >= s.l0 &&
+			v.minx - s.r1 * (s.r1 >= 0 ? v.maxz : v.minz) <= s.r0 &&
+			v.maxy - s.b1 * (s.b1 >= 0 ? v.minz : v.maxz) >= s.b0 &&
+			v.miny - s.t1 * (s.t1 >= 0 ? v.maxz : v.minz) <= s.t0;
+}
+
+// lightview * inverse(cameraview)
+static void
+view_to_light(const float lv[16], const float cv[16], float r[16]) {
+	float inv[16];
+	memset(inv, 0, sizeof(inv));
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			inv[j*4+i] = cv[i*4+j];
+		}
+		inv[12+i] = -(cv[i*4] * cv[12] + cv[i*4+1] * cv[13] + cv[i*4+2] * cv[14]);
+	}
+	inv[15] = 1.f;
+	for (int c = 0; c < 4; ++c) {
+		for (int i = 0; i < 4; ++i) {
+			r[c*4+i] = lv[i] * inv[c*4] + lv[4+i] * inv[c*4+1] + lv[8+i] * inv[c*4+2] + lv[12+i] * inv[c*4+3];
+		}
+	}
+}
+
+void
+caster_cull::begin(const float lv[16], const float cv[16], const csm_slice* s, int n) {
+	assert(0 < n && n <= MAX_CASCADE);
+	memcpy(lightview, lv, sizeof(lightview));
+	memcpy(cameraview, cv, sizeof(cameraview));
+	num = n;
+	memcpy(slices, s, sizeof(csm_slice) * n);
+	float v2l[16];
+	view_to_light(lv, cv, v2l);
+	for (int c = 0; c < num; ++c) {
+		const auto& sc = slices[c];
+		csm_window b = EMPTY_WINDOW;
+		for (int i = 0; i < 8; ++i) {
+			const float z = (i & 4) ? sc.f : sc.n;
+			const float x = (i & 1) ? sc.r0 + sc.r1 * z : sc.l0 + sc.l1 * z;
+			const float y = (i & 2) ? sc.t0 + sc.t1 * z : sc.b0 + sc.b1 * z;
+			const float p[6] = { x, y, z, x, y, z };
+			merge(b, transform_aabb(v2l, p));
+		}
+		slice_bounds[c] = b;
+		results[c] = caster_cull_result { EMPTY_WINDOW, 0, 0 };
+	}
+	receivers.clear();
+	casters.clear();
+	masks.clear();
+}
+
+void
+caster_cull::add(const float aabb[6], bool receiver, bool caster) {
+	if (!receiver && !caster) {
+		return;
+	}
+	const csm_window ls = transform_aabb(lightview, aabb);
+	if (receiver) {
+		receivers.push_back(ls);
+		receivers.push_back(transform_aabb(cameraview, aabb));
+	}
+	if (caster) {
+		casters.push_back(ls);
+	}
+}
+
+void
+caster_cull::cull() {
+	// accumulated in locals, the results are written once
+	csm_window bounds[MAX_CASCADE];
+	uint32_t receiver_num[MAX_CASCADE] = {};
+	for (int c = 0; c < num; ++c) {
+		bounds[c] = EMPTY_WINDOW;
+	}
+	for (size_t i = 0; i < receivers.size(); i += 2) {
+		const auto& ls = receivers[i];
+		const auto& vs = receivers[i+1];
+		for (int c = 0; c < num; ++c) {
+			csm_window r;
+			if (in_slice(slices[c], vs) && intersect(ls, slice_bounds[c], r)) {
+				merge(bounds[c], r);
+				receiver_num[c]++;
+			}
+		}
+	}
+
+	float nearz[MAX_CASCADE];
+	uint32_t caster_num[MAX_CASCADE] = {};
+	for (int c = 0; c < num; ++c) {
+		nearz[c] = bounds[c].minz;
+	}
+	masks.resize(casters.size());
+	for (size_t i = 0; i < casters.size(); ++i) {
+		const auto& ls = casters[i];
+		uint8_t m = 0;
+		for (int c = 0; c < num; ++c) {
+			const auto& r = bounds[c];
+			// the extruded caster covers [ls.minz, +inf) in depth
+			if (ls.maxx >= r.minx && ls.minx <= r.maxx && ls.maxy >= r.miny && ls.miny <= r.maxy && ls.minz <= r.maxz) {
+				m |= (uint8_t)(1 << c);
+				nearz[c] = std::min(nearz[c], ls.minz);
+				caster_num[c]++;
+			}
+		}
+		masks[i] = m;
+	}
+
+	for (int c = 0; c < num; ++c) {
+		bounds[c].minz = nearz[c];
+		results[c] = caster_cull_result { bounds[c], receiver_num[c], caster_num[c] };
+	}
+}
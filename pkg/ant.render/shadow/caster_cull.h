@@ -0,0 +1,57 @@
+#pragma once
+
+#include "csm_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Shadow caster culling of the cascades (graphic/shadow/caster_cull).
+// The receivers in the camera slice of a cascade give its light space bounds, a caster is drawn in
+// the cascade when its box extruded along the light direction reaches these bounds. The near plane
+// is pulled back to the kept casters, the far plane is the farthest receiver.
+// The matrices are column major, the views look down +z.
+
+// the view space slice of the camera: x in [l0 + l1*z, r0 + r1*z], y in [b0 + b1*z, t0 + t1*z], z in [n, f]
+// a perspective camera has l0 = r0 = b0 = t0 = 0, an orthographic one l1 = r1 = b1 = t1 = 0
+struct csm_slice {
+	float l0, l1, r0, r1;
+	float b0, b1, t0, t1;
+	float n, f;
+};
+
+struct caster_cull_result {
+	csm_window bounds;	// in light space, empty when receivers == 0
+	uint32_t receivers;
+	uint32_t casters;
+};
+
+class caster_cull {
+public:
+	static constexpr int MAX_CASCADE = 4;
+
+	// cameraview is a rigid transform
+	void begin(const float lightview[16], const float cameraview[16], const csm_slice* slices, int num);
+	// aabb is min xyz, max xyz in world space, the casters are numbered in the order they are added
+	void add(const float aabb[6], bool receiver, bool caster);
+	void cull();
+
+	int cascade_num() const { return num; }
+	const caster_cull_result& result(int cascade) const { return results[cascade]; }
+	// the slice in light space
+	const csm_window& slice(int cascade) const { return slice_bounds[cascade]; }
+	size_t caster_num() const { return casters.size(); }
+	// bit c is set when the caster is drawn in the cascade c
+	uint8_t mask(size_t caster) const { return masks[caster]; }
+
+private:
+	float lightview[16];
+	float cameraview[16];
+	int num = 0;
+	csm_slice slices[MAX_CASCADE];
+	csm_window slice_bounds[MAX_CASCADE];	// the slices in light space
+	caster_cull_result results[MAX_CASCADE];
+	std::vector<csm_window> receivers;	// light space, view space
+	std::vector<csm_window> casters;
+	std::vector<uint8_t> masks;
+};
@@ -0,0 +1,170 @@
+#include "csm_cache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+// a window more than SHRINK times the size it needs is refitted, it wastes texels
+static constexpr float SHRINK = 2.0f;
+static constexpr float LIGHT_EPSILON = 1e-5f;
+
+static bool
+contains(const csm_window& w, const csm_window& b) {
+	return	b.minx >= w.minx && b.maxx <= w.maxx &&
+			b.miny >= w.miny && b.maxy <= w.maxy &&
+			b.minz >= w.minz && b.maxz <= w.maxz;
+}
+
+// casters in front of the far plane shade the window, the near plane is fitted before all of them
+static bool
+overlap_window(const csm_window& w, const csm_window& ls) {
+	return	ls.maxx >= w.minx && ls.minx <= w.maxx &&
+			ls.maxy >= w.miny && ls.miny <= w.maxy &&
+			ls.minz <= w.maxz;
+}
+
+csm_cache::csm_cache(int cascade_num, int size, float guard_, uint32_t settle_frames_)
+	: num(std::clamp(cascade_num, 1, MAX_CASCADE))
+	, sm_size((float)size)
+	, guard(guard_)
+	, settle_frames(std::max(settle_frames_, 1u)) {
+	memset(lightview, 0, sizeof(lightview));
+}
+
+csm_window
+csm_cache::to_light(const float aabb[6]) const {
+	csm_window r = { INFINITY, INFINITY, INFINITY, -INFINITY, -INFINITY, -INFINITY };
+	for (int i = 0; i < 8; ++i) {
+		const float x = aabb[(i & 1) ? 3 : 0];
+		const float y = aabb[(i & 2) ? 4 : 1];
+		const float z = aabb[(i & 4) ? 5 : 2];
+		const float *m = lightview;
+		const float lx = m[0] * x + m[4] * y + m[8] * z + m[12];
+		const float ly = m[1] * x + m[5] * y + m[9] * z + m[13];
+		const float lz = m[2] * x + m[6] * y + m[10] * z + m[14];
+		r.minx = std::min(r.minx, lx); r.maxx = std::max(r.maxx, lx);
+		r.miny = std::min(r.miny, ly); r.maxy = std::max(r.maxy, ly);
+		r.minz = std::min(r.minz, lz); r.maxz = std::max(r.maxz, lz);
+	}
+	return r;
+}
+
+bool
+csm_cache::set_light(const float lv[16]) {
+	if (has_light) {
+		bool same = true;
+		for (int i = 0; i < 16 && same; ++i) {
+			same = std::fabs(lv[i] - lightview[i]) <= LIGHT_EPSILON;
+		}
+		if (same) {
+			return false;
+		}
+	}
+	memcpy(lightview, lv, sizeof(lightview));
+	has_light = true;
+	for (auto& [_, c] : casters) {
+		c.ls = to_light(c.aabb);
+	}
+	for (int i = 0; i < num; ++i) {
+		cascades[i].valid = false;
+		cascades[i].dirty = true;
+	}
+	return true;
+}
+
+bool
+csm_cache::fit(int idx, const csm_window& b) {
+	assert(0 <= idx && idx < num);
+	auto& c = cascades[idx];
+	const float need = std::max({ b.maxx - b.minx, b.maxy - b.miny, 1e-3f });
+	if (c.valid) {
+		const float size = c.window.maxx - c.window.minx;
+		if (contains(c.window, b) && size <= need * (1.0f + 2.0f * guard) * SHRINK) {
+			return false;
+		}
+	}
+	// square, so the texels are square, centered on a texel corner
+	const float size = need * (1.0f + 2.0f * guard);
+	const float texel = size / sm_size;
+	const float cx = std::round((b.minx + b.maxx) * 0.5f / texel) * texel;
+	const float cy = std::round((b.miny + b.maxy) * 0.5f / texel) * texel;
+	const float depth = std::max(b.maxz - b.minz, 1e-3f);
+	const float half = size * 0.5f;
+	c.window = csm_window {
+		cx - half, cy - half, b.minz - depth * guard,
+		cx + half, cy + half, b.maxz + depth * guard,
+	};
+	c.valid = true;
+	c.dirty = true;
+	return true;
+}
+
+void
+csm_cache::invalidate(const csm_window& ls) {
+	for (int i = 0; i < num; ++i) {
+		auto& c = cascades[i];
+		if (c.valid && overlap_window(c.window, ls)) {
+			c.dirty = true;
+		}
+	}
+}
+
+void
+csm_cache::caster_update(uint64_t id, const float aabb[6], uint64_t frame) {
+	auto [it, inserted] = casters.try_emplace(id);
+	auto& c = it->second;
+	if (inserted) {
+		c.is_static = false;
+		dynamics.insert(id);
+	} else if (c.is_static) {
+		// its shadow is in the static layer
+		invalidate(c.ls);
+		c.is_static = false;
+		dynamics.insert(id);
+		changes.push_back(id);
+	}
+	memcpy(c.aabb, aabb, sizeof(c.aabb));
+	c.ls = to_light(aabb);
+	c.moved = frame;
+}
+
+void
+csm_cache::caster_remove(uint64_t id) {
+	auto it = casters.find(id);
+	if (it == casters.end()) {
+		return;
+	}
+	if (it->second.is_static) {
+		invalidate(it->second.ls);
+	}
+	dynamics.erase(id);
+	casters.erase(it);
+}
+
+void
+csm_cache::update(uint64_t frame) {
+	for (auto it = dynamics.begin(); it != dynamics.end();) {
+		auto& c = casters[*it];
+		if (frame - c.moved >= settle_frames) {
+			c.is_static = true;
+			invalidate(c.ls);
+			changes.push_back(*it);
+			it = dynamics.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+bool
+csm_cache::is_static(uint64_t id) const {
+	auto it = casters.find(id);
+	return it != casters.end() && it->second.is_static;
+}
+
+bool
+csm_cache::overlap(int cascade, uint64_t id) const {
+	auto it = casters.find(id);
+	return it != casters.end() && cascades[cascade].valid && overlap_window(cascades[cascade].window, it->second.ls);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Static caster cache of the cascaded shadow maps (graphic/shadow/static_cache).
+// Each cascade keeps a light space window, larger than the cascade by a guard band and snapped
+// to texels, so the window and the shadow matrix stay the same while the camera moves a little.
+// Static casters are drawn into a persistent layer when the window moves or a static caster in
+// it changes, dynamic casters are drawn on top of a copy of that layer every frame.
+// A caster is dynamic until it has not moved for settle_frames frames.
+struct csm_window {
+	float minx, miny, minz;
+	float maxx, maxy, maxz;
+};
+
+class csm_cache {
+public:
+	static constexpr int MAX_CASCADE = 4;
+	csm_cache(int cascade_num, int size, float guard = 0.2f, uint32_t settle_frames = 30);
+
+	// lightview is column major, a new light direction invalidates every cascade, returns true then
+	bool set_light(const float lightview[16]);
+	// bounds is what the cascade has to cover in light space, returns true when the window moved
+	bool fit(int cascade, const csm_window& bounds);
+	const csm_window& window(int cascade) const { return cascades[cascade].window; }
+	// fitted since the last light change
+	bool valid(int cascade) const { return cascades[cascade].valid; }
+
+	// aabb is min xyz, max xyz in world space, for a new or moved caster
+	void caster_update(uint64_t id, const float aabb[6], uint64_t frame);
+	void caster_remove(uint64_t id);
+	// turns the casters settled at frame static, after the caster updates of the frame
+	void update(uint64_t frame);
+
+	bool is_static(uint64_t id) const;
+	bool overlap(int cascade, uint64_t id) const;
+	bool dirty(int cascade) const { return cascades[cascade].dirty; }
+	// the static layer of the cascade is drawn
+	void clean(int cascade) { cascades[cascade].dirty = false; }
+
+	// f(id, is_static) for the casters which changed class since the last call
+	template <typename F>
+	void flush_changes(F&& f) {
+		for (auto id : changes) {
+			auto it = casters.find(id);
+			if (it != casters.end()) {
+				f(id, it->second.is_static);
+			}
+		}
+		changes.clear();
+	}
+
+	int cascade_num() const { return num; }
+	size_t caster_num() const { return casters.size(); }
+	size_t dynamic_num() const { return dynamics.size(); }
+
+private:
+	struct caster {
+		float aabb[6];
+		csm_window ls;
+		uint64_t moved;
+		bool is_static;
+	};
+	struct cascade {
+		csm_window window;
+		bool valid = false;
+		bool dirty = true;
+	};
+	csm_window to_light(const float aabb[6]) const;
+	void invalidate(const csm_window& ls);
+
+	int num;
+	float sm_size;
+	float guard;
+	uint32_t settle_frames;
+	float lightview[16];
+	bool has_light = false;
+	cascade cascades[MAX_CASCADE];
+	std::unordered_map<uint64_t, caster> casters;
+	std::unordered_set<uint64_t> dynamics;
+	std::vector<uint64_t> changes;
+};
+
+// ecs_world::shadow_cache, created by shadow.cache init in the cached mode
+struct shadow_cache {
+	shadow_cache(int cascade_num, int size, uint32_t settle_frames)
+		: cache(cascade_num, size, 0.2f, settle_frames) {}
+	// render_object.rm_idx of the static casters, they are submitted to the csm_static queues only
+	bool is_static(uint32_t rm_idx) const {
+		return rm_idx < static_objects.size() && static_objects[rm_idx];
+	}
+	csm_cache cache;
+	std::vector<uint8_t> static_objects;
+	std::unordered_map<uint64_t, uint32_t> rm_idx;	// caster eid -> render_object.rm_idx
+	std::vector<uint64_t> pending;	// new casters, their scene_aabb is not ready yet
+	uint64_t frame = 0;	// the last update
+};
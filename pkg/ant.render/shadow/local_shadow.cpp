@@ -0,0 +1,211 @@
+#include "ecs/world.h"
+#include "ecs/select.h"
+#include "ecs/version.h"
+#include "ecs/component.hpp"
+
+extern "C"{
+	#include "math3d.h"
+	#include "math3dfunc.h"
+}
+
+#include "shadow_atlas.h"
+
+#include <cstring>
+#include <vector>
+
+struct local_shadow {
+	local_shadow(uint32_t atlas_size, uint32_t min_tile, uint32_t max_tile, uint32_t views)
+		: scheduler(atlas_size, min_tile, max_tile, views) {}
+	shadow_scheduler scheduler;
+	std::vector<local_light> lights;
+	shadow_casters casters;
+	std::vector<float> spheres;		// x, y, z, range of the lights
+	uint64_t frame = 0;
+};
+
+static inline struct local_shadow*
+get_shadow(lua_State *L, struct ecs_world *w) {
+	if (w->local_shadow == nullptr) {
+		luaL_error(L, "shadow.atlas is not initialized");
+	}
+	return w->local_shadow;
+}
+
+static float
+field_number(lua_State *L, int idx, const char *name) {
+	lua_getfield(L, idx, name);
+	if (!lua_isnumber(L, -1)) {
+		luaL_error(L, "light.%s need a number", name);
+	}
+	const float v = (float)lua_tonumber(L, -1);
+	lua_pop(L, 1);
+	return v;
+}
+
+static void
+set_integer(lua_State *L, int idx, const char *name, lua_Integer v) {
+	lua_pushinteger(L, v);
+	lua_setfield(L, idx, name);
+}
+
+// init(atlas_size, min_tile, max_tile, views)
+static int
+linit(lua_State *L) {
+	auto w = getworld(L);
+	const lua_Integer size = luaL_checkinteger(L, 1);
+	const lua_Integer min_tile = luaL_checkinteger(L, 2);
+	const lua_Integer max_tile = luaL_checkinteger(L, 3);
+	const lua_Integer views = luaL_checkinteger(L, 4);
+	auto pow2 = [](lua_Integer v) { return v > 0 && (v & (v - 1)) == 0; };
+	luaL_argcheck(L, pow2(size) && size <= 0x8000, 1, "the atlas size need a power of two");
+	luaL_argcheck(L, pow2(min_tile) && min_tile <= size, 2, "min_tile need a power of two");
+	luaL_argcheck(L, min_tile <= max_tile, 3, "invalid max_tile");
+	luaL_argcheck(L, views > 0, 4, "invalid views");
+	w->local_shadow = new struct local_shadow((uint32_t)size, (uint32_t)min_tile, (uint32_t)max_tile, (uint32_t)views);
+	w->local_shadow->frame = w->frame;
+	return 0;
+}
+
+static int
+lexit(lua_State *L) {
+	auto w = getworld(L);
+	delete w->local_shadow;
+	w->local_shadow = nullptr;
+	return 0;
+}
+
+// update(lights) returns the faces to draw this frame, { light=, face=, x=, y=, size= } (face is 0 based).
+// lights[i] = { id=, faces=(1 spot, 6 point), coverage=, x=, y=, z=, range=, dirty= }, dirty when the light changed.
+// A light is dirty as well when a caster moved into or out of its range, or was removed from it, since the last update.
+static int
+lupdate(lua_State *L) {
+	auto w = getworld(L);
+	auto ls = get_shadow(L, w);
+	luaL_checktype(L, 1, LUA_TTABLE);
+	const lua_Integer num = luaL_len(L, 1);
+
+	ls->lights.resize((size_t)num);
+	ls->spheres.resize((size_t)num * 4);
+	for (lua_Integer i = 0; i < num; ++i) {
+		lua_geti(L, 1, i+1);
+		const int idx = lua_gettop(L);
+		luaL_checktype(L, idx, LUA_TTABLE);
+		auto& l = ls->lights[i];
+		lua_getfield(L, idx, "id");
+		l.id = (uint64_t)luaL_checkinteger(L, -1);
+		lua_pop(L, 1);
+		const float faces = field_number(L, idx, "faces");
+		if (faces != 1.f && faces != (float)shadow_scheduler::MAX_FACE) {
+			return luaL_error(L, "light.faces need 1 or 6");
+		}
+		l.faces = (uint32_t)faces;
+		l.coverage = field_number(L, idx, "coverage");
+		lua_getfield(L, idx, "dirty");
+		l.dirty = lua_toboolean(L, -1);
+		lua_pop(L, 1);
+		float *s = &ls->spheres[i * 4];
+		s[0] = field_number(L, idx, "x");
+		s[1] = field_number(L, idx, "y");
+		s[2] = field_number(L, idx, "z");
+		s[3] = field_number(L, idx, "range");
+		lua_pop(L, 1);
+	}
+
+	auto caster_moved = [&](uint64_t eid, const component::bounding &b) {
+		if (math_isnull(b.scene_aabb)) {
+			return;
+		}
+		const float *v = math_value(w->math3d->M, b.scene_aabb);
+		const float aabb[6] = { v[0], v[1], v[2], v[4], v[5], v[6] };
+		ls->casters.update(eid, aabb);
+	};
+	const bool known = ecs::changed_select<component::eid>(w->ecs, w->versions->log<component::bounding>(), ls->frame, [&](auto& e) {
+		if (!e.template component<component::cast_shadow>()) {
+			return;
+		}
+		const component::bounding *b = e.template component<component::bounding>();
+		if (b != nullptr) {
+			caster_moved((uint64_t)e.template get<component::eid>(), *b);
+		}
+	});
+	if (!known) {
+		// not updated for longer than the version history, any caster may have moved
+		for (auto& e : ecs::select<component::cast_shadow, component::bounding, component::eid>(w->ecs)) {
+			caster_moved((uint64_t)e.get<component::eid>(), e.get<component::bounding>());
+		}
+	}
+	ls->frame = w->frame;
+	ls->casters.mark_dirty(ls->lights.data(), ls->spheres.data(), ls->lights.size());
+
+	const auto& views = ls->scheduler.update(ls->lights.data(), ls->lights.size(), w->frame);
+	lua_createtable(L, (int)views.size(), 0);
+	for (size_t i = 0; i < views.size(); ++i) {
+		const auto& v = views[i];
+		lua_createtable(L, 0, 5);
+		const int idx = lua_gettop(L);
+		set_integer(L, idx, "light", (lua_Integer)v.light);
+		set_integer(L, idx, "face", v.face);
+		set_integer(L, idx, "x", v.tile.x);
+		set_integer(L, idx, "y", v.tile.y);
+		set_integer(L, idx, "size", v.tile.size);
+		lua_seti(L, -2, (lua_Integer)i+1);
+	}
+	return 1;
+}
+
+// remove(eid) for a removed caster, the lights it was in the range of are dirty at the next update
+static int
+lremove(lua_State *L) {
+	auto ls = get_shadow(L, getworld(L));
+	ls->casters.remove((uint64_t)luaL_checkinteger(L, 1));
+	return 0;
+}
+
+// tile(light, face) returns x, y, size, or nothing when the face has not been drawn
+static int
+ltile(lua_State *L) {
+	auto ls = get_shadow(L, getworld(L));
+	const uint64_t light = (uint64_t)luaL_checkinteger(L, 1);
+	const lua_Integer face = luaL_checkinteger(L, 2);
+	atlas_tile t;
+	if (face < 0 || !ls->scheduler.tile(light, (uint32_t)face, t)) {
+		return 0;
+	}
+	lua_pushinteger(L, t.x);
+	lua_pushinteger(L, t.y);
+	lua_pushinteger(L, t.size);
+	return 3;
+}
+
+static int
+lstat(lua_State *L) {
+	auto ls = get_shadow(L, getworld(L));
+	const auto& s = ls->scheduler.stats();
+	lua_createtable(L, 0, 6);
+	const int idx = lua_gettop(L);
+	set_integer(L, idx, "lights", s.lights);
+	set_integer(L, idx, "shadowed", s.shadowed);
+	set_integer(L, idx, "views", s.views);
+	set_integer(L, idx, "pending", s.pending);
+	set_integer(L, idx, "allocs", s.allocs);
+	set_integer(L, idx, "free", (lua_Integer)ls->scheduler.atlas().free_area());
+	return 1;
+}
+
+extern "C" int
+luaopen_shadow_atlas(lua_State *L) {
+	luaL_checkversion(L);
+	luaL_Reg l[] = {
+		{ "init", linit },
+		{ "exit", lexit },
+		{ "update", lupdate },
+		{ "remove", lremove },
+		{ "tile", ltile },
+		{ "stat", lstat },
+		{ NULL, NULL },
+	};
+	luaL_newlibtable(L,l);
+	lua_pushnil(L);
+	luaL_setfuncs(L,l,1);
+	return 1;
+}
@@ -0,0 +1,316 @@
+local ecs   = ...
+local world = ecs.world
+local w     = world.w
+
+--shadows of the point and spot lights, every face is a tile of one atlas, see shadow_atlas.h
+local ls_sys = ecs.system "local_shadow_system"
+
+local setting	= import_package "ant.settings"
+local ENABLE_LOCAL_SHADOW<const> = setting:get "graphic/shadow/enable" and setting:get "graphic/shadow/local/enable"
+if not ENABLE_LOCAL_SHADOW then
+	return
+end
+
+local hwi       = import_package "ant.hwi"
+local mathpkg   = import_package "ant.math"
+local mc, mu    = mathpkg.constant, mathpkg.util
+local sampler   = import_package "ant.render.core".sampler
+local layoutmgr = import_package "ant.render".layoutmgr
+
+local bgfx      = require "bgfx"
+local math3d    = require "math3d"
+local fbmgr     = require "framebuffer_mgr"
+
+local queuemgr  = ecs.require "queue_mgr"
+local icamera   = ecs.require "ant.camera|camera"
+local irq       = ecs.require "renderqueue"
+local imaterial = ecs.require "ant.render|material"
+local irender	= ecs.require "ant.render|render"
+local ilight	= ecs.require "ant.render|light.light"
+
+local SA        = world:clibs "shadow.atlas"
+
+local INV_Z<const> = setting:get "graphic/inv_z"
+local CLEAR_DEPTH_VALUE<const> = INV_Z and 0 or 1
+
+local ATLAS_SIZE<const>		= setting:get "graphic/shadow/local/atlas_size" or 4096
+local MIN_TILE<const>		= setting:get "graphic/shadow/local/min_tile" or 128
+local MAX_TILE<const>		= setting:get "graphic/shadow/local/max_tile" or 1024
+local VIEWS<const>			= math.max(1, math.min(8, setting:get "graphic/shadow/local/views" or 8))
+local NORMAL_OFFSET<const>	= setting:get "graphic/shadow/local/normal_offset" or 0.02
+
+local TEXTURE_BIAS_MATRIX<const> = mu.texture_bias_matrix
+local ORIGIN_BOTTOM_LEFT<const> = math3d.get_origin_bottom_left()
+
+--+x, -x, +y, -y, +z, -z, see local_shadow_face in common/shadow/local.sh
+local POINT_FACES<const> = {
+	{dir = mc.XAXIS,	up = mc.YAXIS},
+	{dir = mc.NXAXIS,	up = mc.YAXIS},
+	{dir = mc.YAXIS,	up = mc.ZAXIS},
+	{dir = mc.NYAXIS,	up = mc.ZAXIS},
+	{dir = mc.ZAXIS,	up = mc.YAXIS},
+	{dir = mc.NZAXIS,	up = mc.YAXIS},
+}
+
+local ZERO_MATRIX<const> = ('f'):rep(16):pack(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0)
+local NO_SHADOW<const> = ('f'):rep(4):pack(0, 0, 0, 0)
+
+local QUEUE_NAMES = {}
+for ii=1, VIEWS do
+	QUEUE_NAMES[ii] = "local_shadow" .. ii .. "_queue"
+end
+
+--eid: {id=, faces=, coverage=, x=, y=, z=, range=, dirty=, radian=, dir=, matrices=, seen=}, the fields to dirty are for SA.update
+local LIGHTS = {}
+local frame_lights = {}
+local shadow_buffer = bgfx.create_dynamic_vertex_buffer(1, layoutmgr.get "t40".handle, "ra")
+local last_version, last_shadowed
+local last_frame = 0
+local atlas_rb
+
+local function create_view_entity(index, fbidx)
+	local name = "local_shadow" .. index
+	local queuename = QUEUE_NAMES[index]
+	local camera_ref = icamera.create{
+			updir 	= mc.YAXIS,
+			viewdir = mc.ZAXIS,
+			eyepos 	= mc.ZERO_PT,
+			frustum = {
+				fov = 90, aspect = 1, n = 0.1, f = 10,
+			},
+			name = name,
+			camera_depend = true,
+		}
+	world:create_entity {
+		policy = {
+			"ant.render|render_queue",
+			"ant.render|local_shadow_queue",
+		},
+		data = {
+			local_shadow = {
+				index = index,
+			},
+			camera_ref = camera_ref,
+			render_target = {
+				viewid = hwi.viewid_get(name),
+				view_rect = {x=0, y=0, w=MIN_TILE, h=MIN_TILE},
+				--bgfx clears the view rect only, the other tiles are kept
+				clear_state = {
+					clear = "D",
+					depth = CLEAR_DEPTH_VALUE,
+				},
+				fb_idx = fbidx,
+			},
+			visible = false,
+			queue_name = queuename,
+			submit_queue = true,
+			[queuename] = true,
+		},
+	}
+end
+
+function ls_sys:init()
+	local midx = queuemgr.material_index "csm1_queue"
+	for ii=1, VIEWS do
+		queuemgr.register_queue(QUEUE_NAMES[ii], midx)
+	end
+
+	atlas_rb = fbmgr.create_rb{
+		format = "D16",
+		w = ATLAS_SIZE,
+		h = ATLAS_SIZE,
+		layers = 1,
+		flags = sampler{
+			RT="RT_ON",
+			MIN="LINEAR",
+			MAG="LINEAR",
+			U="CLAMP",
+			V="CLAMP",
+			COMPARE="COMPARE_GEQUAL",
+		},
+	}
+	local fbidx = fbmgr.create{rbidx = atlas_rb}
+	for ii=1, VIEWS do
+		create_view_entity(ii, fbidx)
+	end
+	SA.init(ATLAS_SIZE, MIN_TILE, MAX_TILE, VIEWS)
+
+	imaterial.system_attrib_update("s_local_shadowmap", fbmgr.get_rb(atlas_rb).handle)
+	imaterial.system_attrib_update("b_local_shadow", shadow_buffer)
+end
+
+function ls_sys:exit()
+	SA.exit()
+end
+
+function ls_sys:entity_remove()
+	for e in w:select "REMOVED cast_shadow eid:in" do
+		SA.remove(e.eid)
+	end
+end
+
+local function mark_camera_changed(e)
+	-- this camera should not generate the change tag
+	w:extend(e, "scene_changed?out scene_needchange?out camera_changed?out")
+	e.camera_changed = true
+	e.scene_changed = false
+	e.scene_needchange = false
+	w:submit(e)
+end
+
+--the screen height the range of the light covers
+local function light_coverage(eyepos, tanfov, pos, range)
+	local d = math3d.length(math3d.sub(pos, eyepos))
+	if d <= range then
+		return 1
+	end
+	return math.min(1, range / (d * tanfov))
+end
+
+--the lights in the order of the light buffer, see light.lua
+local function collect_lights()
+	local mq = w:first "main_queue camera_ref:in"
+	local ce <close> = world:entity(mq.camera_ref, "scene:in camera:in")
+	local eyepos = math3d.index(ce.scene.worldmat, 4)
+	local tanfov = math.tan(math.rad(ce.camera.frustum.fov or 60) * 0.5)
+
+	local order, n = {}, 0
+	for _ in w:select "directional_light light visible scene" do
+		n = n + 1
+	end
+	for k=#frame_lights, 1, -1 do
+		frame_lights[k] = nil
+	end
+	local frame = last_frame + 1
+	last_frame = frame
+	for e in w:select "light:in directional_light:absent visible scene:in eid:in make_shadow?in scene_changed?in" do
+		local l = e.light
+		if e.make_shadow and (l.type == "point" or l.type == "spot") then
+			local dir, pos = math3d.index(e.scene.worldmat, 3, 4)
+			local x, y, z = math3d.index(pos, 1, 2, 3)
+			local radian = l.type == "spot" and l.outter_radian or 0
+			local s = LIGHTS[e.eid]
+			if s == nil then
+				s = {id = e.eid, dir = math3d.ref(), matrices = {}}
+				LIGHTS[e.eid] = s
+			end
+			s.seen = frame
+			s.dirty = e.scene_changed or s.range ~= l.range or s.radian ~= radian
+			s.faces = l.type == "point" and 6 or 1
+			s.coverage = light_coverage(eyepos, tanfov, pos, l.range)
+			s.x, s.y, s.z, s.range, s.radian = x, y, z, l.range, radian
+			s.dir.v = math3d.normalize(dir)
+			frame_lights[#frame_lights+1] = s
+		end
+		order[#order+1] = e.eid
+	end
+	for eid, s in pairs(LIGHTS) do
+		if s.seen ~= frame then
+			LIGHTS[eid] = nil
+		end
+	end
+	return n, order
+end
+
+--1 texel of guard on each side of a tile, for the filtering at the edges of a face
+local function face_fov(tanhalf, size)
+	return math.deg(2 * math.atan(tanhalf * size / (size - 2)))
+end
+
+local function face_matrices(s, face, size)
+	local pos = math3d.vector(s.x, s.y, s.z, 1)
+	local viewdir, updir, tanhalf
+	if s.faces == 1 then
+		viewdir = s.dir
+		local _, dy = math3d.index(s.dir, 1, 2)
+		updir = math.abs(dy) > 0.99 and mc.ZAXIS or mc.YAXIS
+		tanhalf = math.tan(s.radian * 0.5)
+	else
+		local f = POINT_FACES[face+1]
+		viewdir, updir, tanhalf = f.dir, f.up, 1
+	end
+	local Lv = math3d.lookto(pos, viewdir, updir)
+	local Lp = math3d.projmat({
+		fov = face_fov(tanhalf, size), aspect = 1,
+		n = math.max(0.01, s.range * 0.01), f = s.range,
+	}, INV_Z)
+	return Lv, Lp
+end
+
+--world position to the tile of the atlas
+local function atlas_matrix(viewproj, x, y, size)
+	local scale = size / ATLAS_SIZE
+	local u0 = x / ATLAS_SIZE
+	local v0 = (ORIGIN_BOTTOM_LEFT and (ATLAS_SIZE - y - size) or y) / ATLAS_SIZE
+	local tile = math3d.matrix{
+		scale, 0, 0, 0,
+		0, scale, 0, 0,
+		0, 0, 1, 0,
+		u0, v0, 0, 1,
+	}
+	return math3d.mul(tile, math3d.mul(TEXTURE_BIAS_MATRIX, viewproj))
+end
+
+local function draw_views(views)
+	for e in w:select "local_shadow:in camera_ref:in queue_name:in" do
+		local v = views[e.local_shadow.index]
+		local s = v and LIGHTS[v.light]
+		irender.set_visible(e, s ~= nil)
+		if s then
+			local Lv, Lp = face_matrices(s, v.face, v.size)
+			local ce <close> = world:entity(e.camera_ref, "scene:update camera:in")
+			local c = ce.camera
+			c.viewmat		= Lv
+			c.projmat		= Lp
+			c.infprojmat	= Lp
+			c.viewprojmat	= math3d.mul(Lp, Lv)
+			ce.scene.worldmat = mu.M3D_mark(ce.scene.worldmat, math3d.inverse(Lv))
+			mark_camera_changed(ce)
+			irq.set_view_rect(e.queue_name, {x=v.x, y=v.y, w=v.size, h=v.size})
+
+			--the matrix the face is drawn with, until it is drawn again
+			s.matrices[v.face+1] = math3d.serialize(atlas_matrix(c.viewprojmat, v.x, v.y, v.size))
+		end
+	end
+end
+
+--b_local_shadow: a header for each light of the light buffer, then 4 columns for each face, see common/shadow/local.sh
+local function update_shadow_buffer(dircount, order)
+	local headers, faces = {}, {}
+	for _=1, dircount do
+		headers[#headers+1] = NO_SHADOW
+	end
+	local first = dircount + #order
+	for _, eid in ipairs(order) do
+		local s = LIGHTS[eid]
+		local m, drawn = {}, false
+		for f=1, s and s.faces or 0 do
+			m[f] = SA.tile(eid, f-1) and s.matrices[f]
+			drawn = drawn or m[f]
+		end
+		if drawn then
+			headers[#headers+1] = ('f'):rep(4):pack(first + #faces * 4, s.faces, NORMAL_OFFSET, 0)
+			for f=1, s.faces do
+				faces[#faces+1] = m[f] or ZERO_MATRIX
+			end
+		else
+			headers[#headers+1] = NO_SHADOW
+		end
+	end
+	if #headers > 0 then
+		bgfx.update(shadow_buffer, 0, bgfx.memory_buffer(table.concat(headers) .. table.concat(faces)))
+	end
+end
+
+function ls_sys:update_camera_depend()
+	local dircount, order = collect_lights()
+	local views = SA.update(frame_lights)
+	draw_views(views)
+
+	local _, _, version = ilight.light_data()
+	local st = SA.stat()
+	if #views > 0 or st.allocs > 0 or st.shadowed ~= last_shadowed or version ~= last_version then
+		last_shadowed, last_version = st.shadowed, version
+		update_shadow_buffer(dircount, order)
+	end
+end
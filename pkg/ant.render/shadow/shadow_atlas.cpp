@@ -0,0 +1,331 @@
+#include "shadow_atlas.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+static uint32_t
+next_pow2(uint32_t v) {
+	uint32_t p = 1;
+	while (p < v) {
+		p <<= 1;
+	}
+	return p;
+}
+
+static int
+log2_of(uint32_t v) {
+	int n = 0;
+	while (v > 1) {
+		v >>= 1;
+		++n;
+	}
+	return n;
+}
+
+shadow_atlas::shadow_atlas(uint32_t size, uint32_t min_tile)
+	: atlas_size(size)
+	, min_size(min_tile) {
+	assert(size <= 0x8000 && (size & (size - 1)) == 0);
+	assert(min_tile > 0 && min_tile <= size && (min_tile & (min_tile - 1)) == 0);
+	free_nodes.resize(log2_of(size / min_tile) + 1);
+	free_nodes[0].insert(0);
+}
+
+int
+shadow_atlas::level_of(uint32_t size) const {
+	size = std::clamp(next_pow2(size), min_size, atlas_size);
+	return log2_of(atlas_size / size);
+}
+
+bool
+shadow_atlas::alloc_level(int level, uint32_t& node) {
+	auto& nodes = free_nodes[level];
+	if (!nodes.empty()) {
+		node = *nodes.begin();
+		nodes.erase(nodes.begin());
+		return true;
+	}
+	uint32_t parent;
+	if (level == 0 || !alloc_level(level - 1, parent)) {
+		return false;
+	}
+	const uint32_t x = (parent & 0xffff) * 2, y = (parent >> 16) * 2;
+	node = y << 16 | x;
+	nodes.insert(y << 16 | (x + 1));
+	nodes.insert((y + 1) << 16 | x);
+	nodes.insert((y + 1) << 16 | (x + 1));
+	return true;
+}
+
+void
+shadow_atlas::free_level(int level, uint32_t node) {
+	auto& nodes = free_nodes[level];
+	assert(nodes.find(node) == nodes.end());
+	if (level > 0) {
+		const uint32_t x = (node & 0xffff) & ~1u, y = (node >> 16) & ~1u;
+		const uint32_t siblings[4] = { y << 16 | x, y << 16 | (x + 1), (y + 1) << 16 | x, (y + 1) << 16 | (x + 1) };
+		bool merge = true;
+		for (auto s : siblings) {
+			if (s != node && nodes.find(s) == nodes.end()) {
+				merge = false;
+				break;
+			}
+		}
+		if (merge) {
+			for (auto s : siblings) {
+				nodes.erase(s);
+			}
+			free_level(level - 1, (y / 2) << 16 | (x / 2));
+			return;
+		}
+	}
+	nodes.insert(node);
+}
+
+bool
+shadow_atlas::alloc(uint32_t size, atlas_tile& tile) {
+	const int level = level_of(size);
+	uint32_t node;
+	if (!alloc_level(level, node)) {
+		return false;
+	}
+	const uint32_t tsize = atlas_size >> level;
+	tile = atlas_tile { (uint16_t)((node & 0xffff) * tsize), (uint16_t)((node >> 16) * tsize), (uint16_t)tsize };
+	return true;
+}
+
+void
+shadow_atlas::free(const atlas_tile& tile) {
+	if (tile.size == 0) {
+		return;
+	}
+	const int level = level_of(tile.size);
+	free_level(level, (uint32_t)(tile.y / tile.size) << 16 | (uint32_t)(tile.x / tile.size));
+}
+
+uint64_t
+shadow_atlas::free_area() const {
+	uint64_t area = 0;
+	for (size_t level = 0; level < free_nodes.size(); ++level) {
+		const uint64_t tsize = atlas_size >> level;
+		area += free_nodes[level].size() * tsize * tsize;
+	}
+	return area;
+}
+
+static bool
+sphere_aabb(const float s[4], const float aabb[6]) {
+	float sq = 0.f;
+	for (int i = 0; i < 3; ++i) {
+		const float d = s[i] < aabb[i] ? aabb[i] - s[i] : (s[i] > aabb[3+i] ? s[i] - aabb[3+i] : 0.f);
+		sq += d * d;
+	}
+	return sq <= s[3] * s[3];
+}
+
+void
+shadow_casters::update(uint64_t id, const float aabb[6]) {
+	box b;
+	memcpy(b.v, aabb, sizeof(b.v));
+	auto it = casters.find(id);
+	if (it != casters.end()) {
+		changed.push_back(it->second);
+		it->second = b;
+	} else {
+		casters.emplace(id, b);
+	}
+	changed.push_back(b);
+}
+
+void
+shadow_casters::remove(uint64_t id) {
+	auto it = casters.find(id);
+	if (it != casters.end()) {
+		changed.push_back(it->second);
+		casters.erase(it);
+	}
+}
+
+void
+shadow_casters::mark_dirty(local_light* lights, const float* spheres, size_t num) {
+	for (size_t i = 0; i < num; ++i) {
+		auto& l = lights[i];
+		for (size_t c = 0; !l.dirty && c < changed.size(); ++c) {
+			l.dirty = sphere_aabb(&spheres[i * 4], changed[c].v);
+		}
+	}
+	changed.clear();
+}
+
+shadow_scheduler::shadow_scheduler(uint32_t atlas_size, uint32_t min_tile, uint32_t max_tile, uint32_t b)
+	: allocator(atlas_size, min_tile)
+	, max_size(std::clamp(next_pow2(max_tile), min_tile, atlas_size))
+	, budget(b) {
+}
+
+uint32_t
+shadow_scheduler::tile_size(float coverage, uint32_t faces) const {
+	// a face of a point light sees a quarter of what a spot light sees across
+	float s = std::clamp(coverage, 0.f, 1.f) * max_size;
+	if (faces > 1) {
+		s *= 0.5f;
+	}
+	return std::clamp(next_pow2((uint32_t)s), allocator.min_tile(), max_size);
+}
+
+void
+shadow_scheduler::release(light_state& s) {
+	for (uint32_t f = 0; f < s.faces; ++f) {
+		allocator.free(s.face[f].tile);
+		s.face[f] = face_state {};
+	}
+	s.size = 0;
+}
+
+// all the faces of the light, at size or smaller
+bool
+shadow_scheduler::place(light_state& s, uint32_t size) {
+	for (uint32_t sz = size; sz >= allocator.min_tile(); sz >>= 1) {
+		uint32_t f = 0;
+		for (; f < s.faces; ++f) {
+			if (!allocator.alloc(sz, s.face[f].tile)) {
+				break;
+			}
+		}
+		if (f == s.faces) {
+			s.size = sz;
+			for (f = 0; f < s.faces; ++f) {
+				s.face[f].valid = false;
+				s.face[f].dirty = true;
+				s.face[f].drawn = 0;
+			}
+			return true;
+		}
+		while (f > 0) {
+			--f;
+			allocator.free(s.face[f].tile);
+			s.face[f].tile = atlas_tile {};
+		}
+	}
+	s.size = 0;
+	return false;
+}
+
+const std::vector<shadow_view>&
+shadow_scheduler::update(const local_light* in, size_t num, uint64_t frame) {
+	views.clear();
+	last = stat {};
+	last.lights = (uint32_t)num;
+
+	std::vector<std::pair<light_state*, uint64_t>> order;
+	order.reserve(num);
+	for (size_t i = 0; i < num; ++i) {
+		const auto& l = in[i];
+		assert(l.faces == 1 || l.faces == MAX_FACE);
+		auto [it, inserted] = lights.try_emplace(l.id);
+		auto& s = it->second;
+		if (inserted) {
+			s = light_state {};
+			s.faces = l.faces;
+		} else if (s.faces != l.faces) {
+			release(s);
+			s.faces = l.faces;
+		}
+		s.seen = frame;
+		s.coverage = l.coverage;
+		if (l.dirty) {
+			for (uint32_t f = 0; f < s.faces; ++f) {
+				s.face[f].dirty = true;
+			}
+		}
+		order.emplace_back(&s, l.id);
+	}
+	for (auto it = lights.begin(); it != lights.end();) {
+		if (it->second.seen != frame) {
+			release(it->second);
+			it = lights.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	// the lights covering more of the screen get their tiles first, and may take the tiles of the others
+	std::sort(order.begin(), order.end(), [](const auto& a, const auto& b) {
+		return a.first->coverage != b.first->coverage ? a.first->coverage > b.first->coverage : a.second < b.second;
+	});
+	for (auto& [s, id] : order) {
+		const uint32_t desired = tile_size(s->coverage, s->faces);
+		// it grows at once, and shrinks only when it is four times too large
+		if (s->size != 0 && desired <= s->size && desired * 4 > s->size) {
+			continue;
+		}
+		release(*s);
+		while (!place(*s, desired)) {
+			light_state* victim = nullptr;
+			for (auto& [vid, v] : lights) {
+				if (v.size != 0 && v.coverage < s->coverage && (victim == nullptr || v.coverage < victim->coverage)) {
+					victim = &v;
+				}
+			}
+			if (victim == nullptr) {
+				break;
+			}
+			release(*victim);
+		}
+		if (s->size != 0) {
+			++last.allocs;
+		}
+	}
+
+	// the faces never drawn first, then the ones covering more and waiting longer
+	struct candidate {
+		uint64_t light;
+		uint32_t face;
+		bool valid;
+		float score;
+	};
+	std::vector<candidate> candidates;
+	for (auto& [id, s] : lights) {
+		if (s.size == 0) {
+			continue;
+		}
+		++last.shadowed;
+		for (uint32_t f = 0; f < s.faces; ++f) {
+			const auto& fs = s.face[f];
+			if (fs.dirty) {
+				candidates.push_back({ id, f, fs.valid, s.coverage * (float)(frame - fs.drawn + 1) });
+			}
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const candidate& a, const candidate& b) {
+		if (a.valid != b.valid) {
+			return !a.valid;
+		}
+		if (a.score != b.score) {
+			return a.score > b.score;
+		}
+		return a.light != b.light ? a.light < b.light : a.face < b.face;
+	});
+	const size_t n = std::min<size_t>(budget, candidates.size());
+	for (size_t i = 0; i < n; ++i) {
+		auto& fs = lights[candidates[i].light].face[candidates[i].face];
+		fs.valid = true;
+		fs.dirty = false;
+		fs.drawn = frame;
+		views.push_back({ candidates[i].light, candidates[i].face, fs.tile });
+	}
+	last.views = (uint32_t)views.size();
+	last.pending = (uint32_t)(candidates.size() - n);
+	return views;
+}
+
+bool
+shadow_scheduler::tile(uint64_t light, uint32_t face, atlas_tile& t) const {
+	auto it = lights.find(light);
+	if (it == lights.end() || it->second.size == 0 || face >= it->second.faces || !it->second.face[face].valid) {
+		return false;
+	}
+	t = it->second.face[face].tile;
+	return true;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+// Shadows of the point and spot lights (graphic/shadow/local).
+// Every face of a light (one for a spot light, six for a point light) gets a square tile of a
+// single depth atlas, sized by the screen coverage of the light. Only a budget of faces is drawn
+// each frame, a face is drawn again only when its light or a caster in its range changed, so
+// the tiles of static lights are reused as they are.
+
+// a square of the atlas in texels, size 0 is no tile
+struct atlas_tile {
+	uint16_t x, y;
+	uint16_t size;
+};
+
+// Quadtree allocator, the tiles are powers of two from min_tile to the atlas size.
+// A free tile is split into four to allocate a smaller one, four free siblings are merged back.
+class shadow_atlas {
+public:
+	shadow_atlas(uint32_t size, uint32_t min_tile);
+
+	uint32_t size() const { return atlas_size; }
+	uint32_t min_tile() const { return min_size; }
+	// size is rounded up to a power of two, false when there is no room
+	bool alloc(uint32_t size, atlas_tile& tile);
+	void free(const atlas_tile& tile);
+	// in texels
+	uint64_t free_area() const;
+
+private:
+	int level_of(uint32_t size) const;
+	bool alloc_level(int level, uint32_t& node);
+	void free_level(int level, uint32_t node);
+
+	uint32_t atlas_size;
+	uint32_t min_size;
+	// the free nodes of each level, level 0 is the whole atlas; a node is y << 16 | x in tiles of its level
+	std::vector<std::set<uint32_t>> free_nodes;
+};
+
+struct local_light {
+	uint64_t id;
+	uint32_t faces;		// 1 for a spot light, 6 for a point light
+	float coverage;		// the screen height the range of the light covers, in [0, 1]
+	bool dirty;			// the light or a caster in its range changed
+};
+
+// The last box of each caster. A light is dirty when a caster moves into or out of its range,
+// or a caster in its range is removed, so the old boxes are tested as well as the new ones.
+class shadow_casters {
+public:
+	// aabb is min xyz, max xyz in world space, for a new or moved caster
+	void update(uint64_t id, const float aabb[6]);
+	void remove(uint64_t id);
+	// marks the lights with a changed box in their sphere (x, y, z, range) dirty, then forgets the changes
+	void mark_dirty(local_light* lights, const float* spheres, size_t num);
+	size_t size() const { return casters.size(); }
+
+private:
+	struct box {
+		float v[6];
+	};
+	std::unordered_map<uint64_t, box> casters;
+	std::vector<box> changed;	// the old and new boxes since mark_dirty
+};
+
+struct shadow_view {
+	uint64_t light;
+	uint32_t face;
+	atlas_tile tile;
+};
+
+class shadow_scheduler {
+public:
+	static constexpr uint32_t MAX_FACE = 6;
+
+	// budget is the number of faces drawn in a frame
+	shadow_scheduler(uint32_t atlas_size, uint32_t min_tile, uint32_t max_tile, uint32_t budget);
+
+	// the lights of the frame, the lights not in it lose their tiles; returns the faces to draw
+	const std::vector<shadow_view>& update(const local_light* lights, size_t num, uint64_t frame);
+	// the tile of a face, when it has been drawn since the tile was allocated
+	bool tile(uint64_t light, uint32_t face, atlas_tile& tile) const;
+
+	// the tile size of a light face for its coverage
+	uint32_t tile_size(float coverage, uint32_t faces) const;
+	const shadow_atlas& atlas() const { return allocator; }
+
+	struct stat {
+		uint32_t lights;
+		uint32_t shadowed;		// the lights with tiles
+		uint32_t views;			// the faces drawn this frame
+		uint32_t pending;		// the faces left to draw
+		uint32_t allocs;		// the lights given new tiles this frame
+	};
+	const stat& stats() const { return last; }
+
+private:
+	struct face_state {
+		atlas_tile tile;
+		bool valid;			// drawn since the tile was allocated
+		bool dirty;
+		uint64_t drawn;		// the frame it was drawn
+	};
+	struct light_state {
+		uint32_t faces;
+		uint32_t size;		// of each face, 0 when it has no tiles
+		float coverage;
+		uint64_t seen;
+		face_state face[MAX_FACE];
+	};
+	void release(light_state& s);
+	bool place(light_state& s, uint32_t size);
+
+	shadow_atlas allocator;
+	uint32_t max_size;
+	uint32_t budget;
+	std::unordered_map<uint64_t, light_state> lights;
+	std::vector<shadow_view> views;
+	stat last = {};
+};
@@ -0,0 +1,273 @@
+#include "ecs/world.h"
+#include "ecs/select.h"
+#include "ecs/version.h"
+#include "ecs/component.hpp"
+
+extern "C"{
+	#include "math3d.h"
+	#include "math3dfunc.h"
+}
+
+#include "csm_cache.h"
+
+#include <cstring>
+
+static inline struct shadow_cache*
+get_cache(lua_State *L, struct ecs_world *w) {
+	if (w->shadow_cache == nullptr) {
+		luaL_error(L, "shadow.cache is not initialized");
+	}
+	return w->shadow_cache;
+}
+
+static inline int
+check_cascade(lua_State *L, struct shadow_cache *sc, int idx) {
+	const int c = (int)luaL_checkinteger(L, idx) - 1;
+	luaL_argcheck(L, 0 <= c && c < sc->cache.cascade_num(), idx, "invalid cascade");
+	return c;
+}
+
+// bounding.scene_aabb as min xyz, max xyz, false when it is not ready
+template<typename EntityType>
+static bool
+scene_aabb(struct ecs_world *w, EntityType &e, float aabb[6]) {
+	const component::bounding *b = e.template component<component::bounding>();
+	if (b == nullptr || math_isnull(b->scene_aabb)) {
+		return false;
+	}
+	const float *v = math_value(w->math3d->M, b->scene_aabb);
+	memcpy(aabb, v, sizeof(float) * 3);
+	memcpy(aabb+3, v+4, sizeof(float) * 3);
+	return true;
+}
+
+static void
+add_caster(struct shadow_cache *sc, uint64_t eid, const component::render_object *ro) {
+	sc->rm_idx[eid] = ro->rm_idx;
+	sc->pending.push_back(eid);
+}
+
+static void
+remove_caster(struct shadow_cache *sc, uint64_t eid) {
+	auto it = sc->rm_idx.find(eid);
+	if (it == sc->rm_idx.end()) {
+		return;
+	}
+	if (it->second < sc->static_objects.size()) {
+		sc->static_objects[it->second] = 0;
+	}
+	sc->rm_idx.erase(it);
+	sc->cache.caster_remove(eid);
+}
+
+// init(cascade_num, shadowmap_size, settle_frames = 30)
+static int
+linit(lua_State *L) {
+	auto w = getworld(L);
+	const int num = (int)luaL_checkinteger(L, 1);
+	const int size = (int)luaL_checkinteger(L, 2);
+	const int settle = (int)luaL_optinteger(L, 3, 30);
+	luaL_argcheck(L, 0 < num && num <= csm_cache::MAX_CASCADE, 1, "invalid cascade number");
+	luaL_argcheck(L, size > 0, 2, "invalid shadowmap size");
+	w->shadow_cache = new struct shadow_cache(num, size, (uint32_t)settle);
+	w->shadow_cache->frame = w->frame;
+	return 0;
+}
+
+static int
+lexit(lua_State *L) {
+	auto w = getworld(L);
+	delete w->shadow_cache;
+	w->shadow_cache = nullptr;
+	return 0;
+}
+
+// set_light(math3d.serialize(Lv)) returns true when the light changed, every cascade is dirty then
+static int
+lset_light(lua_State *L) {
+	auto sc = get_cache(L, getworld(L));
+	size_t sz;
+	const char *lv = luaL_checklstring(L, 1, &sz);
+	luaL_argcheck(L, sz == sizeof(float) * 16, 1, "need a serialized matrix");
+	float m[16];
+	memcpy(m, lv, sizeof(m));
+	lua_pushboolean(L, sc->cache.set_light(m));
+	return 1;
+}
+
+// fit(cascade, minx, miny, minz, maxx, maxy, maxz) returns changed, and the window as minx, miny, minz, maxx, maxy, maxz
+static int
+lfit(lua_State *L) {
+	auto sc = get_cache(L, getworld(L));
+	const int c = check_cascade(L, sc, 1);
+	float v[6];
+	for (int i = 0; i < 6; ++i) {
+		v[i] = (float)luaL_checknumber(L, i+2);
+	}
+	const bool changed = sc->cache.fit(c, csm_window{ v[0], v[1], v[2], v[3], v[4], v[5] });
+	const csm_window& r = sc->cache.window(c);
+	lua_pushboolean(L, changed);
+	lua_pushnumber(L, r.minx);
+	lua_pushnumber(L, r.miny);
+	lua_pushnumber(L, r.minz);
+	lua_pushnumber(L, r.maxx);
+	lua_pushnumber(L, r.maxy);
+	lua_pushnumber(L, r.maxz);
+	return 7;
+}
+
+// caster(eid), the entity needs render_object and bounding
+static int
+lcaster(lua_State *L) {
+	auto w = getworld(L);
+	auto sc = get_cache(L, w);
+	const component::eid eid = (component::eid)luaL_checkinteger(L, 1);
+	auto e = ecs::find_entity(w->ecs, eid);
+	if (e.invalid()) {
+		return luaL_error(L, "Invalid entity id:%d", eid);
+	}
+	const component::render_object *ro = e.component<component::render_object>();
+	if (!ro) {
+		return luaL_error(L, "shadow caster need entity has 'render_object' component");
+	}
+	add_caster(sc, eid, ro);
+	return 0;
+}
+
+static int
+lremove(lua_State *L) {
+	auto sc = get_cache(L, getworld(L));
+	remove_caster(sc, (uint64_t)luaL_checkinteger(L, 1));
+	return 0;
+}
+
+// shown(eid, shown) when visible or cast_shadow of a caster changes at runtime, a hidden static
+// caster leaves its cascades dirty, a shown one comes back as a dynamic caster
+static int
+lshown(lua_State *L) {
+	auto w = getworld(L);
+	auto sc = w->shadow_cache;
+	if (sc == nullptr) {
+		return 0;
+	}
+	const component::eid eid = (component::eid)luaL_checkinteger(L, 1);
+	if (!lua_toboolean(L, 2)) {
+		remove_caster(sc, eid);
+		return 0;
+	}
+	auto e = ecs::find_entity(w->ecs, eid);
+	if (e.invalid()) {
+		return luaL_error(L, "Invalid entity id:%d", eid);
+	}
+	const component::render_object *ro = e.component<component::render_object>();
+	if (ro && sc->rm_idx.find(eid) == sc->rm_idx.end()) {
+		add_caster(sc, eid, ro);
+	}
+	return 0;
+}
+
+// after bounding_update: the moved casters become dynamic, the settled ones static
+static int
+lupdate(lua_State *L) {
+	auto w = getworld(L);
+	auto sc = get_cache(L, w);
+	float aabb[6];
+	if (!sc->pending.empty()) {
+		std::vector<uint64_t> pending;
+		pending.swap(sc->pending);
+		for (auto eid : pending) {
+			if (sc->rm_idx.find(eid) == sc->rm_idx.end()) {
+				continue;
+			}
+			auto e = ecs::find_entity(w->ecs, (component::eid)eid);
+			if (e.invalid()) {
+				continue;
+			}
+			if (scene_aabb(w, e, aabb)) {
+				sc->cache.caster_update(eid, aabb, w->frame);
+			} else {
+				sc->pending.push_back(eid);
+			}
+		}
+	}
+	const bool known = ecs::changed_select<component::eid>(w->ecs, w->versions->log<component::bounding>(), sc->frame, [&](auto& e) {
+		const uint64_t eid = (uint64_t)e.template get<component::eid>();
+		if (sc->rm_idx.find(eid) != sc->rm_idx.end() && scene_aabb(w, e, aabb)) {
+			sc->cache.caster_update(eid, aabb, w->frame);
+		}
+	});
+	if (!known) {
+		// not updated for longer than the version history, any caster may have moved
+		for (const auto& c : sc->rm_idx) {
+			auto e = ecs::find_entity(w->ecs, (component::eid)c.first);
+			if (!e.invalid() && scene_aabb(w, e, aabb)) {
+				sc->cache.caster_update(c.first, aabb, w->frame);
+			}
+		}
+	}
+	sc->frame = w->frame;
+
+	sc->cache.update(w->frame);
+	sc->cache.flush_changes([sc](uint64_t eid, bool is_static) {
+		auto it = sc->rm_idx.find(eid);
+		if (it == sc->rm_idx.end()) {
+			return;
+		}
+		const uint32_t idx = it->second;
+		if (idx >= sc->static_objects.size()) {
+			sc->static_objects.resize(idx + 1, 0);
+		}
+		sc->static_objects[idx] = is_static ? 1 : 0;
+	});
+	return 0;
+}
+
+// dirty(cascade) returns true when the static layer of the cascade has to be drawn this frame
+static int
+ldirty(lua_State *L) {
+	auto sc = get_cache(L, getworld(L));
+	const int c = check_cascade(L, sc, 1);
+	lua_pushboolean(L, sc->cache.valid(c) && sc->cache.dirty(c));
+	return 1;
+}
+
+static int
+lclean(lua_State *L) {
+	auto sc = get_cache(L, getworld(L));
+	sc->cache.clean(check_cascade(L, sc, 1));
+	return 0;
+}
+
+static int
+lstat(lua_State *L) {
+	auto sc = get_cache(L, getworld(L));
+	lua_createtable(L, 0, 2);
+	lua_pushinteger(L, (lua_Integer)sc->cache.caster_num());
+	lua_setfield(L, -2, "casters");
+	lua_pushinteger(L, (lua_Integer)sc->cache.dynamic_num());
+	lua_setfield(L, -2, "dynamics");
+	return 1;
+}
+
+extern "C" int
+luaopen_shadow_cache(lua_State *L) {
+	luaL_checkversion(L);
+	luaL_Reg l[] = {
+		{ "init", linit },
+		{ "exit", lexit },
+		{ "set_light", lset_light },
+		{ "fit", lfit },
+		{ "caster", lcaster },
+		{ "remove", lremove },
+		{ "shown", lshown },
+		{ "update", lupdate },
+		{ "dirty", ldirty },
+		{ "clean", lclean },
+		{ "stat", lstat },
+		{ NULL, NULL },
+	};
+	luaL_newlibtable(L,l);
+	lua_pushnil(L);
+	luaL_setfuncs(L,l,1);
+	return 1;
+}
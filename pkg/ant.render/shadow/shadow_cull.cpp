@@ -0,0 +1,169 @@
+#include "ecs/world.h"
+#include "ecs/select.h"
+#include "ecs/component.hpp"
+
+extern "C"{
+	#include "math3d.h"
+	#include "math3dfunc.h"
+}
+
+#include "../render/queue.h"
+#include "caster_cull.h"
+
+#include <cstring>
+#include <vector>
+
+struct shadow_cull {
+	shadow_cull(struct ecs_context* ctx) : render_obj(ctx), hitch_obj(ctx){}
+	ecs::cached_context<component::render_object_visible, component::render_object, component::visible, component::bounding> render_obj;
+	ecs::cached_context<component::hitch_visible, component::hitch, component::visible, component::bounding> hitch_obj;
+	caster_cull cc;
+	std::vector<int> cull_idx;	// of the casters, in the order they are added
+};
+
+static int
+linit(lua_State *L) {
+	auto w = getworld(L);
+	w->shadow_cull = new struct shadow_cull(w->ecs);
+	return 0;
+}
+
+static int
+lexit(lua_State *L) {
+	auto w = getworld(L);
+	delete w->shadow_cull;
+	w->shadow_cull = nullptr;
+	return 0;
+}
+
+static void
+check_matrix(lua_State *L, int idx, float m[16]) {
+	size_t sz;
+	const char *s = luaL_checklstring(L, idx, &sz);
+	luaL_argcheck(L, sz == sizeof(float) * 16, idx, "need a serialized matrix");
+	memcpy(m, s, sizeof(float) * 16);
+}
+
+static float
+field_number(lua_State *L, int idx, const char *name) {
+	lua_getfield(L, idx, name);
+	if (!lua_isnumber(L, -1)) {
+		luaL_error(L, "cascade.%s need a number", name);
+	}
+	const float v = (float)lua_tonumber(L, -1);
+	lua_pop(L, 1);
+	return v;
+}
+
+static void
+set_number(lua_State *L, int idx, const char *name, lua_Number v) {
+	lua_pushnumber(L, v);
+	lua_setfield(L, idx, name);
+}
+
+template<typename ObjType, typename EntityType>
+static void
+add_object(struct ecs_world *w, EntityType &e, uint8_t main_queue) {
+	const auto &b = e.template get<component::bounding>();
+	if (math_isnull(b.scene_aabb)) {
+		return;
+	}
+	const bool caster = e.template component<component::cast_shadow>();
+	const auto &o = e.template get<ObjType>();
+	// the receivers of the main view, culled the last frame
+	const bool receiver = e.template component<component::receive_shadow>() &&
+		queue_check(w->Q, o.visible_idx, main_queue) && !queue_check(w->Q, o.cull_idx, main_queue);
+	if (!caster && !receiver) {
+		return;
+	}
+	const float *v = math_value(w->math3d->M, b.scene_aabb);
+	const float aabb[6] = { v[0], v[1], v[2], v[4], v[5], v[6] };
+	w->shadow_cull->cc.add(aabb, receiver, caster);
+	if (caster) {
+		w->shadow_cull->cull_idx.push_back(o.cull_idx);
+	}
+}
+
+// cull(math3d.serialize(Lv), math3d.serialize(Cv), main_queue_index, cascades)
+// cascades[i] = { l0=, l1=, r0=, r1=, b0=, b1=, t0=, t1=, n=, f=, queue= }, see csm_slice.
+// The casters not in a cascade are culled in its queue, the results are written to the cascades:
+// minx, miny, minz, maxx, maxy, maxz in light space, receivers and casters.
+static int
+lcull(lua_State *L) {
+	auto w = getworld(L);
+	auto sc = w->shadow_cull;
+	float lv[16], cv[16];
+	check_matrix(L, 1, lv);
+	check_matrix(L, 2, cv);
+	const uint8_t main_queue = (uint8_t)luaL_checkinteger(L, 3);
+	luaL_checktype(L, 4, LUA_TTABLE);
+	const int num = (int)luaL_len(L, 4);
+	luaL_argcheck(L, 0 < num && num <= caster_cull::MAX_CASCADE, 4, "invalid cascade number");
+
+	csm_slice slices[caster_cull::MAX_CASCADE];
+	uint8_t queues[caster_cull::MAX_CASCADE];
+	for (int c = 0; c < num; ++c) {
+		lua_geti(L, 4, c+1);
+		const int idx = lua_gettop(L);
+		luaL_checktype(L, idx, LUA_TTABLE);
+		slices[c] = csm_slice {
+			field_number(L, idx, "l0"), field_number(L, idx, "l1"),
+			field_number(L, idx, "r0"), field_number(L, idx, "r1"),
+			field_number(L, idx, "b0"), field_number(L, idx, "b1"),
+			field_number(L, idx, "t0"), field_number(L, idx, "t1"),
+			field_number(L, idx, "n"), field_number(L, idx, "f"),
+		};
+		queues[c] = (uint8_t)field_number(L, idx, "queue");
+		lua_pop(L, 1);
+	}
+
+	sc->cc.begin(lv, cv, slices, num);
+	sc->cull_idx.clear();
+	for (auto& e : ecs::cached_select(sc->render_obj)) {
+		add_object<component::render_object>(w, e, main_queue);
+	}
+	for (auto& e : ecs::cached_select(sc->hitch_obj)) {
+		add_object<component::hitch>(w, e, main_queue);
+	}
+	sc->cc.cull();
+
+	for (size_t i = 0; i < sc->cull_idx.size(); ++i) {
+		const uint8_t m = sc->cc.mask(i);
+		for (int c = 0; c < num; ++c) {
+			queue_set(w->Q, sc->cull_idx[i], queues[c], (m & (1 << c)) == 0);
+		}
+	}
+
+	for (int c = 0; c < num; ++c) {
+		const auto& r = sc->cc.result(c);
+		lua_geti(L, 4, c+1);
+		const int idx = lua_gettop(L);
+		set_number(L, idx, "minx", r.bounds.minx);
+		set_number(L, idx, "miny", r.bounds.miny);
+		set_number(L, idx, "minz", r.bounds.minz);
+		set_number(L, idx, "maxx", r.bounds.maxx);
+		set_number(L, idx, "maxy", r.bounds.maxy);
+		set_number(L, idx, "maxz", r.bounds.maxz);
+		lua_pushinteger(L, r.receivers);
+		lua_setfield(L, idx, "receivers");
+		lua_pushinteger(L, r.casters);
+		lua_setfield(L, idx, "casters");
+		lua_pop(L, 1);
+	}
+	return 0;
+}
+
+extern "C" int
+luaopen_shadow_cull(lua_State *L) {
+	luaL_checkversion(L);
+	luaL_Reg l[] = {
+		{ "init", linit },
+		{ "exit", lexit },
+		{ "cull", lcull },
+		{ NULL, NULL },
+	};
+	luaL_newlibtable(L,l);
+	lua_pushnil(L);
+	luaL_setfuncs(L,l,1);
+	return 1;
+}
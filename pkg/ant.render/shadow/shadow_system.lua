@@ -56,6 +56,23 @@ local TEXTURE_BIAS_MATRIX<const> = mu.texture_bias_matrix
 
 local SHADOW_PARAM<const>	= math3d.ref(math3d.vector(NORMAL_OFFSET, 1.0/SM_SIZE, ics.split_num, 0.0))
 
+--static casters are drawn into a persistent layer, copied to the cascade every frame, see csm_cache.h
+local STATIC_CACHE<const>	= setting:get "graphic/shadow/static_cache"
+local SC					= STATIC_CACHE and world:clibs "shadow.cache" or nil
+local RC					= STATIC_CACHE and world:clibs "render.cache" or nil
+local csm_rb, static_rb
+
+--the casters of each cascade are culled against its receivers, and the cascade is fitted to them, see caster_cull.h
+local CASTER_CULL<const>	= setting:get "graphic/shadow/caster_cull"
+local SCULL					= CASTER_CULL and world:clibs "shadow.cull" or nil
+local CULL_CASCADES			= {}
+local last_zn, last_zf
+if CASTER_CULL then
+	for ii=1, ics.split_num do
+		CULL_CASCADES[ii] = {queue = queuemgr.queue_index("csm" .. ii .. "_queue")}
+	end
+end
+
 local function calc_focus_matrix(aabb)
 	local center, extents = math3d.aabb_center_extents(aabb)
 
@@ -105,6 +122,40 @@ local function create_csm_entity(index, vr, fbidx)
 			render_target = {
 				viewid = hwi.viewid_get(csmname),
 				view_rect = {x=vr.x, y=vr.y, w=vr.w, h=vr.h},
+				--the static layer is copied before the dynamic casters are drawn
+				clear_state = STATIC_CACHE and {clear = ""} or {
+					clear = "D",
+					depth = CLEAR_DEPTH_VALUE,
+				},
+				fb_idx = fbidx,
+			},
+			visible = false,
+			queue_name = queuename,
+			submit_queue = true,
+			cull_external = CASTER_CULL or nil,
+			[queuename] = true,
+		},
+	}
+	return camera_ref
+end
+
+--it shares the camera of the cascade, and it is visible only in the frames the static layer is redrawn
+local function create_csm_static_entity(index, camera_ref, vr, fbidx)
+	local name = "csm_static" .. index
+	local queuename = name .. "_queue"
+	world:create_entity {
+		policy = {
+			"ant.render|render_queue",
+			"ant.render|csm_static_queue",
+		},
+		data = {
+			csm_static = {
+				index = index,
+			},
+			camera_ref = camera_ref,
+			render_target = {
+				viewid = hwi.viewid_get(name),
+				view_rect = {x=vr.x, y=vr.y, w=vr.w, h=vr.h},
 				clear_state = {
 					clear = "D",
 					depth = CLEAR_DEPTH_VALUE,
@@ -147,8 +198,29 @@ function shadow_sys:init()
 			V="BORDER",
 			COMPARE="COMPARE_GEQUAL",
 			BOARD_COLOR="0",
+			BLIT=STATIC_CACHE and "BLIT_AS_DST" or nil,
 		},
 	}
+	if STATIC_CACHE then
+		csm_rb = rb_arrays
+		static_rb = fbmgr.create_rb{
+			format = "D16",
+			w=SM_SIZE,
+			h=SM_SIZE,
+			layers=math.max(2, ics.split_num),
+			flags=sampler{
+				RT="RT_ON",
+				MIN="POINT",
+				MAG="POINT",
+				U="CLAMP",
+				V="CLAMP",
+			},
+		}
+		SC.init(ics.split_num, SM_SIZE)
+	end
+	if CASTER_CULL then
+		SCULL.init()
+	end
 
 	local function create_fb(rb, refidx)
 		return fbmgr.create{
@@ -162,7 +234,10 @@ function shadow_sys:init()
 
 	for ii=1, ics.split_num do
 		local vr = {x=0, y=0, w=SM_SIZE, h=SM_SIZE}
-		create_csm_entity(ii, vr, create_fb(rb_arrays, ii))
+		local camera_ref = create_csm_entity(ii, vr, create_fb(rb_arrays, ii))
+		if STATIC_CACHE then
+			create_csm_static_entity(ii, camera_ref, vr, create_fb(static_rb, ii))
+		end
 		fg.register_pass("csm" .. ii, {
 			init = function () end,	--TODO
 			run = function () end,	--TODO
@@ -173,6 +248,25 @@ function shadow_sys:init()
 	imaterial.system_attrib_update("u_shadow_param1",	SHADOW_PARAM)
 end
 
+function shadow_sys:post_init()
+	if STATIC_CACHE then
+		for ii=1, ics.split_num do
+			local qn, sqn = "csm" .. ii .. "_queue", "csm_static" .. ii .. "_queue"
+			RC.set_queue_type(qn, queuemgr.queue_index(qn))
+			RC.set_queue_type(sqn, queuemgr.queue_index(sqn))
+		end
+	end
+end
+
+function shadow_sys:exit()
+	if STATIC_CACHE then
+		SC.exit()
+	end
+	if CASTER_CULL then
+		SCULL.exit()
+	end
+end
+
 local function set_csm_visible(enable)
 	for v in w:select "csm" do
 		irender.set_visible(v, enable)
@@ -193,6 +287,11 @@ function shadow_sys:entity_remove()
 	for _ in w:select "REMOVED csm_directional_light" do
 		set_csm_visible(false)
 	end
+	if STATIC_CACHE then
+		for e in w:select "REMOVED cast_shadow eid:in" do
+			SC.remove(e.eid)
+		end
+	end
 end
 
 local function mark_camera_changed(e)
@@ -264,13 +363,92 @@ local function update_shadow_matrices(si, li, c, viewfrustum)
 	update_camera(c, li.Lv, li.Lp)
 end
 
+--the window of the cascade only moves when the cascade leaves it, returns true then
+local function fit_cached_window(si, li, c, index, minx, miny, n, maxx, maxy, f)
+	local changed, l, b, wn, r, t, wf = SC.fit(index, minx, miny, n, maxx, maxy, f)
+	if changed then
+		local cf = c.frustum
+		cf.l, cf.r, cf.t, cf.b, cf.n, cf.f = l, r, t, b, wn, wf
+		si.nearLS, si.farLS = wn, wf
+		li.Lp = math3d.projmat(cf, INV_Z)
+		update_camera(c, li.Lv, li.Lp)
+	end
+	return changed
+end
+
+local function update_cached_shadow_matrices(si, li, c, viewfrustum, index)
+	local sp = math3d.projmat(viewfrustum)
+	local Lv2Ndc = math3d.mul(sp, li.Lv2Cv)
+
+	local intersectpointsLS = math3d.frustum_aabb_intersect_points(Lv2Ndc, si.sceneaabbLS)
+	if mc.NULL == intersectpointsLS then
+		return false
+	end
+
+	local n, f = calc_light_view_nearfar(intersectpointsLS, si.sceneaabbLS)
+	local minv, maxv = mu.aabb_minmax(math3d.minmax(intersectpointsLS))
+	local minx, miny = math3d.index(minv, 1, 2)
+	local maxx, maxy = math3d.index(maxv, 1, 2)
+	return fit_cached_window(si, li, c, index, minx, miny, n, maxx, maxy, f)
+end
+
+--r is the result of the caster cull of the cascade, the receivers in the slice with the near plane pulled to the casters
+local function update_culled_shadow_matrices(si, li, c, r, index)
+	if r.receivers == 0 then
+		return false
+	end
+	local n, f = r.minz, math.max(r.maxz, r.minz + 1e-3)
+	if STATIC_CACHE then
+		return fit_cached_window(si, li, c, index, r.minx, r.miny, n, r.maxx, r.maxy, f)
+	end
+	c.frustum.n, c.frustum.f = n, f
+	si.nearLS, si.farLS = n, f
+	li.Lp = math3d.projmat(c.frustum, INV_Z)
+
+	local bounds = math3d.array_vector{math3d.vector(r.minx, r.miny, n), math3d.vector(r.maxx, r.maxy, f)}
+	local F = calc_focus_matrix(math3d.minmax(bounds, li.Lp))
+	li.Lp = math3d.mul(F, li.Lp)
+	update_camera(c, li.Lv, li.Lp)
+	return true
+end
+
+--the view space slice of the camera frustum, see csm_slice in caster_cull.h
+local function update_cull_slice(t, CF, viewfrustum)
+	if CF.ortho then
+		t.l0, t.r0, t.b0, t.t0 = CF.l, CF.r, CF.b, CF.t
+		t.l1, t.r1, t.b1, t.t1 = 0, 0, 0, 0
+	else
+		if CF.fov then
+			local ty = math.tan(math.rad(CF.fov) * 0.5)
+			local tx = ty * CF.aspect
+			t.l1, t.r1, t.b1, t.t1 = -tx, tx, -ty, ty
+		else
+			t.l1, t.r1, t.b1, t.t1 = CF.l / CF.n, CF.r / CF.n, CF.b / CF.n, CF.t / CF.n
+		end
+		t.l0, t.r0, t.b0, t.t0 = 0, 0, 0, 0
+	end
+	t.n, t.f = viewfrustum.n, viewfrustum.f
+end
+
+local function cull_casters(li, CF, csmfrustums)
+	for ii=1, ics.split_num do
+		update_cull_slice(CULL_CASCADES[ii], CF, csmfrustums[ii])
+	end
+	SCULL.cull(math3d.serialize(li.Lv), math3d.serialize(li.Cv), queuemgr.queue_index "main_queue", CULL_CASCADES)
+end
+
+--the camera right direction changes the light view with the camera, the cached cascades need a fixed one
+local function light_updir(lightdirWS)
+	return math.abs(math3d.index(lightdirWS, 2)) > 0.99 and mc.ZAXIS or mc.YAXIS
+end
+
 local function init_light_info(C, D, li)
     local lightdirWS = math3d.index(D.scene.worldmat, 3)
 	local Cv = C.camera.viewmat
 
 	local rightdir, viewdir, camerapos = math3d.index(C.scene.worldmat, 1, 3, 4)
 
-	local Lv = math3d.lookto(mc.ZERO_PT, lightdirWS, rightdir)
+	local Lv = math3d.lookto(mc.ZERO_PT, lightdirWS, STATIC_CACHE and light_updir(lightdirWS) or rightdir)
 	local Lw = math3d.inverse_fast(Lv)
 
 	li.Lv			= Lv
@@ -336,8 +514,32 @@ local function shadow_changed()
 	end
 end
 
+--the receivers are the ones the main queue culled the last frame, after a change they are
+--settled only the next frame, so the casters are culled once more then
+local cull_again = false
+
+--the casters are culled again when they move, with the split of the last scene info
+local function casters_moved(again)
+	if not last_zn or not (again or w:check "scene_changed") then
+		return
+	end
+	local D = w:first "make_shadow directional_light scene:in"
+	if not D then
+		return
+	end
+	local C = irq.main_camera_entity "camera:in scene:in"
+	return true, C, D, w:first "shadow_bounding:in".shadow_bounding
+end
+
 function shadow_sys:update_camera_depend()
 	local changed, C, D, sb = shadow_changed()
+	if CASTER_CULL then
+		local again = cull_again
+		cull_again = changed or w:check "scene_changed" or false
+		if not changed then
+			changed, C, D, sb = casters_moved(again)
+		end
+	end
 	if not changed then
 		return
 	end
@@ -348,35 +550,85 @@ function shadow_sys:update_camera_depend()
 
 	local si, li = sb.scene_info, sb.light_info
 	init_light_info(C, D, sb.light_info)
-	si.sceneaabbLS = build_sceneaabbLS(si, li)
+	if STATIC_CACHE then
+		SC.set_light(math3d.serialize(li.Lv))
+	end
 	local CF = C.camera.frustum
 	si.view_near, si.view_far = CF.n, CF.f
+	if CASTER_CULL then
+		if si.zn then
+			last_zn, last_zf = si.zn, si.zf
+		else
+			si.zn, si.zf = last_zn, last_zf
+		end
+	end
+	if si.PSR then
+		si.sceneaabbLS = build_sceneaabbLS(si, li)
+	end
 
 	-- print("near", si.view_near, "far", si.view_far)
 	local zn, zf = assert(si.zn), assert(si.zf)
 	local _ = (zn >= 0 and zf > zn) or error(("Invalid near and far after cliped, zn must >= 0 and zf > zn, where zn: %2f, zf: %2f"):format(zn, zf))
 	--split bounding zn, zf
 	local csmfrustums = ics.split_viewfrustum(zn, zf, CF)
+	if CASTER_CULL then
+		cull_casters(li, CF, csmfrustums)
+	end
 
     for e in w:select "csm:in camera_ref:in queue_name:in" do
         local ce<close> = world:entity(e.camera_ref, "scene:update camera:in")	--update scene.worldmat
         local c = ce.camera
         local csm = e.csm
 		local viewfrustum = csmfrustums[csm.index]
-		update_shadow_matrices(si, li, c, viewfrustum)
-		mark_camera_changed(ce)
+		local changed = true
+		if CASTER_CULL then
+			changed = update_culled_shadow_matrices(si, li, c, CULL_CASCADES[csm.index], csm.index)
+		elseif STATIC_CACHE then
+			changed = update_cached_shadow_matrices(si, li, c, viewfrustum, csm.index)
+		else
+			update_shadow_matrices(si, li, c, viewfrustum)
+		end
+		if changed then
+			mark_camera_changed(ce)
 
-		ce.scene.worldmat = mu.M3D_mark(ce.scene.worldmat, li.Lw)
+			ce.scene.worldmat = mu.M3D_mark(ce.scene.worldmat, li.Lw)
 
-		csm_matrices[csm.index].m = math3d.mul(TEXTURE_BIAS_MATRIX, c.viewprojmat)
+			csm_matrices[csm.index].m = math3d.mul(TEXTURE_BIAS_MATRIX, c.viewprojmat)
+		end
 		split_distances_VS[csm.index] = viewfrustum.f
     end
 
 	commit_csm_matrices_attribs()
 end
 
+local function update_static_cache()
+	SC.update()
+	if w:count "csm_directional_light" == 0 then
+		return
+	end
+	for e in w:select "csm_static:in camera_ref:in" do
+		local index = e.csm_static.index
+		local dirty = SC.dirty(index)
+		irender.set_visible(e, dirty)
+		if dirty then
+			--cull and set the view transform of the static queue with the camera of the cascade
+			local ce <close> = world:entity(e.camera_ref, "camera_changed?out")
+			mark_camera_changed(ce)
+			SC.clean(index)
+		end
+	end
+
+	local dst, src = fbmgr.get_rb(csm_rb).handle, fbmgr.get_rb(static_rb).handle
+	for ii=1, ics.split_num do
+		bgfx.blit(hwi.viewid_get("csm" .. ii), dst, 0, 0, 0, ii-1, src, 0, 0, 0, ii-1, SM_SIZE, SM_SIZE, 1)
+	end
+end
+
 function shadow_sys:camera_usage()
 	w:clear "scene_bounding_changed"
+	if STATIC_CACHE then
+		update_static_cache()
+	end
 end
 
 local function which_material(e, matres)
@@ -453,6 +705,13 @@ function shadow_sys:entity_ready()
 				castshadow = hasaabb
 			end
 		end
+		if STATIC_CACHE and castshadow then
+			-- a hidden caster joins the cache when it is shown, see irender.set_visible
+			w:extend(e, "eid:in visible?in")
+			if e.visible then
+				SC.caster(e.eid)
+			end
+		end
 		e.cast_shadow		= castshadow
 		e.receive_shadow	= receiveshadow
 	end
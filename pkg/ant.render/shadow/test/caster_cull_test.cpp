@@ -0,0 +1,258 @@
+// Ground tiles receive the shadows of boxes standing on them, under an oblique light.
+// On a small scene, points of the tiles inside each camera slice are traced towards the light:
+// every box such a ray hits has to be kept in the cascade, and lie behind its near plane.
+// Then a 100k objects scene is culled to time it, and to count the casters kept against
+// a test of the casters against the light space box of each slice.
+#include "../caster_cull.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+struct vec3 {
+    float x, y, z;
+};
+
+static vec3 normalize(vec3 v) {
+    const float l = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+    return { v.x / l, v.y / l, v.z / l };
+}
+
+static vec3 cross(vec3 a, vec3 b) {
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+static float dot(vec3 a, vec3 b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// left handed view looking along dir, column major
+static void lookto(float m[16], vec3 eye, vec3 dir, vec3 up) {
+    const vec3 z = normalize(dir);
+    const vec3 x = normalize(cross(up, z));
+    const vec3 y = cross(z, x);
+    const vec3 axis[3] = { x, y, z };
+    for (int i = 0; i < 3; ++i) {
+        m[i] = (&axis[i].x)[0];
+        m[4+i] = (&axis[i].x)[1];
+        m[8+i] = (&axis[i].x)[2];
+        m[12+i] = -dot(axis[i], eye);
+        m[3+i*4] = 0.f;
+    }
+    m[15] = 1.f;
+}
+
+static vec3 transform(const float m[16], vec3 p) {
+    return {
+        m[0] * p.x + m[4] * p.y + m[8] * p.z + m[12],
+        m[1] * p.x + m[5] * p.y + m[9] * p.z + m[13],
+        m[2] * p.x + m[6] * p.y + m[10] * p.z + m[14],
+    };
+}
+
+static bool in_slice(const csm_slice& s, vec3 v) {
+    return v.z >= s.n && v.z <= s.f &&
+        v.x >= s.l0 + s.l1 * v.z && v.x <= s.r0 + s.r1 * v.z &&
+        v.y >= s.b0 + s.b1 * v.z && v.y <= s.t0 + s.t1 * v.z;
+}
+
+// the ray from p along d hits the box
+static bool hit(const float aabb[6], vec3 p, vec3 d) {
+    float t0 = 0.f, t1 = INFINITY;
+    for (int i = 0; i < 3; ++i) {
+        const float o = (&p.x)[i], v = (&d.x)[i];
+        if (std::fabs(v) < 1e-8f) {
+            if (o < aabb[i] || o > aabb[i+3]) {
+                return false;
+            }
+            continue;
+        }
+        float a = (aabb[i] - o) / v, b = (aabb[i+3] - o) / v;
+        if (a > b) {
+            std::swap(a, b);
+        }
+        t0 = std::max(t0, a);
+        t1 = std::min(t1, b);
+        if (t0 > t1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct object {
+    float aabb[6];
+    bool receiver;
+    bool caster;
+};
+
+static float frand(float a, float b) {
+    return a + (b - a) * (float)rand() / (float)RAND_MAX;
+}
+
+// tiles of size 4 on y = 0, and boxes on them
+static std::vector<object> scene(int tiles, int boxes) {
+    std::vector<object> objs;
+    const float half = tiles * 2.f;
+    for (int z = 0; z < tiles; ++z) {
+        for (int x = 0; x < tiles; ++x) {
+            const float x0 = x * 4.f - half, z0 = z * 4.f - half;
+            objs.push_back({ { x0, -0.2f, z0, x0 + 4.f, 0.f, z0 + 4.f }, true, false });
+        }
+    }
+    for (int i = 0; i < boxes; ++i) {
+        const float x = frand(-half, half), z = frand(-half, half);
+        const float s = frand(0.2f, 2.f), h = frand(0.5f, 12.f);
+        objs.push_back({ { x - s, 0.f, z - s, x + s, h, z + s }, true, true });
+    }
+    return objs;
+}
+
+static const float SPLITS[5] = { 1.f, 8.f, 25.f, 70.f, 200.f };
+
+int main() {
+    int failed = 0;
+    auto check = [&](bool ok, const char* what) {
+        if (!ok) {
+            printf("FAILED: %s\n", what);
+            failed++;
+        }
+    };
+
+    const vec3 lightdir = normalize({ 0.3f, -1.f, 0.4f });
+    float lv[16], cv[16];
+    lookto(lv, { 0.f, 0.f, 0.f }, lightdir, { 0.f, 1.f, 0.f });
+    lookto(cv, { 3.f, 10.f, -40.f }, { 0.1f, -0.3f, 1.f }, { 0.f, 1.f, 0.f });
+
+    const float ty = std::tan(3.14159265f / 6.f), tx = ty * 16.f / 9.f;
+    csm_slice slices[4];
+    for (int c = 0; c < 4; ++c) {
+        slices[c] = csm_slice { 0.f, -tx, 0.f, tx, 0.f, -ty, 0.f, ty, SPLITS[c], SPLITS[c+1] };
+    }
+
+    caster_cull cc;
+
+    // correctness, every shadow on a receiver in a slice comes from a kept caster
+    {
+        srand(1);
+        auto objs = scene(20, 600);
+        cc.begin(lv, cv, slices, 4);
+        std::vector<size_t> caster_objs;
+        for (size_t i = 0; i < objs.size(); ++i) {
+            cc.add(objs[i].aabb, objs[i].receiver, objs[i].caster);
+            if (objs[i].caster) {
+                caster_objs.push_back(i);
+            }
+        }
+        cc.cull();
+        check(cc.caster_num() == caster_objs.size(), "every caster is numbered");
+
+        const vec3 tolight = { -lightdir.x, -lightdir.y, -lightdir.z };
+        int traced = 0, missing = 0, near_wrong = 0;
+        for (const auto& o : objs) {
+            if (o.caster) {
+                continue;
+            }
+            for (int sz = 0; sz < 4; ++sz) {
+                for (int sx = 0; sx < 4; ++sx) {
+                    const vec3 p = { o.aabb[0] + (sx + 0.5f), 0.f, o.aabb[2] + (sz + 0.5f) };
+                    const vec3 v = transform(cv, p);
+                    for (int c = 0; c < 4; ++c) {
+                        if (!in_slice(slices[c], v)) {
+                            continue;
+                        }
+                        traced++;
+                        for (size_t i = 0; i < caster_objs.size(); ++i) {
+                            const float* b = objs[caster_objs[i]].aabb;
+                            if (hit(b, p, tolight)) {
+                                if (!(cc.mask(i) & (1 << c))) {
+                                    missing++;
+                                }
+                                const vec3 top = transform(lv, { (b[0] + b[3]) * 0.5f, b[4], (b[2] + b[5]) * 0.5f });
+                                if (top.z < cc.result(c).bounds.minz) {
+                                    near_wrong++;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        printf("traced %d receiver points, %d missing casters, %d casters in front of the near plane\n", traced, missing, near_wrong);
+        check(traced > 1000, "the slices see the ground");
+        check(missing == 0, "no missing shadow caster");
+        check(near_wrong == 0, "the near plane is in front of the casters");
+
+        for (int c = 0; c < 4; ++c) {
+            const auto& r = cc.result(c);
+            const auto& s = cc.slice(c);
+            check(r.receivers > 0 && r.casters > 0, "each cascade has receivers and casters");
+            check(r.bounds.minx >= s.minx && r.bounds.maxx <= s.maxx && r.bounds.miny >= s.miny && r.bounds.maxy <= s.maxy,
+                "the bounds are in the slice");
+        }
+    }
+
+    // a caster behind every receiver, and one out of the light space bounds
+    {
+        const object ground = { { -50.f, -0.2f, -10.f, 50.f, 0.f, 100.f }, true, false };
+        const object below = { { 0.f, -300.f, 20.f, 1.f, -290.f, 21.f }, false, true };
+        const object aside = { { 500.f, 0.f, 20.f, 501.f, 2.f, 21.f }, false, true };
+        cc.begin(lv, cv, slices, 4);
+        cc.add(ground.aabb, true, false);
+        cc.add(below.aabb, false, true);
+        cc.add(aside.aabb, false, true);
+        cc.cull();
+        check(cc.mask(0) == 0, "a caster behind the receivers is culled");
+        check(cc.mask(1) == 0, "a caster aside the receivers is culled");
+        for (int c = 0; c < 4; ++c) {
+            check(cc.result(c).casters == 0, "no caster is counted");
+        }
+    }
+
+    // 100k objects
+    {
+        srand(2);
+        auto objs = scene(100, 90000);
+        const int RUNS = 20;
+        const auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < RUNS; ++run) {
+            cc.begin(lv, cv, slices, 4);
+            for (const auto& o : objs) {
+                cc.add(o.aabb, o.receiver, o.caster);
+            }
+            cc.cull();
+        }
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / RUNS;
+
+        size_t kept = 0, boxed = 0, caster_index = 0;
+        for (const auto& o : objs) {
+            if (!o.caster) {
+                continue;
+            }
+            const uint8_t m = cc.mask(caster_index++);
+            for (int c = 0; c < 4; ++c) {
+                kept += (m >> c) & 1;
+                // the light space box of the slice, the caster ends before its far plane or reaches it
+                float ls[6] = { INFINITY, INFINITY, INFINITY, -INFINITY, -INFINITY, -INFINITY };
+                for (int i = 0; i < 8; ++i) {
+                    const vec3 p = transform(lv, { o.aabb[(i & 1) ? 3 : 0], o.aabb[(i & 2) ? 4 : 1], o.aabb[(i & 4) ? 5 : 2] });
+                    ls[0] = std::min(ls[0], p.x); ls[3] = std::max(ls[3], p.x);
+                    ls[1] = std::min(ls[1], p.y); ls[4] = std::max(ls[4], p.y);
+                    ls[2] = std::min(ls[2], p.z); ls[5] = std::max(ls[5], p.z);
+                }
+                const auto& s = cc.slice(c);
+                if (ls[3] >= s.minx && ls[0] <= s.maxx && ls[4] >= s.miny && ls[1] <= s.maxy && ls[2] <= s.maxz) {
+                    boxed++;
+                }
+            }
+        }
+        printf("%zu objects, %zu casters: %.2f ms, %zu cascade draws kept, %zu with the slice boxes (%.1fx)\n",
+            objs.size(), cc.caster_num(), ms, kept, boxed, (double)boxed / (double)kept);
+        check(kept < boxed, "the receivers cull more than the slice boxes");
+    }
+
+    printf(failed ? "caster cull: %d failure(s)\n" : "caster cull: ok\n", failed);
+    return failed ? 1 : 0;
+}
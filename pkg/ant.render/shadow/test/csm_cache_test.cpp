@@ -0,0 +1,199 @@
+// A grid of static boxes, a few boxes moving every frame and a scripted camera path: slow walks,
+// a jump and a light change. Counts the caster draws of the cached cascades against redrawing
+// every caster in every cascade each frame, and checks after every frame that the static layer
+// of each cascade holds exactly the static casters in its window, where they are. A static caster
+// hidden at runtime must make the layer be drawn again.
+#include "../csm_cache.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+static constexpr int CASCADES = 4;
+static constexpr int SM_SIZE = 1024;
+static const float CASCADE_RADIUS[CASCADES] = { 8.f, 20.f, 50.f, 120.f };
+
+struct box {
+    float aabb[6];
+};
+
+// the light looks down -y: light x = x, light y = z, depth = -y
+static void top_down(float m[16]) {
+    memset(m, 0, sizeof(float) * 16);
+    m[0] = 1.f;
+    m[9] = 1.f;
+    m[6] = -1.f;
+    m[15] = 1.f;
+}
+
+static csm_window light_box(const float aabb[6]) {
+    return csm_window{ aabb[0], aabb[2], -aabb[4], aabb[3], aabb[5], -aabb[1] };
+}
+
+static bool overlap(const csm_window& w, const csm_window& b) {
+    return b.maxx >= w.minx && b.minx <= w.maxx && b.maxy >= w.miny && b.miny <= w.maxy && b.minz <= w.maxz;
+}
+
+static void place(box& b, float x, float z) {
+    const float v[6] = { x - 0.5f, 0.f, z - 0.5f, x + 0.5f, 2.f, z + 0.5f };
+    memcpy(b.aabb, v, sizeof(v));
+}
+
+int main() {
+    int failed = 0;
+    auto check = [&](bool ok, const char* what) {
+        if (!ok) {
+            printf("FAILED: %s\n", what);
+            failed++;
+        }
+    };
+
+    csm_cache cache(CASCADES, SM_SIZE, 0.2f, 30);
+    float lv[16];
+    top_down(lv);
+    check(cache.set_light(lv), "the first light invalidates");
+    check(!cache.set_light(lv), "the same light keeps the cache");
+
+    std::vector<box> boxes;
+    for (int z = 0; z < 60; ++z) {
+        for (int x = 0; x < 60; ++x) {
+            box b;
+            place(b, x * 4.f - 120.f, z * 4.f - 120.f);
+            boxes.push_back(b);
+        }
+    }
+    const size_t static_num = boxes.size();
+    for (int i = 0; i < 16; ++i) {
+        boxes.push_back(box{});
+    }
+
+    // what each static layer was drawn with: caster id -> its box then
+    std::map<uint64_t, csm_window> baked[CASCADES];
+    uint64_t baseline = 0, draws = 0, redraws = 0;
+
+    float cx = 0.f, cz = 0.f;
+    for (uint64_t frame = 1; frame <= 1200; ++frame) {
+        // camera path: walk at 3 units per second, jump at 500, walk back along z after 800
+        if (frame == 500) {
+            cx += 60.f;
+        } else if (frame > 800) {
+            cz -= 0.05f;
+        } else {
+            cx += 0.05f;
+        }
+        if (frame == 1000) {
+            // the sun moves
+            lv[2] = 0.1f;
+            check(cache.set_light(lv), "a new light direction invalidates");
+            for (int c = 0; c < CASCADES; ++c) {
+                check(cache.dirty(c), "every cascade is redrawn for a new light");
+            }
+        }
+
+        for (size_t i = static_num; i < boxes.size(); ++i) {
+            const float a = frame * 0.02f + i;
+            place(boxes[i], cx + std::cos(a) * 10.f, cz + std::sin(a) * 10.f);
+            cache.caster_update(i, boxes[i].aabb, frame);
+        }
+        if (frame == 1) {
+            for (size_t i = 0; i < static_num; ++i) {
+                cache.caster_update(i, boxes[i].aabb, frame);
+            }
+        }
+        // a static box is moved once, then settles
+        if (frame == 300 || frame == 700) {
+            place(boxes[1830], cx + 3.f, cz + 3.f);
+            cache.caster_update(1830, boxes[1830].aabb, frame);
+        }
+        cache.update(frame);
+        cache.flush_changes([](uint64_t, bool) {});
+
+        for (int c = 0; c < CASCADES; ++c) {
+            const float r = CASCADE_RADIUS[c];
+            const csm_window bounds{ cx - r, cz - r, -10.f, cx + r, cz + r, 5.f };
+            cache.fit(c, bounds);
+            const csm_window& w = cache.window(c);
+            if (!(w.minx <= bounds.minx && w.maxx >= bounds.maxx && w.miny <= bounds.miny && w.maxy >= bounds.maxy)) {
+                check(false, "the window covers the cascade");
+            }
+            const float texel = (w.maxx - w.minx) / SM_SIZE;
+            const float center = (w.minx + w.maxx) * 0.5f / texel;
+            check(std::fabs(center - std::round(center)) < 0.01f, "the window is snapped to texels");
+
+            for (size_t i = 0; i < boxes.size(); ++i) {
+                if (overlap(bounds, light_box(boxes[i].aabb))) {
+                    baseline++;
+                }
+            }
+            if (cache.dirty(c)) {
+                redraws++;
+                baked[c].clear();
+                for (size_t i = 0; i < boxes.size(); ++i) {
+                    if (cache.is_static(i) && cache.overlap(c, i)) {
+                        baked[c][i] = light_box(boxes[i].aabb);
+                        draws++;
+                    }
+                }
+                cache.clean(c);
+            }
+            for (size_t i = 0; i < boxes.size(); ++i) {
+                if (!cache.is_static(i) && cache.overlap(c, i)) {
+                    draws++;
+                }
+            }
+
+            // the static layer matches the scene, once the light is known in the test
+            if (frame < 1000) {
+                size_t in_window = 0;
+                for (size_t i = 0; i < boxes.size(); ++i) {
+                    if (cache.is_static(i) && cache.overlap(c, i)) {
+                        in_window++;
+                        auto it = baked[c].find(i);
+                        const csm_window now = light_box(boxes[i].aabb);
+                        if (it == baked[c].end() || memcmp(&it->second, &now, sizeof(now)) != 0) {
+                            printf("frame %d cascade %d box %d\n", (int)frame, c, (int)i);
+                            check(false, "a static caster in the window is in the static layer");
+                        }
+                    }
+                }
+                if (in_window != baked[c].size()) {
+                    printf("frame %d cascade %d: %d in the window, %d baked\n", (int)frame, c, (int)in_window, (int)baked[c].size());
+                    check(false, "no stale caster in the static layer");
+                }
+            }
+        }
+    }
+
+    check(cache.is_static(1830), "the moved box is static again");
+    check(cache.dynamic_num() == 16, "the moving boxes stay dynamic");
+
+    // a static caster hidden at runtime leaves the cache, the cascades it is in are drawn again without it
+    int covered = -1;
+    for (int c = 0; c < CASCADES && covered < 0; ++c) {
+        check(!cache.dirty(c), "the static layers are drawn");
+        if (cache.overlap(c, 1830)) {
+            covered = c;
+        }
+    }
+    check(covered >= 0, "the moved box is in a cascade");
+    cache.caster_remove(1830);
+    check(cache.caster_num() == boxes.size() - 1, "removed");
+    check(covered >= 0 && cache.dirty(covered), "hiding a static caster dirties the static layer");
+    for (int c = 0; c < CASCADES; ++c) {
+        cache.clean(c);
+    }
+    // shown again, it is drawn as a dynamic caster until it settles into the static layer
+    cache.caster_update(1830, boxes[1830].aabb, 1201);
+    check(!cache.is_static(1830) && covered >= 0 && !cache.dirty(covered), "a shown caster is dynamic first");
+    cache.update(1201 + 30);
+    check(cache.is_static(1830) && covered >= 0 && cache.dirty(covered), "a shown caster settles into the static layer");
+
+    printf("caster draws: %llu every frame, %llu cached (%llu static layer redraws), %.1fx fewer\n",
+        (unsigned long long)baseline, (unsigned long long)draws, (unsigned long long)redraws, (double)baseline / (double)draws);
+    check(draws * 4 < baseline, "the cache draws at least 4 times fewer casters");
+
+    printf(failed ? "csm cache: %d failure(s)\n" : "csm cache: ok\n", failed);
+    return failed ? 1 : 0;
+}
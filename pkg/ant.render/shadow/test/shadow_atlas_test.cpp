@@ -0,0 +1,285 @@
+// The atlas must never hand out overlapping tiles and must merge back to one whole tile.
+// The scheduler must keep to its budget, reuse the tiles of the static lights, reach every
+// dirty face in a bounded number of frames, and give up the shadows of the smallest lights first.
+// A caster dirties the lights it moves into or out of the range of, and the lights it is removed from.
+#include "../shadow_atlas.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+static float frand(float a, float b) {
+    return a + (b - a) * (float)rand() / (float)RAND_MAX;
+}
+
+// every texel of the atlas owned by at most one tile, in units of min_tile
+static bool disjoint(const std::vector<atlas_tile>& tiles, uint32_t size, uint32_t unit) {
+    const uint32_t n = size / unit;
+    std::vector<uint8_t> used(n * n, 0);
+    for (const auto& t : tiles) {
+        if (t.size == 0 || t.x % t.size != 0 || t.y % t.size != 0 || t.x + t.size > size || t.y + t.size > size) {
+            return false;
+        }
+        for (uint32_t y = t.y / unit; y < (t.y + t.size) / unit; ++y) {
+            for (uint32_t x = t.x / unit; x < (t.x + t.size) / unit; ++x) {
+                if (used[y * n + x]++) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main() {
+    int failed = 0;
+    auto check = [&](bool ok, const char* what) {
+        if (!ok) {
+            printf("FAILED: %s\n", what);
+            failed++;
+        }
+    };
+
+    // the allocator
+    {
+        const uint32_t SIZE = 4096, MIN = 64;
+        shadow_atlas atlas(SIZE, MIN);
+        srand(11);
+        std::vector<atlas_tile> tiles;
+        bool overlap = false, area = true;
+        for (int i = 0; i < 20000; ++i) {
+            if (tiles.empty() || (rand() % 3) != 0) {
+                atlas_tile t;
+                const uint32_t want = MIN << (rand() % 6);
+                if (atlas.alloc(want, t)) {
+                    if (t.size != want) {
+                        area = false;
+                    }
+                    tiles.push_back(t);
+                }
+            } else {
+                const size_t k = rand() % tiles.size();
+                atlas.free(tiles[k]);
+                tiles[k] = tiles.back();
+                tiles.pop_back();
+            }
+            if (i % 97 == 0) {
+                overlap = overlap || !disjoint(tiles, SIZE, MIN);
+                uint64_t used = 0;
+                for (const auto& t : tiles) {
+                    used += (uint64_t)t.size * t.size;
+                }
+                area = area && used + atlas.free_area() == (uint64_t)SIZE * SIZE;
+            }
+        }
+        check(!overlap, "the tiles do not overlap");
+        check(area, "the tiles and the free area cover the atlas");
+        for (const auto& t : tiles) {
+            atlas.free(t);
+        }
+        atlas_tile whole;
+        check(atlas.alloc(SIZE, whole) && whole.x == 0 && whole.y == 0 && whole.size == SIZE, "the free tiles merge back to the whole atlas");
+        atlas_tile t;
+        check(!atlas.alloc(MIN, t), "a full atlas has no room");
+        atlas.free(whole);
+
+        // sizes are rounded up to a power of two, and clamped
+        check(atlas.alloc(100, t) && t.size == 128, "a size is rounded up to a power of two");
+        atlas.free(t);
+        check(atlas.alloc(1, t) && t.size == MIN, "a size is at least min_tile");
+        atlas.free(t);
+
+        // (4096/64)^2 tiles of the smallest size fit exactly
+        uint32_t count = 0;
+        tiles.clear();
+        while (atlas.alloc(MIN, t)) {
+            tiles.push_back(t);
+            ++count;
+        }
+        check(count == (SIZE / MIN) * (SIZE / MIN) && disjoint(tiles, SIZE, MIN), "the atlas packs the smallest tiles");
+    }
+
+    // the budget, static lights and starvation
+    {
+        const uint32_t BUDGET = 16;
+        shadow_scheduler s(8192, 128, 1024, BUDGET);
+        std::vector<local_light> lights;
+        srand(5);
+        for (uint64_t i = 0; i < 40; ++i) {
+            lights.push_back({ i + 1, 6, frand(0.05f, 0.6f), true });
+        }
+        for (uint64_t i = 0; i < 10; ++i) {
+            lights.push_back({ 100 + i, 1, frand(0.05f, 0.6f), true });
+        }
+
+        // all dirty every frame: the budget is kept and nothing starves
+        std::map<std::pair<uint64_t, uint32_t>, uint64_t> last_drawn;
+        bool budget = true;
+        uint64_t worst_wait = 0;
+        const uint64_t FRAMES = 200;
+        uint64_t drawn = 0;
+        for (uint64_t frame = 1; frame <= FRAMES; ++frame) {
+            const auto& views = s.update(lights.data(), lights.size(), frame);
+            budget = budget && views.size() <= BUDGET;
+            drawn += views.size();
+            for (const auto& v : views) {
+                auto& last = last_drawn[{ v.light, v.face }];
+                worst_wait = std::max(worst_wait, frame - last);
+                last = frame;
+            }
+        }
+        for (const auto& [key, frame] : last_drawn) {
+            worst_wait = std::max(worst_wait, FRAMES + 1 - frame);
+        }
+        const uint32_t faces = 40 * 6 + 10;
+        check(budget, "a frame draws at most the budget");
+        check(last_drawn.size() == faces && s.stats().shadowed == 50, "every face is drawn");
+        // the oldest face of the smallest light is redrawn at worst once its score beats the biggest one
+        check(worst_wait <= 12 * (faces / BUDGET + 1), "no face waits for ever");
+        printf("50 dynamic lights (%u faces), budget %u: %.1f faces a frame against %u, longest wait %llu frames\n",
+            faces, BUDGET, (double)drawn / FRAMES, faces, (unsigned long long)worst_wait);
+
+        // static from now: the faces drawn once are reused
+        for (auto& l : lights) {
+            l.dirty = false;
+        }
+        uint64_t frame = FRAMES + 1;
+        for (; frame < FRAMES + 100 && s.stats().views + s.stats().pending > 0; ++frame) {
+            s.update(lights.data(), lights.size(), frame);
+        }
+        s.update(lights.data(), lights.size(), frame);
+        check(s.stats().views == 0 && s.stats().pending == 0 && s.stats().allocs == 0, "static lights draw nothing");
+        atlas_tile t;
+        bool all = true;
+        for (const auto& l : lights) {
+            for (uint32_t f = 0; f < l.faces; ++f) {
+                all = all && s.tile(l.id, f, t);
+            }
+        }
+        check(all, "the static lights keep their tiles");
+        check(!s.tile(1, 6, t) && !s.tile(1000, 0, t), "no tile for a missing face");
+
+        // one light moves: only its faces
+        lights[3].dirty = true;
+        const auto& views = s.update(lights.data(), lights.size(), ++frame);
+        bool only = views.size() == 6;
+        for (const auto& v : views) {
+            only = only && v.light == lights[3].id;
+        }
+        check(only, "a dirty light redraws only its faces");
+        lights[3].dirty = false;
+
+        // a light gone gives its tiles back
+        const uint64_t before = s.atlas().free_area();
+        const auto gone = lights.back();
+        lights.pop_back();
+        s.update(lights.data(), lights.size(), ++frame);
+        check(s.atlas().free_area() > before && !s.tile(gone.id, 0, t), "a removed light frees its tiles");
+    }
+
+    // the tile size follows the coverage, with hysteresis
+    {
+        shadow_scheduler s(4096, 64, 1024, 8);
+        local_light l = { 1, 1, 0.5f, false };
+        uint64_t frame = 1;
+        auto size_of = [&](float coverage) {
+            l.coverage = coverage;
+            s.update(&l, 1, frame++);
+            s.update(&l, 1, frame++);
+            atlas_tile t = {};
+            s.tile(1, 0, t);
+            return (uint32_t)t.size;
+        };
+        check(size_of(0.5f) == 512, "the tile size is the coverage of max_tile");
+        check(size_of(1.f) == 1024, "a light growing on screen gets a bigger tile");
+        check(size_of(0.4f) == 1024, "a light shrinking a little keeps its tile");
+        check(size_of(0.2f) == 256, "a light shrinking a lot gets a smaller tile");
+        check(size_of(0.f) == 64, "the tile size is at least min_tile");
+        check(s.tile_size(1.f, 6) == 512, "a point light face is half of a spot light");
+    }
+
+    // overflow: the smallest lights lose their shadows
+    {
+        shadow_scheduler s(2048, 256, 1024, 64);
+        std::vector<local_light> lights;
+        for (uint64_t i = 0; i < 8; ++i) {
+            // 1024 tiles: four of them fill the atlas
+            lights.push_back({ i + 1, 1, 0.9f - i * 0.01f, true });
+        }
+        s.update(lights.data(), lights.size(), 1);
+        atlas_tile t;
+        std::vector<atlas_tile> tiles;
+        int shadowed = 0;
+        for (const auto& l : lights) {
+            if (s.tile(l.id, 0, t)) {
+                ++shadowed;
+                tiles.push_back(t);
+            }
+        }
+        check(s.tile(1, 0, t) && t.size == 1024, "the biggest light keeps its size");
+        check(shadowed == 4 && !s.tile(5, 0, t), "the lights past a full atlas have no shadow");
+        check(disjoint(tiles, 2048, 256), "the scheduled tiles do not overlap");
+        printf("8 lights in a 2048 atlas: %d shadowed\n", shadowed);
+
+        // many more lights than the atlas holds
+        lights.clear();
+        for (uint64_t i = 0; i < 100; ++i) {
+            lights.push_back({ i + 1, 6, 1.f - i * 0.005f, true });
+        }
+        s.update(lights.data(), lights.size(), 2);
+        bool prefix = true, lost = false;
+        tiles.clear();
+        for (const auto& l : lights) {
+            const bool has = s.tile(l.id, 0, t);
+            prefix = prefix && !(has && lost);
+            lost = lost || !has;
+            for (uint32_t f = 0; f < 6 && has; ++f) {
+                s.tile(l.id, f, t);
+                tiles.push_back(t);
+            }
+        }
+        check(lost, "an atlas too small drops some shadows");
+        check(prefix, "the lights covering less lose their shadows first");
+        check(disjoint(tiles, 2048, 256), "the tiles of the lights do not overlap");
+        check(s.stats().shadowed * 6 == tiles.size(), "a light has all its faces or none");
+    }
+
+    // the casters
+    {
+        shadow_casters casters;
+        local_light lights[2] = {
+            { 1, 6, 1.f, false },
+            { 2, 1, 1.f, false },
+        };
+        // a light at the origin and one at x = 100, both of range 10
+        const float spheres[8] = { 0, 0, 0, 10, 100, 0, 0, 10 };
+        auto dirty = [&]() {
+            lights[0].dirty = lights[1].dirty = false;
+            casters.mark_dirty(lights, spheres, 2);
+            return (lights[0].dirty ? 1 : 0) | (lights[1].dirty ? 2 : 0);
+        };
+        const float near_first[6] = { 4, -1, -1, 6, 1, 1 };
+        const float far_away[6] = { 49, -1, -1, 51, 1, 1 };
+        const float near_second[6] = { 94, -1, -1, 96, 1, 1 };
+        casters.update(7, near_first);
+        check(dirty() == 1, "a new caster dirties the light it is in the range of");
+        check(dirty() == 0, "the changes are forgotten after mark_dirty");
+        casters.update(7, far_away);
+        check(dirty() == 1, "a caster moving out of range dirties the light it left");
+        casters.update(7, far_away);
+        check(dirty() == 0, "a caster out of every range dirties nothing");
+        casters.update(7, near_second);
+        casters.update(7, near_first);
+        check(dirty() == 3, "a caster moving twice in a frame dirties every light it passed");
+        casters.remove(7);
+        check(dirty() == 1, "a removed caster dirties the light it was in the range of");
+        check(casters.size() == 0, "a removed caster is forgotten");
+        casters.remove(7);
+        check(dirty() == 0, "removing an unknown caster dirties nothing");
+    }
+
+    printf(failed ? "shadow atlas: %d failure(s)\n" : "shadow atlas: ok\n", failed);
+    return failed ? 1 : 0;
+}
@@ -31,6 +31,18 @@ local MASK_MAPPER<const> = {
 			Q.set(vidx, queuemgr.queue_index "csm2_queue", v)
 			Q.set(vidx, queuemgr.queue_index "csm3_queue", v)
 			Q.set(vidx, queuemgr.queue_index "csm4_queue", v)
+			Q.set(vidx, queuemgr.queue_index "csm_static1_queue", v)
+			Q.set(vidx, queuemgr.queue_index "csm_static2_queue", v)
+			Q.set(vidx, queuemgr.queue_index "csm_static3_queue", v)
+			Q.set(vidx, queuemgr.queue_index "csm_static4_queue", v)
+			--registered by local_shadow_system with graphic/shadow/local
+			for ii=1, 8 do
+				local qidx = queuemgr.has("local_shadow" .. ii .. "_queue")
+				if not qidx then
+					break
+				end
+				Q.set(vidx, qidx, v)
+			end
 		end,
 		check = function (vidx)
 			return	Q.check(vidx, queuemgr.queue_index "csm1_queue") and
@@ -90,5 +90,9 @@ float shadow_visibility(float distanceVS, vec4 posWS)
 
 	return sample_visibility(shadowcoord, cascadeidx);
 }
+
+#ifdef ENABLE_LOCAL_SHADOW
+#include "common/shadow/local.sh"
+#endif //ENABLE_LOCAL_SHADOW
 #endif //ENABLE_SHADOW
 #endif //__SHADER_SHADOW_SH__
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef __SHADOW_LOCAL_SH__
+#define __SHADOW_LOCAL_SH__
+
+#include "bgfx_compute.sh"
+
+// see local_shadow_system.lua
+// b_local_shadow[ilight] = (first face matrix, faces, normal offset, 0), 0 faces when the light has no shadow,
+// a face matrix is 4 columns from first + face*4, it maps a world position to the tile of the face in the atlas
+BUFFER_RO(b_local_shadow,		vec4,	14);
+SAMPLER2DSHADOW(s_local_shadowmap, 15);
+
+// the cube face of a point light, in the order +x, -x, +y, -y, +z, -z
+int local_shadow_face(vec3 l2p)
+{
+	vec3 a = abs(l2p);
+	if (a.x >= a.y && a.x >= a.z)
+		return l2p.x > 0.0 ? 0 : 1;
+	if (a.y >= a.z)
+		return l2p.y > 0.0 ? 2 : 3;
+	return l2p.z > 0.0 ? 4 : 5;
+}
+
+float local_shadow_visibility(uint ilight, vec3 posWS, vec3 N, vec3 lightpos)
+{
+	vec4 header = b_local_shadow[ilight];
+	int faces = int(header.y);
+	if (faces == 0)
+		return 1.0;
+
+	int face = faces == 1 ? 0 : local_shadow_face(posWS - lightpos);
+	int idx = int(header.x) + face * 4;
+	mat4 m = mtxFromCols(b_local_shadow[idx], b_local_shadow[idx+1], b_local_shadow[idx+2], b_local_shadow[idx+3]);
+	vec4 coord = mul(m, vec4(posWS + N * header.z, 1.0));
+	// the face is not drawn yet, its matrix is zero
+	if (coord.w <= 0.0)
+		return 1.0;
+	return shadow2DProj(s_local_shadowmap, coord);
+}
+
+#endif //__SHADOW_LOCAL_SH__
@@ -56,6 +56,7 @@ bool check_light_interset_aabb(light_info l, AABB aabb, uint clusterlightcount){
 
 void transform_light(inout light_info l){
     l.pos = mul(u_view, vec4(l.pos, 1.0)).xyz;
+    l.dir = mul(u_view, vec4(l.dir, 0.0)).xyz;
 }
 
 uint light_offset_idx()
@@ -85,6 +85,12 @@ light_info get_light(uint ilight, in material_info mi)
 {
     light_info l; load_light_info(b_light_info, ilight, l);
     init_light_info(l, mi);
+#if defined(ENABLE_SHADOW) && defined(ENABLE_LOCAL_SHADOW)
+    if (!IS_DIRECTIONAL_LIGHT(l.type) && l.attenuation > 0)
+    {
+        l.attenuation *= local_shadow_visibility(ilight, mi.posWS, mi.gN, l.pos);
+    }
+#endif //ENABLE_SHADOW && ENABLE_LOCAL_SHADOW
     return l;
 }
 
@@ -132,7 +138,7 @@ vec3 calc_direct_light(in material_info mi)
 
     if (u_culled_light_count > 0)
     {
-        //TODO: other lights not check visibility right now
+        //the point and spot lights check visibility with graphic/shadow/local, see get_light
         light_grid g = get_light_grid(mi);
         const uint count = g.count; //see cs_lightcull.sc, limit g.count into u_cluster_max_light_count
         LOOP
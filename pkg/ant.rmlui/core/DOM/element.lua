@@ -5,6 +5,8 @@ local eventListener = require "core.event.listener"
 
 local constructorElement
 
+local datasource = {}
+
 local attribute_mt = {}
 function attribute_mt:__index(name)
     return rmlui.ElementGetAttribute(self._object._handle, name)
@@ -153,6 +155,45 @@ function property_init:scrollInsets()
     end
 end
 
+function property_init:setDataSource()
+    return function (source)
+        local document = self._document
+        local handle = self._handle
+        local _datasource = datasource[document]
+        if not _datasource then
+            _datasource = {}
+            datasource[document] = _datasource
+        end
+        _datasource[handle] = source
+        rmlui.ElementVirtualListSetup(handle, source.mode or "fixed", source.rowHeight or 20, source.overscan or 0)
+        rmlui.ElementVirtualListSetCount(handle, source.count or 0)
+    end
+end
+
+function property_init:setItemCount()
+    return function (n)
+        rmlui.ElementVirtualListSetCount(self._handle, n)
+    end
+end
+
+function property_init:refresh()
+    return function ()
+        rmlui.ElementVirtualListRefresh(self._handle)
+    end
+end
+
+function property_init:scrollToIndex()
+    return function (index)
+        rmlui.ElementVirtualListScrollTo(self._handle, index)
+    end
+end
+
+function property_init:getRow()
+    return function (index)
+        return constructorElement(self._document, false, rmlui.ElementVirtualListGetRow(self._handle, index))
+    end
+end
+
 function property_init:getAttribute()
     return function (name)
         local handle = self._handle
@@ -281,6 +322,7 @@ end
 local pool = {}
 
 function event.OnDocumentDestroy(handle)
+    datasource[handle] = nil
     if not pool[handle] then
         return
     end
@@ -295,6 +337,9 @@ function event.OnDocumentDestroy(handle)
 end
 
 function event.OnDestroyNode(handle, node)
+    if datasource[handle] then
+        datasource[handle][node] = nil
+    end
     if not pool[handle] then
         return
     end
@@ -305,6 +350,14 @@ function event.OnDestroyNode(handle, node)
     pool[handle][node] = nil
 end
 
+function event.OnVirtualListBind(document, list, row, index)
+    local _datasource = datasource[document]
+    local source = _datasource and _datasource[list]
+    if source and source.bind then
+        source.bind(constructorElement(document, false, row), index)
+    end
+end
+
 function constructorElement(document, owner, handle)
     if handle == nil then
         return
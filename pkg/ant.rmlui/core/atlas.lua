@@ -0,0 +1,135 @@
+local ltask = require "ltask"
+local bgfx = require "bgfx"
+local image = require "image"
+local setting = import_package "ant.settings"
+local renderpkg = import_package "ant.render"
+local sampler = renderpkg.sampler
+local ServiceResource = ltask.queryservice "ant.resource_manager|resource"
+
+-- Small ui images are copied into shared pages at load time, so the elements of a panel
+-- use the same texture and their draws can be merged by the renderer.
+
+local ENABLE <const> = setting:get "rmlui/atlas/enable"
+local PAGE_SIZE <const> = setting:get "rmlui/atlas/size" or 2048
+local THRESHOLD <const> = setting:get "rmlui/atlas/threshold" or 256
+local PADDING <const> = 1
+
+local FLAGS <const> = sampler {
+    MIN = "LINEAR",
+    MAG = "LINEAR",
+    U = "CLAMP",
+    V = "CLAMP",
+}
+
+local m = {}
+
+local pages = {}
+
+local function create_page()
+    local page = {
+        handle = bgfx.create_texture2d(PAGE_SIZE, PAGE_SIZE, false, 1, "RGBA8", FLAGS),
+        id = ltask.call(ServiceResource, "texture_register_id"),
+        x = 0,
+        y = 0,
+        bottom = 0,
+    }
+    ltask.call(ServiceResource, "texture_set_handle", page.id, page.handle)
+    pages[#pages+1] = page
+    return page
+end
+
+-- shelf packer, same as ant.atlas
+local function alloc_in_page(page, w, h)
+    if page.x + w > PAGE_SIZE then
+        page.x = 0
+        page.y = page.bottom
+    end
+    if page.y + h > PAGE_SIZE then
+        return
+    end
+    local x, y = page.x, page.y
+    page.x = page.x + w
+    if page.y + h > page.bottom then
+        page.bottom = page.y + h
+    end
+    return x, y
+end
+
+local function alloc(w, h)
+    for i = 1, #pages do
+        local page = pages[i]
+        local x, y = alloc_in_page(page, w, h)
+        if x then
+            return page, x, y
+        end
+    end
+    local page = create_page()
+    return page, alloc_in_page(page, w, h)
+end
+
+-- copy the image with its edges extruded by PADDING pixels, so linear filtering doesn't sample the neighbours.
+local function padded_memory(rgba, w, h)
+    local pw, ph = w + PADDING * 2, h + PADDING * 2
+    local mem = bgfx.memory_texture(pw * ph * 4)
+    local update = image.png.updateAtlas
+    update(mem, rgba, 1 + PADDING, 1 + PADDING, 1, 1, w, h, w, pw)
+    for i = 1, PADDING do
+        update(mem, rgba, 1 + PADDING, i, 1, 1, w, 1, w, pw)
+        update(mem, rgba, 1 + PADDING, ph - i + 1, 1, h, w, 1, w, pw)
+    end
+    for i = 1, PADDING do
+        update(mem, mem, i, 1, 1 + PADDING, 1, 1, ph, pw, pw)
+        update(mem, mem, pw - i + 1, 1, pw - PADDING, 1, 1, ph, pw, pw)
+    end
+    return mem, pw, ph
+end
+
+function m.accept(info)
+    if not ENABLE then
+        return false
+    end
+    local texinfo = info.texinfo
+    if texinfo.lattice or texinfo.atlas then
+        return false
+    end
+    return texinfo.width <= THRESHOLD and texinfo.height <= THRESHOLD
+end
+
+-- returns the page id and the normalized rect of the image in the page, or nil if the content isn't available.
+function m.insert(info)
+    local content = ltask.call(ServiceResource, "texture_memory", info.id)
+    if not content then
+        return
+    end
+    local ok, w, h, _, _, _, _, rgba = pcall(image.png.cliprect, content, "RGBA8")
+    if not ok then
+        return
+    end
+    local mem, pw, ph = padded_memory(rgba, w, h)
+    local page, x, y = alloc(pw, ph)
+    bgfx.update_texture2d(page.handle, 0, 0, x, y, pw, ph, mem)
+    return {
+        id = page.id,
+        width = w,
+        height = h,
+        ux = (x + PADDING) / PAGE_SIZE,
+        uy = (y + PADDING) / PAGE_SIZE,
+        uw = w / PAGE_SIZE,
+        uh = h / PAGE_SIZE,
+    }
+end
+
+function m.stats()
+    local r = {}
+    for i = 1, #pages do
+        local page = pages[i]
+        r[i] = {
+            id = page.id,
+            size = PAGE_SIZE,
+            used = page.bottom / PAGE_SIZE,
+        }
+    end
+    return r
+end
+
+return m
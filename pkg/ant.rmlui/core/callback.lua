@@ -36,6 +36,10 @@ function m.OnLoadTexture(doc, e, path, width, height, isRT)
 	textureloader.loadTexture(doc, e, path, width, height, isRT)
 end
 
+function m.OnVirtualListBind(document, list, row, index)
+	event("OnVirtualListBind", document, list, row, index)
+end
+
 function m.OnParseText(str)
 	return parsetext.ParseText(str)
 end
@@ -412,6 +412,9 @@ local function updateTexture()
             elseif v.atlas then
                 local at = parse_atlas(v.width, v.height, v.atlas)
                 rmlui.RenderSetTextureAtlas(v.path, v.id, at.w, at.h, at.ax, at.ay, at.aw, at.ah, at.fx, at.fy, at.fw, at.fh)
+            elseif v.runtime_atlas then
+                local at = v.runtime_atlas
+                rmlui.RenderSetTextureAtlas(v.path, at.id, at.width, at.height, at.ux, at.uy, at.uw, at.uh, 0, 0, 1, 1, v.id)
             else
                 rmlui.RenderSetTexture(v.path, v.id, v.width, v.height)
             end
@@ -6,6 +6,7 @@ local task = require "core.task"
 local message = require "core.message"
 local extern_windows = require "core.extern_windows"
 local document_manager = require "core.document_manager"
+local atlas = require "core.atlas"
 local audio = import_package "ant.audio"
 local hwi = import_package "ant.hwi"
 
@@ -53,6 +54,14 @@ function S.init_canvas()
 	canvas.init()
 end
 
+function S.text_cache_stats()
+    return rmlui.RenderGetTextCacheStats()
+end
+
+function S.atlas_stats()
+    return atlas.stats()
+end
+
 S.gesture = document_manager.process_gesture
 S.touch = document_manager.process_touch
 S.hover = document_manager.process_hover
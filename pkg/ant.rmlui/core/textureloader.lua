@@ -3,6 +3,7 @@ local constructor = require "core.DOM.constructor"
 local ServiceWindow = ltask.queryservice "ant.window|window"
 local ServiceResource = ltask.queryservice "ant.resource_manager|resource"
 local assetmgr = import_package "ant.asset"
+local atlas = require "core.atlas"
 local m = {}
 
 local pendQueue = {}
@@ -40,7 +41,8 @@ function m.loadTexture(doc, e, path, width, height, isRT)
                 width = info.texinfo.width,
                 height = info.texinfo.height,
                 lattice = info.texinfo.lattice,
-                atlas = info.texinfo.atlas
+                atlas = info.texinfo.atlas,
+                runtime_atlas = atlas.accept(info) and atlas.insert(info) or nil,
             }
             pendQueue[path] = nil
         end)
@@ -4,6 +4,7 @@
 #include <binding/ScriptImpl.h>
 #include <css/StyleSheetSpecification.h>
 #include <core/Texture.h>
+#include <core/TextCache.h>
 
 namespace Rml {
 
@@ -30,6 +31,7 @@ bool Initialise(lua_State* L, int idx) {
 void Shutdown() {
     StyleSheetSpecification::Shutdown();
     Texture::Shutdown();
+    TextCache::Shutdown();
     if (g_context) {
         delete g_context;
         g_context = nullptr;
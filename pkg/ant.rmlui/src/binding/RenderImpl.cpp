@@ -3,6 +3,7 @@
 #include <binding/Context.h>
 #include <core/Color.h>
 #include <core/Interface.h>
+#include <core/TextCache.h>
 #include <assert.h>
 #include <memory.h>
 #include <stdint.h>
@@ -103,6 +104,9 @@ public:
         bgfx_texture_handle_t handle = texture_get(tex);
         BGFX(encoder_set_texture)(encoder, 0, {id}, handle, flags);
     }
+    TextureId Texture() const {
+        return tex;
+    }
 private:
     uint16_t id;
     TextureId tex;
@@ -146,6 +150,8 @@ class RenderMaterial : public Material {
 public:
     virtual void    Submit(bgfx_encoder_t* encoder) = 0;
     virtual int     Program(const RenderState& state, const Shader& s) = 0;
+    // materials without per-draw uniforms can be merged with the adjacent draws.
+    virtual bool    GetBatchKey(const RenderState& state, const Shader& s, BatchKey& key) { return false; }
 };
 
 class TextureMaterial: public RenderMaterial {
@@ -190,6 +196,12 @@ public:
         }
         return gray ? s.image_gray : s.image;
     }
+    bool GetBatchKey(const RenderState& state, const Shader& s, BatchKey& key) override {
+        key.texture = tex_uniform.Texture();
+        key.flags = flags;
+        key.program = Program(state, s);
+        return true;
+    }
     bool SetGray() override {
         gray = true;
         return true;
@@ -304,6 +316,7 @@ RenderImpl::RenderImpl(lua_State* L, int idx)
     , clip_uniform(std::make_unique<Uniform>(
         context.shader.find_uniform("u_clip_rect")
     ))
+    , tex_uniform(context.shader.find_uniform("s_tex"))
 {
     BGFX(vertex_layout_begin)(&layout, BGFX_RENDERER_TYPE_NOOP);
     BGFX(vertex_layout_add)(&layout, BGFX_ATTRIB_POSITION, 2, BGFX_ATTRIB_TYPE_FLOAT, false, false);
@@ -317,7 +330,48 @@ RenderImpl::~RenderImpl() {
     BGFX(destroy_texture)({default_tex});
 }
 
+static bool IsAffine2D(const glm::mat4x4& m) {
+    return m[0][2] == 0.f && m[0][3] == 0.f
+        && m[1][2] == 0.f && m[1][3] == 0.f
+        && m[3][2] == 0.f && m[3][3] == 1.f
+        ;
+}
+
+static constexpr size_t MaxBatchVertices = 65536;
+
 void RenderImpl::RenderGeometry(Vertex* vertices, size_t num_vertices, Index* indices, size_t num_indices, Material* mat) {
+    RenderMaterial* material = reinterpret_cast<RenderMaterial*>(mat);
+    BatchKey key;
+    if (!state.needShaderClipRect && IsAffine2D(state.transform) && material->GetBatchKey(state, context.shader, key)) {
+        key.scissor = state.lastScissorId;
+        if (!batch.vertices.empty() && (!(batch.key == key) || batch.vertices.size() + num_vertices > MaxBatchVertices)) {
+            flushBatch();
+        }
+        batch.key = key;
+        // the vertices are moved to the screen space, so the draws of different elements can be merged.
+        const glm::mat4x4& m = state.transform;
+        const Index base = (Index)batch.vertices.size();
+        for (size_t i = 0; i < num_vertices; ++i) {
+            Vertex v = vertices[i];
+            v.pos.x = m[0][0] * vertices[i].pos.x + m[1][0] * vertices[i].pos.y + m[3][0];
+            v.pos.y = m[0][1] * vertices[i].pos.x + m[1][1] * vertices[i].pos.y + m[3][1];
+            batch.vertices.push_back(v);
+        }
+        for (size_t i = 0; i < num_indices; ++i) {
+            batch.indices.push_back(base + indices[i]);
+        }
+        return;
+    }
+    flushBatch();
+    BGFX(encoder_set_transform)(mEncoder, &state.transform, 1);
+    submitGeometry(vertices, num_vertices, indices, num_indices);
+    submitScissorRect(mEncoder);
+    material->Submit(mEncoder);
+    auto prog = program_get(material->Program(state, context.shader));
+    BGFX(encoder_submit)(mEncoder, context.viewid, { prog }, 0, BGFX_DISCARD_ALL);
+}
+
+void RenderImpl::submitGeometry(const Vertex* vertices, size_t num_vertices, const Index* indices, size_t num_indices) {
     BGFX(encoder_set_state)(mEncoder, RENDER_STATE, 0);
     bgfx_transient_vertex_buffer_t tvb;
     BGFX(alloc_transient_vertex_buffer)(&tvb, (uint32_t)num_vertices, (bgfx_vertex_layout_t*)&layout);
@@ -331,15 +385,20 @@ void RenderImpl::RenderGeometry(Vertex* vertices, size_t num_vertices, Index* in
     static_assert(sizeof(Index) == sizeof(uint32_t));
     memcpy(tib.data, indices, num_indices * sizeof(Index));
     BGFX(encoder_set_transient_index_buffer)(mEncoder, &tib, 0, (uint32_t)num_indices);
+}
 
-    submitScissorRect(mEncoder);
-
-    RenderMaterial* material = reinterpret_cast<RenderMaterial*>(mat);
-    material->Submit(mEncoder);
-
-    auto prog = program_get(material->Program(state, context.shader));
-    const uint8_t discard_flags = ~BGFX_DISCARD_TRANSFORM;
-    BGFX(encoder_submit)(mEncoder, context.viewid, { prog }, 0, discard_flags);
+void RenderImpl::flushBatch() {
+    if (batch.vertices.empty()) {
+        return;
+    }
+    static const glm::mat4x4 identity(1.f);
+    BGFX(encoder_set_transform)(mEncoder, &identity, 1);
+    submitGeometry(batch.vertices.data(), batch.vertices.size(), batch.indices.data(), batch.indices.size());
+    BGFX(encoder_set_scissor_cached)(mEncoder, batch.key.scissor);
+    AsyncTextureUniform(tex_uniform, batch.key.texture).Submit(mEncoder, batch.key.flags);
+    BGFX(encoder_submit)(mEncoder, context.viewid, { program_get(batch.key.program) }, 0, BGFX_DISCARD_ALL);
+    batch.vertices.clear();
+    batch.indices.clear();
 }
 
 void RenderImpl::Begin() {
@@ -348,6 +407,7 @@ void RenderImpl::Begin() {
 }
 
 void RenderImpl::End() {
+    flushBatch();
     BGFX(encoder_end)(mEncoder);
 }
 
@@ -413,7 +473,7 @@ void RenderImpl::submitScissorRect(bgfx_encoder_t* encoder){
 }
 
 void RenderImpl::SetTransform(const glm::mat4x4& transform) {
-    BGFX(encoder_set_transform)(mEncoder, &transform, 1);
+    state.transform = transform;
 }
 
 void RenderImpl::SetClipRect() {
@@ -544,6 +604,45 @@ float RenderImpl::GetFontWidth(FontFaceHandle handle, uint32_t codepoint) {
 // why store in uint16 ? because bgfx not support ....
 #define MAGIC_FACTOR    32768.f
 
+static constexpr uint32_t kImageCodepoint = 0x8000000u;
+
+// Glyph runs are cached by (face, string), texture coords stay valid until the
+// font manager evicts any glyph from its atlas.
+template <typename Fill>
+static const GlyphRun& GetGlyphRun(const RendererContext& context, FontFaceHandle handle, TextCache::Kind kind, const std::string& text, Fill&& fill) {
+    font_manager* F = context.font_mgr;
+    GlyphRun* cached = TextCache::FindGlyphRun(handle, kind, text);
+    if (cached && cached->stamp == font_manager_evict(F)) {
+        return *cached;
+    }
+    FontFace face;
+    face.handle = handle;
+    GlyphRun run;
+    fill([&](uint32_t codepoint) {
+        GlyphQuad& q = run.glyphs.emplace_back();
+        q.codepoint = codepoint;
+        if (codepoint == kImageCodepoint) {
+            q.offset_x = q.offset_y = q.advance = 0;
+            q.w = q.h = q.u = q.v = q.tw = q.th = 0;
+            return;
+        }
+        struct font_glyph og;
+        auto g = GetGlyph(context, face, codepoint, &og);
+        q.offset_x = g.offset_x;
+        q.offset_y = g.offset_y;
+        q.advance = g.advance_x;
+        q.w = g.w;
+        q.h = g.h;
+        q.u = g.u;
+        q.v = g.v;
+        q.tw = og.w;
+        q.th = og.h;
+    });
+    run.glyphs.shrink_to_fit();
+    run.stamp = font_manager_evict(F);
+    return TextCache::InsertGlyphRun(handle, kind, text, std::move(run));
+}
+
 void RenderImpl::GenerateString(FontFaceHandle handle, LineList& lines, const Color& color, Geometry& geometry){
     auto& vertices = geometry.GetVertices();
     auto& indices = geometry.GetIndices();
@@ -551,34 +650,30 @@ void RenderImpl::GenerateString(FontFaceHandle handle, LineList& lines, const Co
     indices.clear();
     for (size_t i = 0; i < lines.size(); ++i) {
         Line& line = lines[i];
-        vertices.reserve(vertices.size() + line.text.size() * 4);
-        indices.reserve(indices.size() + line.text.size() * 6);
+        const GlyphRun& run = GetGlyphRun(context, handle, TextCache::Kind::Plain, line.text, [&](auto&& push) {
+            for (auto codepoint : utf8::view(line.text)) {
+                push(codepoint);
+            }
+        });
+        vertices.reserve(vertices.size() + run.glyphs.size() * 4);
+        indices.reserve(indices.size() + run.glyphs.size() * 6);
 
-        FontFace face;
-        face.handle = handle;
         const Point fonttexel(1.f / FONT_MANAGER_TEXSIZE, 1.f / FONT_MANAGER_TEXSIZE);
 
         int x = int(line.position.x + 0.5f), y = int(line.position.y + 0.5f);
-        for (auto codepoint : utf8::view(line.text)) {
-
-            struct font_glyph og;
-            auto g = GetGlyph(context, face, codepoint, &og);
-
+        for (auto const& g : run.glyphs) {
             // Generate the geometry for the character.
             const int x0 = x + g.offset_x;
             const int y0 = y + g.offset_y;
-            const int16_t u0 = g.u;
-            const int16_t v0 = g.v;
 
             const float scale = FONT_POSTION_FIX_POINT / MAGIC_FACTOR;
             geometry.AddRectFilled(
                 { x0 * scale, y0 * scale, g.w * scale, g.h * scale },
-                { u0 * fonttexel.x, v0 * fonttexel.y ,og.w * fonttexel.x , og.h * fonttexel.y },
+                { g.u * fonttexel.x, g.v * fonttexel.y, g.tw * fonttexel.x, g.th * fonttexel.y },
                 color
             );
 
-            //x += g.advance_x + (dim.x - olddim.x);
-            x += g.advance_x;
+            x += g.advance;
         }
 
         line.width = x - int(line.position.x + 0.5f);
@@ -592,20 +687,26 @@ void RenderImpl::GenerateRichString(FontFaceHandle handle, LineList& lines, std:
     indices.clear();
     for (size_t i = 0; i < lines.size(); ++i) {
         Line& line = lines[i];
-        vertices.reserve(vertices.size() + line.text.size() * 4);
-        indices.reserve(indices.size() + line.text.size() * 6);
+        const GlyphRun& run = GetGlyphRun(context, handle, TextCache::Kind::Rich, line.text, [&](auto&& push) {
+            for (auto& layout : layouts[i]) {
+                for (int ii = 0; ii < layout.num; ++ii) {
+                    push(codepoints[layout.start + ii]);
+                }
+            }
+        });
+        vertices.reserve(vertices.size() + run.glyphs.size() * 4);
+        indices.reserve(indices.size() + run.glyphs.size() * 6);
 
-        FontFace face;
-        face.handle = handle;
         const Point fonttexel(1.f / FONT_MANAGER_TEXSIZE, 1.f / FONT_MANAGER_TEXSIZE);
 
         float x = line.position.x + 0.5f, y = line.position.y + 0.5f;
         
         Color color;
+        size_t glyph_idx = 0;
         for (auto& layout:layouts[i]){
             for(int ii=0;ii<layout.num;++ii){
-                uint32_t codepoint=codepoints[layout.start+ii];
-                if(codepoint == 0x8000000u){
+                const GlyphQuad& g = run.glyphs[glyph_idx++];
+                if(g.codepoint == kImageCodepoint){
                     color.r = color.g = color.b = 255;
                     auto& image_vertices = imagegeometries[cur_image_idx]->GetVertices();
                     auto& image_indices = imagegeometries[cur_image_idx]->GetIndices();
@@ -628,21 +729,16 @@ void RenderImpl::GenerateRichString(FontFaceHandle handle, LineList& lines, std:
                 }
                 else{
                     color=layout.color;
-                    struct font_glyph og;
-                    auto g = GetGlyph(context, face, codepoint, &og);
-
                     const float x0 = x + g.offset_x;
                     const float y0 = y + g.offset_y;
-                    const int16_t u0 = g.u;
-                    const int16_t v0 = g.v;
 
                     const float scale = FONT_POSTION_FIX_POINT / MAGIC_FACTOR;
                     textgeometry.AddRectFilled(
                         { x0 * scale, y0 * scale, g.w * scale, g.h * scale },
-                        { u0 * fonttexel.x, v0 * fonttexel.y ,og.w * fonttexel.x , og.h * fonttexel.y },
+                        { g.u * fonttexel.x, g.v * fonttexel.y, g.tw * fonttexel.x, g.th * fonttexel.y },
                         color
                     );
-                    x += g.advance_x;   
+                    x += g.advance;
                 }             
             }
         }
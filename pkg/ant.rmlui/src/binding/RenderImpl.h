@@ -3,6 +3,7 @@
 #include <core/Interface.h>
 #include <bgfx/c99/bgfx.h>
 #include <map>
+#include <vector>
 #include <string>
 #include <stdint.h>
 
@@ -47,11 +48,26 @@ struct RendererContext {
 };
 
 struct RenderState {
+    glm::mat4x4 transform {1.f};
     glm::vec4 rectVerteices[2] {glm::vec4(0.f), glm::vec4(0.f)};
     uint16_t lastScissorId = UINT16_MAX;
     bool needShaderClipRect = false;
 };
 
+struct BatchKey {
+    TextureId texture = UINT16_MAX;
+    uint32_t flags = 0;
+    int program = 0;
+    uint16_t scissor = UINT16_MAX;
+    bool operator==(const BatchKey&) const = default;
+};
+
+struct Batch {
+    BatchKey key;
+    std::vector<Vertex> vertices;
+    std::vector<Index> indices;
+};
+
 class TextureMaterial;
 class TextMaterial;
 class Uniform;
@@ -81,9 +97,12 @@ public:
     void GenerateRichString(FontFaceHandle handle, LineList& lines, std::vector<std::vector<layout>> layouts, std::vector<uint32_t>& codepoints, Geometry& textgeometry, std::vector<std::unique_ptr<Geometry>> & imagegeometries, std::vector<image>& images, int& cur_image_idx, float line_height) override;
     float PrepareText(FontFaceHandle handle,const std::string& string,std::vector<uint32_t>& codepoints,std::vector<int>& groupmap,std::vector<group>& groups,std::vector<image>& images,std::vector<layout>& line_layouts,int start,int num) override;
 	void SetView(int viewid) {
+		flushBatch();
 		context.viewid = (uint16_t)viewid;
 	}
 private:
+    void submitGeometry(const Vertex* vertices, size_t num_vertices, const Index* indices, size_t num_indices);
+    void flushBatch();
     void submitScissorRect(bgfx_encoder_t* encoder);
     void setScissorRect(bgfx_encoder_t* encoder, const glm::u16vec4 *r);
     void setShaderScissorRect(bgfx_encoder_t* encoder, const glm::vec4 r[2]);
@@ -100,5 +119,7 @@ private:
     std::unique_ptr<TextureMaterial> default_tex_mat;
     std::unique_ptr<TextMaterial> default_font_mat;
     std::unique_ptr<Uniform>      clip_uniform;
+    uint16_t              tex_uniform;
+    Batch                 batch;
 };
 }
@@ -88,6 +88,7 @@ enum class LuaEvent : uint8_t {
 	OnDestroyNode,
 	OnLoadTexture,
 	OnParseText,
+	OnVirtualListBind,
 };
 
 static int ref_function(luaref reference, lua_State* L, const char* funcname) {
@@ -117,6 +118,7 @@ ScriptImpl::ScriptImpl(lua_State* L) {
 	ref_function(reference, L, "OnDestroyNode");
 	ref_function(reference, L, "OnLoadTexture");
 	ref_function(reference, L, "OnParseText");
+	ref_function(reference, L, "OnVirtualListBind");
 }
 
 ScriptImpl::~ScriptImpl() {
@@ -182,6 +184,16 @@ void ScriptImpl::OnLoadTexture(Document* document, Element* element, const std::
     });
 }
 
+void ScriptImpl::OnVirtualListBind(Document* document, Element* list, Element* row, size_t index) {
+	luabind::invoke([&](lua_State* L) {
+		lua_pushlightuserdata(L, (void*)document);
+		lua_pushlightuserdata(L, (void*)list);
+		lua_pushlightuserdata(L, (void*)row);
+		lua_pushinteger(L, (lua_Integer)index + 1);
+		CallLua(L, reference, LuaEvent::OnVirtualListBind, 4);
+	});
+}
+
 static uint32_t border_color_or_compare(char c){
 	int n = 0;
 	if(c >= '0' && c <= '9'){
@@ -19,6 +19,7 @@ public:
 	void OnDestroyNode(Document* document, Node* node) override;
 	void OnLoadTexture(Document* document, Element* element, const std::string& path) override;
 	void OnLoadTexture(Document* document, Element* element, const std::string& path, Size size) override;
+	void OnVirtualListBind(Document* document, Element* list, Element* row, size_t index) override;
 	void OnParseText(const std::string& str,std::vector<group>& groups,std::vector<int>& groupMap,std::vector<image>& images,std::vector<int>& imageMap,std::string& ctext,group& default_group) override;
 private:
 	luaref reference = 0;
@@ -4,8 +4,10 @@
 #include <binding/ContextImpl.h>
 #include <core/Document.h>
 #include <core/Element.h>
+#include <core/ElementVirtualList.h>
 #include <core/Text.h>
 #include <core/Texture.h>
+#include <core/TextCache.h>
 #include <util/HtmlParser.h>
 #include <bee/nonstd/unreachable.h>
 
@@ -560,6 +562,67 @@ lTextSetText(lua_State* L) {
 	return 0;
 }
 
+static Rml::ElementVirtualList*
+lua_checkvirtuallist(lua_State* L, int idx) {
+	Rml::Element* e = lua_checkobject<Rml::Element>(L, idx);
+	auto list = dynamic_cast<Rml::ElementVirtualList*>(e);
+	if (!list) {
+		luaL_error(L, "<%s> is not a virtuallist.", e->GetTagName().c_str());
+	}
+	return list;
+}
+
+static int
+lElementVirtualListSetup(lua_State* L) {
+	Rml::ElementVirtualList* e = lua_checkvirtuallist(L, 1);
+	static const char* const opts[] = { "fixed", "measured", NULL };
+	auto mode = (Rml::ElementVirtualList::Mode)luaL_checkoption(L, 2, "fixed", opts);
+	float row_height = (float)luaL_checknumber(L, 3);
+	float overscan = (float)luaL_optnumber(L, 4, 0);
+	e->Setup(mode, row_height, overscan);
+	return 0;
+}
+
+static int
+lElementVirtualListSetCount(lua_State* L) {
+	Rml::ElementVirtualList* e = lua_checkvirtuallist(L, 1);
+	lua_Integer n = luaL_checkinteger(L, 2);
+	luaL_argcheck(L, n >= 0, 2, "invalid count");
+	e->SetItemCount((size_t)n);
+	return 0;
+}
+
+static int
+lElementVirtualListRefresh(lua_State* L) {
+	Rml::ElementVirtualList* e = lua_checkvirtuallist(L, 1);
+	e->Refresh();
+	return 0;
+}
+
+static int
+lElementVirtualListScrollTo(lua_State* L) {
+	Rml::ElementVirtualList* e = lua_checkvirtuallist(L, 1);
+	lua_Integer index = luaL_checkinteger(L, 2);
+	luaL_argcheck(L, index >= 1, 2, "invalid index");
+	e->ScrollToIndex((size_t)(index - 1));
+	return 0;
+}
+
+static int
+lElementVirtualListGetRow(lua_State* L) {
+	Rml::ElementVirtualList* e = lua_checkvirtuallist(L, 1);
+	lua_Integer index = luaL_checkinteger(L, 2);
+	if (index < 1) {
+		return 0;
+	}
+	Rml::Element* row = e->GetRow((size_t)(index - 1));
+	if (!row) {
+		return 0;
+	}
+	lua_pushlightuserdata(L, row);
+	return 1;
+}
+
 static int
 lTextDelete(lua_State* L) {
 	Rml::Text* e = lua_checkobject<Rml::Text>(L, 1);
@@ -648,7 +711,8 @@ lRenderSetTextureAtlas(lua_State* L) {
 			.fx = (float)luaL_optnumber(L, 9, 0),
 			.fy = (float)luaL_optnumber(L, 10, 0),
 			.fw = (float)luaL_optnumber(L, 11, 1),
-			.fh = (float)luaL_optnumber(L, 12, 11),
+			.fh = (float)luaL_optnumber(L, 12, 1),
+			.source = (Rml::TextureId)luaL_optinteger(L, 13, UINT16_MAX),
 		};
 		Rml::Texture::Set(lua_checkstdstring(L, 1), std::move(texture_data));
 	}
@@ -656,6 +720,48 @@ lRenderSetTextureAtlas(lua_State* L) {
     return 0;
 }
 
+static void
+lua_pushTextCacheStats(lua_State* L, const Rml::TextCache::Stats& s) {
+	lua_createtable(L, 0, 6);
+	lua_pushinteger(L, (lua_Integer)s.hits);
+	lua_setfield(L, -2, "hits");
+	lua_pushinteger(L, (lua_Integer)s.misses);
+	lua_setfield(L, -2, "misses");
+	size_t total = s.hits + s.misses;
+	lua_pushnumber(L, total ? (lua_Number)s.hits / total : 0.0);
+	lua_setfield(L, -2, "hit_rate");
+	lua_pushinteger(L, (lua_Integer)s.entries);
+	lua_setfield(L, -2, "entries");
+	lua_pushinteger(L, (lua_Integer)s.memory);
+	lua_setfield(L, -2, "memory");
+	lua_pushinteger(L, (lua_Integer)s.budget);
+	lua_setfield(L, -2, "budget");
+}
+
+static int
+lRenderGetTextCacheStats(lua_State* L) {
+	lua_createtable(L, 0, 2);
+	lua_pushTextCacheStats(L, Rml::TextCache::GetGlyphRunStats());
+	lua_setfield(L, -2, "glyphrun");
+	lua_pushTextCacheStats(L, Rml::TextCache::GetLineBreakStats());
+	lua_setfield(L, -2, "linebreak");
+	return 1;
+}
+
+static int
+lRenderSetTextCacheBudget(lua_State* L) {
+	size_t glyphrun = (size_t)luaL_checkinteger(L, 1);
+	size_t linebreak = (size_t)luaL_optinteger(L, 2, glyphrun / 4);
+	Rml::TextCache::SetBudget(glyphrun, linebreak);
+	return 0;
+}
+
+static int
+lRenderClearTextCache(lua_State* L) {
+	Rml::TextCache::Clear();
+	return 0;
+}
+
 }
 
 extern "C"
@@ -715,6 +821,11 @@ luaopen_rmlui(lua_State* L) {
 		{ "ElementDelete", lElementDelete },
 		{ "ElementProject", lElementProject },
 		{ "ElementDirtyImage", lElementDirtyImage },
+		{ "ElementVirtualListSetup", lElementVirtualListSetup },
+		{ "ElementVirtualListSetCount", lElementVirtualListSetCount },
+		{ "ElementVirtualListRefresh", lElementVirtualListRefresh },
+		{ "ElementVirtualListScrollTo", lElementVirtualListScrollTo },
+		{ "ElementVirtualListGetRow", lElementVirtualListGetRow },
 		{ "NodeGetParent", lNodeGetParent },
 		{ "NodeClone", lNodeClone },
 		{ "TextGetText", lTextGetText },
@@ -726,6 +837,9 @@ luaopen_rmlui(lua_State* L) {
 		{ "RenderSetTexture", lRenderSetTexture },
 		{ "RenderSetLatticeTexture", lRenderSetLatticeTexture },
 		{ "RenderSetTextureAtlas", lRenderSetTextureAtlas },
+		{ "RenderGetTextCacheStats", lRenderGetTextCacheStats },
+		{ "RenderSetTextCacheBudget", lRenderSetTextCacheBudget },
+		{ "RenderClearTextCache", lRenderClearTextCache },
 		{ "RmlInitialise", lRmlInitialise },
 		{ "RmlShutdown", lRmlShutdown },
 		{ NULL, NULL },
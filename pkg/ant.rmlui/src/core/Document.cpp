@@ -1,6 +1,7 @@
 #include <core/Document.h>
 #include <core/Interface.h>
 #include <core/Text.h>
+#include <core/ElementVirtualList.h>
 #include <css/StyleSheet.h>
 #include <css/StyleSheetParser.h>
 #include <binding/Context.h>
@@ -95,6 +96,7 @@ void Document::Flush() {
 }
 
 void Document::Update(float delta) {
+	style_sheet.PrepareDefinitions(&body);
 	body.Update();
 	body.UpdateAnimations(delta);
 	Style::Instance().Flush();//TODO
@@ -127,6 +129,9 @@ const Element* Document::GetBody() const {
 }
 
 Element* Document::CreateElement(const std::string& tag){
+	if (tag == "virtuallist") {
+		return new ElementVirtualList(this, tag);
+	}
 	return new Element(this, tag);
 }
 
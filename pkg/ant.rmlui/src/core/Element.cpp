@@ -1355,6 +1355,10 @@ std::string Element::GetClassName() const {
 	return res;
 }
 
+const std::vector<std::string>& Element::GetClassNames() const {
+	return classes;
+}
+
 void Element::DirtyPropertiesWithUnitRecursive(PropertyUnit unit) {
 	DirtyProperties(unit);
 	for (auto& child : children) {
@@ -1497,6 +1501,10 @@ void Element::DirtyDefinition() {
 	dirty.insert(Dirty::Definition);
 }
 
+bool Element::IsDefinitionDirty() const {
+	return dirty.contains(Dirty::Definition) || dirty.contains(Dirty::Structure);
+}
+
 void Element::DirtyInheritableProperties() {
 	dirty_properties |= StyleSheetSpecification::GetInheritableProperties();
 }
@@ -96,7 +96,7 @@ public:
 	void GetElementsByTagName(const std::string& tag, std::function<void(Element*)> func);
 	void GetElementsByClassName(const std::string& class_name, std::function<void(Element*)> func);
 
-	void Update();
+	virtual void Update();
 	void UpdateRender();
 	bool SetRenderStatus();
 
@@ -114,10 +114,12 @@ public:
 	bool IsClassSet(const std::string& class_name) const;
 	void SetClassName(const std::string& class_names);
 	std::string GetClassName() const;
+	const std::vector<std::string>& GetClassNames() const;
 	void DirtyPropertiesWithUnitRecursive(PropertyUnit unit);
 
 	void UpdateDefinition();
 	void DirtyDefinition();
+	bool IsDefinitionDirty() const;
 	void DirtyInheritableProperties();
 	void DirtyProperty(PropertyId id);
 	void DirtyProperties(const PropertyIdSet& properties);
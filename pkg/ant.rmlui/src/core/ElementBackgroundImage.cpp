@@ -174,17 +174,23 @@ bool ElementBackground::GenerateImageGeometry(Element* element, Geometry& geomet
 	}
 	}
 
+	auto backgroundRepeat = element->GetComputedProperty(PropertyId::BackgroundRepeat).GetEnum<Style::BackgroundRepeat>();
+
 	Rect uv = CalcUV(surface, background);
+	TextureId handle = texture.handle;
 	auto atlasData = std::get_if<TextureData::Atlas>(&texture.extra);
+	if (atlasData && backgroundRepeat != Style::BackgroundRepeat::NoRepeat && atlasData->source != UINT16_MAX) {
+		// the sampler can't wrap inside an atlas, use the standalone texture.
+		handle = atlasData->source;
+		atlasData = nullptr;
+	}
 	if (atlasData) {
-		uv.origin.x = uv.origin.x + atlasData->ux;
-		uv.origin.y = uv.origin.y + atlasData->uy;
+		uv.origin.x = uv.origin.x * atlasData->uw + atlasData->ux;
+		uv.origin.y = uv.origin.y * atlasData->uh + atlasData->uy;
 		uv.size.w = uv.size.w * atlasData->uw;
 		uv.size.h = uv.size.h * atlasData->uh;
 	}
 
-	auto backgroundRepeat = element->GetComputedProperty(PropertyId::BackgroundRepeat).GetEnum<Style::BackgroundRepeat>();
-
 	if (backgroundRepeat == Style::BackgroundRepeat::Repeat){
 		uv.size = uv.size / ( Size(texture.dimensions) / background.size);
 	}
@@ -197,7 +203,7 @@ bool ElementBackground::GenerateImageGeometry(Element* element, Geometry& geomet
 		background.size.w = background.size.w > texture.dimensions.w ? texture.dimensions.w : background.size.w;		
 	}
 
-	Material* material = GetRender()->CreateTextureMaterial(texture.handle, GetSamplerFlag(backgroundRepeat));
+	Material* material = GetRender()->CreateTextureMaterial(handle, GetSamplerFlag(backgroundRepeat));
 	geometry.SetMaterial(material);
 
 	if (auto latticeData = std::get_if<TextureData::Lattice>(&texture.extra)) {
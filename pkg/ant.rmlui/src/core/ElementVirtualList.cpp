@@ -0,0 +1,248 @@
+#include <core/ElementVirtualList.h>
+#include <core/Document.h>
+#include <core/Interface.h>
+#include <binding/Context.h>
+#include <algorithm>
+#include <string>
+
+namespace Rml {
+
+static std::string ToPixel(float v) {
+	return std::to_string(v) + "px";
+}
+
+ElementVirtualList::ElementVirtualList(Document* owner, const std::string& tag)
+	: Element(owner, tag)
+{}
+
+ElementVirtualList::~ElementVirtualList()
+{}
+
+void ElementVirtualList::Setup(Mode mode_, float row_height_, float overscan_) {
+	mode = mode_;
+	row_height = std::max(row_height_, 1.f);
+	overscan = std::max(overscan_, 0.f);
+	heights.assign(count, row_height);
+	for (auto& [_, row] : rows) {
+		ReleaseRow(row.element);
+	}
+	rows.clear();
+	for (auto row : pool) {
+		row->SetProperty("height", mode == Mode::Fixed ? ToPixel(row_height) : "auto");
+	}
+	dirty_offsets = true;
+	dirty_window = true;
+}
+
+void ElementVirtualList::SetItemCount(size_t n) {
+	count = n;
+	heights.resize(count, row_height);
+	dirty_offsets = true;
+	dirty_window = true;
+	dirty_bind = true;
+}
+
+size_t ElementVirtualList::GetItemCount() const {
+	return count;
+}
+
+void ElementVirtualList::Refresh() {
+	dirty_window = true;
+	dirty_bind = true;
+}
+
+void ElementVirtualList::ScrollToIndex(size_t index) {
+	if (count == 0) {
+		return;
+	}
+	SetScrollTop(GetItemOffset(std::min(index, count - 1)));
+	dirty_window = true;
+}
+
+Element* ElementVirtualList::GetRow(size_t index) const {
+	auto it = rows.find(index);
+	if (it == rows.end()) {
+		return nullptr;
+	}
+	return it->second.element;
+}
+
+void ElementVirtualList::UpdateOffsets() {
+	if (!dirty_offsets) {
+		return;
+	}
+	dirty_offsets = false;
+	if (mode == Mode::Fixed) {
+		offsets.clear();
+		return;
+	}
+	offsets.resize(count + 1);
+	float offset = 0.f;
+	for (size_t i = 0; i < count; ++i) {
+		offsets[i] = offset;
+		offset += heights[i];
+	}
+	offsets[count] = offset;
+}
+
+float ElementVirtualList::GetItemOffset(size_t index) {
+	if (mode == Mode::Fixed) {
+		return index * row_height;
+	}
+	UpdateOffsets();
+	return offsets[std::min(index, count)];
+}
+
+size_t ElementVirtualList::GetItemIndex(float offset) {
+	if (count == 0 || offset <= 0.f) {
+		return 0;
+	}
+	if (mode == Mode::Fixed) {
+		return std::min(count - 1, (size_t)(offset / row_height));
+	}
+	UpdateOffsets();
+	auto it = std::upper_bound(offsets.begin(), offsets.end() - 1, offset);
+	return std::min(count - 1, (size_t)(it - offsets.begin()) - 1);
+}
+
+float ElementVirtualList::GetTotalHeight() {
+	return GetItemOffset(count);
+}
+
+void ElementVirtualList::UpdateTemplate() {
+	if (row_template && GetChildNodeIndex(row_template) != size_t(-1)) {
+		return;
+	}
+	// the children has been replaced, all rows are gone with them.
+	row_template = nullptr;
+	rows.clear();
+	pool.clear();
+	dirty_window = true;
+	dirty_bind = true;
+	for (auto child : children) {
+		row_template = child;
+		row_template->SetVisible(false);
+		break;
+	}
+}
+
+Element* ElementVirtualList::AcquireRow() {
+	if (!pool.empty()) {
+		Element* row = pool.back();
+		pool.pop_back();
+		row->SetVisible(true);
+		return row;
+	}
+	Element* row = static_cast<Element*>(row_template->Clone(true));
+	row->SetProperty("position", "absolute");
+	row->SetProperty("left", "0px");
+	row->SetProperty("right", "0px");
+	if (mode == Mode::Fixed) {
+		row->SetProperty("height", ToPixel(row_height));
+	}
+	AppendChild(row);
+	row->SetVisible(true);
+	return row;
+}
+
+void ElementVirtualList::ReleaseRow(Element* row) {
+	row->SetVisible(false);
+	pool.push_back(row);
+}
+
+void ElementVirtualList::PlaceRow(Row& row, size_t index) {
+	float top = GetItemOffset(index);
+	if (row.top != top) {
+		row.top = top;
+		row.element->SetProperty("top", ToPixel(top));
+	}
+}
+
+void ElementVirtualList::UpdateWindow() {
+	if (!row_template) {
+		return;
+	}
+	float scroll = GetScrollTop();
+	float viewport = GetBounds().size.h;
+	if (!dirty_window && scroll == last_scroll && viewport == last_viewport) {
+		return;
+	}
+	dirty_window = false;
+	last_scroll = scroll;
+	last_viewport = viewport;
+
+	size_t new_first = 0;
+	size_t new_last = 0;
+	if (count > 0) {
+		new_first = GetItemIndex(scroll - overscan);
+		new_last = std::min(count, GetItemIndex(scroll + viewport + overscan) + 1);
+	}
+	for (auto it = rows.begin(); it != rows.end();) {
+		if (it->first < new_first || it->first >= new_last) {
+			ReleaseRow(it->second.element);
+			it = rows.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+	Script* script = GetScript();
+	for (size_t i = new_first; i < new_last; ++i) {
+		auto it = rows.find(i);
+		if (it == rows.end()) {
+			it = rows.emplace(i, Row { AcquireRow(), -1.f }).first;
+			script->OnVirtualListBind(GetOwnerDocument(), this, it->second.element, i);
+		}
+		else if (dirty_bind) {
+			script->OnVirtualListBind(GetOwnerDocument(), this, it->second.element, i);
+		}
+		PlaceRow(it->second, i);
+	}
+	dirty_bind = false;
+	first = new_first;
+	last = new_last;
+}
+
+void ElementVirtualList::Update() {
+	if (!IsVisible()) {
+		return;
+	}
+	UpdateTemplate();
+	UpdateWindow();
+	Element::Update();
+}
+
+void ElementVirtualList::CalculateLayout() {
+	Element::CalculateLayout();
+	if (mode == Mode::Measured) {
+		for (auto const& [index, row] : rows) {
+			if (index >= count) {
+				continue;
+			}
+			float h = row.element->GetBounds().size.h;
+			if (h > 0.f && h != heights[index]) {
+				heights[index] = h;
+				dirty_offsets = true;
+				dirty_window = true;
+			}
+		}
+	}
+	// rows are absolute positioned, the scroll range comes from the item offsets.
+	Rect total = GetBounds();
+	total.size.h = GetTotalHeight() + padding.top + padding.bottom + border.top + border.bottom;
+	content_rect.Union(total);
+}
+
+Node* ElementVirtualList::Clone(bool deep) const {
+	auto e = static_cast<ElementVirtualList*>(Element::Clone(false));
+	if (e) {
+		e->Setup(mode, row_height, overscan);
+		if (deep && row_template) {
+			e->AppendChild(row_template->Clone(true));
+		}
+		e->SetItemCount(count);
+	}
+	return e;
+}
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <core/Element.h>
+#include <map>
+#include <vector>
+
+namespace Rml {
+
+// <virtuallist> only instances the rows which intersect the visible scroll window
+// (plus `overscan` pixels on each side). The first child element is used as the
+// row template, rows leaving the window are hidden and reused for new indices.
+// The content of a row is filled by Script::OnVirtualListBind.
+class ElementVirtualList final : public Element {
+public:
+	enum class Mode : uint8_t {
+		Fixed,
+		Measured,
+	};
+	ElementVirtualList(Document* owner, const std::string& tag);
+	~ElementVirtualList() override;
+
+	void Setup(Mode mode, float row_height, float overscan);
+	void SetItemCount(size_t count);
+	size_t GetItemCount() const;
+	void Refresh();
+	void ScrollToIndex(size_t index);
+	Element* GetRow(size_t index) const;
+
+	void Update() override;
+	void CalculateLayout() override;
+	Node* Clone(bool deep = true) const override;
+
+private:
+	struct Row {
+		Element* element;
+		float top;
+	};
+	float GetItemOffset(size_t index);
+	size_t GetItemIndex(float offset);
+	float GetTotalHeight();
+	void UpdateOffsets();
+	void UpdateTemplate();
+	void UpdateWindow();
+	Element* AcquireRow();
+	void ReleaseRow(Element* row);
+	void PlaceRow(Row& row, size_t index);
+
+	Mode mode = Mode::Fixed;
+	float row_height = 20.f;
+	float overscan = 0.f;
+	size_t count = 0;
+	Element* row_template = nullptr;
+	std::map<size_t, Row> rows;
+	std::vector<Element*> pool;
+	std::vector<float> heights;
+	std::vector<float> offsets;
+	size_t first = 0;
+	size_t last = 0;
+	float last_scroll = -1.f;
+	float last_viewport = -1.f;
+	bool dirty_offsets = true;
+	bool dirty_window = true;
+	bool dirty_bind = false;
+};
+
+}
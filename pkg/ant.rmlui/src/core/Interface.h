@@ -53,6 +53,7 @@ struct TextureData {
 	struct Atlas {
 		float ux, uy, uw, uh;
 		float fx, fy, fw, fh;
+		TextureId source = UINT16_MAX; // standalone texture, used when the image repeats
 	};
 
 	TextureId handle = UINT16_MAX;
@@ -96,6 +97,7 @@ public:
 	virtual void OnDestroyNode(Document* document, Node* node) = 0;
 	virtual void OnLoadTexture(Document* document, Element* element, const std::string& path) = 0;
 	virtual void OnLoadTexture(Document* document, Element* element, const std::string& path, Size size) = 0;
+	virtual void OnVirtualListBind(Document* document, Element* list, Element* row, size_t index) = 0;
 	virtual void OnParseText(const std::string& str,std::vector<Rml::group>& groups,std::vector<int>& groupmap,std::vector<Rml::image>& images,std::vector<int>& imageMap,std::string& ctext,Rml::group& default_group)=0;
 };
 
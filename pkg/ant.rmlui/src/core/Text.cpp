@@ -1,6 +1,7 @@
 #include <core/Text.h>
 #include <core/Document.h>
 #include <core/Interface.h>
+#include <core/TextCache.h>
 #include <binding/Context.h>
 #include <binding/utf8.h>
 #include <util/Log.h>
@@ -265,30 +266,38 @@ Size Text::Measure(float minWidth, float maxWidth, float minHeight, float maxHei
 	Style::TextAlign text_align = GetProperty<Style::TextAlign>(PropertyId::TextAlign);
 	Style::WordBreak word_break = GetProperty<Style::WordBreak>(PropertyId::WordBreak);
 
-	std::string line;
-	if (word_break == Style::WordBreak::Normal) {
-		if (line_height < maxHeight) {
-			float line_width;
-			GenerateLine(line, line_width, line_begin, maxWidth, text, true);
-			lines.push_back(Line { line, Point(line_width, baseline), 0 });
-			width = std::max(width, line_width);
-			line_begin += line.size();
-			height += line_height;
+	TextCache::Layout layout { maxWidth, maxHeight, line_height, (uint8_t)word_break };
+	const LineBreakList* breaks = TextCache::FindLineBreaks(font_handle, text, layout);
+	if (!breaks) {
+		LineBreakList newbreaks;
+		std::string line;
+		if (word_break == Style::WordBreak::Normal) {
+			if (line_height < maxHeight) {
+				float line_width;
+				GenerateLine(line, line_width, line_begin, maxWidth, text, true);
+				newbreaks.push_back(LineBreak { line, line_width });
+			}
 		}
-	}
-	else {
-		bool finish = false;
-		while (height <= maxHeight) {
-			float line_width;
-			finish = GenerateLine(line, line_width, line_begin, maxWidth, text, height + line_height > maxHeight);
-			lines.push_back(Line { line, Point(line_width, height + baseline), 0 });
-			width = std::max(width, line_width);
-			height += line_height;
-			line_begin += line.size();
-			if (finish) {
-				break;
+		else {
+			bool finish = false;
+			while (height <= maxHeight) {
+				float line_width;
+				finish = GenerateLine(line, line_width, line_begin, maxWidth, text, height + line_height > maxHeight);
+				newbreaks.push_back(LineBreak { line, line_width });
+				height += line_height;
+				line_begin += line.size();
+				if (finish) {
+					break;
+				}
 			}
+			height = 0.f;
 		}
+		breaks = &TextCache::InsertLineBreaks(font_handle, text, layout, std::move(newbreaks));
+	}
+	for (auto const& b : *breaks) {
+		lines.push_back(Line { b.text, Point(b.width, height + baseline), 0 });
+		width = std::max(width, b.width);
+		height += line_height;
 	}
 	for (auto& line : lines) {
 		float start_width = 0.0f;
@@ -0,0 +1,231 @@
+#include <core/TextCache.h>
+#include <bit>
+#include <list>
+#include <string_view>
+#include <unordered_map>
+
+namespace Rml::TextCache {
+
+struct KeyView {
+	uint64_t face;
+	uint32_t max_width;
+	uint32_t max_height;
+	uint32_t line_height;
+	uint8_t kind;
+	std::string_view text;
+	bool operator==(const KeyView& rhs) const {
+		return face == rhs.face
+			&& max_width == rhs.max_width
+			&& max_height == rhs.max_height
+			&& line_height == rhs.line_height
+			&& kind == rhs.kind
+			&& text == rhs.text
+			;
+	}
+};
+
+struct Key {
+	uint64_t face;
+	uint32_t max_width;
+	uint32_t max_height;
+	uint32_t line_height;
+	uint8_t kind;
+	std::string text;
+	Key(const KeyView& v)
+		: face(v.face)
+		, max_width(v.max_width)
+		, max_height(v.max_height)
+		, line_height(v.line_height)
+		, kind(v.kind)
+		, text(v.text)
+	{}
+	KeyView view() const {
+		return { face, max_width, max_height, line_height, kind, text };
+	}
+};
+
+static size_t HashCombine(size_t seed, size_t v) {
+	return seed ^ (v + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+struct KeyHash {
+	using is_transparent = void;
+	size_t operator()(const KeyView& k) const {
+		size_t h = std::hash<std::string_view>{}(k.text);
+		h = HashCombine(h, std::hash<uint64_t>{}(k.face));
+		h = HashCombine(h, k.max_width);
+		h = HashCombine(h, k.max_height);
+		h = HashCombine(h, k.line_height);
+		h = HashCombine(h, k.kind);
+		return h;
+	}
+	size_t operator()(const Key& k) const {
+		return (*this)(k.view());
+	}
+};
+
+struct KeyEqual {
+	using is_transparent = void;
+	bool operator()(const KeyView& a, const KeyView& b) const { return a == b; }
+	bool operator()(const Key& a, const KeyView& b) const { return a.view() == b; }
+	bool operator()(const KeyView& a, const Key& b) const { return a == b.view(); }
+	bool operator()(const Key& a, const Key& b) const { return a.view() == b.view(); }
+};
+
+static size_t MemoryUsage(const GlyphRun& run) {
+	return run.glyphs.capacity() * sizeof(GlyphQuad);
+}
+
+static size_t MemoryUsage(const LineBreakList& lines) {
+	size_t n = lines.capacity() * sizeof(LineBreak);
+	for (auto const& line : lines) {
+		n += line.text.capacity();
+	}
+	return n;
+}
+
+template <typename Value>
+class LruCache {
+public:
+	explicit LruCache(size_t budget)
+		: budget(budget)
+	{}
+	Value* Find(const KeyView& key) {
+		auto it = index.find(key);
+		if (it == index.end()) {
+			stats.misses++;
+			return nullptr;
+		}
+		stats.hits++;
+		entries.splice(entries.begin(), entries, it->second);
+		return &it->second->value;
+	}
+	Value& Insert(const KeyView& key, Value&& value) {
+		auto it = index.find(key);
+		if (it != index.end()) {
+			Entry& e = *it->second;
+			memory -= e.memory;
+			e.value = std::move(value);
+			e.memory = EntryMemory(e);
+			memory += e.memory;
+			entries.splice(entries.begin(), entries, it->second);
+			Shrink();
+			return entries.front().value;
+		}
+		entries.emplace_front(key, std::move(value));
+		Entry& e = entries.front();
+		e.memory = EntryMemory(e);
+		memory += e.memory;
+		index.emplace(e.key, entries.begin());
+		Shrink();
+		return entries.front().value;
+	}
+	void SetBudget(size_t bytes) {
+		budget = bytes;
+		Shrink();
+	}
+	void Clear() {
+		index.clear();
+		entries.clear();
+		memory = 0;
+	}
+	Stats GetStats() const {
+		Stats s = stats;
+		s.entries = entries.size();
+		s.memory = memory;
+		s.budget = budget;
+		return s;
+	}
+private:
+	struct Entry {
+		Key key;
+		Value value;
+		size_t memory = 0;
+		Entry(const KeyView& k, Value&& v)
+			: key(k)
+			, value(std::move(v))
+		{}
+	};
+	using List = std::list<Entry>;
+	static size_t EntryMemory(const Entry& e) {
+		// list node + hash node (which holds a copy of the key)
+		return sizeof(Entry) + sizeof(Key) + sizeof(void*) * 4
+			+ e.key.text.capacity() * 2
+			+ MemoryUsage(e.value);
+	}
+	void Shrink() {
+		// always keep the most recent entry, even if it is larger than the budget
+		while (memory > budget && entries.size() > 1) {
+			Entry& e = entries.back();
+			memory -= e.memory;
+			index.erase(e.key);
+			entries.pop_back();
+		}
+	}
+	List entries;
+	std::unordered_map<Key, typename List::iterator, KeyHash, KeyEqual> index;
+	size_t memory = 0;
+	size_t budget;
+	Stats stats;
+};
+
+static constexpr size_t kDefaultGlyphRunBudget = 4 * 1024 * 1024;
+static constexpr size_t kDefaultLineBreakBudget = 1 * 1024 * 1024;
+
+static LruCache<GlyphRun> glyphruns { kDefaultGlyphRunBudget };
+static LruCache<LineBreakList> linebreaks { kDefaultLineBreakBudget };
+
+static KeyView MakeKey(uint64_t face, Kind kind, const std::string& text) {
+	return { face, 0, 0, 0, (uint8_t)kind, text };
+}
+
+static KeyView MakeKey(uint64_t face, const std::string& text, const Layout& layout) {
+	return {
+		face,
+		std::bit_cast<uint32_t>(layout.max_width),
+		std::bit_cast<uint32_t>(layout.max_height),
+		std::bit_cast<uint32_t>(layout.line_height),
+		layout.word_break,
+		text,
+	};
+}
+
+GlyphRun* FindGlyphRun(uint64_t face, Kind kind, const std::string& text) {
+	return glyphruns.Find(MakeKey(face, kind, text));
+}
+
+GlyphRun& InsertGlyphRun(uint64_t face, Kind kind, const std::string& text, GlyphRun&& run) {
+	return glyphruns.Insert(MakeKey(face, kind, text), std::move(run));
+}
+
+const LineBreakList* FindLineBreaks(uint64_t face, const std::string& text, const Layout& layout) {
+	return linebreaks.Find(MakeKey(face, text, layout));
+}
+
+const LineBreakList& InsertLineBreaks(uint64_t face, const std::string& text, const Layout& layout, LineBreakList&& lines) {
+	return linebreaks.Insert(MakeKey(face, text, layout), std::move(lines));
+}
+
+Stats GetGlyphRunStats() {
+	return glyphruns.GetStats();
+}
+
+Stats GetLineBreakStats() {
+	return linebreaks.GetStats();
+}
+
+void SetBudget(size_t glyphrun_bytes, size_t linebreak_bytes) {
+	glyphruns.SetBudget(glyphrun_bytes);
+	linebreaks.SetBudget(linebreak_bytes);
+}
+
+void Clear() {
+	glyphruns.Clear();
+	linebreaks.Clear();
+}
+
+void Shutdown() {
+	Clear();
+}
+
+}
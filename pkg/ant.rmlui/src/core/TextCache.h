@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Rml {
+
+// One shaped glyph, color independent. Positions are relative to the pen,
+// the pen moves by `advance` after the glyph.
+struct GlyphQuad {
+	uint32_t codepoint;
+	int16_t offset_x;
+	int16_t offset_y;
+	int16_t advance;
+	uint16_t w;
+	uint16_t h;
+	uint16_t u;
+	uint16_t v;
+	uint16_t tw;
+	uint16_t th;
+};
+
+struct GlyphRun {
+	std::vector<GlyphQuad> glyphs;
+	int stamp = 0;
+};
+
+struct LineBreak {
+	std::string text;
+	float width;
+};
+
+using LineBreakList = std::vector<LineBreak>;
+
+namespace TextCache {
+	enum class Kind : uint8_t {
+		Plain,
+		Rich,
+	};
+
+	struct Layout {
+		float max_width;
+		float max_height;
+		float line_height;
+		uint8_t word_break;
+	};
+
+	struct Stats {
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t entries = 0;
+		size_t memory = 0;
+		size_t budget = 0;
+	};
+
+	GlyphRun* FindGlyphRun(uint64_t face, Kind kind, const std::string& text);
+	GlyphRun& InsertGlyphRun(uint64_t face, Kind kind, const std::string& text, GlyphRun&& run);
+
+	const LineBreakList* FindLineBreaks(uint64_t face, const std::string& text, const Layout& layout);
+	const LineBreakList& InsertLineBreaks(uint64_t face, const std::string& text, const Layout& layout, LineBreakList&& lines);
+
+	Stats GetGlyphRunStats();
+	Stats GetLineBreakStats();
+	void SetBudget(size_t glyphrun_bytes, size_t linebreak_bytes);
+	void Clear();
+	void Shutdown();
+}
+
+}
@@ -1,10 +1,64 @@
 #include <css/StyleSheet.h>
 #include <css/StyleSheetNode.h>
+#include <core/Element.h>
 #include <util/Log.h>
+#include <util/ParallelFor.h>
 #include <algorithm>
+#include <iterator>
+#include <string_view>
+#include <unordered_set>
 
 namespace Rml {
 
+static constexpr size_t MaxCacheEntries = 8192;
+static constexpr size_t MinParallelElements = 256;
+static constexpr size_t ParallelGrain = 32;
+
+static void AppendKey(std::string& key, const Element* element) {
+	key += element->GetTagName();
+	key += '\x1f';
+	key += element->GetId();
+	key += '\x1f';
+	auto const& classes = element->GetClassNames();
+	if (classes.size() == 1) {
+		key += classes[0];
+	}
+	else if (!classes.empty()) {
+		std::vector<std::string_view> sorted(classes.begin(), classes.end());
+		std::sort(sorted.begin(), sorted.end());
+		for (auto name : sorted) {
+			key += name;
+			key += ' ';
+		}
+	}
+	key += '\x1f';
+	key += (char)element->GetActivePseudoClasses();
+	key += '\x1e';
+}
+
+// everything a selector without structural pseudo classes can depend on.
+static std::string BuildKey(const Element* element) {
+	std::string key;
+	for (; element; element = element->GetParentNode()) {
+		AppendKey(key, element);
+	}
+	return key;
+}
+
+static void CollectDirty(const Element* element, bool force, std::vector<const Element*>& elements) {
+	if (!element->IsVisible()) {
+		return;
+	}
+	// when an element changes its definition, all its children will be dirty too.
+	force = force || element->IsDefinitionDirty();
+	if (force) {
+		elements.push_back(element);
+	}
+	for (const Element* child : element->Children()) {
+		CollectDirty(child, force, elements);
+	}
+}
+
 StyleSheet::StyleSheet()
 {}
 
@@ -18,18 +72,153 @@ const AnimationKeyframes* StyleSheet::GetKeyframes(const std::string & name) con
 	return nullptr;
 }
 
-Style::TableRef StyleSheet::GetElementDefinition(const Element* element) const {
+StyleSheet::NodeList StyleSheet::MatchSelectors(const Element* element, bool structural) const {
+	NodeList matched;
+	if (!indexed) {
+		for (uint32_t i = 0; i < (uint32_t)stylenode.size(); ++i) {
+			auto const& node = stylenode[i];
+			if (node.IsStructural() == structural && node.IsApplicable(element)) {
+				matched.push_back(i);
+			}
+		}
+		return matched;
+	}
+	NodeList candidates = index.universal;
+	auto append = [&](const std::unordered_map<std::string, NodeList>& map, const std::string& name) {
+		if (name.empty()) {
+			return;
+		}
+		auto it = map.find(name);
+		if (it != map.end()) {
+			candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+		}
+	};
+	append(index.id, element->GetId());
+	append(index.tag, element->GetTagName());
+	auto const& classes = element->GetClassNames();
+	for (auto const& name : classes) {
+		append(index.classes, name);
+	}
+	std::sort(candidates.begin(), candidates.end());
+	if (classes.size() > 1) {
+		candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+	}
+	for (uint32_t i : candidates) {
+		auto const& node = stylenode[i];
+		if (node.IsStructural() == structural && node.IsApplicable(element)) {
+			matched.push_back(i);
+		}
+	}
+	return matched;
+}
+
+const StyleSheet::NodeList& StyleSheet::InsertMatch(std::string&& key, NodeList&& matched) const {
+	if (match_cache.size() >= MaxCacheEntries) {
+		match_cache.clear();
+	}
+	return match_cache.insert_or_assign(std::move(key), std::move(matched)).first->second;
+}
+
+Style::TableRef StyleSheet::GetDefinition(const NodeList& matched) const {
+	auto it = definition_cache.find(matched);
+	if (it != definition_cache.end()) {
+		return it->second;
+	}
 	std::vector<Style::TableValue> applicable;
-	for (auto& node : stylenode) {
-		if (node.IsApplicable(element)) {
-			applicable.emplace_back(node.GetProperties());
+	applicable.reserve(matched.size());
+	for (uint32_t i : matched) {
+		applicable.emplace_back(stylenode[i].GetProperties());
+	}
+	auto definition = Style::Instance().Merge(applicable);
+	if (definition_cache.size() >= MaxCacheEntries) {
+		definition_cache.clear();
+	}
+	definition_cache.emplace(matched, definition);
+	return definition;
+}
+
+Style::TableRef StyleSheet::GetElementDefinition(const Element* element) const {
+	std::string key = BuildKey(element);
+	auto it = match_cache.find(key);
+	const NodeList& matched = (it != match_cache.end())
+		? it->second
+		: InsertMatch(std::move(key), MatchSelectors(element, false))
+		;
+	NodeList structural = MatchSelectors(element, true);
+	if (structural.empty()) {
+		return GetDefinition(matched);
+	}
+	NodeList all;
+	all.reserve(matched.size() + structural.size());
+	std::merge(matched.begin(), matched.end(), structural.begin(), structural.end(), std::back_inserter(all));
+	return GetDefinition(all);
+}
+
+void StyleSheet::PrepareDefinitions(const Element* root) const {
+	std::vector<const Element*> elements;
+	CollectDirty(root, false, elements);
+	if (elements.size() < MinParallelElements || ParallelForConcurrency() <= 1) {
+		return;
+	}
+	// 1. build the keys, 2. match the missing keys, both in parallel. The caches are only read
+	// by the workers, the results are inserted here, GetElementDefinition will find them later.
+	std::vector<std::string> keys(elements.size());
+	ParallelFor(elements.size(), ParallelGrain, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			keys[i] = BuildKey(elements[i]);
+		}
+	});
+	std::vector<size_t> missing;
+	std::unordered_set<std::string_view> seen;
+	for (size_t i = 0; i < elements.size(); ++i) {
+		if (!match_cache.contains(keys[i]) && seen.insert(keys[i]).second) {
+			missing.push_back(i);
 		}
 	}
-	return Style::Instance().Merge(applicable);
+	if (missing.empty()) {
+		return;
+	}
+	std::vector<NodeList> results(missing.size());
+	ParallelFor(missing.size(), ParallelGrain, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			results[i] = MatchSelectors(elements[missing[i]], false);
+		}
+	});
+	for (size_t i = 0; i < missing.size(); ++i) {
+		InsertMatch(std::move(keys[missing[i]]), std::move(results[i]));
+	}
 }
 
 void StyleSheet::AddNode(StyleSheetNode&& node) {
 	stylenode.emplace_back(std::move(node));
+	indexed = false;
+	match_cache.clear();
+	definition_cache.clear();
+}
+
+void StyleSheet::BuildIndex() {
+	index = {};
+	for (uint32_t i = 0; i < (uint32_t)stylenode.size(); ++i) {
+		auto req = stylenode[i].GetKeyRequirements();
+		if (!req) {
+			continue;
+		}
+		if (!req->id.empty()) {
+			index.id[req->id].push_back(i);
+		}
+		else if (!req->class_names.empty()) {
+			index.classes[req->class_names[0]].push_back(i);
+		}
+		else if (!req->tag.empty()) {
+			index.tag[req->tag].push_back(i);
+		}
+		else {
+			index.universal.push_back(i);
+		}
+	}
+	indexed = true;
+	match_cache.clear();
+	definition_cache.clear();
 }
 
 void StyleSheet::AddKeyframe(const std::string& identifier, const std::vector<float>& rule_values, const PropertyVector& properties) {
@@ -50,6 +239,7 @@ void StyleSheet::Sort() {
 	std::sort(stylenode.begin(), stylenode.end(), [](const StyleSheetNode& lhs, const StyleSheetNode& rhs) {
 		return lhs.GetSpecificity() > rhs.GetSpecificity();
 	});
+	BuildIndex();
 	for (auto& [_, kfs] : keyframes) {
 		for (auto it = kfs.begin(); it != kfs.end();) {
 			auto& kf = it->second;
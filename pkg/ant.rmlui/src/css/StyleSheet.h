@@ -3,6 +3,8 @@
 #include <core/ID.h>
 #include <css/StyleCache.h>
 #include <map>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace Rml {
@@ -36,10 +38,29 @@ public:
 	void Sort();
 	const AnimationKeyframes* GetKeyframes(const std::string& name) const;
 	Style::TableRef GetElementDefinition(const Element* element) const;
+	void PrepareDefinitions(const Element* root) const;
 
 private:
+	using NodeList = std::vector<uint32_t>;
+	struct SelectorIndex {
+		std::unordered_map<std::string, NodeList> id;
+		std::unordered_map<std::string, NodeList> classes;
+		std::unordered_map<std::string, NodeList> tag;
+		NodeList universal;
+	};
+	void BuildIndex();
+	NodeList MatchSelectors(const Element* element, bool structural) const;
+	const NodeList& InsertMatch(std::string&& key, NodeList&& matched) const;
+	Style::TableRef GetDefinition(const NodeList& matched) const;
+
 	std::vector<StyleSheetNode> stylenode;
 	std::map<std::string, AnimationKeyframes> keyframes;
+	SelectorIndex index;
+	bool indexed = false;
+	// key is the tag/id/classes/pseudo classes of the element and all its ancestors,
+	// value is the matched nodes without structural selectors.
+	mutable std::unordered_map<std::string, NodeList> match_cache;
+	mutable std::map<NodeList, Style::TableRef> definition_cache;
 };
 
 }
@@ -185,6 +185,11 @@ int StyleSheetRequirements::GetSpecificity() const {
 StyleSheetNode::StyleSheetNode(const std::string& rule_name, const Style::TableRef& props)
 	: properties(props) {
 	ImportRequirements(rule_name);
+	for (auto const& req : requirements) {
+		if (!req.structural_selectors.empty()) {
+			structural = true;
+		}
+	}
 }
 
 int StyleSheetNode::GetSpecificity() const {
@@ -220,10 +225,21 @@ bool StyleSheetNode::IsApplicable(const Element* const in_element) const {
 	return requirements[0].MatchStructuralSelector(in_element);
 }
 
+bool StyleSheetNode::IsStructural() const {
+	return structural;
+}
+
 const Style::TableRef& StyleSheetNode::GetProperties() const {
 	return properties;
 }
 
+const StyleSheetRequirements* StyleSheetNode::GetKeyRequirements() const {
+	if (requirements.empty()) {
+		return nullptr;
+	}
+	return &requirements[0];
+}
+
 void StyleSheetNode::ImportRequirements(std::string rule_name) {
 
 	// Find child combinators, the RCSS '>' rule.
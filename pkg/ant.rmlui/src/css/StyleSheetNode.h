@@ -37,14 +37,17 @@ public:
 	StyleSheetNode(const std::string& rule_name, const Style::TableRef& props);
 	void SetSpecificity(int rule_specificity);
 	bool IsApplicable(const Element* element) const;
+	bool IsStructural() const;
 	int GetSpecificity() const;
 	const Style::TableRef& GetProperties() const;
+	const StyleSheetRequirements* GetKeyRequirements() const;
 private:
 	void ImportRequirements(std::string rule_name);
 private:
 	Style::TableRef properties;
 	std::vector<StyleSheetRequirements> requirements;
 	int specificity = 0;
+	bool structural = false;
 };
 
 }
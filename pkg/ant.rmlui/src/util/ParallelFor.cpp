@@ -0,0 +1,117 @@
+#include <util/ParallelFor.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace Rml {
+
+static constexpr unsigned MaxWorkers = 8;
+
+class WorkerPool {
+public:
+	WorkerPool() {
+		unsigned n = std::min(std::max(std::thread::hardware_concurrency(), 1u) - 1, MaxWorkers);
+		for (unsigned i = 0; i < n; ++i) {
+			threads.emplace_back([this]() { Run(); });
+		}
+	}
+	~WorkerPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		wakeup.notify_all();
+		for (auto& t : threads) {
+			t.join();
+		}
+	}
+	size_t Concurrency() const {
+		return threads.size() + 1;
+	}
+	void Dispatch(size_t n, size_t grain, const ParallelForFunc& f) {
+		std::lock_guard<std::mutex> dispatch(dispatch_mutex);
+		Job job { &f, n, grain };
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			current = &job;
+			generation++;
+		}
+		wakeup.notify_all();
+		Work(job);
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [&]() { return job.active == 0; });
+		current = nullptr;
+	}
+private:
+	struct Job {
+		const ParallelForFunc* f;
+		size_t n;
+		size_t grain;
+		std::atomic<size_t> next = 0;
+		int active = 0;
+	};
+	static void Work(Job& job) {
+		for (;;) {
+			size_t begin = job.next.fetch_add(job.grain);
+			if (begin >= job.n) {
+				break;
+			}
+			(*job.f)(begin, std::min(job.n, begin + job.grain));
+		}
+	}
+	void Run() {
+		uint64_t seen = 0;
+		for (;;) {
+			Job* job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wakeup.wait(lock, [&]() { return stop || (current && generation != seen); });
+				if (stop) {
+					return;
+				}
+				seen = generation;
+				job = current;
+				job->active++;
+			}
+			Work(*job);
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--job->active == 0) {
+				finished.notify_all();
+			}
+		}
+	}
+	std::vector<std::thread> threads;
+	std::mutex dispatch_mutex;
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	std::condition_variable finished;
+	Job* current = nullptr;
+	uint64_t generation = 0;
+	bool stop = false;
+};
+
+static WorkerPool& GetWorkerPool() {
+	static WorkerPool pool;
+	return pool;
+}
+
+void ParallelFor(size_t n, size_t grain, const ParallelForFunc& f) {
+	grain = std::max<size_t>(grain, 1);
+	if (n <= grain) {
+		if (n > 0) {
+			f(0, n);
+		}
+		return;
+	}
+	GetWorkerPool().Dispatch(n, grain, f);
+}
+
+size_t ParallelForConcurrency() {
+	return GetWorkerPool().Concurrency();
+}
+
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <functional>
+#include <stddef.h>
+
+namespace Rml {
+
+// Runs f(begin, end) over [0, n) in chunks of `grain` items on a small worker pool,
+// the calling thread takes part too. Returns when all chunks are done.
+// f must only read shared state.
+using ParallelForFunc = std::function<void(size_t begin, size_t end)>;
+void ParallelFor(size_t n, size_t grain, const ParallelForFunc& f);
+size_t ParallelForConcurrency();
+
+}
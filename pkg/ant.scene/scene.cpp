@@ -1,5 +1,6 @@
 #include "ecs/world.h"
 #include "ecs/select.h"
+#include "ecs/version.h"
 #include "ecs/component.hpp"
 #include <bee/utility/flatmap.h>
 #include <glm/glm.hpp>
@@ -65,6 +66,7 @@ worldmat_update(bee::flatmap<component::eid, math_t>& worldmats, struct math_con
 }
 
 #define MUTABLE_TICK 128
+#define VERSION_HISTORY 8
 
 static int
 entity_init(lua_State *L) {
@@ -138,6 +140,7 @@ scene_changed(lua_State *L) {
 
 	// step.2
 	bee::flatmap<component::eid, math_t> worldmats;
+	auto& scene_log = w->versions->log<component::scene>();
 	for (auto& e : ecs::select<component::scene_mutable, component::scene, component::eid>(w->ecs)) {
 		auto& s = e.get<component::scene>();
 		component::eid id = e.get<component::eid>();
@@ -148,6 +151,7 @@ scene_changed(lua_State *L) {
 				return luaL_error(L, "entity(%d)'s parent(%d) cannot be found.", id, s.parent);
 			}
 			s.movement = w->frame;
+			scene_log.write(id, w->frame);
 			if (!selfchanged){
 				changed.insert(id);
 			}
@@ -166,6 +170,9 @@ static int
 end_frame(lua_State *L) {
 	auto w = getworld(L);
 	ecs::clear_type<component::scene_changed>(w->ecs);
+	if (w->frame > VERSION_HISTORY) {
+		w->versions->clear(w->frame - VERSION_HISTORY);
+	}
 	return 0;
 }
 
@@ -181,6 +188,10 @@ scene_remove(lua_State *L) {
 
 	entity_propagate_tag(w->ecs, ecs::component_id<component::scene>, ecs::component_id<component::REMOVED>);
 
+	for (auto& e : ecs::select<component::REMOVED, component::eid>(w->ecs)) {
+		w->versions->erase(e.get<component::eid>());
+	}
+
 	return 0;
 }
 
@@ -189,13 +200,15 @@ bounding_update(lua_State *L){
 	auto w = getworld(L);
 	auto math3d = w->math3d->M;
 	math3d_checkpoint cp(math3d);
-	for (auto& e : ecs::select<component::scene_changed, component::bounding, component::scene>(w->ecs)){
+	auto& bounding_log = w->versions->log<component::bounding>();
+	for (auto& e : ecs::select<component::scene_changed, component::bounding, component::scene, component::eid>(w->ecs)){
 		auto &b = e.get<component::bounding>();
 		if (math_isnull(b.aabb))
 			continue;
 		const auto &s = e.get<component::scene>();
 		const math_t aabb = math3d_aabb_transform(math3d, s.worldmat, b.aabb);
 		math3d_update(math3d, b.scene_aabb, aabb);
+		bounding_log.write(e.get<component::eid>(), w->frame);
 	}
 	return 0;
 }
@@ -25,13 +25,20 @@ end
 local function create(w)
 	local bgfx = require "bgfx"
 	local math3d = require "math3d"
+	local jobs = require "ecs.jobs"
+	local versions = require "ecs.versions"
 	local ecs = w.w
+	w._jobs = jobs.create(w.args.ecs.job_threads)
+	w._versions = versions.create()
 	w._ecs_world = cstruct(
 		ecs:context(),
 		bgfx.CINTERFACE,
 		math3d.CINTERFACE,
 		bgfx.encoder_get(),
-		0,0,0,0,0,0,0,0
+		0,0,0,0,0,0,
+		w._jobs,
+		w._versions,
+		0,0,0,0,0
 	)
 end
 
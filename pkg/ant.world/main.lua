@@ -2,6 +2,7 @@ local luaecs = import_package "ant.luaecs"
 local serialize = import_package "ant.serialize"
 local assetmgr = import_package "ant.asset"
 local btime = require "bee.time"
+local profiler = require "profiler"
 local inputmgr = require "inputmgr"
 local bgfx = require "bgfx"
 local policy = require "policy"
@@ -368,16 +369,29 @@ function world:get_mouse()
     return self._mouse
 end
 
-local function cpustat_update(w, funcs, symbols)
+local function profile_names(what, symbols)
+    local names = {}
+    for i, symbol in ipairs(symbols) do
+        names[i] = profiler.intern(symbol)
+    end
+    return profiler.intern(what), names
+end
+
+local function cpustat_update(w, what, funcs, symbols)
     local ecs_world = w._ecs_world
     local monotonic = btime.monotonic
+    local enter, leave = profiler.enter, profiler.leave
+    local pipeline, names = profile_names(what, symbols)
     return function()
         local stat = w._cpu_stat
+        local pt = enter()
         for i = 1, #funcs do
             local func = funcs[i]
+            local t = enter()
             local now = monotonic()
             func(ecs_world)
             local time = monotonic() - now
+            leave(names[i], t)
             local name = symbols[i]
             if stat[name] then
                 stat[name] = stat[name] + time
@@ -386,6 +400,7 @@ local function cpustat_update(w, funcs, symbols)
                 stat[#stat+1] = name
             end
         end
+        leave(pipeline, pt)
     end
 end
 
@@ -393,8 +408,8 @@ local function dbg_print(x, y, ...)
 	return bgfx.dbg_text_print(x + 16, y + 1, ...)
 end
 
-local function cpustat_update_then_print(w, funcs, symbols)
-    local update_func = cpustat_update(w, funcs, symbols)
+local function cpustat_update_then_print(w, what, funcs, symbols)
+    local update_func = cpustat_update(w, what, funcs, symbols)
     local MaxFrame <const> = 30
     local MaxText <const> = math.min(10, #funcs)
     local MaxName <const> = 48
@@ -467,18 +482,37 @@ function world:pipeline_func(what, step)
     end
     if self._profile then
         if what == "_update" then
-            return cpustat_update_then_print(w, funcs, symbols)
+            return cpustat_update_then_print(w, what, funcs, symbols)
         end
     end
     local ecs_world = w._ecs_world
+    local enter, leave = profiler.enter, profiler.leave
+    local pipeline, names = profile_names(what, symbols)
     return function()
+        local pt = enter()
         for i = 1, #funcs do
             local f = funcs[i]
+            local t = enter()
             f(ecs_world)
+            leave(names[i], t)
         end
+        leave(pipeline, pt)
     end
 end
 
+-- Scopes of every system step go to the native profiler while it is enabled,
+-- a capture is written as Chrome trace_event json, or as the binary format of clibs/profiler.
+-- The request handlers of the ltask services are scopes only with ANT_PROFILER set, see ltask_initservice.lua.
+function world:profiler_enable(enable)
+    profiler.enable(enable)
+end
+
+function world:profiler_capture(path, binary)
+    local f <close> = assert(io.open(path, "wb"))
+    f:write(binary and profiler.binary() or profiler.chrome())
+    profiler.clear()
+end
+
 local function sortpairs(t)
 	local sort = {}
 	for k in pairs(t) do
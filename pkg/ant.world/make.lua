@@ -12,3 +12,34 @@ lm:lua_src "ecs" {
     },
     objdeps = "compile_ecs",
 }
+
+lm:exe "ecs_jobs_test" {
+    includes = {
+        lm.AntDir .. "/clibs/ecs",
+        lm.AntDir .. "/3rd/luaecs",
+    },
+    sources = {
+        "src/job_scheduler.cpp",
+        "test/jobs_test.cpp",
+    },
+}
+
+lm:exe "ecs_chunk_test" {
+    includes = {
+        lm.AntDir .. "/clibs/ecs",
+        lm.AntDir .. "/3rd/luaecs",
+    },
+    sources = {
+        "test/chunk_test.cpp",
+    },
+}
+
+lm:exe "ecs_version_test" {
+    includes = {
+        lm.AntDir .. "/clibs/ecs",
+        lm.AntDir .. "/3rd/luaecs",
+    },
+    sources = {
+        "test/version_test.cpp",
+    },
+}
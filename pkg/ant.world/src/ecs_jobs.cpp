@@ -0,0 +1,48 @@
+#include "ecs/jobs.h"
+#include <lua.hpp>
+#include <new>
+
+static job_scheduler* tojobs(lua_State* L) {
+    return (job_scheduler*)luaL_checkudata(L, 1, "JOBS");
+}
+
+static int gc(lua_State* L) {
+    tojobs(L)->~job_scheduler();
+    return 0;
+}
+
+static int concurrency(lua_State* L) {
+    lua_pushinteger(L, tojobs(L)->concurrency());
+    return 1;
+}
+
+// the address is stored in ecs_world, see cworld.lua
+static int create(lua_State* L) {
+    const lua_Integer threads = luaL_optinteger(L, 1, job_scheduler::default_threads());
+    luaL_argcheck(L, threads >= 0 && threads <= 256, 1, "invalid thread count");
+    void* ud = lua_newuserdatauv(L, sizeof(job_scheduler), 0);
+    new (ud) job_scheduler((unsigned)threads);
+    if (luaL_newmetatable(L, "JOBS")) {
+        luaL_Reg l[] = {
+            { "__gc", gc },
+            { "concurrency", concurrency },
+            { NULL, NULL },
+        };
+        luaL_setfuncs(L, l, 0);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -2, "__index");
+    }
+    lua_setmetatable(L, -2);
+    return 1;
+}
+
+extern "C" int
+luaopen_ecs_jobs(lua_State* L) {
+	luaL_checkversion(L);
+	luaL_Reg l[] = {
+		{ "create", create },
+		{ NULL, NULL },
+	};
+	luaL_newlib(L, l);
+	return 1;
+}
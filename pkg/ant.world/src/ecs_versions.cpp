@@ -0,0 +1,46 @@
+#include "ecs/version.h"
+#include <lua.hpp>
+#include <new>
+
+static component_versions* toversions(lua_State* L) {
+    return (component_versions*)luaL_checkudata(L, 1, "VERSIONS");
+}
+
+static int gc(lua_State* L) {
+    toversions(L)->~component_versions();
+    return 0;
+}
+
+static int clear(lua_State* L) {
+    toversions(L)->clear((uint64_t)luaL_checkinteger(L, 2));
+    return 0;
+}
+
+// the address is stored in ecs_world, see cworld.lua
+static int create(lua_State* L) {
+    void* ud = lua_newuserdatauv(L, sizeof(component_versions), 0);
+    new (ud) component_versions;
+    if (luaL_newmetatable(L, "VERSIONS")) {
+        luaL_Reg l[] = {
+            { "__gc", gc },
+            { "clear", clear },
+            { NULL, NULL },
+        };
+        luaL_setfuncs(L, l, 0);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -2, "__index");
+    }
+    lua_setmetatable(L, -2);
+    return 1;
+}
+
+extern "C" int
+luaopen_ecs_versions(lua_State* L) {
+	luaL_checkversion(L);
+	luaL_Reg l[] = {
+		{ "create", create },
+		{ NULL, NULL },
+	};
+	luaL_newlib(L, l);
+	return 1;
+}
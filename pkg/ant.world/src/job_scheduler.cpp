@@ -0,0 +1,128 @@
+#include "ecs/jobs.h"
+
+static constexpr int SPIN_COUNT = 64;
+
+static thread_local const job_scheduler* t_scheduler = nullptr;
+static thread_local unsigned t_worker = 0;
+
+job_scheduler::job_scheduler(unsigned n) noexcept {
+    queues.reserve(n + 1);
+    for (unsigned i = 0; i <= n; ++i) {
+        queues.emplace_back(std::make_unique<queue>());
+    }
+    threads.reserve(n);
+    for (unsigned i = 1; i <= n; ++i) {
+        threads.emplace_back([this, i] { worker_main(i); });
+    }
+}
+
+job_scheduler::~job_scheduler() noexcept {
+    {
+        std::unique_lock<std::mutex> lk(sleep_mutex);
+        stop = true;
+    }
+    sleep_cv.notify_all();
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+bool job_scheduler::pop(unsigned worker, task& t) noexcept {
+    auto& q = *queues[worker];
+    std::unique_lock<std::mutex> lk(q.mutex);
+    if (q.tasks.empty()) {
+        return false;
+    }
+    t = q.tasks.back();
+    q.tasks.pop_back();
+    return true;
+}
+
+bool job_scheduler::steal(unsigned worker, task& t) noexcept {
+    const unsigned n = concurrency();
+    for (unsigned i = 1; i < n; ++i) {
+        auto& q = *queues[(worker + i) % n];
+        std::unique_lock<std::mutex> lk(q.mutex);
+        if (!q.tasks.empty()) {
+            t = q.tasks.front();
+            q.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool job_scheduler::execute(unsigned worker) noexcept {
+    if (queued.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+    task t;
+    if (!pop(worker, t) && !steal(worker, t)) {
+        return false;
+    }
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    t.func(t.ud, t.job, worker);
+    t.pending->fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+void job_scheduler::worker_main(unsigned worker) noexcept {
+    t_scheduler = this;
+    t_worker = worker;
+    for (;;) {
+        int spin = 0;
+        while (spin < SPIN_COUNT) {
+            if (execute(worker)) {
+                spin = 0;
+            }
+            else {
+                ++spin;
+                std::this_thread::yield();
+            }
+        }
+        std::unique_lock<std::mutex> lk(sleep_mutex);
+        sleep_cv.wait(lk, [this] {
+            return stop || queued.load(std::memory_order_acquire) > 0;
+        });
+        if (stop) {
+            return;
+        }
+    }
+}
+
+void job_scheduler::run(job_func func, void* ud, size_t n) noexcept {
+    if (n == 0) {
+        return;
+    }
+    const unsigned worker = t_scheduler == this ? t_worker : 0;
+    const unsigned workers = concurrency();
+    if (n == 1 || workers == 1) {
+        for (size_t i = 0; i < n; ++i) {
+            func(ud, i, worker);
+        }
+        return;
+    }
+    std::atomic<size_t> pending = n;
+    // the first jobs go to the caller, it starts on them from the back of its queue
+    for (unsigned w = 0; w < workers; ++w) {
+        const unsigned q = (worker + w) % workers;
+        const size_t first = n * w / workers, last = n * (w + 1) / workers;
+        if (first == last) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(queues[q]->mutex);
+        for (size_t i = last; i > first; --i) {
+            queues[q]->tasks.push_back({ func, ud, i - 1, &pending });
+        }
+    }
+    queued.fetch_add(n, std::memory_order_release);
+    {
+        std::unique_lock<std::mutex> lk(sleep_mutex);
+    }
+    sleep_cv.notify_all();
+    while (pending.load(std::memory_order_acquire) != 0) {
+        if (!execute(worker)) {
+            std::this_thread::yield();
+        }
+    }
+}
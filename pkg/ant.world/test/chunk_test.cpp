@@ -0,0 +1,316 @@
+// Per entity selectors against chunk_select on the scene and cull workloads, over an
+// in-process context that stores components like luaecs: a sorted entity array per type,
+// sub keys found through a call into a lookup table, like cached_context. Both paths must give the same result.
+#include "ecs/select.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace test {
+    struct scene { float worldmat[16]; };
+    struct bounding { float aabb[8]; float scene_aabb[8]; };
+    struct render_object { int cull_idx; };
+    struct scene_changed {};
+    struct visible {};
+    struct render_object_visible {};
+}
+
+template <> inline constexpr int ecs::component_id<test::scene> = 1;
+template <> inline constexpr int ecs::component_id<test::bounding> = 2;
+template <> inline constexpr int ecs::component_id<test::render_object> = 3;
+template <> inline constexpr int ecs::component_id<test::scene_changed> = 4;
+template <> inline constexpr int ecs::component_id<test::visible> = 5;
+template <> inline constexpr int ecs::component_id<test::render_object_visible> = 6;
+
+static constexpr int ENTITIES = 200000;
+static constexpr int QUEUES = 4;
+static constexpr size_t CHUNK = ecs::CHUNK_SIZE;
+
+template <typename T>
+struct pool {
+    std::vector<int> eids;
+    std::vector<int> cache;     // entity -> index, what cached_context builds on sync
+    std::vector<T> data;
+};
+
+template <>
+struct pool<void> {
+    std::vector<int> eids;
+    std::vector<int> cache;
+};
+
+struct fake_world {
+    pool<test::scene> scene;
+    pool<test::bounding> bounding;
+    pool<test::render_object> render_object;
+    pool<void> scene_changed;
+    pool<void> visible;
+    pool<void> render_object_visible;
+
+    template <typename T>
+    auto& get() {
+        if constexpr (std::is_same_v<T, test::scene>) return scene;
+        else if constexpr (std::is_same_v<T, test::bounding>) return bounding;
+        else if constexpr (std::is_same_v<T, test::render_object>) return render_object;
+        else if constexpr (std::is_same_v<T, test::scene_changed>) return scene_changed;
+        else if constexpr (std::is_same_v<T, test::visible>) return visible;
+        else return render_object_visible;
+    }
+
+    fake_world() {
+        uint32_t x = 1;
+        auto rnd = [&] { x = x * 1664525u + 1013904223u; return x >> 8; };
+        for (int e = 0; e < ENTITIES; ++e) {
+            test::scene s {};
+            const float a = (float)(e % 360) * 0.0174533f;
+            s.worldmat[0] = std::cos(a); s.worldmat[2] = -std::sin(a);
+            s.worldmat[5] = 1.f;
+            s.worldmat[8] = std::sin(a); s.worldmat[10] = std::cos(a);
+            s.worldmat[12] = (float)(e % 1000) - 500.f; s.worldmat[13] = 0.f; s.worldmat[14] = (float)(e / 1000) - 100.f;
+            s.worldmat[15] = 1.f;
+            scene.eids.push_back(e);
+            scene.data.push_back(s);
+            if (rnd() % 10 != 0) {
+                bounding.eids.push_back(e);
+                bounding.data.push_back({ { -1, -1, -1, 0, 1, 1, 1, 0 }, {} });
+            }
+            if (rnd() % 2 == 0) {
+                scene_changed.eids.push_back(e);
+            }
+            if (rnd() % 5 != 0) {
+                render_object.eids.push_back(e);
+                render_object.data.push_back({ (int)render_object.eids.size() - 1 });
+                render_object_visible.eids.push_back(e);
+            }
+            if (rnd() % 10 < 7) {
+                visible.eids.push_back(e);
+            }
+        }
+        build_cache(scene);
+        build_cache(bounding);
+        build_cache(render_object);
+        build_cache(scene_changed);
+        build_cache(visible);
+        build_cache(render_object_visible);
+    }
+    template <typename P>
+    static void build_cache(P& p) {
+        p.cache.assign(ENTITIES, -1);
+        for (size_t i = 0; i < p.eids.size(); ++i) {
+            p.cache[p.eids[i]] = (int)i;
+        }
+    }
+};
+
+// the cost model of entity_cache_fetch_index: a call and a table lookup
+[[gnu::noinline]] static int find_index(const std::vector<int>& cache, int eid) {
+    return cache[eid];
+}
+
+template <typename MainKey>
+struct fake_context {
+    fake_world* w;
+    int entity(int i) const {
+        return w->get<MainKey>().eids[i];
+    }
+    void sync() noexcept {}
+    template <typename T>
+        requires (ecs::is_tag<T>)
+    void next(int& i, ecs_token&) noexcept {
+        i = ++i < (int)w->get<T>().eids.size() ? i : -1;
+    }
+    template <typename T>
+        requires (!ecs::is_tag<T>)
+    T* fetch(int i, ecs_token&) noexcept {
+        auto& p = w->get<T>();
+        return i < (int)p.data.size() ? &p.data[i] : nullptr;
+    }
+    template <typename T>
+    int component_index(ecs_token, int i) noexcept {
+        return find_index(w->get<T>().cache, entity(i));
+    }
+    template <typename T>
+        requires (ecs::is_tag<T>)
+    bool component(ecs_token token, int i) noexcept {
+        return component_index<T>(token, i) >= 0;
+    }
+    template <typename T>
+        requires (!ecs::is_tag<T>)
+    T* component(ecs_token token, int i) noexcept {
+        const int index = component_index<T>(token, i);
+        return index < 0 ? nullptr : &w->get<T>().data[index];
+    }
+    template <typename T>
+    std::span<T> component_array() noexcept {
+        return w->get<T>().data;
+    }
+};
+
+static void aabb_transform(const float wm[16], const float aabb[8], float out[8]) {
+    for (int r = 0; r < 3; ++r) {
+        float lo = wm[12 + r], hi = wm[12 + r];
+        for (int c = 0; c < 3; ++c) {
+            const float a = wm[c * 4 + r] * aabb[c], b = wm[c * 4 + r] * aabb[4 + c];
+            lo += std::min(a, b);
+            hi += std::max(a, b);
+        }
+        out[r] = lo;
+        out[4 + r] = hi;
+    }
+    out[3] = out[7] = 0.f;
+}
+
+struct frustum {
+    float planes[6][4];
+};
+
+static bool culled(const frustum& f, const float aabb[8]) {
+    for (auto& p : f.planes) {
+        const float x = p[0] > 0 ? aabb[4] : aabb[0];
+        const float y = p[1] > 0 ? aabb[5] : aabb[1];
+        const float z = p[2] > 0 ? aabb[6] : aabb[2];
+        if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename F>
+static double best_ms(F&& f) {
+    double best = 1e30;
+    for (int run = 0; run < 7; ++run) {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main() {
+    int failed = 0;
+    auto check = [&](bool ok, const char* what) {
+        if (!ok) {
+            printf("FAILED: %s\n", what);
+            failed++;
+        }
+    };
+
+    fake_world w;
+
+    // scene: bounding_update
+    using scene_ctx = fake_context<test::scene_changed>;
+    scene_ctx sctx { &w };
+    auto scene_select = [&] {
+        ecs::impl::basic_selector<scene_ctx, test::scene_changed, test::bounding, test::scene> sel(sctx);
+        for (auto& e : sel) {
+            auto& b = e.get<test::bounding>();
+            aabb_transform(e.get<test::scene>().worldmat, b.aabb, b.scene_aabb);
+        }
+    };
+    auto scene_chunk = [&] {
+        ecs::basic_chunk_select<scene_ctx, test::scene_changed, test::bounding, test::scene>(sctx, [](auto& c) {
+            auto bounding = c.template array<test::bounding>();
+            auto scene = c.template array<test::scene>();
+            auto bi = c.template index<test::bounding>();
+            auto si = c.template index<test::scene>();
+            for (size_t k = 0; k < c.size(); ++k) {
+                auto& b = bounding[bi[k]];
+                aabb_transform(scene[si[k]].worldmat, b.aabb, b.scene_aabb);
+            }
+        });
+    };
+    scene_select();
+    const auto expect_bounding = w.bounding.data;
+    for (auto& b : w.bounding.data) {
+        std::fill(std::begin(b.scene_aabb), std::end(b.scene_aabb), 0.f);
+    }
+    scene_chunk();
+    check(std::memcmp(expect_bounding.data(), w.bounding.data.data(), expect_bounding.size() * sizeof(test::bounding)) == 0,
+        "scene workload: chunks match the selector");
+    size_t chunked = 0, chunks = 0;
+    ecs::basic_chunk_select<scene_ctx, test::scene_changed, test::bounding, test::scene>(sctx, [&](auto& c) {
+        chunked += c.size();
+        chunks++;
+    }, 1000);
+    size_t selected = 0;
+    for ([[maybe_unused]] auto& e : ecs::impl::basic_selector<scene_ctx, test::scene_changed, test::bounding, test::scene>(sctx)) {
+        selected++;
+    }
+    check(chunked == selected && chunks == (selected + 999) / 1000, "chunks hold every entity of the query once");
+
+    // cull: lcull over render_object_visible, one frustum per queue
+    frustum queues[QUEUES];
+    for (int q = 0; q < QUEUES; ++q) {
+        const float nx = std::cos(q * 1.5f), nz = std::sin(q * 1.5f);
+        const float planes[6][4] = {
+            { 1, 0, 0, 400.f }, { -1, 0, 0, 400.f }, { 0, 1, 0, 50.f }, { 0, -1, 0, 50.f },
+            { nx, 0, nz, 20.f }, { -nx, 0, -nz, 300.f },
+        };
+        std::memcpy(queues[q].planes, planes, sizeof(planes));
+    }
+    std::vector<uint8_t> result_select(w.render_object.data.size() * QUEUES), result_chunk(result_select.size());
+    using cull_ctx = fake_context<test::render_object_visible>;
+    cull_ctx cctx { &w };
+    auto cull_select = [&] {
+        ecs::impl::basic_selector<cull_ctx, test::render_object_visible, test::render_object, test::visible, test::bounding> sel(cctx);
+        for (auto& e : sel) {
+            const auto& b = e.get<test::bounding>();
+            const auto& o = e.get<test::render_object>();
+            for (int q = 0; q < QUEUES; ++q) {
+                result_select[o.cull_idx * QUEUES + q] = culled(queues[q], b.scene_aabb);
+            }
+        }
+    };
+    auto cull_chunk = [&] {
+        // the bounds of a chunk as separate min / max rows, each plane test is one loop over them
+        static float lo[3][CHUNK], hi[3][CHUNK];
+        static uint8_t out[CHUNK];
+        ecs::basic_chunk_select<cull_ctx, test::render_object_visible, test::render_object, test::visible, test::bounding>(cctx, [&](auto& c) {
+            auto bounding = c.template array<test::bounding>();
+            auto objects = c.template array<test::render_object>();
+            auto bi = c.template index<test::bounding>();
+            auto oi = c.template index<test::render_object>();
+            const size_t n = c.size();
+            for (size_t k = 0; k < n; ++k) {
+                const float* aabb = bounding[bi[k]].scene_aabb;
+                for (int a = 0; a < 3; ++a) {
+                    lo[a][k] = aabb[a];
+                    hi[a][k] = aabb[4 + a];
+                }
+            }
+            for (int q = 0; q < QUEUES; ++q) {
+                std::fill_n(out, n, 0);
+                for (auto& p : queues[q].planes) {
+                    const float* x = p[0] > 0 ? hi[0] : lo[0];
+                    const float* y = p[1] > 0 ? hi[1] : lo[1];
+                    const float* z = p[2] > 0 ? hi[2] : lo[2];
+                    for (size_t k = 0; k < n; ++k) {
+                        out[k] |= p[0] * x[k] + p[1] * y[k] + p[2] * z[k] + p[3] < 0;
+                    }
+                }
+                for (size_t k = 0; k < n; ++k) {
+                    result_chunk[objects[oi[k]].cull_idx * QUEUES + q] = out[k];
+                }
+            }
+        }, CHUNK);
+    };
+    cull_select();
+    cull_chunk();
+    check(result_select == result_chunk, "cull workload: chunks match the selector");
+    check(std::count(result_select.begin(), result_select.end(), 1) > 0 && std::count(result_select.begin(), result_select.end(), 0) > 0,
+        "cull workload culls some of the objects");
+
+    const double scene_a = best_ms(scene_select), scene_b = best_ms(scene_chunk);
+    const double cull_a = best_ms(cull_select), cull_b = best_ms(cull_chunk);
+    printf("%d entities, %d queues\n", ENTITIES, QUEUES);
+    printf("scene: select %6.2f ms, chunk %6.2f ms, %.2fx\n", scene_a, scene_b, scene_a / scene_b);
+    printf("cull:  select %6.2f ms, chunk %6.2f ms, %.2fx\n", cull_a, cull_b, cull_a / cull_b);
+
+    printf(failed ? "ecs_chunk_test: %d failure(s)\n" : "ecs_chunk_test: ok\n", failed);
+    return failed ? 1 : 0;
+}
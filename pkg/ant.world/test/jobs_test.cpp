@@ -0,0 +1,183 @@
+// Job scheduler checks, then parallel_select over 1M entities of an in-process context
+// with 1, 2, 4, ... workers. The context has the interface of cached_context, its sub key
+// lookups assert that no two workers share it.
+#include "ecs/parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace test {
+    struct position { float x, y, z; };
+    struct velocity { float x, y, z; };
+}
+
+template <> inline constexpr int ecs::component_id<test::position> = 1;
+template <> inline constexpr int ecs::component_id<test::velocity> = 2;
+
+static constexpr int ENTITIES = 1000000;
+
+struct fake_world {
+    std::vector<test::position> position;
+    std::vector<int> velocity_index;        // every third entity has no velocity
+    std::vector<test::velocity> velocity;
+    fake_world() {
+        position.resize(ENTITIES);
+        velocity_index.resize(ENTITIES, -1);
+        for (int i = 0; i < ENTITIES; ++i) {
+            position[i] = { (float)i, 0.f, 1.f };
+            if (i % 3 != 2) {
+                velocity_index[i] = (int)velocity.size();
+                velocity.push_back({ 1.f, (float)(i % 7), -0.5f });
+            }
+        }
+    }
+};
+
+struct fake_context {
+    fake_world* w;
+    std::atomic<int> users = 0;
+    std::atomic<bool> shared = false;
+    void sync() noexcept {}
+    template <typename T>
+    T* fetch(int i, ecs_token&) noexcept {
+        static_assert(std::is_same_v<T, test::position>);
+        return i < ENTITIES ? &w->position[i] : nullptr;
+    }
+    template <typename T>
+    T* component(ecs_token, int i) noexcept {
+        static_assert(std::is_same_v<T, test::velocity>);
+        if (users.fetch_add(1) != 0) {
+            shared = true;
+        }
+        const int v = w->velocity_index[i];
+        users.fetch_sub(1);
+        return v < 0 ? nullptr : &w->velocity[v];
+    }
+};
+
+using entity_type = ecs::basic_entity<fake_context, test::position, test::velocity>;
+
+static void integrate(entity_type& e) {
+    auto& p = e.get<test::position>();
+    auto& v = e.get<test::velocity>();
+    for (int step = 0; step < 8; ++step) {
+        p.x += v.x * 0.016f;
+        p.y += v.y * 0.016f;
+        p.z += v.z * 0.016f;
+        const float l = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z) + 1.f;
+        p.z = p.z / l + std::sin(p.x * 0.001f);
+    }
+}
+
+template <typename F>
+static double best_ms(F&& f) {
+    double best = 1e30;
+    for (int run = 0; run < 5; ++run) {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main() {
+    int failed = 0;
+    auto check = [&](bool ok, const char* what) {
+        if (!ok) {
+            printf("FAILED: %s\n", what);
+            failed++;
+        }
+    };
+
+    {
+        job_scheduler js(3);
+        check(js.concurrency() == 4, "concurrency counts the caller");
+        std::vector<std::atomic<int>> hits(100000);
+        std::atomic<bool> bad_worker = false;
+        js.parallel_for(hits.size(), [&](size_t job, unsigned worker) {
+            hits[job]++;
+            bad_worker = bad_worker || worker >= js.concurrency();
+        });
+        check(std::all_of(hits.begin(), hits.end(), [](auto& h) { return h == 1; }), "every job runs once");
+        check(!bad_worker, "worker ids are below concurrency");
+
+        std::atomic<int> nested = 0;
+        js.parallel_for(16, [&](size_t, unsigned) {
+            js.parallel_for(64, [&](size_t, unsigned) {
+                nested++;
+            });
+        });
+        check(nested == 16 * 64, "jobs may run jobs");
+
+        std::vector<std::atomic<int>> used(js.concurrency());
+        js.parallel_for(256, [&](size_t, unsigned worker) {
+            used[worker]++;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        });
+        check(std::count_if(used.begin(), used.end(), [](auto& u) { return u > 0; }) > 1, "jobs run on several workers");
+
+        js.parallel_for(0, [&](size_t, unsigned) { failed++; });
+    }
+    {
+        job_scheduler js(0);
+        int n = 0;
+        js.parallel_for(10, [&](size_t, unsigned worker) { n += worker == 0; });
+        check(n == 10, "no threads runs everything on the caller");
+    }
+
+    fake_world reference;
+    {
+        fake_context ctx { &reference };
+        int count = 0;
+        ecs::impl::parallel_select<fake_context, test::position, test::velocity>(nullptr, ENTITIES, 0,
+            [&](unsigned) -> fake_context& { return ctx; },
+            [&](entity_type& e) { integrate(e); count++; });
+        check(count == ENTITIES - ENTITIES / 3, "serial select skips entities without the sub key");
+    }
+
+    const unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+    double serial = 0.;
+    printf("%d entities, %u hardware threads\n", ENTITIES, hw);
+    for (unsigned workers = 1; workers <= std::max(hw, 2u); workers *= 2) {
+        job_scheduler js(workers - 1);
+        std::vector<std::unique_ptr<fake_context>> contexts;
+        fake_world w;
+        for (unsigned i = 0; i < js.concurrency(); ++i) {
+            contexts.emplace_back(new fake_context { &w });
+        }
+        auto get = [&](unsigned worker) -> fake_context& { return *contexts[worker]; };
+        std::atomic<int> count = 0;
+        ecs::impl::parallel_select<fake_context, test::position, test::velocity>(&js, ENTITIES, 0, get, [&](entity_type& e) {
+            integrate(e);
+            count.fetch_add(1, std::memory_order_relaxed);
+        });
+        check(count == ENTITIES - ENTITIES / 3, "parallel select visits every entity once");
+        bool same = true;
+        for (int i = 0; i < ENTITIES; ++i) {
+            same = same && std::memcmp(&w.position[i], &reference.position[i], sizeof(test::position)) == 0;
+        }
+        check(same, "parallel select matches the serial result");
+        const double ms = best_ms([&] {
+            ecs::impl::parallel_select<fake_context, test::position, test::velocity>(&js, ENTITIES, 0, get, integrate);
+        });
+        if (workers == 1) {
+            serial = ms;
+        }
+        bool shared = false;
+        for (auto& c : contexts) {
+            shared = shared || c->shared;
+        }
+        check(!shared, "a worker context is used by one worker at a time");
+        printf("workers %2u: %7.2f ms, speedup %.2f\n", workers, ms, serial / ms);
+    }
+
+    printf(failed ? "ecs_jobs_test: %d failure(s)\n" : "ecs_jobs_test: ok\n", failed);
+    return failed ? 1 : 0;
+}
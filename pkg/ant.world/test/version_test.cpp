@@ -0,0 +1,121 @@
+// change_log write / read / clear / history checks, then a benchmark with 1% of 1M entities written
+// every frame: a reader scanning the version of every entity against one asking the log.
+#include "ecs/version.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace test {
+    struct scene { float worldmat[16]; };
+    struct bounding { float aabb[8]; };
+}
+
+template <> inline constexpr int ecs::component_id<test::scene> = 1;
+template <> inline constexpr int ecs::component_id<test::bounding> = 2;
+
+static constexpr int ENTITIES = 1000000;
+static constexpr int FRAMES = 32;
+static constexpr int HISTORY = 8;
+
+int main() {
+    int failed = 0;
+    auto check = [&](bool ok, const char* what) {
+        if (!ok) {
+            printf("FAILED: %s\n", what);
+            failed++;
+        }
+    };
+    auto collect = [](const ecs::change_log& log, uint64_t frame) {
+        std::vector<uint64_t> r;
+        log.changed_after(frame, [&](uint64_t eid) { r.push_back(eid); });
+        return r;
+    };
+
+    {
+        ecs::change_log log;
+        check(log.version(1) == 0 && collect(log, 0).empty(), "nothing written");
+        log.write(1, 10);
+        log.write(2, 10);
+        log.write(1, 10);
+        check(log.version(1) == 10 && log.version(3) == 0, "write sets the version");
+        check(collect(log, 9) == std::vector<uint64_t> { 1, 2 }, "a write is visited once per frame");
+        check(collect(log, 10).empty(), "writes at the frame are not after it");
+        log.write(3, 11);
+        log.write(1, 12);
+        check(log.version(1) == 12, "a later write moves the version");
+        check(collect(log, 9) == std::vector<uint64_t> { 2, 3, 1 }, "an entity is visited at its last write");
+        check(collect(log, 10) == std::vector<uint64_t> { 3, 1 }, "read after a frame");
+        check(log.changed(1, 11) && !log.changed(2, 10), "changed compares the version");
+        log.clear(10);
+        check(log.version(2) == 0 && log.version(1) == 12 && log.size() == 2, "clear forgets the old writes only");
+        check(collect(log, 10) == std::vector<uint64_t> { 3, 1 }, "clear keeps the newer writes");
+        check(!log.changed_after(9, [](uint64_t) {}), "a frame older than the history is not answered");
+        check(log.changed(2, 9) && !log.changed(2, 10), "everything changed after a frame older than the history");
+        log.erase(3);
+        check(collect(log, 10) == std::vector<uint64_t> { 1 }, "erased entities are not visited");
+        log.clear(12);
+        check(log.size() == 0 && collect(log, 12).empty(), "clear everything");
+        log.write(2, 13);
+        check(collect(log, 12) == std::vector<uint64_t> { 2 }, "write after clear");
+    }
+    {
+        component_versions versions;
+        versions.log<test::bounding>().write(7, 1);
+        check(versions.logs.size() == 3, "one log per component id");
+        check(versions.log<test::scene>().size() == 0 && versions.log<test::bounding>().version(7) == 1, "logs are separate");
+        versions.log<test::scene>().write(7, 2);
+        versions.erase(7);
+        check(versions.log<test::scene>().size() == 0 && versions.log<test::bounding>().size() == 0, "erase from every log");
+        versions.log<test::bounding>().write(7, 2);
+        versions.clear(2);
+        check(versions.log<test::bounding>().size() == 0, "clear every log");
+    }
+
+    // 1% of the entities written every frame, the reader runs every frame and must find them
+    std::vector<uint64_t> dense(ENTITIES, 0);     // a version per entity, the scanning reader
+    component_versions versions;
+    auto& log = versions.log<test::scene>();
+    double scan_ms = 0., log_ms = 0.;
+    size_t scan_found = 0, log_found = 0;
+    bool same = true;
+    uint32_t x = 1;
+    for (uint64_t frame = 1; frame <= FRAMES; ++frame) {
+        std::vector<uint64_t> expect;
+        for (int i = 0; i < ENTITIES / 100; ++i) {
+            x = x * 1664525u + 1013904223u;
+            const uint64_t eid = (x >> 8) % ENTITIES;
+            dense[eid] = frame;
+            log.write(eid, frame);
+        }
+        auto start = std::chrono::steady_clock::now();
+        std::vector<uint64_t> a;
+        for (uint64_t eid = 0; eid < ENTITIES; ++eid) {
+            if (dense[eid] > frame - 1) {
+                a.push_back(eid);
+            }
+        }
+        auto mid = std::chrono::steady_clock::now();
+        std::vector<uint64_t> b;
+        log.changed_after(frame - 1, [&](uint64_t eid) { b.push_back(eid); });
+        auto end = std::chrono::steady_clock::now();
+        scan_ms += std::chrono::duration<double, std::milli>(mid - start).count();
+        log_ms += std::chrono::duration<double, std::milli>(end - mid).count();
+        scan_found += a.size();
+        log_found += b.size();
+        std::sort(b.begin(), b.end());
+        same = same && a == b;
+        if (frame > HISTORY) {
+            versions.clear(frame - HISTORY);
+        }
+    }
+    check(same, "the log finds the entities the scan finds");
+    check(log.size() <= (size_t)(ENTITIES / 100 * HISTORY), "clear bounds the history");
+    printf("%d entities, %d%% written per frame, %d frames\n", ENTITIES, 1, FRAMES);
+    printf("scan: %7.3f ms/frame, %zu found\n", scan_ms / FRAMES, scan_found);
+    printf("log:  %7.3f ms/frame, %zu found, %.1fx\n", log_ms / FRAMES, log_found, scan_ms / log_ms);
+
+    printf(failed ? "ecs_version_test: %d failure(s)\n" : "ecs_version_test: ok\n", failed);
+    return failed ? 1 : 0;
+}
@@ -24,6 +24,8 @@ int luaopen_datalist(lua_State* L);
 int luaopen_ecs_core(lua_State* L);
 int luaopen_ecs_components(lua_State* L);
 int luaopen_ecs_util(lua_State* L);
+int luaopen_ecs_jobs(lua_State* L);
+int luaopen_ecs_versions(lua_State* L);
 int luaopen_efk(lua_State* L);
 int luaopen_effekseer_callback(lua_State* L);
 int luaopen_fastio(lua_State* L);
@@ -51,11 +53,14 @@ int luaopen_material_core(lua_State *L);
 int luaopen_math3d(lua_State* L);
 int luaopen_math3d_adapter(lua_State* L);
 int luaopen_math3d_adapter_test(lua_State *L);
+int luaopen_meshopt(lua_State* L);
+int luaopen_bake(lua_State* L);
 int luaopen_motion_sampler(lua_State *L);
 int luaopen_motion_tween(lua_State *L);
 int luaopen_noise(lua_State *L);
 int luaopen_ozz(lua_State* L);
 int luaopen_ozz_offline(lua_State* L);
+int luaopen_profiler(lua_State* L);
 int luaopen_protocol(lua_State* L);
 int luaopen_programan_client(lua_State *L);
 int luaopen_programan_server(lua_State *L);
@@ -65,6 +70,11 @@ int luaopen_render_mesh(lua_State *L);
 int luaopen_render_cache(lua_State *L);
 int luaopen_rmlui(lua_State* L);
 int luaopen_system_cull(lua_State* L);
+int luaopen_shadow_cache(lua_State* L);
+int luaopen_shadow_cull(lua_State* L);
+int luaopen_light_cluster(lua_State* L);
+int luaopen_shadow_atlas(lua_State* L);
+int luaopen_pick_mesh(lua_State* L);
 int luaopen_system_render(lua_State *L);
 int luaopen_entity_drawer(lua_State *L);
 int luaopen_system_scene(lua_State* L);
@@ -122,6 +132,8 @@ void ant_loadmodules(lua_State* L) {
         { "ecs.core", luaopen_ecs_core},
         { "ecs.components", luaopen_ecs_components},
         { "ecs.util", luaopen_ecs_util},
+        { "ecs.jobs", luaopen_ecs_jobs},
+        { "ecs.versions", luaopen_ecs_versions},
         { "fastio", luaopen_fastio},
         { "render.material.arena",  luaopen_material_arena},
         { "render.material.core",   luaopen_material_core},
@@ -134,6 +146,9 @@ void ant_loadmodules(lua_State* L) {
         { "motion.sampler",     luaopen_motion_sampler},
         { "motion.tween",       luaopen_motion_tween},
         { "image", luaopen_image },
+        { "meshopt", luaopen_meshopt },
+        { "bake", luaopen_bake },
+        { "profiler", luaopen_profiler },
         { "imgui", luaopen_imgui },
         { "imgui.backend", luaopen_imgui_backend },
         { "imgui.internal", luaopen_imgui_internal },
@@ -142,6 +157,11 @@ void ant_loadmodules(lua_State* L) {
         { "firmware", luaopen_firmware },
         { "system.scene", luaopen_system_scene },
         { "cull.core", luaopen_system_cull},
+        { "shadow.cache", luaopen_shadow_cache},
+        { "shadow.cull", luaopen_shadow_cull},
+        { "light.cluster", luaopen_light_cluster},
+        { "shadow.atlas", luaopen_shadow_atlas},
+        { "pick.mesh", luaopen_pick_mesh},
         { "zip", luaopen_zip },
 #if !BX_PLATFORM_IOS && !BX_PLATFORM_ANDROID
         { "ozz.offline", luaopen_ozz_offline },
@@ -153,9 +173,7 @@ void ant_loadmodules(lua_State* L) {
 #endif
         { "window", luaopen_window },
         { "font.util", luaopen_font_util },
-#if !BX_PLATFORM_LINUX
         { "httpc", luaopen_httpc },
-#endif
 #if BX_PLATFORM_IOS
         { "ios", luaopen_ios },
         { "window.ios", luaopen_window_ios },
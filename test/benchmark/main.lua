@@ -0,0 +1,93 @@
+-- Headless benchmark of the native hot paths: worldmat update, cull and render submit with
+-- material apply, on synthetic worlds. bgfx runs the NOOP renderer, no window or GPU is needed.
+-- usage: ant test/benchmark/main.lua [--sizes 1000,10000,100000,1000000] [--frames 120] [--moving 0.01]
+--                                    [--output benchmark.json] [--baseline old.json] [--tolerance 1.25]
+-- A step is a regression when its mean time is over tolerance times the baseline.
+local ltask = require "ltask"
+local json = import_package "ant.json"
+
+-- steps under this are noise
+local MIN_COMPARE_MS <const> = 0.05
+local TRACKED <const> = {
+    "frame",
+    "worldmat_update",
+    "bounding_update",
+    "cull",
+    "render_collect",
+    "render_submit",
+}
+
+local options = {
+    sizes = "1000,10000,100000,1000000",
+    frames = "120",
+    moving = "0.01",
+    output = "benchmark.json",
+    tolerance = "1.25",
+}
+do
+    local args = { ... }
+    for i = 1, #args, 2 do
+        local key = args[i]:match "^%-%-(.+)$"
+        if not key or options[key] == nil and key ~= "baseline" then
+            error(("unknown option `%s`"):format(args[i]))
+        end
+        options[key] = assert(args[i+1], "missing option value")
+    end
+end
+
+local sizes = {}
+for n in options.sizes:gmatch "%d+" do
+    sizes[#sizes+1] = math.tointeger(n)
+end
+
+ltask.spawn_service {
+    unique = true,
+    name = "ant.hwi|bgfx",
+    worker_id = 1,
+}
+ltask.uniqueservice "ant.resource_manager|resource"
+local ServiceBench = ltask.uniqueservice "ant.test.benchmark|bench"
+local results = ltask.call(ServiceBench, "run", sizes, tonumber(options.frames), tonumber(options.moving))
+
+for _, r in ipairs(results) do
+    print(("%d entities, %d frames"):format(r.entities, r.frames))
+    for _, key in ipairs(TRACKED) do
+        local t = r[key]
+        if t then
+            print(("  %-16s mean %8.3fms  max %8.3fms"):format(key, t.mean, t.max))
+        end
+    end
+end
+
+do
+    local f <close> = assert(io.open(options.output, "wb"))
+    f:write(json.encode { results = results })
+end
+
+if options.baseline then
+    local f <close> = assert(io.open(options.baseline, "rb"))
+    local baseline = {}
+    for _, r in ipairs(json.decode(f:read "a").results) do
+        baseline[r.entities] = r
+    end
+    local tolerance = tonumber(options.tolerance)
+    local regressions = 0
+    for _, r in ipairs(results) do
+        local base = baseline[r.entities]
+        if base then
+            for _, key in ipairs(TRACKED) do
+                local now, before = r[key], base[key]
+                if now and before and before.mean >= MIN_COMPARE_MS then
+                    local ratio = now.mean / before.mean
+                    local bad = ratio > tolerance
+                    print(("%s %8d %-16s %8.3fms -> %8.3fms (x%.2f)"):format(bad and "SLOWER" or "      ", r.entities, key, before.mean, now.mean, ratio))
+                    if bad then
+                        regressions = regressions + 1
+                    end
+                end
+            end
+        end
+    end
+    assert(regressions == 0, ("%d step(s) are slower than the baseline"):format(regressions))
+end
+print "benchmark: ok"
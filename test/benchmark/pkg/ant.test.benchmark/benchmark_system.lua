@@ -0,0 +1,89 @@
+local ecs = ...
+local world = ecs.world
+local w = world.w
+
+local math3d = require "math3d"
+local iom = ecs.require "ant.objcontroller|obj_motion"
+
+-- A grid of cubes in groups of GROUP, the first cube of a group is the parent of the others.
+-- Every frame a part of the parents move, so their children need a new worldmat too.
+local GROUP <const> = 16
+local SPACING <const> = 3
+local MATERIAL <const> = "/pkg/ant.resources/materials/primitive.material"
+
+local cfg = world.args.ecs.benchmark
+local roots = {}
+local frame = 0
+local next_root = 1
+local camera_ready
+
+local m = ecs.system "benchmark_system"
+
+local function entity_ready()
+    cfg.ready = cfg.ready + 1
+end
+
+local function create_cube(t, parent)
+    return world:create_entity {
+        policy = {
+            "ant.render|render",
+        },
+        data = {
+            scene = {
+                t = t,
+                parent = parent,
+            },
+            material = MATERIAL,
+            visible = true,
+            mesh = "cube.primitive",
+            on_ready = entity_ready,
+        }
+    }
+end
+
+function m:init_world()
+    cfg.ready = 0
+    local side = math.ceil(cfg.count ^ (1/3))
+    local half = side * SPACING / 2
+    local root
+    for i = 0, cfg.count - 1 do
+        local x = (i % side) * SPACING - half
+        local y = (i // side % side) * SPACING - half
+        local z = (i // (side * side)) * SPACING - half
+        if i % GROUP == 0 then
+            root = { x, y, z, eid = create_cube { x, y, z } }
+            roots[#roots+1] = root
+        else
+            create_cube({ x - root[1], y - root[2], z - root[3] }, root.eid)
+        end
+    end
+    cfg.side = side * SPACING
+end
+
+local function setup_camera()
+    local mq = w:first "main_queue camera_ref:in"
+    if not mq then
+        return
+    end
+    local e <close> = world:entity(mq.camera_ref, "scene:update")
+    -- the far half of the grid is out of the frustum
+    iom.set_view(e, math3d.vector(0, cfg.side * 0.25, -cfg.side * 0.75), math3d.vector(0, -0.2, 1))
+    camera_ready = true
+end
+
+function m:data_changed()
+    if not camera_ready then
+        setup_camera()
+    end
+    frame = frame + 1
+    local offset = math.sin(frame * 0.1)
+    local n = math.ceil(#roots * cfg.moving)
+    for _ = 1, n do
+        local root = roots[next_root]
+        next_root = next_root % #roots + 1
+        local e <close> = world:entity(root.eid, "scene:update")
+        if e then
+            iom.set_position(e, math3d.vector(root[1] + offset, root[2], root[3]))
+        end
+    end
+end
@@ -0,0 +1,130 @@
+local bgfx      = require "bgfx"
+local profiler  = require "profiler"
+local assetmgr  = import_package "ant.asset"
+local new_world = import_package "ant.world".new_world
+local rhwi      = import_package "ant.hwi"
+
+rhwi.init_bgfx()
+
+local WIDTH <const> = 1280
+local HEIGHT <const> = 720
+local WARMUP_FRAMES <const> = 10
+local LOAD_TIMEOUT_FRAMES <const> = 100000
+
+-- the steps we track between runs, the rest of the systems are reported too
+local TRACKED <const> = {
+    frame = "^_update$",
+    worldmat_update = "scenespace_system%.scene_changed$",
+    bounding_update = "scenespace_system%.bounding_update$",
+    cull = "cull_system%.cull$",
+    render_collect = "submit_render_system%.render_collect$",
+    render_submit = "submit_render_system%.render_submit$",     -- material apply is a part of it
+}
+
+local S = {}
+
+local function frame(world)
+    world:dispatch_message { type = "update" }
+    bgfx.encoder_begin()
+    world:pipeline_update()
+    bgfx.encoder_end()
+    world._frametime = bgfx.encoder_frame()
+end
+
+local function run(count, frames, moving)
+    local cfg = {
+        count = count,
+        moving = moving,
+        ready = 0,
+    }
+    bgfx.encoder_begin()
+    local world = new_world {
+        ecs = {
+            profile = false,
+            feature = {
+                "ant.test.benchmark",
+                "ant.render",
+                "ant.pipeline",
+            },
+            benchmark = cfg,
+        },
+        width = WIDTH,
+        height = HEIGHT,
+    }
+    world:dispatch_message {
+        type = "window_init",
+        size = {
+            w = WIDTH,
+            h = HEIGHT,
+        },
+    }
+    world:dispatch_message { type = "update" }
+    world:pipeline_init()
+    bgfx.encoder_end()
+
+    local n = 0
+    while cfg.ready < count do
+        frame(world)
+        n = n + 1
+        if n > LOAD_TIMEOUT_FRAMES then
+            error(("only %d of %d entities are ready"):format(cfg.ready, count))
+        end
+    end
+    for _ = 1, WARMUP_FRAMES do
+        frame(world)
+    end
+
+    profiler.clear()
+    profiler.enable(true)
+    for _ = 1, frames do
+        frame(world)
+    end
+    profiler.enable(false)
+    local stat = profiler.stat()
+    profiler.clear()
+
+    world:pipeline_exit()
+    bgfx.encoder_frame()
+    world = nil
+    collectgarbage "collect"
+
+    local systems = {}
+    local result = {
+        entities = count,
+        frames = frames,
+        systems = systems,
+    }
+    for name, v in pairs(stat) do
+        local t = {
+            mean = v.total / v.count / 1e6,
+            max = v.max / 1e6,
+        }
+        systems[name] = t
+        for key, pattern in pairs(TRACKED) do
+            if name:match(pattern) then
+                result[key] = t
+            end
+        end
+    end
+    return result
+end
+
+function S.run(sizes, frames, moving)
+    rhwi.init {
+        renderer = "NOOP",
+        width = WIDTH,
+        height = HEIGHT,
+    }
+    bgfx.encoder_create "world"
+    bgfx.encoder_init()
+    assetmgr.init()
+    local results = {}
+    for i, count in ipairs(sizes) do
+        results[i] = run(count, frames, moving)
+    end
+    bgfx.encoder_destroy()
+    bgfx.shutdown()
+    return results
+end
+
+return S
@@ -0,0 +1,365 @@
+-- End to end test of the fileserver protocol over a loopback socket.
+-- It fetches the same blobs with protocol 1 (a GET at a time, 2 bytes chunks)
+-- and protocol 2 (SHAKEHANDS 2, MANIFEST, GETS window, 4 bytes chunks, ZBLOB),
+-- through a link with latency and bandwidth, and prints the throughput.
+--
+-- main.lua [latency(ms) [bandwidth(MB/s) [size(MB)]]]
+
+local socket = require "bee.socket"
+local bee_select = require "bee.select"
+local btime = require "bee.time"
+local fs = require "bee.filesystem"
+local serialization = require "bee.serialization"
+local protocol = require "protocol"
+local zip = require "zip"
+
+local selector = bee_select.create()
+local SELECT_READ <const> = bee_select.SELECT_READ
+
+local arg = ...
+local LATENCY <const> = tonumber(arg[1]) or 20
+local BANDWIDTH <const> = (tonumber(arg[2]) or 4) * 1024 * 1024 / 1000	-- bytes per ms
+local TOTAL_SIZE <const> = (tonumber(arg[3]) or 4) * 1024 * 1024
+local ADDRESS <const> = "127.0.0.1"
+local PORT <const> = 2021
+local ROOT <const> = ("0"):rep(40)
+
+-- the same as engine/firmware/io.lua and tools/fileserver/pkg/s/service/agent.lua
+local PREFETCH_WINDOW <const> = 2 * 1024 * 1024
+local PREFETCH_BATCH <const> = 256
+local SLICE_SIZE <const> = 0x8000
+local BLOB_SIZE <const> = 4 * 1024 * 1024
+local LONG_SLICE_SIZE <const> = 1024 * 1024
+local COMPRESS_SIZE <const> = 64
+
+local blobs = {}
+local manifest = {}
+local dictionary
+do
+	local TEXT <const> = {
+		[".lua"] = true,
+		[".ecs"] = true,
+		[".prefab"] = true,
+		[".material"] = true,
+	}
+	local size = 0
+	local heads = {}
+	local function walk(dir)
+		for path in fs.pairs(dir) do
+			if size >= TOTAL_SIZE then
+				return
+			end
+			if fs.is_directory(path) then
+				walk(path)
+			else
+				local f <close> = assert(io.open(path:string(), "rb"))
+				local data = f:read "a"
+				local hash = ("%040x"):format(#manifest + 1)
+				blobs[hash] = data
+				manifest[#manifest+1] = hash .. " " .. #data .. "\n"
+				size = size + #data
+				if #heads < 32 and TEXT[path:extension()] then
+					heads[#heads+1] = data:sub(1, 1024)
+				end
+			end
+		end
+	end
+	walk(fs.path "pkg")
+	dictionary = table.concat(heads)
+	manifest = table.concat(manifest)
+end
+
+-- A side of the connection : what it receives is delayed by LATENCY,
+-- what it sends is limited by bandwidth.
+local function link(fd, bandwidth)
+	return {
+		fd = fd,
+		delayed = {},
+		reading = {},
+		sending = {},
+		bandwidth = bandwidth,
+		budget = 0,
+		last = btime.monotonic(),
+		sent = 0,
+		long_recv = false,
+		long_send = false,
+	}
+end
+
+local function link_recv(l, now)
+	while true do
+		local data = l.fd:recv()
+		if data == nil then
+			error "Connection closed"
+		elseif data == false then
+			break
+		end
+		l.delayed[#l.delayed+1] = { time = now + LATENCY, data = data }
+	end
+	while l.delayed[1] and l.delayed[1].time <= now do
+		table.insert(l.reading, table.remove(l.delayed, 1).data)
+	end
+end
+
+local function link_send(l, now)
+	local budget = math.huge
+	if l.bandwidth then
+		-- allows bursts of 10ms
+		budget = math.min(l.budget + (now - l.last) * l.bandwidth, l.bandwidth * 10)
+		l.last = now
+	end
+	while l.sending[1] and budget >= 1 do
+		local data = l.sending[1]
+		if #data > budget then
+			data = data:sub(1, math.floor(budget))
+		end
+		local n = l.fd:send(data)
+		if not n then
+			break
+		end
+		budget = budget - n
+		l.sent = l.sent + n
+		if n < #l.sending[1] then
+			l.sending[1] = l.sending[1]:sub(n+1)
+			if n < #data then
+				break
+			end
+		else
+			table.remove(l.sending, 1)
+		end
+	end
+	if l.bandwidth then
+		l.budget = budget
+	end
+end
+
+local function link_write(l, ...)
+	l.sending[#l.sending+1] = string.pack(l.long_send and "<s4" or "<s2", serialization.packstring(...))
+end
+
+local function link_read(l)
+	local msg = protocol.readchunk(l.reading, l.long_recv)
+	if msg then
+		return serialization.unpack(msg)
+	end
+end
+
+local function new_server(fd)
+	local server = link(fd, BANDWIDTH)
+	local version = 1
+	local S = {}
+	local function out(...)
+		link_write(server, ...)
+	end
+	function S.SHAKEHANDS(v)
+		if tonumber(v or 1) >= 2 then
+			out("SHAKEHANDS", "2", dictionary)
+			version = 2
+			server.long_send = true
+		end
+	end
+	function S.MANIFEST(root)
+		out("MANIFEST", root, zip.compress(manifest))
+	end
+	function S.GET(hash)
+		local data = blobs[hash]
+		if not data then
+			out("MISSING", hash)
+			return
+		end
+		local sz = #data
+		local blob_size = version >= 2 and BLOB_SIZE or SLICE_SIZE
+		local slice_size = version >= 2 and LONG_SLICE_SIZE or SLICE_SIZE
+		if sz < blob_size then
+			if version >= 2 and sz >= COMPRESS_SIZE then
+				local z = zip.compress(data, dictionary ~= "" and dictionary or nil)
+				if #z < sz - sz // 8 then
+					out("ZBLOB", hash, z)
+					return
+				end
+			end
+			out("BLOB", hash, data)
+			return
+		end
+		out("FILE", hash, tostring(sz))
+		for offset = 0, sz - 1, slice_size do
+			out("SLICE", hash, tostring(offset), data:sub(offset + 1, offset + slice_size))
+		end
+	end
+	function S.GETS(...)
+		for i = 1, select("#", ...) do
+			S.GET(select(i, ...))
+		end
+	end
+	local function dispatch(cmd, ...)
+		assert(S[cmd], cmd)(...)
+	end
+	function server.dispatch()
+		while true do
+			local msg = protocol.readchunk(server.reading)
+			if msg == nil then
+				break
+			end
+			dispatch(serialization.unpack(msg))
+		end
+	end
+	return server
+end
+
+local function recv(l)
+	while true do
+		local r = table.pack(link_read(l))
+		if r.n > 0 then
+			return table.unpack(r, 1, r.n)
+		end
+		coroutine.yield()
+	end
+end
+
+local function recv_file(l, size)
+	local slices = {}
+	local n = 0
+	while n < size do
+		local cmd, _, _, data = recv(l)
+		assert(cmd == "SLICE", cmd)
+		slices[#slices+1] = data
+		n = n + #data
+	end
+	return table.concat(slices)
+end
+
+-- protocol 1 : a GET at a time; the hashes are known, as if the dirs were read
+local function fetch_v1(l, result)
+	for hash in manifest:gmatch "(%x+) %d+" do
+		link_write(l, "GET", hash)
+		local cmd, h, data = recv(l)
+		assert(h == hash)
+		if cmd == "BLOB" then
+			result[h] = data
+		elseif cmd == "FILE" then
+			result[h] = recv_file(l, tonumber(data))
+		else
+			error(cmd)
+		end
+	end
+end
+
+-- protocol 2 : the manifest is prefetched with GETS, PREFETCH_WINDOW bytes in flight
+local function fetch_v2(l, result)
+	link_write(l, "SHAKEHANDS", "2")
+	local cmd, version, dict = recv(l)
+	assert(cmd == "SHAKEHANDS" and version == "2")
+	-- the replies after SHAKEHANDS 2 are long chunks, the requests are still short
+	l.long_recv = true
+	dict = dict ~= "" and dict or nil
+	link_write(l, "MANIFEST", ROOT)
+	local _, root, list = recv(l)
+	assert(root == ROOT)
+	local queue = {}
+	local size = {}
+	for hash, sz in zip.uncompress(list):gmatch "(%x+) (%d+)" do
+		queue[#queue+1] = hash
+		size[hash] = tonumber(sz)
+	end
+	local index = 1
+	local inflight = 0
+	local files = {}
+	local done = 0
+	while done < #queue do
+		local batch = {}
+		while inflight < PREFETCH_WINDOW and #batch < PREFETCH_BATCH and queue[index] do
+			local hash = queue[index]
+			index = index + 1
+			inflight = inflight + size[hash]
+			batch[#batch+1] = hash
+		end
+		if #batch > 0 then
+			link_write(l, "GETS", table.unpack(batch))
+		end
+		local cmd, hash, a, b = recv(l)
+		local data
+		if cmd == "BLOB" then
+			data = a
+		elseif cmd == "ZBLOB" then
+			data = zip.uncompress(a, dict)
+		elseif cmd == "FILE" then
+			files[hash] = { size = tonumber(a), n = 0 }
+		elseif cmd == "SLICE" then
+			local f = files[hash]
+			f[#f+1] = b
+			f.n = f.n + #b
+			if f.n >= f.size then
+				files[hash] = nil
+				data = table.concat(f)
+			end
+		else
+			error(cmd)
+		end
+		if data then
+			result[hash] = data
+			inflight = inflight - size[hash]
+			done = done + 1
+		end
+	end
+end
+
+local listen_fd = assert(socket.create "tcp")
+assert(listen_fd:bind(ADDRESS, PORT))
+assert(listen_fd:listen())
+selector:event_add(listen_fd, SELECT_READ)
+
+local function run(name, fetch)
+	local client_fd = assert(socket.create "tcp")
+	assert(client_fd:connect(ADDRESS, PORT) ~= nil)
+	local server_fd
+	while not server_fd do
+		for _ in selector:wait(100) do
+			server_fd = listen_fd:accept() or nil
+		end
+	end
+	selector:event_add(client_fd, SELECT_READ)
+	selector:event_add(server_fd, SELECT_READ)
+
+	local server = new_server(server_fd)
+	local client = link(client_fd)
+	local result = {}
+	local co = coroutine.create(fetch)
+	local start = btime.monotonic()
+	assert(coroutine.resume(co, client, result))
+	while coroutine.status(co) ~= "dead" do
+		for _ in selector:wait(1) do
+		end
+		local now = btime.monotonic()
+		link_recv(server, now)
+		server.dispatch()
+		link_send(server, now)
+		link_recv(client, now)
+		assert(coroutine.resume(co))
+		link_send(client, now)
+	end
+	local time = math.max(btime.monotonic() - start, 1)
+
+	local n = 0
+	local size = 0
+	for hash, data in pairs(blobs) do
+		assert(result[hash] == data, hash)
+		n = n + 1
+		size = size + #data
+	end
+	print(("%s : %d blobs, %.2f MB (%.2f MB on the wire) in %d ms, %.2f MB/s"):format(
+		name, n, size / 1048576, server.sent / 1048576, time, size / 1048576 / (time / 1000)))
+
+	selector:event_del(client_fd)
+	selector:event_del(server_fd)
+	client_fd:close()
+	server_fd:close()
+	return time
+end
+
+print(("latency %d ms, bandwidth %.1f MB/s"):format(LATENCY, BANDWIDTH * 1000 / 1048576))
+local t1 = run("protocol 1", fetch_v1)
+local t2 = run("protocol 2", fetch_v2)
+print(("speedup %.1fx"):format(t1 / t2))
+
+selector:event_del(listen_fd)
+listen_fd:close()
@@ -0,0 +1,90 @@
+-- Compiles every material of a project twice with the project shader directory removed
+-- in between. The second pass must get every shader from the shared cache.
+-- Then an include is touched, the shaders with it must not come from the project cache.
+-- usage: ant test/shadercache/main.lua <projectpath> [os]
+local ltask = require "ltask"
+local fs = require "bee.filesystem"
+local platform = require "bee.platform"
+local vfsrepo = import_package "ant.vfs"
+local cr = import_package "ant.compile_resource"
+
+local path, config_os = ...
+local repopath = fs.absolute(assert(path, "Need the project path")):lexically_normal()
+
+local platform_relates <const> = {
+    windows = "direct3d11",
+    macos = "metal",
+    ios = "metal",
+    android = "vulkan",
+}
+config_os = config_os or platform.os
+local setting = ("%s-%s"):format(config_os, platform_relates[config_os])
+
+local function compile_materials(keep_shaders)
+    fs.remove_all(repopath / "res" / setting / "material")
+    if not keep_shaders then
+        fs.remove_all(repopath / ".app" / "build" / "shader")
+    end
+    cr.reset_shader_stat()
+
+    local std_vfs <close> = vfsrepo.new_std {
+        rootpath = repopath,
+        nohash = true,
+    }
+    local cfg = cr.init_setting(vfsrepo.new_tiny(repopath), setting)
+    local names, paths = std_vfs:export_resources()
+    local tasks = {}
+    for i = 1, #names do
+        if names[i]:match "%.material$" then
+            tasks[#tasks+1] = { cr.compile_file, cfg, names[i], paths[i] }
+        end
+    end
+    for _, resp in ltask.parallel(tasks) do
+        if resp.error then
+            resp:rethrow()
+        end
+    end
+    local stat = cr.shader_stat()
+    print(("materials: %d, shaders: compiled %d, shared cache %d, project cache %d"):format(#tasks, stat.miss, stat.hit, stat.local_hit))
+    return stat
+end
+
+-- an include from the depends of the project shader directory
+local function find_include()
+    for dir in fs.pairs(repopath / ".app" / "build" / "shader") do
+        local f = io.open((dir / ".dep"):string())
+        if f then
+            local deps = f:read "a"
+            f:close()
+            local include = deps:match '"([^"]-%.sh)"'
+            if include then
+                return include
+            end
+        end
+    end
+end
+
+-- rewrites the file with the same content, only its write time changes
+local function touch(filename)
+    local f = assert(io.open(filename, "rb"))
+    local content = f:read "a"
+    f:close()
+    f = assert(io.open(filename, "wb"))
+    f:write(content)
+    f:close()
+end
+
+print "pass 1."
+compile_materials()
+print "pass 2."
+local stat = compile_materials()
+assert(stat.miss == 0, "shaders are compiled again")
+assert(stat.local_hit == 0, "the project shader directory is not removed")
+local total = stat.hit
+local include = assert(find_include(), "no shader has an include")
+print("pass 3. touch " .. include)
+touch(include)
+stat = compile_materials(true)
+assert(stat.local_hit < total, "the touched include does not invalidate the project cache")
+assert(stat.miss + stat.hit > 0, "the shaders with the touched include are not compiled")
+print "shadercache: ok"
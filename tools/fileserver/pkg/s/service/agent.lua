@@ -2,6 +2,7 @@ local ltask = require "ltask"
 local socket = require "socket"
 local protocol = require "protocol"
 local serialization = require "bee.serialization"
+local zip = require "zip"
 
 local FD = ...
 
@@ -32,8 +33,16 @@ ltask.fork(function ()
 end)
 
 
+-- 2 after SHAKEHANDS 2 : long chunks, GETS, MANIFEST and ZBLOB
+local ProtocolVersion = 1
+local Dictionary
+
+local function pack(...)
+	return string.pack(ProtocolVersion >= 2 and "<s4" or "<s2", serialization.packstring(...))
+end
+
 local function response(...)
-	if socket.send(FD, string.pack("<s2", serialization.packstring(...))) == nil then
+	if socket.send(FD, pack(...)) == nil then
 		quit = true
 	end
 end
@@ -161,7 +170,12 @@ function message.DEBUGGER_RESP(port, session, resp)
 	end
 end
 
-function message.SHAKEHANDS()
+function message.SHAKEHANDS(version)
+	if tonumber(version or 1) >= 2 then
+		Dictionary = ltask.call(ServiceVfsMgr, "DICTIONARY")
+		response("SHAKEHANDS", "2", Dictionary)
+		ProtocolVersion = 2
+	end
 end
 
 function message.ROOT()
@@ -186,53 +200,107 @@ function message.RESOURCE(path)
 	end
 end
 
-function message.GET(hash)
+local SLICE_SIZE <const> = 0x8000
+-- protocol 2
+local BLOB_SIZE <const> = 4 * 1024 * 1024
+local LONG_SLICE_SIZE <const> = 1024 * 1024
+local COMPRESS_SIZE <const> = 64
+local SEND_SIZE <const> = 1024 * 1024
+
+-- out(...) for every reply of the blob of hash
+local function get(hash, out)
 	local v = ltask.call(ServiceVfsMgr, "GET", hash)
 	if not v then
-		response("MISSING", hash)
-	elseif v.dir then
-		local content = v.dir
-		local sz = #content
-		if sz < 0x8000 then
-			response("BLOB", hash, content)
-		else
-			response("FILE", hash, tostring(sz))
-			local offset = 0
-			while true do
-				local data = content:sub(offset+1, offset+0x8000)
-				response("SLICE", hash, tostring(offset), data)
-				offset = offset + #data
-				if offset >= sz then
-					break
-				end
-			end
-		end
+		out("MISSING", hash)
+		return
+	end
+	local content, f
+	if v.dir then
+		content = v.dir
 	else
-		local f = io.open(v.path, "rb")
+		f = io.open(v.path, "rb")
 		if not f then
-			response("MISSING", hash)
+			out("MISSING", hash)
 			return
 		end
-		local sz = f:seek "end"
-		f:seek("set", 0)
-		if sz < 0x8000 then
-			response("BLOB", hash, f:read "a")
-		else
-			response("FILE", hash, tostring(sz))
-			local offset = 0
-			while true do
-				local data = f:read(0x8000)
-				response("SLICE", hash, tostring(offset), data)
-				offset = offset + #data
-				if offset >= sz then
-					break
-				end
+	end
+	local sz = content and #content or f:seek "end"
+	local blob_size = ProtocolVersion >= 2 and BLOB_SIZE or SLICE_SIZE
+	local slice_size = ProtocolVersion >= 2 and LONG_SLICE_SIZE or SLICE_SIZE
+	if sz < blob_size then
+		if f then
+			f:seek("set", 0)
+			content = f:read "a"
+			f:close()
+		end
+		if ProtocolVersion >= 2 and sz >= COMPRESS_SIZE then
+			local z = zip.compress(content, Dictionary ~= "" and Dictionary or nil)
+			if #z < sz - sz // 8 then
+				out("ZBLOB", hash, z)
+				return
 			end
 		end
+		out("BLOB", hash, content)
+		return
+	end
+	out("FILE", hash, tostring(sz))
+	if f then
+		f:seek("set", 0)
+	end
+	local offset = 0
+	while true do
+		local data = f and f:read(slice_size) or content:sub(offset+1, offset+slice_size)
+		out("SLICE", hash, tostring(offset), data)
+		offset = offset + #data
+		if offset >= sz then
+			break
+		end
+	end
+	if f then
 		f:close()
 	end
 end
 
+function message.GET(hash)
+	get(hash, response)
+end
+
+-- protocol 2, the replies are sent together
+function message.GETS(...)
+	local frames = {}
+	local size = 0
+	local function flush()
+		if size > 0 then
+			if socket.send(FD, table.concat(frames)) == nil then
+				quit = true
+			end
+			frames = {}
+			size = 0
+		end
+	end
+	local function out(...)
+		local frame = pack(...)
+		frames[#frames+1] = frame
+		size = size + #frame
+		if size >= SEND_SIZE then
+			flush()
+		end
+	end
+	for i = 1, select("#", ...) do
+		if quit then
+			return
+		end
+		get(select(i, ...), out)
+	end
+	flush()
+end
+
+-- protocol 2, the blobs of the tree of hash for prefetching
+function message.MANIFEST(hash)
+	local manifest = ltask.call(ServiceVfsMgr, "MANIFEST", hash)
+	response("MANIFEST", hash, zip.compress(manifest))
+end
+
 function message.LOG(data)
 	ltask.send(ServiceEditor, "MESSAGE", "LOG", "RUNTIME", data)
 	LoggerQueue[#LoggerQueue+1] = data
@@ -244,6 +312,7 @@ end
 local ignore_log = {
 	LOG = true,
 	TUNNEL_RESP = true,
+	GETS = true,
 }
 
 local function dispatch_netmsg(cmd, ...)
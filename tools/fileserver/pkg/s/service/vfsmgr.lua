@@ -122,6 +122,123 @@ function S.GET(hash)
 	return repo:hash(hash)
 end
 
+-- f(type, name, hash) for every entry of the tree of root, once per directory hash
+local function walk(root, f)
+	local queue = { root }
+	local visited = { [root] = true }
+	local i = 1
+	while queue[i] do
+		local v = repo:hash(queue[i])
+		if v and v.dir then
+			for type, name, hash in v.dir:gmatch "([dfr]) (%S*) (%S*)\n" do
+				f(type, name, hash)
+				if type == "d" and not visited[hash] then
+					visited[hash] = true
+					queue[#queue+1] = hash
+				end
+			end
+		end
+		i = i + 1
+	end
+end
+
+local function blob_size(v)
+	if v.dir then
+		return #v.dir
+	end
+	local ok, size = pcall(fs.file_size, v.path)
+	return ok and size
+end
+
+-- "hash size" lines of the directories then the files of root, the device prefetches them
+local Manifest = {}
+
+function S.MANIFEST(root)
+	if Manifest.root == root then
+		return Manifest.content
+	end
+	local dirs = {}
+	local files = {}
+	local seen = {}
+	local function add(list, hash)
+		if seen[hash] then
+			return
+		end
+		seen[hash] = true
+		local v = repo:hash(hash)
+		local size = v and blob_size(v)
+		if size then
+			list[#list+1] = hash .. " " .. size
+		end
+	end
+	add(dirs, root)
+	walk(root, function (type, _, hash)
+		if type == "d" then
+			add(dirs, hash)
+		elseif type == "f" then
+			add(files, hash)
+		end
+	end)
+	dirs[#dirs+1] = ""
+	Manifest.root = root
+	Manifest.content = table.concat(dirs, "\n") .. table.concat(files, "\n")
+	return Manifest.content
+end
+
+-- Preset dictionary of ZBLOB, the heads of text files taken in turn from every extension.
+-- Built once, so it doesn't change for a device when the repo is rebuilt.
+local DICTIONARY_SIZE <const> = 32 * 1024
+local DICTIONARY_SAMPLE <const> = 1024
+local DICTIONARY_EXT <const> = {
+	lua = true, ecs = true, prefab = true, material = true, ant = true,
+	rml = true, rcss = true, sc = true, sh = true, def = true,
+}
+local Dictionary
+
+function S.DICTIONARY()
+	if Dictionary then
+		return Dictionary
+	end
+	local exts = {}
+	local files = {}
+	walk(repo:root(), function (type, name, hash)
+		local ext = type == "f" and name:match "%.(%w+)$"
+		if ext and DICTIONARY_EXT[ext] then
+			if not files[ext] then
+				exts[#exts+1] = ext
+				files[ext] = {}
+			end
+			table.insert(files[ext], hash)
+		end
+	end)
+	table.sort(exts)
+	local samples = {}
+	local size = 0
+	local i = 1
+	while size < DICTIONARY_SIZE do
+		local more
+		for _, ext in ipairs(exts) do
+			local v = files[ext][i] and repo:hash(files[ext][i])
+			local f = v and v.path and io.open(v.path, "rb")
+			if f then
+				local data = f:read(DICTIONARY_SAMPLE)
+				f:close()
+				if data then
+					samples[#samples+1] = data
+					size = size + #data
+				end
+				more = true
+			end
+		end
+		if not more then
+			break
+		end
+		i = i + 1
+	end
+	Dictionary = table.concat(samples):sub(1, DICTIONARY_SIZE)
+	return Dictionary
+end
+
 function S.REALPATH(path)
 	local file = repo:file(path)
 	if file and file.path then